@@ -48,6 +48,9 @@ namespace EchoRelay.Cli
             [Option('p', "port", Required = false, Default = 777, HelpText = "The TCP port to broadcast central services over.")]
             public int Port { get; set; }
 
+            [Option("serverdbport", Required = false, Default = null, HelpText = "The TCP port to broadcast ServerDB over, separately from the other central services. By default, it shares the port set by --port.")]
+            public int? ServerDBPort { get; set; }
+
             [Option("apikey", Required = false, Default = null, HelpText = "Requires a specific API key as part of the ServerDB connection URI query parameters.")]
             public string? ServerDBApiKey { get; set; }
 
@@ -69,6 +72,15 @@ namespace EchoRelay.Cli
             [Option("servervalidationtimeout", Required = false, Default = 3000, HelpText = "Sets the timeout for game server validation using raw ping requests. In milliseconds.")]
             public int ServerDBValidateGameServersTimeout { get; set; }
 
+            [Option("sessiontracerate", Required = false, Default = 0.0, HelpText = "Sets the portion of game server sessions (0.0-1.0) to write lifecycle trace spans for. Game servers should be configured with the same rate.")]
+            public double SessionTraceSampleRate { get; set; }
+
+            [Option("sessiontracedir", Required = false, Default = null, HelpText = "Sets the directory session trace files are written to. Defaults to a \"traces\" folder within the database folder.")]
+            public string? SessionTraceDirectory { get; set; }
+
+            [Option("accountlog", Required = false, Default = false, HelpText = "Stores accounts in a single append-only log within the database folder, rather than as individual files. Existing account files are imported when the log is first created.")]
+            public bool UseAccountLog { get; set; }
+
             [Option('v', "verbose", Required = false, Default = false, HelpText = "Verbose output for every message sent between clients and servers.")]
             public bool Verbose { get; set; } = true;
         }
@@ -100,7 +112,7 @@ namespace EchoRelay.Cli
                 }
 
                 // Create our file system storage and open it.
-                ServerStorage serverStorage = new FilesystemServerStorage(options.DatabaseFolder);
+                ServerStorage serverStorage = new FilesystemServerStorage(options.DatabaseFolder, options.UseAccountLog);
                 serverStorage.Open();
 
                 // Check if initial deployment needs to be performed.
@@ -131,7 +143,10 @@ namespace EchoRelay.Cli
                         serverDBValidateServerEndpoint: options.ServerDBValidateGameServers,
                         serverDBValidateServerEndpointTimeout: options.ServerDBValidateGameServersTimeout,
                         favorPopulationOverPing: !options.LowPingMatching,
-                        forceIntoAnySessionIfCreationFails: options.ForceMatching
+                        forceIntoAnySessionIfCreationFails: options.ForceMatching,
+                        sessionTraceSampleRate: options.SessionTraceSampleRate,
+                        sessionTraceDirectory: options.SessionTraceDirectory ?? Path.Combine(options.DatabaseFolder, "traces"),
+                        serverDBPort: (ushort?)options.ServerDBPort
                         )
                     );
 
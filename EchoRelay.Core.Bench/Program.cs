@@ -0,0 +1,194 @@
+﻿using CommandLine;
+using EchoRelay.Core.Game;
+using EchoRelay.Core.Server.Storage;
+using EchoRelay.Core.Server.Storage.Filesystem;
+using EchoRelay.Core.Server.Storage.Types;
+using System.Diagnostics;
+
+namespace EchoRelay.Core.Bench
+{
+    class Program
+    {
+        /// <summary>
+        /// The CLI argument options for the application.
+        /// </summary>
+        public class BenchOptions
+        {
+            [Option('d', "directory", Required = false, Default = null, HelpText = "The directory to create the benchmark databases in. Defaults to a new temporary directory, which is deleted afterwards.")]
+            public string? Directory { get; set; }
+
+            [Option("accounts", Required = false, Default = 1000000, HelpText = "The amount of accounts to store.")]
+            public int Accounts { get; set; }
+
+            [Option("reads", Required = false, Default = 100000, HelpText = "The amount of random account reads to measure.")]
+            public int Reads { get; set; }
+
+            [Option("writes", Required = false, Default = 10000, HelpText = "The amount of random account updates to measure.")]
+            public int Writes { get; set; }
+
+            [Option("nojson", Required = false, Default = false, HelpText = "Skips the JSON file provider, benchmarking only the account log.")]
+            public bool SkipJson { get; set; }
+
+            [Option("registry", Required = false, Default = false, HelpText = "Benchmarks the game server registry's indexes against scanning, rather than the account providers.")]
+            public bool Registry { get; set; }
+
+            [Option("servers", Required = false, Default = 100000, HelpText = "The amount of game servers to register, for the registry benchmark.")]
+            public int Servers { get; set; }
+
+            [Option("queries", Required = false, Default = 10000, HelpText = "The amount of times to run each query, for the registry benchmark.")]
+            public int Queries { get; set; }
+        }
+
+        /// <summary>
+        /// The results of benchmarking a storage provider.
+        /// </summary>
+        private class BenchResult
+        {
+            public string Name = "";
+            public TimeSpan PopulateTime;
+            public long SizeOnDisk;
+            public TimeSpan OpenTime;
+            public long OpenMemory;
+            public double[] ReadMicroseconds = Array.Empty<double>();
+            public double[] WriteMicroseconds = Array.Empty<double>();
+        }
+
+        /// <summary>
+        /// The main entry point for the application.
+        /// </summary>
+        /// <param name="args">The command-line arguments the application was invoked with.</param>
+        static void Main(string[] args)
+        {
+            Parser.Default.ParseArguments<BenchOptions>(args).WithParsed(options =>
+            {
+                // Create the directory the databases are written to. The temporary directory is named in lowercase, as the
+                // filesystem providers normalize the paths they access to lowercase.
+                bool temporary = options.Directory == null;
+                string rootDirectory = options.Directory ?? Path.Join(Path.GetTempPath(), $"echorelay-core-bench-{Environment.ProcessId}");
+                Directory.CreateDirectory(rootDirectory);
+                try
+                {
+                    // If we are benchmarking the game server registry, do so instead of the account providers.
+                    if (options.Registry)
+                    {
+                        RegistryBench.Run(options, rootDirectory);
+                        return;
+                    }
+
+                    // Benchmark each account provider with the same accounts and access pattern.
+                    List<BenchResult> results = new List<BenchResult>();
+                    if (!options.SkipJson)
+                        results.Add(Run("json files", Path.Join(rootDirectory, "json"), false, options));
+                    results.Add(Run("account log", Path.Join(rootDirectory, "log"), true, options));
+
+                    // Print the results side by side.
+                    Console.WriteLine();
+                    Console.WriteLine($"{options.Accounts} accounts, {options.Reads} random reads, {options.Writes} random updates");
+                    Console.WriteLine($"{"provider",-12} {"populate",10} {"disk",10} {"open",10} {"open mem",10} | {"read mean",10} {"p50",8} {"p99",8} {"max",8} | {"write mean",10} {"p99",8}");
+                    foreach (BenchResult result in results)
+                    {
+                        Console.WriteLine($"{result.Name,-12} {result.PopulateTime.TotalSeconds,9:F1}s {result.SizeOnDisk / 1048576.0,8:F0}MB {result.OpenTime.TotalSeconds,9:F2}s {result.OpenMemory / 1048576.0,8:F0}MB | " +
+                            $"{result.ReadMicroseconds.Average(),8:F1}us {Percentile(result.ReadMicroseconds, 0.5),6:F1}us {Percentile(result.ReadMicroseconds, 0.99),6:F1}us {result.ReadMicroseconds.Max(),6:F0}us | " +
+                            $"{result.WriteMicroseconds.Average(),8:F1}us {Percentile(result.WriteMicroseconds, 0.99),6:F1}us");
+                    }
+                }
+                finally
+                {
+                    if (temporary)
+                        Directory.Delete(rootDirectory, true);
+                }
+            });
+        }
+
+        /// <summary>
+        /// Benchmarks the accounts provider of a <see cref="FilesystemServerStorage"/>: populating it, opening it, then reading and updating random accounts.
+        /// </summary>
+        /// <param name="name">The name of the provider, for display.</param>
+        /// <param name="databaseDirectory">The directory to create the database in.</param>
+        /// <param name="useAccountLog">Indicates whether accounts are stored in the account log, rather than as individual files.</param>
+        /// <param name="options">The benchmark options.</param>
+        /// <returns>The benchmark results.</returns>
+        private static BenchResult Run(string name, string databaseDirectory, bool useAccountLog, BenchOptions options)
+        {
+            BenchResult result = new BenchResult() { Name = name };
+
+            // Populate the database, if it was not populated by a previous run.
+            ServerStorage storage;
+            Console.WriteLine($"[{name}] populating {options.Accounts} accounts..");
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            storage = new FilesystemServerStorage(databaseDirectory, useAccountLog);
+            storage.Open();
+            for (int i = storage.Accounts.Keys().Length; i < options.Accounts; i++)
+                storage.Accounts.Set(CreateAccount(i));
+            storage.Close();
+            result.PopulateTime = stopwatch.Elapsed;
+            result.SizeOnDisk = new DirectoryInfo(databaseDirectory).EnumerateFiles("*", SearchOption.AllDirectories).Sum(x => x.Length);
+
+            // Open the database, measuring the time and memory taken to index (or load) every account.
+            Console.WriteLine($"[{name}] opening..");
+            long memoryBefore = GC.GetTotalMemory(true);
+            stopwatch.Restart();
+            storage = new FilesystemServerStorage(databaseDirectory, useAccountLog);
+            storage.Open();
+            result.OpenTime = stopwatch.Elapsed;
+            result.OpenMemory = GC.GetTotalMemory(true) - memoryBefore;
+
+            // Read random accounts. These are cold reads, as the accounts touched exceed any cache held by the provider,
+            // though the operating system's page cache may hold the underlying files.
+            Console.WriteLine($"[{name}] reading..");
+            Random random = new Random(0);
+            result.ReadMicroseconds = new double[options.Reads];
+            for (int i = 0; i < options.Reads; i++)
+            {
+                XPlatformId userId = CreateUserId(random.Next(options.Accounts));
+                long start = Stopwatch.GetTimestamp();
+                AccountResource? account = storage.Accounts.Get(userId);
+                result.ReadMicroseconds[i] = (Stopwatch.GetTimestamp() - start) * 1000000.0 / Stopwatch.Frequency;
+                if (account == null || !account.AccountIdentifier.Equals(userId))
+                    throw new InvalidDataException($"[{name}] account {userId} was not read back.");
+            }
+
+            // Update random accounts, as a login would.
+            Console.WriteLine($"[{name}] updating..");
+            result.WriteMicroseconds = new double[options.Writes];
+            for (int i = 0; i < options.Writes; i++)
+            {
+                AccountResource account = CreateAccount(random.Next(options.Accounts));
+                account.Profile.Server.UpdateTime = (ulong)i;
+                long start = Stopwatch.GetTimestamp();
+                storage.Accounts.Set(account);
+                result.WriteMicroseconds[i] = (Stopwatch.GetTimestamp() - start) * 1000000.0 / Stopwatch.Frequency;
+            }
+            storage.Close();
+            return result;
+        }
+
+        /// <summary>
+        /// Obtains the user identifier of the account with a given index.
+        /// </summary>
+        private static XPlatformId CreateUserId(int index)
+        {
+            return new XPlatformId(PlatformCode.OVR, 3000000000000000UL + (ulong)index);
+        }
+
+        /// <summary>
+        /// Creates the account with a given index, as the login service would for a new user.
+        /// </summary>
+        private static AccountResource CreateAccount(int index)
+        {
+            AccountResource account = new AccountResource(CreateUserId(index), $"User [{index:X}]", true, true, true);
+            account.Profile.Server.CreateTime = 1700000000UL + (ulong)index;
+            return account;
+        }
+
+        /// <summary>
+        /// Obtains a percentile of a set of samples.
+        /// </summary>
+        internal static double Percentile(double[] samples, double percentile)
+        {
+            double[] sorted = (double[])samples.Clone();
+            Array.Sort(sorted);
+            return sorted[Math.Min(sorted.Length - 1, (int)(sorted.Length * percentile))];
+        }
+    }
+}
@@ -0,0 +1,231 @@
+﻿using EchoRelay.Core.Game;
+using EchoRelay.Core.Server.Messages.ServerDB;
+using EchoRelay.Core.Server.Services;
+using EchoRelay.Core.Server.Services.ServerDB;
+using EchoRelay.Core.Server.Storage.Filesystem;
+using EchoRelay.Core.Utils;
+using System.Diagnostics;
+using System.Net;
+using System.Net.WebSockets;
+using static EchoRelay.Core.Server.Messages.ServerDB.ERGameServerStartSession;
+
+namespace EchoRelay.Core.Bench
+{
+    /// <summary>
+    /// Benchmarks the <see cref="GameServerRegistry"/>'s indexes against scanning every registered game server, with the
+    /// queries the matching service makes when finding a session.
+    /// </summary>
+    internal static class RegistryBench
+    {
+        #region Constants
+        /// <summary>
+        /// The amount of game servers hosted on each address, each on its own port.
+        /// </summary>
+        private const int GameServersPerHost = 8;
+        /// <summary>
+        /// The amount of addresses a client reports ping results for, matching the limit on the ping request's endpoints.
+        /// </summary>
+        private const int PingResultCount = 100;
+        /// <summary>
+        /// The game types sessions are started with. The symbols are arbitrary, as the game types are only looked up by name.
+        /// </summary>
+        private static readonly (string Name, long Symbol)[] GameTypes =
+        {
+            ("echo_arena", 0x10001),
+            ("echo_combat", 0x10002),
+            ("social_2.0", 0x10003),
+        };
+        #endregion
+
+        #region Classes
+        /// <summary>
+        /// A query made against the registry, and its results with and without the indexes.
+        /// </summary>
+        private class QueryResult
+        {
+            public string Name = "";
+            public double[] IndexMicroseconds = Array.Empty<double>();
+            public double[] ScanMicroseconds = Array.Empty<double>();
+            public double MeanResults;
+        }
+
+        /// <summary>
+        /// A websocket which discards everything sent through it, so simulated game servers can be sent their session's messages.
+        /// </summary>
+        private class NullWebSocket : WebSocket
+        {
+            public override WebSocketCloseStatus? CloseStatus => null;
+            public override string? CloseStatusDescription => null;
+            public override WebSocketState State => WebSocketState.Open;
+            public override string? SubProtocol => null;
+            public override void Abort() { }
+            public override Task CloseAsync(WebSocketCloseStatus closeStatus, string? statusDescription, CancellationToken cancellationToken) => Task.CompletedTask;
+            public override Task CloseOutputAsync(WebSocketCloseStatus closeStatus, string? statusDescription, CancellationToken cancellationToken) => Task.CompletedTask;
+            public override void Dispose() { }
+            public override Task<WebSocketReceiveResult> ReceiveAsync(ArraySegment<byte> buffer, CancellationToken cancellationToken) => throw new NotSupportedException();
+            public override Task SendAsync(ArraySegment<byte> buffer, WebSocketMessageType messageType, bool endOfMessage, CancellationToken cancellationToken) => Task.CompletedTask;
+        }
+        #endregion
+
+        #region Functions
+        /// <summary>
+        /// Registers the game servers, then measures each query with and without the indexes and prints the results.
+        /// </summary>
+        /// <param name="options">The benchmark options.</param>
+        /// <param name="rootDirectory">The directory the server's storage is created in. It is never opened.</param>
+        public static void Run(Program.BenchOptions options, string rootDirectory)
+        {
+            // Create a server which is never started, so game servers can register to its registry.
+            Server.Server server = new Server.Server(new FilesystemServerStorage(Path.Join(rootDirectory, "registry")), new Server.ServerSettings());
+            foreach (var gameType in GameTypes)
+                server.SymbolCache.Add(gameType.Name, gameType.Symbol);
+            GameServerRegistry registry = server.ServerDBService.Registry;
+
+            Console.WriteLine($"[registry] registering {options.Servers} game servers..");
+            Stopwatch stopwatch = Stopwatch.StartNew();
+            Random random = new Random(0);
+            for (int i = 0; i < options.Servers; i++)
+                Register(server, i, random);
+            Console.WriteLine($"[registry] registered in {stopwatch.Elapsed.TotalSeconds:F1}s");
+
+            // The queries the matching service makes: finding candidates to send a ping request for, then selecting from the
+            // candidates the client reported ping results for.
+            LobbyType[] lobbyTypes = new LobbyType[] { LobbyType.Public };
+            int hostCount = (options.Servers + GameServersPerHost - 1) / GameServersPerHost;
+            List<QueryResult> results = new List<QueryResult>
+            {
+                Measure(registry, "find arena", options.Queries, _ => registry.FilterGameServers(findMax: 100, gameTypeSymbol: GameTypes[0].Symbol,
+                    locked: false, lobbyTypes: lobbyTypes, requestedTeam: TeamIndex.Blue, unfilledServerOnly: true), false),
+                Measure(registry, "find combat", options.Queries, _ => registry.FilterGameServers(findMax: 100, gameTypeSymbol: GameTypes[1].Symbol,
+                    locked: false, lobbyTypes: lobbyTypes, requestedTeam: TeamIndex.Blue, unfilledServerOnly: true), false),
+                Measure(registry, "ping results", options.Queries, queryRandom =>
+                {
+                    HashSet<(uint, uint)> addresses = new HashSet<(uint, uint)>();
+                    while (addresses.Count < Math.Min(PingResultCount, hostCount))
+                    {
+                        int host = queryRandom.Next(hostCount);
+                        addresses.Add((GetInternalAddress(host).ToUInt32(), GetExternalAddress(host).ToUInt32()));
+                    }
+                    return registry.FilterGameServers(addresses: addresses, gameTypeSymbol: GameTypes[0].Symbol,
+                        locked: false, lobbyTypes: lobbyTypes, requestedTeam: TeamIndex.Blue, unfilledServerOnly: true);
+                }, true),
+            };
+
+            // Print the results side by side.
+            Console.WriteLine();
+            Console.WriteLine($"{options.Servers} game servers, {options.Queries} queries each");
+            Console.WriteLine($"{"query",-12} {"results",8} | {"index mean",10} {"p50",8} {"p99",8} | {"scan mean",10} {"p50",8} {"p99",8} | {"speedup",7}");
+            foreach (QueryResult result in results)
+            {
+                Console.WriteLine($"{result.Name,-12} {result.MeanResults,8:F1} | " +
+                    $"{result.IndexMicroseconds.Average(),8:F1}us {Program.Percentile(result.IndexMicroseconds, 0.5),6:F1}us {Program.Percentile(result.IndexMicroseconds, 0.99),6:F1}us | " +
+                    $"{result.ScanMicroseconds.Average(),8:F1}us {Program.Percentile(result.ScanMicroseconds, 0.5),6:F1}us {Program.Percentile(result.ScanMicroseconds, 0.99),6:F1}us | " +
+                    $"{result.ScanMicroseconds.Average() / result.IndexMicroseconds.Average(),6:F1}x");
+            }
+        }
+
+        /// <summary>
+        /// Registers a simulated game server, and starts a session on it with the state a busy deployment would have: most game
+        /// servers host a session, many of which are locked or full, and the rest are idle.
+        /// </summary>
+        /// <param name="server">The server to register the game server to.</param>
+        /// <param name="index">The index of the game server, which determines its identifier and addresses.</param>
+        /// <param name="random">The random number generator used to choose the game server's session state.</param>
+        private static void Register(Server.Server server, int index, Random random)
+        {
+            int host = index / GameServersPerHost;
+            ushort port = (ushort)(6792 + (index % GameServersPerHost));
+            Peer peer = new Peer(server, server.ServerDBService, new IPEndPoint(GetExternalAddress(host), 40000 + (index % GameServersPerHost)),
+                new Uri("ws://localhost/serverdb"), new NullWebSocket());
+            ERGameServerRegistrationRequest registrationRequest = new ERGameServerRegistrationRequest()
+            {
+                ServerId = 0x1000000UL + (ulong)index,
+                InternalAddress = GetInternalAddress(host),
+                Port = port,
+            };
+            RegisteredGameServer gameServer = server.ServerDBService.Registry.AddGameServer(new RegisteredGameServer(server.ServerDBService.Registry, peer, registrationRequest));
+
+            // Leave one in ten game servers idle. The rest host arena (60%), combat (15%) and social (25%) sessions.
+            int roll = random.Next(100);
+            if (roll < 10)
+                return;
+            int gameType = roll < 64 ? 0 : roll < 78 ? 1 : 2;
+            gameServer.StartSession(new XPlatformId(), LobbyType.Public, Guid.Empty, GameTypes[gameType].Symbol, null, null).GetAwaiter().GetResult();
+
+            // Fill the session with players, on alternating teams for matches. Half of matches are locked, as they are in progress.
+            int playerCount = gameType == 2 ? random.Next(13) : random.Next(9);
+            ERGameServerOccupancyEvents occupancyEvents = new ERGameServerOccupancyEvents();
+            occupancyEvents.Events = new ERGameServerOccupancyEvents.OccupancyEvent[playerCount];
+            for (int i = 0; i < playerCount; i++)
+            {
+                occupancyEvents.Events[i] = new ERGameServerOccupancyEvents.OccupancyEvent()
+                {
+                    UserId = new XPlatformId(PlatformCode.OVR, 3000000000000000UL + (ulong)(index * 16 + i)),
+                    Type = ERGameServerOccupancyEvents.OccupancyEventType.Join,
+                    Slot = (ushort)i,
+                    TeamIndex = gameType == 2 ? TeamIndex.SocialLobbyParticipant : (TeamIndex)(i % 2),
+                };
+            }
+            gameServer.ApplyOccupancyEvents(occupancyEvents).GetAwaiter().GetResult();
+            if (gameType != 2 && random.Next(2) == 0)
+                gameServer.SetLockedStatus(true);
+        }
+
+        /// <summary>
+        /// Measures a query against the registry with its indexes, then by scanning every game server, verifying both find
+        /// the same amount of game servers.
+        /// </summary>
+        /// <param name="registry">The registry to query.</param>
+        /// <param name="name">The name of the query, for display.</param>
+        /// <param name="queries">The amount of times to run the query, with and without the indexes.</param>
+        /// <param name="query">The query, given a random number generator to choose its parameters with.</param>
+        /// <param name="exact">Indicates whether the query finds every match, rather than the first matches found, so both
+        /// must find the same game servers.</param>
+        /// <returns>The query's results.</returns>
+        private static QueryResult Measure(GameServerRegistry registry, string name, int queries, Func<Random, IEnumerable<RegisteredGameServer>> query, bool exact)
+        {
+            Console.WriteLine($"[registry] querying {name}..");
+            QueryResult result = new QueryResult() { Name = name };
+            result.IndexMicroseconds = new double[queries];
+            result.ScanMicroseconds = new double[queries];
+            long totalResults = 0;
+            for (int i = 0; i < queries; i++)
+            {
+                // Run the query with the same parameters with and without the indexes.
+                registry.UseIndexes = true;
+                long start = Stopwatch.GetTimestamp();
+                RegisteredGameServer[] indexed = query(new Random(i)).ToArray();
+                result.IndexMicroseconds[i] = (Stopwatch.GetTimestamp() - start) * 1000000.0 / Stopwatch.Frequency;
+
+                registry.UseIndexes = false;
+                start = Stopwatch.GetTimestamp();
+                RegisteredGameServer[] scanned = query(new Random(i)).ToArray();
+                result.ScanMicroseconds[i] = (Stopwatch.GetTimestamp() - start) * 1000000.0 / Stopwatch.Frequency;
+                registry.UseIndexes = true;
+
+                if (indexed.Length != scanned.Length || (exact && !indexed.ToHashSet().SetEquals(scanned)))
+                    throw new InvalidDataException($"[registry] {name} found {indexed.Length} game servers with the indexes, but {scanned.Length} by scanning.");
+                totalResults += indexed.Length;
+            }
+            result.MeanResults = (double)totalResults / queries;
+            return result;
+        }
+
+        /// <summary>
+        /// Obtains the public address of a simulated host.
+        /// </summary>
+        private static IPAddress GetExternalAddress(int host)
+        {
+            return new IPAddress(new byte[] { 20, (byte)(host >> 16), (byte)(host >> 8), (byte)host });
+        }
+
+        /// <summary>
+        /// Obtains the private address of a simulated host.
+        /// </summary>
+        private static IPAddress GetInternalAddress(int host)
+        {
+            return new IPAddress(new byte[] { 10, (byte)(host >> 16), (byte)(host >> 8), (byte)host });
+        }
+        #endregion
+    }
+}
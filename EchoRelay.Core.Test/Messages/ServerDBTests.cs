@@ -0,0 +1,117 @@
+﻿using EchoRelay.Core.Server.Messages.ServerDB;
+
+namespace EchoRelay.Core.Test.Messages
+{
+    public class ServerDBTests
+    {
+        [Fact]
+        public void TestGameServerHeartbeat()
+        {
+            ERGameServerHeartbeat message = new ERGameServerHeartbeat();
+            message.Decode(Convert.FromHexString("8d2000008c230000e02e0000a86100000700e204030000000000002000000000"));
+            Assert.Equal(8333u, message.TickTimeP50);
+            Assert.Equal(9100u, message.TickTimeP95);
+            Assert.Equal(12000u, message.TickTimeP99);
+            Assert.Equal(25000u, message.TickTimeMax);
+            Assert.Equal(7, message.EntrantCount);
+            Assert.Equal(1250, message.CpuUsage);
+            Assert.Equal(3u, message.OutboundQueueDepth);
+            Assert.Equal(512ul * 1024 * 1024, message.WorkingSetBytes);
+            Assert.Equal(32, message.Encode().Length);
+        }
+
+        [Fact]
+        public void TestGameServerHeartbeatNetStats()
+        {
+            ERGameServerHeartbeat message = new ERGameServerHeartbeat();
+            message.Decode(Convert.FromHexString("8d2000008c230000e02e0000a86100000700e204030000000000002000000000" + "140000000300000000020000010000000700000000000000"));
+            Assert.NotNull(message.NetStats);
+            Assert.Equal(20u, message.NetStats!.ServerDBRtt);
+            Assert.Equal(3u, message.NetStats.ServerDBRetransmits);
+            Assert.Equal(512u, message.NetStats.UdpReceiveQueueBytes);
+            Assert.Equal(1u, message.NetStats.UdpReceiveErrors);
+            Assert.True(message.NetStats.Flags.HasFlag(ERGameServerHeartbeat.NetStatsFlags.ServerDBExtendedStats));
+            Assert.Equal(56, message.Encode().Length);
+        }
+
+        [Fact]
+        public void TestGameServerEndSessionTraceContext()
+        {
+            // Older game servers send only the unused byte.
+            ERGameServerEndSession message = new ERGameServerEndSession();
+            message.Decode(Convert.FromHexString("00"));
+            Assert.Null(message.TraceContext);
+            Assert.Single(message.Encode());
+
+            message.Decode(Convert.FromHexString("0000000000000000000102030405060708090a0b0c0d0e0f05000000000000000100000000000000"));
+            Assert.NotNull(message.TraceContext);
+            Assert.Equal(Guid.Parse("03020100-0504-0706-0809-0a0b0c0d0e0f"), message.TraceContext!.TraceId);
+            Assert.Equal(5ul, message.TraceContext.SpanId);
+            Assert.True(message.TraceContext.Sampled);
+            Assert.Equal(40, message.Encode().Length);
+        }
+
+        [Fact]
+        public void TestGameServerSessionStartedTiming()
+        {
+            // Older game servers send only the unused byte.
+            ERGameServerSessionStarted message = new ERGameServerSessionStarted();
+            message.Decode(Convert.FromHexString("00"));
+            Assert.Null(message.TraceContext);
+            Assert.Null(message.Timing);
+            Assert.Single(message.Encode());
+
+            message.Decode(Convert.FromHexString("0000000000000000000102030405060708090a0b0c0d0e0f0500000000000000010000000000000000c0c7f2e7dcd9010000000000000000805660f3e7dcd901"));
+            Assert.NotNull(message.TraceContext);
+            Assert.NotNull(message.Timing);
+            Assert.Null(message.Timing!.LevelLoadTime);
+            Assert.Equal(TimeSpan.FromSeconds(1), message.Timing.StartLatency);
+            Assert.Equal(64, message.Encode().Length);
+        }
+
+        [Fact]
+        public void TestGameServerPingSummary()
+        {
+            ERGameServerPingSummary message = new ERGameServerPingSummary();
+            message.Decode(Convert.FromHexString("0000000000000000000102030405060708090a0b0c0d0e0f05000000000000000100000000000000" +
+                "c80000002a0064000600020000000000" +
+                "04000000000000000100000000000000640000001e002a000a00000000000000" +
+                "0500000000000000020000000000000064000000640090010300000000000000"));
+            Assert.NotNull(message.TraceContext);
+            Assert.Equal(200u, message.Session.SampleCount);
+            Assert.Equal(42, message.Session.RttP50);
+            Assert.Equal(100, message.Session.RttP95);
+            Assert.Equal(6, message.Session.Jitter);
+            Assert.Equal(2, message.Entrants.Length);
+            Assert.Equal(Game.PlatformCode.OVR_ORG, message.Entrants[0].UserId.PlatformCode);
+            Assert.Equal(1ul, message.Entrants[0].UserId.AccountId);
+            Assert.Equal(30, message.Entrants[0].RttP50);
+            Assert.Equal(42, message.Entrants[0].RttP95);
+            Assert.Equal(10, message.Entrants[0].Jitter);
+            Assert.Equal(400, message.Entrants[1].RttP95);
+            Assert.Equal(56 + (2 * ERGameServerPingSummary.EntrantPingSummary.Size), message.Encode().Length);
+        }
+
+        [Fact]
+        public void TestGameServerOccupancyEvents()
+        {
+            ERGameServerOccupancyEvents message = new ERGameServerOccupancyEvents();
+            message.Decode(Convert.FromHexString("0000000000000000000102030405060708090a0b0c0d0e0f05000000000000000100000000000000" +
+                "0300000002000000" +
+                "04000000000000000100000000000000" + "0200010002000000" +
+                "04000000000000000100000000000000" + "0300ffffffffffff"));
+            Assert.NotNull(message.TraceContext);
+            Assert.Equal(3u, message.Sequence);
+            Assert.Equal(2, message.Events.Length);
+            Assert.Equal(ERGameServerOccupancyEvents.OccupancyEventType.TeamChange, message.Events[0].Type);
+            Assert.Equal(1ul, message.Events[0].UserId.AccountId);
+            Assert.Equal(1, message.Events[0].Slot);
+            Assert.Equal(Game.TeamIndex.Spectator, message.Events[0].TeamIndex);
+            Assert.Equal(Game.TeamIndex.Blue, message.Events[0].PreviousTeamIndex);
+            Assert.Equal(ERGameServerOccupancyEvents.OccupancyEventType.OwnerChange, message.Events[1].Type);
+            Assert.Equal(ERGameServerOccupancyEvents.NoSlot, message.Events[1].Slot);
+            Assert.Equal(Game.TeamIndex.Any, message.Events[1].TeamIndex);
+            Assert.Equal(48 + (2 * ERGameServerOccupancyEvents.OccupancyEvent.Size), message.Encode().Length);
+        }
+    }
+}
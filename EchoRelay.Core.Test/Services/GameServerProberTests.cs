@@ -0,0 +1,47 @@
+﻿using EchoRelay.Core.Server.Services.ServerDB;
+using System.Net;
+using System.Net.Sockets;
+
+namespace EchoRelay.Core.Test.Services
+{
+    public class GameServerProberTests
+    {
+        [Fact]
+        public async Task TestGameServerProberAcknowledgedAndLost()
+        {
+            // Create a local responder which acknowledges raw ping requests the way a game server does.
+            using UdpClient responder = new UdpClient(new IPEndPoint(IPAddress.Loopback, 0));
+            IPEndPoint responderEndpoint = (IPEndPoint)responder.Client.LocalEndPoint!;
+            _ = Task.Run(async () =>
+            {
+                while (true)
+                {
+                    UdpReceiveResult request = await responder.ReceiveAsync();
+                    byte[] acknowledgement = request.Buffer.ToArray();
+                    BitConverter.GetBytes(GameServerPingClient.RawPingAcknowledgeMessageSymbol).CopyTo(acknowledgement, 0);
+                    await responder.SendAsync(acknowledgement, request.RemoteEndPoint);
+                }
+            });
+
+            // Create an endpoint which never responds.
+            using UdpClient silent = new UdpClient(new IPEndPoint(IPAddress.Loopback, 0));
+            IPEndPoint silentEndpoint = (IPEndPoint)silent.Client.LocalEndPoint!;
+
+            using GameServerProber prober = new GameServerProber();
+            Assert.True(await prober.Probe(responderEndpoint, 3000));
+            Assert.False(await prober.Probe(silentEndpoint, 200));
+
+            GameServerProber.ProbeStatistics? statistics = prober.GetStatistics(responderEndpoint);
+            Assert.NotNull(statistics);
+            Assert.Equal(1UL, statistics!.ProbesAcknowledged);
+            Assert.NotNull(statistics.RttMilliseconds);
+            Assert.Equal(0.0, statistics.LossRate);
+
+            statistics = prober.GetStatistics(silentEndpoint);
+            Assert.NotNull(statistics);
+            Assert.Equal(0UL, statistics!.ProbesAcknowledged);
+            Assert.True(statistics.LossRate > 0);
+            Assert.Equal(0, prober.OutstandingProbes);
+        }
+    }
+}
@@ -0,0 +1,165 @@
+﻿using EchoRelay.Core.Game;
+using EchoRelay.Core.Server.Messages.ServerDB;
+using EchoRelay.Core.Server.Services;
+using EchoRelay.Core.Server.Services.ServerDB;
+
+namespace EchoRelay.Core.Test.Services
+{
+    public class SessionOccupancyTests
+    {
+        /// <summary>
+        /// The limits of an echo_arena session: 16 players, 8 of which are active participants (4 vs 4).
+        /// </summary>
+        private static readonly GameTypePlayerLimits.PlayerLimits ArenaLimits = new GameTypePlayerLimits.PlayerLimits(16, 8);
+
+        private static XPlatformId CreateUserId(int index)
+        {
+            return new XPlatformId(PlatformCode.OVR, 3000000000000000UL + (ulong)index);
+        }
+
+        private static ERGameServerOccupancyEvents.OccupancyEvent CreateEvent(ERGameServerOccupancyEvents.OccupancyEventType type, int user, ushort slot, TeamIndex team, TeamIndex? previousTeam = null)
+        {
+            return new ERGameServerOccupancyEvents.OccupancyEvent()
+            {
+                UserId = CreateUserId(user),
+                Type = type,
+                Slot = slot,
+                TeamIndex = team,
+                PreviousTeamIndex = previousTeam ?? team,
+            };
+        }
+
+        private static bool Apply(SessionOccupancy occupancy, List<(Guid playerSession, Peer? peer)> removedPlayers, params ERGameServerOccupancyEvents.OccupancyEvent[] occupancyEvents)
+        {
+            return occupancy.ApplyEvents(occupancyEvents, removedPlayers);
+        }
+
+        private static int CountTeam(SessionOccupancy occupancy, TeamIndex team)
+        {
+            return occupancy.OccupiedTeams.Count(x => x == team);
+        }
+
+        [Fact]
+        public void TestJoinLeaveAndTeamChange()
+        {
+            SessionOccupancy occupancy = new SessionOccupancy();
+            List<(Guid playerSession, Peer? peer)> removedPlayers = new List<(Guid, Peer?)>();
+
+            // A player session holds a slot on its requested team until its user joins.
+            Guid playerSession = Guid.NewGuid();
+            occupancy.AddPlayerSession(playerSession, null, CreateUserId(0), TeamIndex.Blue);
+            Assert.Equal(1, occupancy.PlayerCount);
+            Assert.Equal(1, CountTeam(occupancy, TeamIndex.Blue));
+
+            // Once joined, the entrant holds the slot on the team the game assigned, and the player session no longer holds one.
+            Assert.False(Apply(occupancy, removedPlayers,
+                CreateEvent(ERGameServerOccupancyEvents.OccupancyEventType.Join, 0, 3, TeamIndex.Orange),
+                CreateEvent(ERGameServerOccupancyEvents.OccupancyEventType.Join, 1, 4, TeamIndex.Orange),
+                CreateEvent(ERGameServerOccupancyEvents.OccupancyEventType.OwnerChange, 0, 3, TeamIndex.Orange)));
+            Assert.Equal(2, occupancy.PlayerCount);
+            Assert.Equal(2, occupancy.EntrantCount);
+            Assert.Equal(0, CountTeam(occupancy, TeamIndex.Blue));
+            Assert.Equal(2, CountTeam(occupancy, TeamIndex.Orange));
+            Assert.Equal((ushort)3, occupancy.OwnerSlot);
+            Assert.Single(occupancy.GetPlayerSessions());
+
+            // A team change moves the entrant's slot to its new team.
+            Assert.False(Apply(occupancy, removedPlayers,
+                CreateEvent(ERGameServerOccupancyEvents.OccupancyEventType.TeamChange, 1, 4, TeamIndex.Spectator, TeamIndex.Orange)));
+            Assert.Equal(2, occupancy.PlayerCount);
+            Assert.Equal(1, CountTeam(occupancy, TeamIndex.Orange));
+            Assert.Equal(1, CountTeam(occupancy, TeamIndex.Spectator));
+
+            // A leave frees the slot, while players remain.
+            Assert.False(Apply(occupancy, removedPlayers,
+                CreateEvent(ERGameServerOccupancyEvents.OccupancyEventType.Leave, 1, 4, TeamIndex.Spectator),
+                CreateEvent(ERGameServerOccupancyEvents.OccupancyEventType.OwnerChange, 0, ERGameServerOccupancyEvents.NoSlot, TeamIndex.Any)));
+            Assert.Equal(1, occupancy.PlayerCount);
+            Assert.Equal(0, CountTeam(occupancy, TeamIndex.Spectator));
+            Assert.Null(occupancy.OwnerSlot);
+            Assert.Empty(removedPlayers);
+
+            // Clearing the occupancy for a new session removes everything.
+            occupancy.Clear();
+            Assert.Equal(0, occupancy.PlayerCount);
+            Assert.Equal(0, occupancy.EntrantCount);
+            Assert.Empty(occupancy.GetPlayerSessions());
+        }
+
+        [Fact]
+        public void TestFullTeamHasNoFreeSlots()
+        {
+            SessionOccupancy occupancy = new SessionOccupancy();
+            List<(Guid playerSession, Peer? peer)> removedPlayers = new List<(Guid, Peer?)>();
+
+            // Fill blue with joined entrants, and orange with a mix of entrants and player sessions yet to join.
+            for (int i = 0; i < 4; i++)
+                Apply(occupancy, removedPlayers, CreateEvent(ERGameServerOccupancyEvents.OccupancyEventType.Join, i, (ushort)i, TeamIndex.Blue));
+            Assert.Equal(0, ArenaLimits.GetAvailableSlots(occupancy.OccupiedTeams, TeamIndex.Blue));
+            Assert.Equal(4, ArenaLimits.GetAvailableSlots(occupancy.OccupiedTeams, TeamIndex.Orange));
+
+            for (int i = 4; i < 6; i++)
+                Apply(occupancy, removedPlayers, CreateEvent(ERGameServerOccupancyEvents.OccupancyEventType.Join, i, (ushort)i, TeamIndex.Orange));
+            for (int i = 6; i < 8; i++)
+                occupancy.AddPlayerSession(Guid.NewGuid(), null, CreateUserId(i), TeamIndex.Orange);
+            Assert.Equal(0, ArenaLimits.GetAvailableSlots(occupancy.OccupiedTeams, TeamIndex.Orange));
+            Assert.Equal(0, ArenaLimits.GetAvailableSlots(occupancy.OccupiedTeams, TeamIndex.Any));
+            Assert.False(ArenaLimits.CheckTeamAvailability(occupancy.OccupiedTeams, TeamIndex.Blue));
+
+            // Spectators are limited separately, by the slots remaining beyond the active participants.
+            Assert.Equal(8, ArenaLimits.GetAvailableSlots(occupancy.OccupiedTeams, TeamIndex.Spectator));
+
+            // A player moving from blue to spectator frees a blue slot.
+            Apply(occupancy, removedPlayers, CreateEvent(ERGameServerOccupancyEvents.OccupancyEventType.TeamChange, 0, 0, TeamIndex.Spectator, TeamIndex.Blue));
+            Assert.Equal(1, ArenaLimits.GetAvailableSlots(occupancy.OccupiedTeams, TeamIndex.Blue));
+            Assert.Equal(7, ArenaLimits.GetAvailableSlots(occupancy.OccupiedTeams, TeamIndex.Spectator));
+        }
+
+        [Fact]
+        public void TestSilentDisconnectFreesSlot()
+        {
+            SessionOccupancy occupancy = new SessionOccupancy();
+            List<(Guid playerSession, Peer? peer)> removedPlayers = new List<(Guid, Peer?)>();
+            Guid[] playerSessions = new Guid[4];
+            for (int i = 0; i < playerSessions.Length; i++)
+            {
+                playerSessions[i] = Guid.NewGuid();
+                occupancy.AddPlayerSession(playerSessions[i], null, CreateUserId(i), TeamIndex.Blue);
+                Apply(occupancy, removedPlayers, CreateEvent(ERGameServerOccupancyEvents.OccupancyEventType.Join, i, (ushort)i, TeamIndex.Blue));
+            }
+            Assert.Equal(0, ArenaLimits.GetAvailableSlots(occupancy.OccupiedTeams, TeamIndex.Blue));
+
+            // A player which disconnects silently is never reported removed, only as leaving its slot. Its player session is
+            // removed with it, freeing the slot.
+            Assert.False(Apply(occupancy, removedPlayers, CreateEvent(ERGameServerOccupancyEvents.OccupancyEventType.Leave, 2, 2, TeamIndex.Blue)));
+            Assert.Single(removedPlayers);
+            Assert.Equal(playerSessions[2], removedPlayers[0].playerSession);
+            Assert.Null(occupancy.GetPeer(playerSessions[2]));
+            Assert.Equal(3, occupancy.PlayerCount);
+            Assert.Equal(1, ArenaLimits.GetAvailableSlots(occupancy.OccupiedTeams, TeamIndex.Blue));
+        }
+
+        [Fact]
+        public void TestLeaveEmptyingSessionAfterRemoval()
+        {
+            SessionOccupancy occupancy = new SessionOccupancy();
+            List<(Guid playerSession, Peer? peer)> removedPlayers = new List<(Guid, Peer?)>();
+            Guid playerSession = Guid.NewGuid();
+            occupancy.AddPlayerSession(playerSession, null, CreateUserId(0), TeamIndex.Orange);
+            Assert.False(Apply(occupancy, removedPlayers, CreateEvent(ERGameServerOccupancyEvents.OccupancyEventType.Join, 0, 0, TeamIndex.Orange)));
+
+            // The game server reports the player removed before it reports them leaving, so the entrant still holds the slot.
+            Assert.True(occupancy.RemovePlayerSession(playerSession, out _));
+            Assert.False(occupancy.RemovePlayerSession(playerSession, out _));
+            Assert.Equal(1, occupancy.PlayerCount);
+
+            // The leave empties the session, even though it removed no player sessions itself.
+            Assert.True(Apply(occupancy, removedPlayers, CreateEvent(ERGameServerOccupancyEvents.OccupancyEventType.Leave, 0, 0, TeamIndex.Orange)));
+            Assert.Empty(removedPlayers);
+            Assert.Equal(0, occupancy.PlayerCount);
+
+            // Events which leave the session empty without a leave (e.g. an owner change) do not report it emptied.
+            Assert.False(Apply(occupancy, removedPlayers, CreateEvent(ERGameServerOccupancyEvents.OccupancyEventType.OwnerChange, 0, ERGameServerOccupancyEvents.NoSlot, TeamIndex.Any)));
+        }
+    }
+}
@@ -0,0 +1,168 @@
+﻿using EchoRelay.Core.Game;
+using EchoRelay.Core.Server.Storage.Filesystem;
+using EchoRelay.Core.Server.Storage.Types;
+using Newtonsoft.Json;
+
+namespace EchoRelay.Core.Test.Storage
+{
+    public class LogResourceCollectionProviderTests : IDisposable
+    {
+        /// <summary>
+        /// The directory each test stores its log and import files in, deleted once the test completes.
+        /// </summary>
+        private readonly string _directory;
+        /// <summary>
+        /// The storage the providers under test belong to.
+        /// </summary>
+        private readonly FilesystemServerStorage _storage;
+
+        public LogResourceCollectionProviderTests()
+        {
+            _directory = Path.Join(Path.GetTempPath(), $"echorelay-log-tests-{Guid.NewGuid():N}");
+            _storage = new FilesystemServerStorage(_directory);
+        }
+
+        public void Dispose()
+        {
+            Directory.Delete(_directory, true);
+        }
+
+        private string LogFilePath => Path.Join(_directory, "accounts.log");
+        private string ImportDirectory => Path.Join(_directory, "accounts");
+
+        private LogResourceCollectionProvider<XPlatformId, AccountResource> OpenLog(long compactionMinimumStaleBytes = 4 * 1024 * 1024)
+        {
+            var provider = new LogResourceCollectionProvider<XPlatformId, AccountResource>(_storage, LogFilePath, ImportDirectory, 10, compactionMinimumStaleBytes);
+            provider.Open();
+            return provider;
+        }
+
+        private static XPlatformId CreateUserId(int index)
+        {
+            return new XPlatformId(PlatformCode.OVR, 3000000000000000UL + (ulong)index);
+        }
+
+        private static AccountResource CreateAccount(int index, string? displayName = null)
+        {
+            return new AccountResource(CreateUserId(index), displayName ?? $"User {index}");
+        }
+
+        [Fact]
+        public void TestSetGetDeleteAndReopen()
+        {
+            var provider = OpenLog();
+            for (int i = 0; i < 3; i++)
+                provider.Set(CreateAccount(i));
+            provider.Set(CreateAccount(1, "Renamed"));
+            provider.Delete(CreateUserId(2));
+            Assert.Equal("Renamed", provider.Get(CreateUserId(1))?.Profile.Server.DisplayName);
+            Assert.Null(provider.Get(CreateUserId(2)));
+            provider.Close();
+
+            // The latest record for each key is indexed again once reopened, and deleted keys remain deleted.
+            provider = OpenLog();
+            Assert.Equal(2, provider.Keys().Length);
+            Assert.Equal("User 0", provider.Get(CreateUserId(0))?.Profile.Server.DisplayName);
+            Assert.Equal("Renamed", provider.Get(CreateUserId(1))?.Profile.Server.DisplayName);
+            Assert.False(provider.Exists(CreateUserId(2)));
+            provider.Close();
+        }
+
+        [Fact]
+        public void TestTruncatedRecordIsDiscarded()
+        {
+            var provider = OpenLog();
+            provider.Set(CreateAccount(0));
+            provider.Close();
+            long intactLength = new FileInfo(LogFilePath).Length;
+            provider = OpenLog();
+            provider.Set(CreateAccount(1));
+            provider.Close();
+
+            // Cut the last record short, as an interrupted write would.
+            using (FileStream stream = new FileStream(LogFilePath, FileMode.Open, FileAccess.Write))
+                stream.SetLength(stream.Length - 5);
+
+            // The partial record is dropped from the index and the log, so records appended afterwards are read back.
+            provider = OpenLog();
+            Assert.True(provider.Exists(CreateUserId(0)));
+            Assert.False(provider.Exists(CreateUserId(1)));
+            Assert.Equal(intactLength, new FileInfo(LogFilePath).Length);
+            provider.Set(CreateAccount(2));
+            provider.Close();
+
+            provider = OpenLog();
+            Assert.Equal(2, provider.Keys().Length);
+            Assert.Equal("User 2", provider.Get(CreateUserId(2))?.Profile.Server.DisplayName);
+            provider.Close();
+        }
+
+        [Fact]
+        public void TestCompactionKeepsLatestRecords()
+        {
+            // Overwrite two accounts many times, so nearly all of the log is held by stale records.
+            var provider = OpenLog(1);
+            for (int version = 0; version < 50; version++)
+            {
+                provider.Set(CreateAccount(0, $"Zero v{version}"));
+                provider.Set(CreateAccount(1, $"One v{version}"));
+            }
+            provider.Delete(CreateUserId(1));
+
+            // Measure a log holding only the remaining record, which the log should be compacted to.
+            string expectedFilePath = Path.Join(_directory, "expected.log");
+            var expected = new LogResourceCollectionProvider<XPlatformId, AccountResource>(_storage, expectedFilePath);
+            expected.Open();
+            expected.Set(CreateAccount(0, "Zero v49"));
+            expected.Close();
+            long expectedLength = new FileInfo(expectedFilePath).Length;
+
+            // Wait for the background update to compact the log.
+            DateTime deadline = DateTime.UtcNow.AddSeconds(10);
+            while (DateTime.UtcNow < deadline && new FileInfo(LogFilePath).Length != expectedLength)
+                Thread.Sleep(10);
+            Assert.Equal(expectedLength, new FileInfo(LogFilePath).Length);
+            Assert.False(File.Exists(LogFilePath + ".compact"));
+            Assert.Equal("Zero v49", provider.Get(CreateUserId(0))?.Profile.Server.DisplayName);
+            Assert.Null(provider.Get(CreateUserId(1)));
+
+            // Records appended after compaction land in the compacted log.
+            provider.Set(CreateAccount(2));
+            provider.Close();
+            provider = OpenLog();
+            Assert.Equal(2, provider.Keys().Length);
+            Assert.Equal("Zero v49", provider.Get(CreateUserId(0))?.Profile.Server.DisplayName);
+            Assert.Equal("User 2", provider.Get(CreateUserId(2))?.Profile.Server.DisplayName);
+            provider.Close();
+        }
+
+        [Fact]
+        public void TestImportIsRetriedAfterFailure()
+        {
+            Directory.CreateDirectory(ImportDirectory);
+            for (int i = 0; i < 3; i++)
+                File.WriteAllText(Path.Join(ImportDirectory, $"{CreateUserId(i)}.json"), JsonConvert.SerializeObject(CreateAccount(i)));
+            File.WriteAllText(Path.Join(ImportDirectory, "broken.json"), "null");
+
+            // A failed import leaves no log behind, so it is not mistaken for a complete one.
+            var provider = new LogResourceCollectionProvider<XPlatformId, AccountResource>(_storage, LogFilePath, ImportDirectory, 10);
+            Assert.Throws<InvalidDataException>(() => provider.Open());
+            Assert.False(File.Exists(LogFilePath));
+            Assert.False(File.Exists(LogFilePath + ".import"));
+
+            // Once the file is fixed, every account is imported.
+            File.Delete(Path.Join(ImportDirectory, "broken.json"));
+            provider = OpenLog();
+            Assert.Equal(3, provider.Keys().Length);
+            for (int i = 0; i < 3; i++)
+                Assert.Equal($"User {i}", provider.Get(CreateUserId(i))?.Profile.Server.DisplayName);
+            provider.Set(CreateAccount(3));
+            provider.Close();
+
+            // The import only happens when the log is created, so accounts stored in the log are not overwritten by it.
+            provider = OpenLog();
+            Assert.Equal(4, provider.Keys().Length);
+            provider.Close();
+        }
+    }
+}
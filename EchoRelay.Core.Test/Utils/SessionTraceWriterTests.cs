@@ -0,0 +1,18 @@
+﻿using EchoRelay.Core.Utils;
+
+namespace EchoRelay.Core.Test.Utils
+{
+    public class SessionTraceWriterTests
+    {
+        [Fact]
+        public void TestSessionTraceSampling()
+        {
+            // The game server samples sessions identically, so this must not change without updating it too.
+            Guid traceId = Guid.Parse("03020100-0504-0706-0809-0a0b0c0d0e0f");
+            Assert.False(SessionTraceWriter.ShouldSample(traceId, 1769));
+            Assert.True(SessionTraceWriter.ShouldSample(traceId, 1770));
+            Assert.False(SessionTraceWriter.ShouldSample(traceId, 0));
+            Assert.True(SessionTraceWriter.ShouldSample(traceId, SessionTraceWriter.SampleScale));
+        }
+    }
+}
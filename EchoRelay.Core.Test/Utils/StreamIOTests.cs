@@ -1,5 +1,8 @@
 ﻿using EchoRelay.Core.Utils;
+using Newtonsoft.Json;
+using Newtonsoft.Json.Linq;
 using System.Net;
+using System.Text;
 
 namespace EchoRelay.Core.Test.Utils
 {
@@ -126,6 +129,35 @@ namespace EchoRelay.Core.Test.Utils
             io.Close();
         }
 
+        [Fact]
+        public void TestJsonStreaming()
+        {
+            // Create a profile-like document, with nested objects, arrays and non-ASCII strings.
+            JObject profile = JObject.Parse("{\"xplatformid\":\"OVR-ORG-123\",\"displayname\":\"testUTF8Яα⾀\",\"loadout\":{\"instances\":{\"unified\":{\"slots\":{\"emote\":\"emote_default\",\"banner\":\"rwd_banner_0001\"}}},\"number\":7},\"unlocks\":{\"arena\":{\"rwd_tag_0001\":true,\"rwd_tag_0002\":false}},\"stats\":[1,2.5,-3]}");
+
+            // Write the document, followed by another value, and verify it matches the string encoding used previously.
+            StreamIO io = new StreamIO(ByteOrder.LittleEndian, StreamMode.Write);
+            io.WriteJSON(profile);
+            io.Write(0x11223344);
+            byte[] expectedJson = Encoding.UTF8.GetBytes(JsonConvert.SerializeObject(profile, StreamIO.JsonSerializerSettings) + "\0");
+            byte[] data = io.ToArray();
+            io.Close();
+            Assert.Equal(expectedJson, data.Take(expectedJson.Length).ToArray());
+
+            // Read it back, and verify the position lands after its null terminator.
+            io = new StreamIO(data, ByteOrder.LittleEndian, StreamMode.Read);
+            JObject readProfile = io.ReadJSON<JObject>();
+            Assert.Equal(0x11223344, io.ReadInt32());
+            Assert.Equal(io.Length, io.Position);
+            io.Close();
+            Assert.True(JToken.DeepEquals(profile, readProfile));
+
+            // A document without a null terminator should fail to read.
+            io = new StreamIO(Encoding.UTF8.GetBytes("{}"), ByteOrder.LittleEndian, StreamMode.Read);
+            Assert.Throws<IOException>(() => io.ReadJSON<JObject>());
+            io.Close();
+        }
+
         [Fact]
         public void TestIPAddress()
         {
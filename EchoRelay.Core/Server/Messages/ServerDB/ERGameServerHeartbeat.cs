@@ -0,0 +1,181 @@
+﻿using EchoRelay.Core.Utils;
+
+namespace EchoRelay.Core.Server.Messages.ServerDB
+{
+    /// <summary>
+    /// A message from game server to server, periodically describing the load on the game server.
+    /// NOTE: This is an unofficial message created for Echo Relay.
+    /// </summary>
+    public class ERGameServerHeartbeat : Message
+    {
+        #region Fields
+        /// <summary>
+        /// The unique 64-bit symbol denoting the type of message.
+        /// </summary>
+        public override long MessageTypeSymbol => 0x7777777777770B00;
+
+        /// <summary>
+        /// The median time between game server ticks, in microseconds.
+        /// </summary>
+        public uint TickTimeP50;
+        /// <summary>
+        /// The 95th percentile time between game server ticks, in microseconds.
+        /// </summary>
+        public uint TickTimeP95;
+        /// <summary>
+        /// The 99th percentile time between game server ticks, in microseconds.
+        /// </summary>
+        public uint TickTimeP99;
+        /// <summary>
+        /// The maximum time between game server ticks, in microseconds.
+        /// </summary>
+        public uint TickTimeMax;
+        /// <summary>
+        /// The amount of entrants currently occupying the game server.
+        /// </summary>
+        public ushort EntrantCount;
+        /// <summary>
+        /// The portion of total system CPU time used by the game server process, in hundredths of a percent (0-10000).
+        /// </summary>
+        public ushort CpuUsage;
+        /// <summary>
+        /// The amount of bytes written to the ServerDB connection by the game server which are unsent or unacknowledged.
+        /// </summary>
+        public uint OutboundQueueDepth;
+        /// <summary>
+        /// The working set size of the game server process, in bytes.
+        /// </summary>
+        public ulong WorkingSetBytes;
+        /// <summary>
+        /// Network statistics for the game server, or null if the game server did not provide them.
+        /// </summary>
+        public HeartbeatNetStats? NetStats;
+        #endregion
+
+        #region Functions
+        /// <summary>
+        /// Streams the message data in/out based on the streaming mode set.
+        /// </summary>
+        /// <param name="io">The stream to read/write data from/to.</param>
+        public override void Stream(StreamIO io)
+        {
+            io.Stream(ref TickTimeP50);
+            io.Stream(ref TickTimeP95);
+            io.Stream(ref TickTimeP99);
+            io.Stream(ref TickTimeMax);
+            io.Stream(ref EntrantCount);
+            io.Stream(ref CpuUsage);
+            io.Stream(ref OutboundQueueDepth);
+            io.Stream(ref WorkingSetBytes);
+
+            // Network statistics were appended later, so they are only read if present.
+            if (io.StreamMode == StreamMode.Read)
+            {
+                if (io.Length - io.Position < HeartbeatNetStats.Size)
+                    return;
+                NetStats = new HeartbeatNetStats();
+            }
+            NetStats?.Stream(io);
+        }
+
+        public override string ToString()
+        {
+            return $"{GetType().Name}(" +
+                $"tick_time_p50={TickTimeP50}, " +
+                $"tick_time_p95={TickTimeP95}, " +
+                $"tick_time_p99={TickTimeP99}, " +
+                $"tick_time_max={TickTimeMax}, " +
+                $"entrant_count={EntrantCount}, " +
+                $"cpu_usage={CpuUsage}, " +
+                $"outbound_queue_depth={OutboundQueueDepth}, " +
+                $"working_set_bytes={WorkingSetBytes}" +
+                (NetStats != null ? $", {NetStats}" : "") +
+                $")";
+        }
+        #endregion
+
+        #region Classes
+        /// <summary>
+        /// Network statistics provided with a <see cref="ERGameServerHeartbeat"/>, used to tell network saturation apart from
+        /// CPU saturation.
+        /// </summary>
+        public class HeartbeatNetStats : IStreamable
+        {
+            /// <summary>
+            /// The serialized/streamed size of this object.
+            /// </summary>
+            public const int Size = 24;
+
+            /// <summary>
+            /// The smoothed round trip time of the ServerDB connection, in milliseconds.
+            /// </summary>
+            public uint ServerDBRtt;
+            /// <summary>
+            /// The amount of segments retransmitted on the ServerDB connection since the previous heartbeat.
+            /// </summary>
+            public uint ServerDBRetransmits;
+            /// <summary>
+            /// The amount of bytes waiting to be read from the game server's UDP broadcast socket.
+            /// </summary>
+            public uint UdpReceiveQueueBytes;
+            /// <summary>
+            /// The amount of UDP receive errors on the game server's host since the previous heartbeat. This is system-wide.
+            /// </summary>
+            public uint UdpReceiveErrors;
+            /// <summary>
+            /// Indicates which statistics were available to the game server.
+            /// </summary>
+            public NetStatsFlags Flags;
+
+            /// <summary>
+            /// Streams the data in/out based on the streaming mode set.
+            /// </summary>
+            /// <param name="io">The stream to read/write data from/to.</param>
+            public void Stream(StreamIO io)
+            {
+                uint flags = (uint)Flags;
+                byte[] padding = new byte[4];
+                io.Stream(ref ServerDBRtt);
+                io.Stream(ref ServerDBRetransmits);
+                io.Stream(ref UdpReceiveQueueBytes);
+                io.Stream(ref UdpReceiveErrors);
+                io.Stream(ref flags);
+                io.Stream(ref padding);
+                Flags = (NetStatsFlags)flags;
+            }
+
+            public override string ToString()
+            {
+                return $"serverdb_rtt={ServerDBRtt}, " +
+                    $"serverdb_retransmits={ServerDBRetransmits}, " +
+                    $"udp_receive_queue_bytes={UdpReceiveQueueBytes}, " +
+                    $"udp_receive_errors={UdpReceiveErrors}, " +
+                    $"net_stats_flags={Flags}";
+            }
+        }
+        #endregion
+
+        #region Enums
+        /// <summary>
+        /// Flags describing which network statistics were available to the game server.
+        /// </summary>
+        [Flags]
+        public enum NetStatsFlags : uint
+        {
+            None = 0,
+            /// <summary>
+            /// The game server found its ServerDB connection.
+            /// </summary>
+            ServerDBConnectionFound = 0x1,
+            /// <summary>
+            /// The game server could read extended TCP statistics for its ServerDB connection (RTT, retransmits, queue depth).
+            /// </summary>
+            ServerDBExtendedStats = 0x2,
+            /// <summary>
+            /// The game server could read its UDP receive queue depth.
+            /// </summary>
+            UdpReceiveQueue = 0x4,
+        }
+        #endregion
+    }
+}
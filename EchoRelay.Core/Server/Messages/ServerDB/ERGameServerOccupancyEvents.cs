@@ -0,0 +1,181 @@
+﻿using EchoRelay.Core.Game;
+using EchoRelay.Core.Utils;
+
+namespace EchoRelay.Core.Server.Messages.ServerDB
+{
+    /// <summary>
+    /// A message from game server to server, carrying the changes in occupancy of the current session's entrant slots since the
+    /// previous batch, in the order they were observed. Applied in sequence from the start of a session, these describe exactly
+    /// which user occupies each slot, and their team.
+    /// NOTE: This is an unofficial message created for Echo Relay.
+    /// </summary>
+    public class ERGameServerOccupancyEvents : Message
+    {
+        #region Constants
+        /// <summary>
+        /// The slot index used by an event which describes no entrant slot (e.g. the lobby has no owner).
+        /// </summary>
+        public const ushort NoSlot = 0xFFFF;
+        #endregion
+
+        #region Fields
+        /// <summary>
+        /// The unique 64-bit symbol denoting the type of message.
+        /// </summary>
+        public override long MessageTypeSymbol => 0x7777777777770D00;
+
+        /// <summary>
+        /// An unused byte sent with the packet.
+        /// </summary>
+        public byte Unused;
+
+        /// <summary>
+        /// The game server's trace context for the session, identifying the session the events occurred in.
+        /// </summary>
+        public ERTraceContext? TraceContext;
+
+        /// <summary>
+        /// The index of this batch within the session, starting from zero.
+        /// </summary>
+        public uint Sequence;
+
+        /// <summary>
+        /// The changes in occupancy, in the order they were observed.
+        /// </summary>
+        public OccupancyEvent[] Events;
+        #endregion
+
+        #region Constructor
+        /// <summary>
+        /// Initializes a new <see cref="ERGameServerOccupancyEvents"/> message.
+        /// </summary>
+        public ERGameServerOccupancyEvents()
+        {
+            Events = Array.Empty<OccupancyEvent>();
+        }
+        #endregion
+
+        #region Functions
+        /// <summary>
+        /// Streams the message data in/out based on the streaming mode set.
+        /// </summary>
+        /// <param name="io">The stream to read/write data from/to.</param>
+        public override void Stream(StreamIO io)
+        {
+            io.Stream(ref Unused);
+            ERTraceContext.StreamOptional(io, ref TraceContext);
+
+            // Stream the batch sequence, followed by each event.
+            ushort eventCount = (ushort)Events.Length;
+            byte[] padding = new byte[2];
+            io.Stream(ref Sequence);
+            io.Stream(ref eventCount);
+            io.Stream(ref padding);
+            if (io.StreamMode == StreamMode.Read)
+            {
+                Events = new OccupancyEvent[eventCount];
+                for (int i = 0; i < Events.Length; i++)
+                    Events[i] = new OccupancyEvent();
+            }
+            foreach (OccupancyEvent occupancyEvent in Events)
+                occupancyEvent.Stream(io);
+        }
+
+        public override string ToString()
+        {
+            return $"{GetType().Name}(unused={Unused}, trace_context={TraceContext}, sequence={Sequence}, " +
+                $"events=[{string.Join(", ", Events.Select(x => x.ToString()))}])";
+        }
+        #endregion
+
+        #region Classes
+        /// <summary>
+        /// A type of change in the occupancy of an entrant slot.
+        /// </summary>
+        public enum OccupancyEventType : ushort
+        {
+            /// <summary>
+            /// A user took the slot.
+            /// </summary>
+            Join = 0,
+            /// <summary>
+            /// The user in the slot left it, whether their player session was removed or they disconnected silently.
+            /// </summary>
+            Leave = 1,
+            /// <summary>
+            /// The user in the slot changed team.
+            /// </summary>
+            TeamChange = 2,
+            /// <summary>
+            /// The lobby owner changed to the user in the slot, or to no one if the slot is <see cref="NoSlot"/>.
+            /// </summary>
+            OwnerChange = 3,
+        }
+
+        /// <summary>
+        /// A change in the occupancy of an entrant slot, observed by the game server from the lobby's entrant data.
+        /// </summary>
+        public class OccupancyEvent : IStreamable
+        {
+            /// <summary>
+            /// The serialized/streamed size of this object.
+            /// </summary>
+            public const int Size = 24;
+
+            /// <summary>
+            /// The identifier of the user the event describes. For a leave, this is the user which left.
+            /// </summary>
+            public XPlatformId UserId = new XPlatformId();
+            /// <summary>
+            /// The type of change.
+            /// </summary>
+            public OccupancyEventType Type
+            {
+                get { return (OccupancyEventType)_type; }
+                set { _type = (ushort)value; }
+            }
+            private ushort _type;
+            /// <summary>
+            /// The entrant slot the event describes.
+            /// </summary>
+            public ushort Slot;
+            /// <summary>
+            /// The user's team after the event. For a leave, this is the team they left.
+            /// </summary>
+            public TeamIndex TeamIndex
+            {
+                get { return (TeamIndex)_teamIndex; }
+                set { _teamIndex = (short)value; }
+            }
+            private short _teamIndex;
+            /// <summary>
+            /// The user's team before a team change. For other events, this is the same as <see cref="TeamIndex"/>.
+            /// </summary>
+            public TeamIndex PreviousTeamIndex
+            {
+                get { return (TeamIndex)_previousTeamIndex; }
+                set { _previousTeamIndex = (short)value; }
+            }
+            private short _previousTeamIndex;
+
+            /// <summary>
+            /// Streams the data in/out based on the streaming mode set.
+            /// </summary>
+            /// <param name="io">The stream to read/write data from/to.</param>
+            public void Stream(StreamIO io)
+            {
+                UserId.Stream(io);
+                io.Stream(ref _type);
+                io.Stream(ref Slot);
+                io.Stream(ref _teamIndex);
+                io.Stream(ref _previousTeamIndex);
+            }
+
+            public override string ToString()
+            {
+                return $"({Type}, slot={Slot}, user_id={UserId}, team_index={TeamIndex}, previous_team_index={PreviousTeamIndex})";
+            }
+        }
+        #endregion
+    }
+}
@@ -0,0 +1,153 @@
+﻿using EchoRelay.Core.Game;
+using EchoRelay.Core.Utils;
+
+namespace EchoRelay.Core.Server.Messages.ServerDB
+{
+    /// <summary>
+    /// A message from game server to server, periodically summarizing the round trip times of the entrants in the current
+    /// session, as reported by the game, for the session so far. Times are in milliseconds.
+    /// NOTE: This is an unofficial message created for Echo Relay.
+    /// </summary>
+    public class ERGameServerPingSummary : Message
+    {
+        #region Fields
+        /// <summary>
+        /// The unique 64-bit symbol denoting the type of message.
+        /// </summary>
+        public override long MessageTypeSymbol => 0x7777777777770C00;
+
+        /// <summary>
+        /// An unused byte sent with the packet.
+        /// </summary>
+        public byte Unused;
+
+        /// <summary>
+        /// The game server's trace context for the session, identifying the session summarized.
+        /// </summary>
+        public ERTraceContext? TraceContext;
+
+        /// <summary>
+        /// The round trip times across all entrants in the session.
+        /// </summary>
+        public PingSummary Session;
+
+        /// <summary>
+        /// The round trip times of each entrant in the session.
+        /// </summary>
+        public EntrantPingSummary[] Entrants;
+        #endregion
+
+        #region Constructor
+        /// <summary>
+        /// Initializes a new <see cref="ERGameServerPingSummary"/> message.
+        /// </summary>
+        public ERGameServerPingSummary()
+        {
+            Session = new PingSummary();
+            Entrants = Array.Empty<EntrantPingSummary>();
+        }
+        #endregion
+
+        #region Functions
+        /// <summary>
+        /// Streams the message data in/out based on the streaming mode set.
+        /// </summary>
+        /// <param name="io">The stream to read/write data from/to.</param>
+        public override void Stream(StreamIO io)
+        {
+            io.Stream(ref Unused);
+            ERTraceContext.StreamOptional(io, ref TraceContext);
+
+            // Stream the session summary, followed by each entrant's.
+            ushort entrantCount = (ushort)Entrants.Length;
+            byte[] padding = new byte[4];
+            io.Stream(ref Session.SampleCount);
+            io.Stream(ref Session.RttP50);
+            io.Stream(ref Session.RttP95);
+            io.Stream(ref Session.Jitter);
+            io.Stream(ref entrantCount);
+            io.Stream(ref padding);
+            if (io.StreamMode == StreamMode.Read)
+            {
+                Entrants = new EntrantPingSummary[entrantCount];
+                for (int i = 0; i < Entrants.Length; i++)
+                    Entrants[i] = new EntrantPingSummary();
+            }
+            foreach (EntrantPingSummary entrant in Entrants)
+                entrant.Stream(io);
+        }
+
+        public override string ToString()
+        {
+            return $"{GetType().Name}(unused={Unused}, trace_context={TraceContext}, {Session}, " +
+                $"entrants=[{string.Join(", ", Entrants.Select(x => x.ToString()))}])";
+        }
+        #endregion
+
+        #region Classes
+        /// <summary>
+        /// A summary of round trip time samples.
+        /// </summary>
+        public class PingSummary
+        {
+            /// <summary>
+            /// The amount of samples taken. Entrants are sampled about once a second.
+            /// </summary>
+            public uint SampleCount;
+            /// <summary>
+            /// The median round trip time, in milliseconds.
+            /// </summary>
+            public ushort RttP50;
+            /// <summary>
+            /// The 95th percentile round trip time, in milliseconds.
+            /// </summary>
+            public ushort RttP95;
+            /// <summary>
+            /// The mean difference between consecutive round trip time samples of an entrant, in milliseconds.
+            /// </summary>
+            public ushort Jitter;
+
+            public override string ToString()
+            {
+                return $"sample_count={SampleCount}, rtt_p50={RttP50}, rtt_p95={RttP95}, jitter={Jitter}";
+            }
+        }
+
+        /// <summary>
+        /// A summary of round trip time samples for an entrant in the session.
+        /// </summary>
+        public class EntrantPingSummary : PingSummary, IStreamable
+        {
+            /// <summary>
+            /// The serialized/streamed size of this object.
+            /// </summary>
+            public const int Size = 32;
+
+            /// <summary>
+            /// The identifier of the entrant's user.
+            /// </summary>
+            public XPlatformId UserId = new XPlatformId();
+
+            /// <summary>
+            /// Streams the data in/out based on the streaming mode set.
+            /// </summary>
+            /// <param name="io">The stream to read/write data from/to.</param>
+            public void Stream(StreamIO io)
+            {
+                byte[] padding = new byte[6];
+                UserId.Stream(io);
+                io.Stream(ref SampleCount);
+                io.Stream(ref RttP50);
+                io.Stream(ref RttP95);
+                io.Stream(ref Jitter);
+                io.Stream(ref padding);
+            }
+
+            public override string ToString()
+            {
+                return $"(user_id={UserId}, {base.ToString()})";
+            }
+        }
+        #endregion
+    }
+}
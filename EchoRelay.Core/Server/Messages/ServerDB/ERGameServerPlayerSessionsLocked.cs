@@ -18,6 +18,11 @@ namespace EchoRelay.Core.Server.Messages.ServerDB
         /// An unused byte sent with the packet.
         /// </summary>
         public byte Unused;
+
+        /// <summary>
+        /// The game server's trace context for the session, or null if the game server did not provide one.
+        /// </summary>
+        public ERTraceContext? TraceContext;
         #endregion
 
         #region Functions
@@ -28,11 +33,12 @@ namespace EchoRelay.Core.Server.Messages.ServerDB
         public override void Stream(StreamIO io)
         {
             io.Stream(ref Unused);
+            ERTraceContext.StreamOptional(io, ref TraceContext);
         }
 
         public override string ToString()
         {
-            return $"{GetType().Name}(unused={Unused})";
+            return $"{GetType().Name}(unused={Unused}, trace_context={TraceContext})";
         }
         #endregion
     }
@@ -3,7 +3,7 @@
 namespace EchoRelay.Core.Server.Messages.ServerDB
 {
     /// <summary>
-    /// A message from game server to server, indicating a session has been started.
+    /// A message from game server to server, indicating the session it was directed to start is ready for players.
     /// NOTE: This is an unofficial message created for Echo Relay.
     /// </summary>
     public class ERGameServerSessionStarted : Message
@@ -18,6 +18,16 @@ namespace EchoRelay.Core.Server.Messages.ServerDB
         /// An unused byte sent with the packet.
         /// </summary>
         public byte Unused;
+
+        /// <summary>
+        /// The game server's trace context for the session, or null if the game server did not provide one.
+        /// </summary>
+        public ERTraceContext? TraceContext;
+
+        /// <summary>
+        /// The times at which the session progressed through starting, or null if the game server did not provide them.
+        /// </summary>
+        public SessionStartTiming? Timing;
         #endregion
 
         #region Functions
@@ -28,11 +38,97 @@ namespace EchoRelay.Core.Server.Messages.ServerDB
         public override void Stream(StreamIO io)
         {
             io.Stream(ref Unused);
+            ERTraceContext.StreamOptional(io, ref TraceContext);
+
+            // Timing follows the trace context, so it is only read if present.
+            if (io.StreamMode == StreamMode.Read)
+            {
+                if (TraceContext == null || io.Length - io.Position < SessionStartTiming.Size)
+                    return;
+                Timing = new SessionStartTiming();
+            }
+            Timing?.Stream(io);
         }
 
         public override string ToString()
         {
-            return $"{GetType().Name}(unused={Unused})";
+            return $"{GetType().Name}(unused={Unused}, trace_context={TraceContext}" +
+                (Timing != null ? $", {Timing}" : "") +
+                $")";
+        }
+        #endregion
+
+        #region Classes
+        /// <summary>
+        /// The times at which a session progressed through starting on the game server, provided with a
+        /// <see cref="ERGameServerSessionStarted"/>. Times are streamed as UTC file times.
+        /// </summary>
+        public class SessionStartTiming : IStreamable
+        {
+            /// <summary>
+            /// The serialized/streamed size of this object.
+            /// </summary>
+            public const int Size = 24;
+
+            /// <summary>
+            /// The time at which the game server received the start session request.
+            /// </summary>
+            public DateTime RequestReceivedTime;
+            /// <summary>
+            /// The time at which the game server began loading the session's level, or null if it was not observed.
+            /// </summary>
+            public DateTime? LevelLoadTime;
+            /// <summary>
+            /// The time at which the session became ready for players.
+            /// </summary>
+            public DateTime ReadyTime;
+
+            /// <summary>
+            /// The time taken from the start session request being received to the session becoming ready for players.
+            /// </summary>
+            public TimeSpan StartLatency => ReadyTime - RequestReceivedTime;
+
+            /// <summary>
+            /// Streams the data in/out based on the streaming mode set.
+            /// </summary>
+            /// <param name="io">The stream to read/write data from/to.</param>
+            public void Stream(StreamIO io)
+            {
+                // File times can only represent times after 1601, so unset times are written as zero.
+                long requestReceivedTime = 0, levelLoadTime = 0, readyTime = 0;
+                if (io.StreamMode == StreamMode.Write)
+                {
+                    requestReceivedTime = ToFileTime(RequestReceivedTime);
+                    levelLoadTime = LevelLoadTime != null ? ToFileTime(LevelLoadTime.Value) : 0;
+                    readyTime = ToFileTime(ReadyTime);
+                }
+                io.Stream(ref requestReceivedTime);
+                io.Stream(ref levelLoadTime);
+                io.Stream(ref readyTime);
+                if (io.StreamMode == StreamMode.Read)
+                {
+                    RequestReceivedTime = DateTime.FromFileTimeUtc(requestReceivedTime);
+                    LevelLoadTime = levelLoadTime != 0 ? DateTime.FromFileTimeUtc(levelLoadTime) : null;
+                    ReadyTime = DateTime.FromFileTimeUtc(readyTime);
+                }
+            }
+
+            /// <summary>
+            /// Converts a time to a UTC file time, or zero if it precedes the file time epoch.
+            /// </summary>
+            /// <param name="time">The time to convert.</param>
+            /// <returns>The converted file time.</returns>
+            private static long ToFileTime(DateTime time)
+            {
+                return time.Year >= 1601 ? time.ToFileTimeUtc() : 0;
+            }
+
+            public override string ToString()
+            {
+                return $"request_received_time={RequestReceivedTime:O}, " +
+                    $"level_load_time={LevelLoadTime?.ToString("O") ?? "none"}, " +
+                    $"ready_time={ReadyTime:O}";
+            }
         }
         #endregion
     }
@@ -0,0 +1,99 @@
+﻿using EchoRelay.Core.Utils;
+
+namespace EchoRelay.Core.Server.Messages.ServerDB
+{
+    /// <summary>
+    /// Tracing information appended by the game server to session state messages, so service-side spans can be correlated
+    /// with the game server's spans for the same session.
+    /// NOTE: This is an unofficial structure created for Echo Relay.
+    /// </summary>
+    public class ERTraceContext : IStreamable
+    {
+        #region Constants
+        /// <summary>
+        /// The size of the trace context when streamed, in bytes.
+        /// </summary>
+        public const int Size = 32;
+        #endregion
+
+        #region Fields
+        /// <summary>
+        /// The trace identifier, which is the identifier of the session provided when it was started.
+        /// </summary>
+        public Guid TraceId;
+        /// <summary>
+        /// The identifier of the game server span which was active when the message was sent.
+        /// </summary>
+        public ulong SpanId;
+        /// <summary>
+        /// Flags describing the trace context.
+        /// </summary>
+        public TraceContextFlags Flags;
+        #endregion
+
+        #region Properties
+        /// <summary>
+        /// Indicates whether the game server is tracing the session.
+        /// </summary>
+        public bool Sampled => Flags.HasFlag(TraceContextFlags.Sampled);
+        #endregion
+
+        #region Functions
+        /// <summary>
+        /// Streams the data in/out based on the streaming mode set.
+        /// </summary>
+        /// <param name="io">The stream to read/write data from/to.</param>
+        public void Stream(StreamIO io)
+        {
+            uint flags = (uint)Flags;
+            uint padding = 0;
+            io.Stream(ref TraceId);
+            io.Stream(ref SpanId);
+            io.Stream(ref flags);
+            io.Stream(ref padding);
+            Flags = (TraceContextFlags)flags;
+        }
+
+        public override string ToString()
+        {
+            return $"<trace_id={TraceId}, span_id={SpanId}, flags={Flags}>";
+        }
+
+        /// <summary>
+        /// Streams an optional trace context which follows an unused byte in a session state message. Older game servers
+        /// do not send a trace context, in which case it is left null.
+        /// </summary>
+        /// <param name="io">The stream to read/write data from/to.</param>
+        /// <param name="traceContext">The trace context to stream, or null if there is none.</param>
+        public static void StreamOptional(StreamIO io, ref ERTraceContext? traceContext)
+        {
+            byte[] padding = new byte[7];
+            if (io.StreamMode == StreamMode.Read)
+            {
+                if (io.Length - io.Position < padding.Length + Size)
+                    return;
+                traceContext = new ERTraceContext();
+            }
+            else if (traceContext == null)
+            {
+                return;
+            }
+
+            io.Stream(ref padding);
+            traceContext.Stream(io);
+        }
+        #endregion
+
+        #region Classes
+        /// <summary>
+        /// Flags describing a trace context.
+        /// </summary>
+        [Flags]
+        public enum TraceContextFlags : uint
+        {
+            None = 0x0,
+            Sampled = 0x1,
+        }
+        #endregion
+    }
+}
@@ -77,9 +77,14 @@ namespace EchoRelay.Core.Server
         public IPAddress? PublicIPAddress { get; private set; }
 
         /// <summary>
-        /// A map of request paths to <see cref="Service"/>s which serve them.
+        /// A map of request paths to <see cref="Service"/>s which serve them on <see cref="ServerSettings.Port"/>.
         /// </summary>
         private ReadOnlyDictionary<string, Service> _serviceMap;
+        /// <summary>
+        /// A map of request paths to <see cref="Service"/>s which serve them on <see cref="ServerSettings.ServerDBPort"/>,
+        /// or null if ServerDB is not hosted on its own port.
+        /// </summary>
+        private ReadOnlyDictionary<string, Service>? _serverDBServiceMap;
         #endregion
 
         #region Events
@@ -148,6 +153,7 @@ namespace EchoRelay.Core.Server
             Storage = storage;
             Settings = settings;
             PublicIPAddress = null;
+            SymbolCache = new SymbolCache();
    
             // Create our services
             ConfigService = new ConfigService(this);
@@ -165,15 +171,19 @@ namespace EchoRelay.Core.Server
             TransactionService = new TransactionService(this);
             RegisterServiceEvents(TransactionService);
 
-            // Create a map of our services
-            _serviceMap = new Dictionary<string, Service>
+            // Create a map of our services. If ServerDB is hosted on its own port, it is only served there.
+            var serviceMap = new Dictionary<string, Service>
             {
                 { Settings.ConfigServicePath.ToLower(), ConfigService },
                 { Settings.LoginServicePath.ToLower(), LoginService },
                 { Settings.MatchingServicePath.ToLower(), MatchingService },
-                { Settings.ServerDBServicePath.ToLower(), ServerDBService },
                 { Settings.TransactionServicePath.ToLower(), TransactionService },
-            }.AsReadOnly();
+            };
+            if (Settings.ServerDBPort == null)
+                serviceMap[Settings.ServerDBServicePath.ToLower()] = ServerDBService;
+            else
+                _serverDBServiceMap = new Dictionary<string, Service> { { Settings.ServerDBServicePath.ToLower(), ServerDBService } }.AsReadOnly();
+            _serviceMap = serviceMap.AsReadOnly();
         }
         #endregion
 
@@ -202,78 +212,54 @@ namespace EchoRelay.Core.Server
             // Load the symbol cache from our storage
             SymbolCache = Storage.SymbolCache.Get() ?? new SymbolCache();
 
-            // Create an HTTP listener that hosts over the provided port.
+            // Create an HTTP listener that hosts over the provided port, and another for ServerDB if it is hosted on its own port.
             HttpListener listener = new HttpListener();
             listener.Prefixes.Add($"http://*:{Settings.Port}/");
+            HttpListener? serverDBListener = null;
+            if (Settings.ServerDBPort != null)
+            {
+                serverDBListener = new HttpListener();
+                serverDBListener.Prefixes.Add($"http://*:{Settings.ServerDBPort}/");
+            }
 
-            // Start the listener
+            // Start the listeners
             listener.Start();
+            serverDBListener?.Start();
 
             // Fire our started event
             OnServerStarted?.Invoke(this);
 
-            // Enter a loop to accept new web socket connections.
+            // Accept new web socket connections on each listener until we are stopped.
+            List<Task> acceptTasks = new List<Task>();
+            acceptTasks.Add(AcceptConnections(listener, _serviceMap, _cancellationTokenSource.Token));
+            if (serverDBListener != null)
+                acceptTasks.Add(AcceptConnections(serverDBListener, _serverDBServiceMap!, _cancellationTokenSource.Token));
+            await Task.WhenAll(acceptTasks);
+
+            // Set our state to not running.
+            Running = false;
+
+            // Fire our stopped event
+            OnServerStopped?.Invoke(this);
+        }
+
+        /// <summary>
+        /// Accepts connection requests on a listener until the server is stopped, handing each to a task which establishes the
+        /// web socket connection. The handshake is not awaited here, so a slow or stalled client does not delay others.
+        /// </summary>
+        /// <param name="listener">The listener to accept connection requests from.</param>
+        /// <param name="serviceMap">A map of request paths to <see cref="Service"/>s served by the listener.</param>
+        /// <param name="cancellationToken">The cancellation token used to stop the server.</param>
+        /// <returns>A task representing the listener's execution.</returns>
+        private async Task AcceptConnections(HttpListener listener, ReadOnlyDictionary<string, Service> serviceMap, CancellationToken cancellationToken)
+        {
             try
             {
-                while (!_cancellationTokenSource.IsCancellationRequested)
+                while (!cancellationToken.IsCancellationRequested)
                 {
-                    // Upon receipt of a connection request, obtain the context and verify it is a web socket request.
-                    HttpListenerContext listenerContext = await listener.GetContextAsync().WaitAsync(_cancellationTokenSource.Token);
-
-                    // Verify the request is a web socket request
-                    if (!listenerContext.Request.IsWebSocketRequest)
-                    {
-                        // Return a bad request HTTP status code.
-                        listenerContext.Response.StatusCode = (int)HttpStatusCode.BadRequest;
-                        listenerContext.Response.Close();
-
-                        // TODO: Log the interaction.
-
-                        // Do not accept this client.
-                        continue;
-                    }
-
-                    // Verify the IP is authorized against the ACL (if we have no ACL, we accept no connections).
-                    AccessControlListResource? acl = Storage.AccessControlList.Get();
-                    bool authorized = acl?.CheckAuthorized(listenerContext.Request.RemoteEndPoint.Address) ?? false;
-                    OnAuthorizationResult?.Invoke(this, listenerContext.Request.RemoteEndPoint, authorized);
-                    if (!authorized)
-                    {
-                        // TODO: Log the interaction.
-
-                        // Do not accept this client.
-                        continue;
-                    }
-
-                    // Attempt to accept the web socket connection.
-                    WebSocketContext webSocketContext;
-                    try
-                    {
-                        webSocketContext = await listenerContext.AcceptWebSocketAsync(subProtocol: null);
-                    }
-                    catch (Exception e)
-                    {
-                        // Return an internal server error HTTP status code.
-                        listenerContext.Response.StatusCode = (int)HttpStatusCode.InternalServerError;
-                        listenerContext.Response.Close();
-
-                        // TODO: Log the exception.
-                        continue;
-                    }
-
-                    // Try to obtain a service for this request path. If we could not, return an error to the client.
-                    if (listenerContext.Request.Url == null || !_serviceMap.TryGetValue(listenerContext.Request.Url.LocalPath.ToLower() ?? "", out var service))
-                    {
-                        // Return a not found HTTP status code.
-                        listenerContext.Response.StatusCode = (int)HttpStatusCode.NotFound;
-                        listenerContext.Response.Close();
-
-                        // TODO: Log the interaction.
-                        continue;
-                    }
-
-                    // Create a task to handle the new connection asynchronously (we do not await, so we can continue accepting connections).
-                    var handleConnectionTask = Task.Run(() => service.HandleConnection(listenerContext, webSocketContext.WebSocket));
+                    // Upon receipt of a connection request, obtain the context and handle it asynchronously (we do not await, so we can continue accepting connections).
+                    HttpListenerContext listenerContext = await listener.GetContextAsync().WaitAsync(cancellationToken);
+                    var handleConnectionTask = Task.Run(() => AcceptConnection(listenerContext, serviceMap));
                 }
             }
             catch (TimeoutException)
@@ -285,12 +271,70 @@ namespace EchoRelay.Core.Server
 
             // Ensure our listener is closed
             listener.Close();
+        }
 
-            // Set our state to not running.
-            Running = false;
+        /// <summary>
+        /// Verifies a connection request, then establishes the web socket connection and hands it to the service for its request path.
+        /// </summary>
+        /// <param name="listenerContext">The context of the connection request.</param>
+        /// <param name="serviceMap">A map of request paths to <see cref="Service"/>s served by the listener which received the request.</param>
+        /// <returns>A task representing the connection's execution.</returns>
+        private async Task AcceptConnection(HttpListenerContext listenerContext, ReadOnlyDictionary<string, Service> serviceMap)
+        {
+            // Verify the request is a web socket request
+            if (!listenerContext.Request.IsWebSocketRequest)
+            {
+                // Return a bad request HTTP status code.
+                listenerContext.Response.StatusCode = (int)HttpStatusCode.BadRequest;
+                listenerContext.Response.Close();
 
-            // Fire our stopped event
-            OnServerStopped?.Invoke(this);
+                // TODO: Log the interaction.
+
+                // Do not accept this client.
+                return;
+            }
+
+            // Verify the IP is authorized against the ACL (if we have no ACL, we accept no connections).
+            AccessControlListResource? acl = Storage.AccessControlList.Get();
+            bool authorized = acl?.CheckAuthorized(listenerContext.Request.RemoteEndPoint.Address) ?? false;
+            OnAuthorizationResult?.Invoke(this, listenerContext.Request.RemoteEndPoint, authorized);
+            if (!authorized)
+            {
+                // TODO: Log the interaction.
+
+                // Do not accept this client.
+                return;
+            }
+
+            // Try to obtain a service for this request path. If we could not, return an error to the client.
+            if (listenerContext.Request.Url == null || !serviceMap.TryGetValue(listenerContext.Request.Url.LocalPath.ToLower() ?? "", out var service))
+            {
+                // Return a not found HTTP status code.
+                listenerContext.Response.StatusCode = (int)HttpStatusCode.NotFound;
+                listenerContext.Response.Close();
+
+                // TODO: Log the interaction.
+                return;
+            }
+
+            // Attempt to accept the web socket connection.
+            WebSocketContext webSocketContext;
+            try
+            {
+                webSocketContext = await listenerContext.AcceptWebSocketAsync(subProtocol: null);
+            }
+            catch (Exception e)
+            {
+                // Return an internal server error HTTP status code.
+                listenerContext.Response.StatusCode = (int)HttpStatusCode.InternalServerError;
+                listenerContext.Response.Close();
+
+                // TODO: Log the exception.
+                return;
+            }
+
+            // Handle the new connection.
+            await service.HandleConnection(listenerContext, webSocketContext.WebSocket);
         }
 
         /// <summary>
@@ -14,6 +14,13 @@ namespace EchoRelay.Core.Server
         /// </summary>
         public ushort Port { get; }
 
+        /// <summary>
+        /// The port which the <see cref="ServerDBService"/> is bound to, or null if it shares <see cref="Port"/> with the other services.
+        /// Hosting it on its own port gives game server connections their own listener, so registration churn does not delay
+        /// clients connecting to the other services.
+        /// </summary>
+        public ushort? ServerDBPort { get; }
+
         /// <summary>
         /// The path at which the API service processes requests.
         /// </summary>
@@ -79,15 +86,28 @@ namespace EchoRelay.Core.Server
         /// before player count.
         /// </summary>
         public bool FavorPopulationOverPing { get; }
+
+        /// <summary>
+        /// The portion of game server sessions (0.0-1.0) for which ServerDB writes lifecycle spans.
+        /// Game servers configured with the same rate trace the same sessions.
+        /// </summary>
+        public double SessionTraceSampleRate { get; }
+
+        /// <summary>
+        /// The directory which ServerDB session trace files are written to, or null if session tracing is disabled.
+        /// </summary>
+        public string? SessionTraceDirectory { get; }
         #endregion
 
         #region Constructor
         public ServerSettings(ushort port = 777, string apiServicePath = "/api", string configServicePath = "/config",
             string loginServicePath = "/login", string matchingServicePath = "/matching",
             string serverdbServicePath = "/serverdb", string transactionServicePath = "/transaction", TimeSpan? disconnectedSessionTimeout = null,
-            string? serverDbApiKey = null, bool serverDBValidateServerEndpoint = false, int serverDBValidateServerEndpointTimeout = 3000, bool forceIntoAnySessionIfCreationFails = false, bool favorPopulationOverPing = true)
+            string? serverDbApiKey = null, bool serverDBValidateServerEndpoint = false, int serverDBValidateServerEndpointTimeout = 3000, bool forceIntoAnySessionIfCreationFails = false, bool favorPopulationOverPing = true,
+            double sessionTraceSampleRate = 0, string? sessionTraceDirectory = null, ushort? serverDBPort = null)
         {
             Port = port;
+            ServerDBPort = serverDBPort == port ? null : serverDBPort;
             ApiServicePath = apiServicePath;
             ConfigServicePath = configServicePath;
             LoginServicePath = loginServicePath;
@@ -101,6 +121,8 @@ namespace EchoRelay.Core.Server
             ServerDBValidateServerEndpointTimeout = serverDBValidateServerEndpointTimeout;
             ForceIntoAnySessionIfCreationFails = forceIntoAnySessionIfCreationFails;
             FavorPopulationOverPing = favorPopulationOverPing;
+            SessionTraceSampleRate = sessionTraceSampleRate;
+            SessionTraceDirectory = string.IsNullOrEmpty(sessionTraceDirectory) ? null : sessionTraceDirectory;
         }
         #endregion
 
@@ -119,7 +141,7 @@ namespace EchoRelay.Core.Server
             string httpHost = $"http://{address}:{Port}";
 
             // Construct our ServerDB path
-            string serverDBHost = webSocketHost + ServerDBServicePath;
+            string serverDBHost = $"ws://{address}:{ServerDBPort ?? Port}" + ServerDBServicePath;
             if (ServerDBApiKey != null)
             {
                 serverDBHost += $"?api_key={HttpUtility.UrlEncode(ServerDBApiKey)}";
@@ -174,7 +174,8 @@ namespace EchoRelay.Core.Server.Services.Matching
                 locked: false,
                 lobbyTypes: matchingSession.SearchLobbyTypes,
                 requestedTeam: matchingSession.TeamIndex,
-                unfilledServerOnly: true
+                unfilledServerOnly: true,
+                reachableOnly: true
             );
 
             // If we only have one game server, immediately connect the peer. Otherwise, perform a ping request to determine the lowest ping server.
@@ -240,8 +241,8 @@ namespace EchoRelay.Core.Server.Services.Matching
                 if (Server.Settings.ForceIntoAnySessionIfCreationFails)
                 {
                     // Resolve the most populated available game server with open space and select it.
-                    selectedGameServer = Server.ServerDBService.Registry.FilterGameServers(locked: false, requestedTeam: matchingSession.TeamIndex, unfilledServerOnly: true, lobbyTypes: new LobbyType[] {LobbyType.Unassigned, LobbyType.Public})
-                        .MaxBy(x => (float)x.SessionPlayerCount / x.SessionPlayerLimits.TotalPlayerLimit);
+                    selectedGameServer = Server.ServerDBService.Registry.FilterGameServers(locked: false, requestedTeam: matchingSession.TeamIndex, unfilledServerOnly: true, reachableOnly: true, lobbyTypes: new LobbyType[] {LobbyType.Unassigned, LobbyType.Public})
+                        .OrderByDescending(x => x.PopulationBucket).ThenBy(x => x.LoadFactor).FirstOrDefault();
                 } 
                 else
                 {
@@ -264,7 +265,8 @@ namespace EchoRelay.Core.Server.Services.Matching
                     locked: false,
                     lobbyTypes: matchingSession.SearchLobbyTypes,
                     requestedTeam: matchingSession.TeamIndex,
-                    unfilledServerOnly: true
+                    unfilledServerOnly: true,
+                    reachableOnly: true
                 );
                 
                 // All servers should either have no session started, or match the criteria we filtered for.
@@ -272,16 +274,20 @@ namespace EchoRelay.Core.Server.Services.Matching
                 // The most optimal game server will be selected.
                 if (Server.Settings.FavorPopulationOverPing)
                 {
-                    // Select the game server which is most full.
-                    selectedGameServer = gameServers.MaxBy(x => (float)x.SessionPlayerCount / x.SessionPlayerLimits.TotalPlayerLimit);
+                    // Select the game server which is most full, preferring the least loaded game server between those of similar population.
+                    selectedGameServer = gameServers.OrderByDescending(x => x.PopulationBucket).ThenBy(x => x.LoadFactor).FirstOrDefault();
                 } 
                 else
                 {
-                    // Sort the game servers with preference of filters: session started, lowest ping, highest player count.
+                    // Sort the game servers with preference of filters: session started (and ready for players), lowest ping, highest player count, lowest load.
+                    // A single pre-join ping can understate latency, so if the user recently played on the game server's host, we use the
+                    // round trip time they observed in-session (median plus jitter) where it is worse.
                     var sortedGameServers = gameServers.Select(gameServer => {
                         uint? pingMilliseconds = pingResultLookup.TryGetValue((gameServer.InternalAddress.ToUInt32(), gameServer.ExternalAddress.ToUInt32()), out uint p) ? p : uint.MaxValue;
+                        if (Server.ServerDBService.Registry.TryGetObservedPing(matchingSession.UserId, gameServer, out var observedPing))
+                            pingMilliseconds = Math.Max(pingMilliseconds.Value, (uint)observedPing.RttP50 + observedPing.Jitter);
                         return (gameServer, pingMilliseconds);
-                    }).OrderBy(x => x.gameServer.SessionStarted ? 0 : 1).ThenBy(x => x.pingMilliseconds).ThenBy(x => (float)x.gameServer.SessionPlayerCount / x.gameServer.SessionPlayerLimits.TotalPlayerLimit);
+                    }).OrderBy(x => x.gameServer.SessionStarted ? (x.gameServer.SessionReady ? 0 : 1) : 2).ThenBy(x => x.pingMilliseconds).ThenBy(x => (float)x.gameServer.SessionPlayerCount / x.gameServer.SessionPlayerLimits.TotalPlayerLimit).ThenBy(x => x.gameServer.LoadFactor);
 
                     // Select the first game server.
                     selectedGameServer = sortedGameServers.FirstOrDefault().gameServer;
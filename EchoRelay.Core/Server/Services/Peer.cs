@@ -115,13 +115,23 @@ namespace EchoRelay.Core.Server.Services
         /// </summary>
         /// <param name="context">The <see cref="HttpListenerContext"/> used to accept the connection request.</param>
         public Peer(Server server, Service service, HttpListenerContext context, WebSocket connection)
+            : this(server, service, context.Request.RemoteEndPoint, context.Request.Url!, connection)
+        {
+        }
+        /// <summary>
+        /// Initializes a <see cref="Peer"/> for a connection which was not accepted by an <see cref="HttpListener"/>, such as
+        /// one simulated by a benchmark.
+        /// </summary>
+        /// <param name="remoteEndPoint">The remote endpoint of the peer.</param>
+        /// <param name="requestUri">The URI of the request made to connect to the <see cref="Service"/>.</param>
+        internal Peer(Server server, Service service, IPEndPoint remoteEndPoint, Uri requestUri, WebSocket connection)
         {
             // Set our provided arguments.
             Server = server;
             Service = service;
-            Address = context.Request.RemoteEndPoint.Address;
-            Port = (ushort)context.Request.RemoteEndPoint.Port;
-            RequestUri = context.Request.Url!;
+            Address = remoteEndPoint.Address;
+            Port = (ushort)remoteEndPoint.Port;
+            RequestUri = requestUri;
             Connection = connection;
             Id = $"{service.Name}:{Address}:{Port}";
             _sessionData = null;
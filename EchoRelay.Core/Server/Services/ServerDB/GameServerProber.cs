@@ -0,0 +1,298 @@
+﻿using EchoRelay.Core.Utils;
+using System.Collections.Concurrent;
+using System.Diagnostics;
+using System.Net;
+using System.Net.Sockets;
+using System.Security.Cryptography;
+
+namespace EchoRelay.Core.Server.Services.ServerDB
+{
+    /// <summary>
+    /// A prober which validates game server availability and measures round trip times by sending raw ping requests to many
+    /// game servers from a single socket. Acknowledgements are matched to outstanding probes by their ping number, and a
+    /// smoothed round trip time and loss rate is maintained for each endpoint, which can be read at any time without blocking.
+    /// </summary>
+    public class GameServerProber : IDisposable
+    {
+        #region Constants
+        /// <summary>
+        /// The interval at which outstanding probes are checked for timeouts, in milliseconds.
+        /// </summary>
+        private const int ExpiryIntervalMilliseconds = 50;
+        /// <summary>
+        /// The size of a raw ping request or acknowledgement, in bytes.
+        /// </summary>
+        private const int RawPingSize = 16;
+        /// <summary>
+        /// Windows' socket IO control code to disable reporting of ICMP port unreachable messages as receive errors.
+        /// </summary>
+        private const int SIO_UDP_CONNRESET = -1744830452;
+        #endregion
+
+        #region Properties
+        /// <summary>
+        /// The weight given to each new round trip time sample in the smoothed round trip time (0.0-1.0).
+        /// </summary>
+        public double RttSmoothingFactor { get; }
+        /// <summary>
+        /// The weight given to each probe's outcome in the smoothed loss rate (0.0-1.0).
+        /// </summary>
+        public double LossSmoothingFactor { get; }
+        /// <summary>
+        /// The amount of probes currently awaiting acknowledgement.
+        /// </summary>
+        public int OutstandingProbes => _pendingProbes.Count;
+        #endregion
+
+        #region Fields
+        /// <summary>
+        /// The socket used to send all probes and receive all acknowledgements.
+        /// </summary>
+        private Socket _socket;
+        /// <summary>
+        /// Probes awaiting acknowledgement, keyed by their ping number.
+        /// </summary>
+        private ConcurrentDictionary<ulong, PendingProbe> _pendingProbes;
+        /// <summary>
+        /// Probe statistics for each endpoint which has been probed.
+        /// </summary>
+        private ConcurrentDictionary<IPEndPoint, ProbeStatistics> _statistics;
+        /// <summary>
+        /// A timer which expires probes which were not acknowledged in time.
+        /// </summary>
+        private Timer _expiryTimer;
+        /// <summary>
+        /// A cancellation token source used to stop the receive loop.
+        /// </summary>
+        private CancellationTokenSource _cancellationTokenSource;
+        #endregion
+
+        #region Constructor
+        /// <summary>
+        /// Initializes a new <see cref="GameServerProber"/>, binding its socket and starting to receive acknowledgements.
+        /// </summary>
+        /// <param name="rttSmoothingFactor">The weight given to each new round trip time sample in the smoothed round trip time.</param>
+        /// <param name="lossSmoothingFactor">The weight given to each probe's outcome in the smoothed loss rate.</param>
+        public GameServerProber(double rttSmoothingFactor = 0.125, double lossSmoothingFactor = 0.1)
+        {
+            RttSmoothingFactor = rttSmoothingFactor;
+            LossSmoothingFactor = lossSmoothingFactor;
+            _pendingProbes = new ConcurrentDictionary<ulong, PendingProbe>();
+            _statistics = new ConcurrentDictionary<IPEndPoint, ProbeStatistics>();
+            _cancellationTokenSource = new CancellationTokenSource();
+
+            // Create our socket. On Windows, an ICMP port unreachable response to a probe would otherwise fail our next receive.
+            _socket = new Socket(AddressFamily.InterNetwork, SocketType.Dgram, ProtocolType.Udp);
+            if (OperatingSystem.IsWindows())
+                _socket.IOControl(SIO_UDP_CONNRESET, new byte[] { 0, 0, 0, 0 }, null);
+            _socket.Bind(new IPEndPoint(IPAddress.Any, 0));
+
+            // Start receiving acknowledgements and expiring probes.
+            _ = Task.Run(ReceiveLoop);
+            _expiryTimer = new Timer(_ => ExpireProbes(), null, ExpiryIntervalMilliseconds, ExpiryIntervalMilliseconds);
+        }
+        #endregion
+
+        #region Functions
+        /// <summary>
+        /// Sends a raw ping request to an endpoint.
+        /// </summary>
+        /// <param name="endpoint">The endpoint of the game server to probe.</param>
+        /// <param name="timeoutMilliseconds">The time after which the probe is considered lost, in milliseconds.</param>
+        /// <returns>True if the probe was acknowledged in time, false otherwise.</returns>
+        public Task<bool> Probe(IPEndPoint endpoint, int timeoutMilliseconds)
+        {
+            // Register a probe under a unique random ping number.
+            PendingProbe probe = new PendingProbe(endpoint, Stopwatch.GetTimestamp(), Stopwatch.GetTimestamp() + timeoutMilliseconds * Stopwatch.Frequency / 1000);
+            ulong pingNum;
+            do
+            {
+                pingNum = BitConverter.ToUInt64(RandomNumberGenerator.GetBytes(8));
+            }
+            while (!_pendingProbes.TryAdd(pingNum, probe));
+
+            // Create and send the raw ping request.
+            StreamIO io = new StreamIO();
+            io.Write(GameServerPingClient.RawPingRequestMessageSymbol);
+            io.Write(pingNum);
+            byte[] rawPingRequest = io.ToArray();
+            io.Close();
+            try
+            {
+                _socket.SendTo(rawPingRequest, endpoint);
+            }
+            catch (Exception ex) when (ex is SocketException || ex is ObjectDisposedException)
+            {
+                // The probe could not be sent, so we treat it as lost.
+                if (_pendingProbes.TryRemove(pingNum, out _))
+                    Complete(probe, null);
+            }
+            return probe.Completion.Task;
+        }
+
+        /// <summary>
+        /// Sends a raw ping request to each of the provided endpoints, without waiting for acknowledgements. The results are
+        /// reflected in each endpoint's statistics.
+        /// </summary>
+        /// <param name="endpoints">The endpoints of the game servers to probe.</param>
+        /// <param name="timeoutMilliseconds">The time after which a probe is considered lost, in milliseconds.</param>
+        public void ProbeAll(IEnumerable<IPEndPoint> endpoints, int timeoutMilliseconds)
+        {
+            foreach (IPEndPoint endpoint in endpoints)
+                _ = Probe(endpoint, timeoutMilliseconds);
+        }
+
+        /// <summary>
+        /// Obtains the probe statistics for an endpoint.
+        /// </summary>
+        /// <param name="endpoint">The endpoint to obtain statistics for.</param>
+        /// <returns>The statistics for the endpoint, or null if it has not been probed.</returns>
+        public ProbeStatistics? GetStatistics(IPEndPoint endpoint)
+        {
+            _statistics.TryGetValue(endpoint, out ProbeStatistics? statistics);
+            return statistics;
+        }
+
+        /// <summary>
+        /// Removes the probe statistics for an endpoint, such as when its game server unregisters.
+        /// </summary>
+        /// <param name="endpoint">The endpoint to remove statistics for.</param>
+        public void RemoveStatistics(IPEndPoint endpoint)
+        {
+            _statistics.TryRemove(endpoint, out _);
+        }
+
+        /// <summary>
+        /// Receives acknowledgements and completes the probes they correspond to, until the prober is disposed.
+        /// </summary>
+        private async Task ReceiveLoop()
+        {
+            byte[] buffer = new byte[64];
+            EndPoint anyEndpoint = new IPEndPoint(IPAddress.Any, 0);
+            while (!_cancellationTokenSource.IsCancellationRequested)
+            {
+                SocketReceiveFromResult result;
+                try
+                {
+                    result = await _socket.ReceiveFromAsync(buffer, SocketFlags.None, anyEndpoint, _cancellationTokenSource.Token);
+                }
+                catch (SocketException)
+                {
+                    continue;
+                }
+                catch (Exception ex) when (ex is OperationCanceledException || ex is ObjectDisposedException)
+                {
+                    break;
+                }
+                long receivedTimestamp = Stopwatch.GetTimestamp();
+
+                // Verify the acknowledgement's size and message type, then match it to an outstanding probe from the same endpoint.
+                if (result.ReceivedBytes != RawPingSize || BitConverter.ToUInt64(buffer, 0) != GameServerPingClient.RawPingAcknowledgeMessageSymbol)
+                    continue;
+                ulong pingNum = BitConverter.ToUInt64(buffer, 8);
+                if (!_pendingProbes.TryGetValue(pingNum, out PendingProbe? probe) || !probe.Endpoint.Equals(result.RemoteEndPoint))
+                    continue;
+                if (_pendingProbes.TryRemove(pingNum, out _))
+                    Complete(probe, (receivedTimestamp - probe.SentTimestamp) * 1000.0 / Stopwatch.Frequency);
+            }
+        }
+
+        /// <summary>
+        /// Expires any probes which were not acknowledged before their timeout.
+        /// </summary>
+        private void ExpireProbes()
+        {
+            long now = Stopwatch.GetTimestamp();
+            foreach (var pendingProbe in _pendingProbes)
+            {
+                if (now >= pendingProbe.Value.ExpiryTimestamp && _pendingProbes.TryRemove(pendingProbe.Key, out _))
+                    Complete(pendingProbe.Value, null);
+            }
+        }
+
+        /// <summary>
+        /// Completes a probe, updating the statistics for its endpoint.
+        /// </summary>
+        /// <param name="probe">The probe which completed.</param>
+        /// <param name="rttMilliseconds">The round trip time of the probe, in milliseconds, or null if it was lost.</param>
+        private void Complete(PendingProbe probe, double? rttMilliseconds)
+        {
+            ProbeStatistics statistics = _statistics.GetOrAdd(probe.Endpoint, _ => new ProbeStatistics());
+            lock (statistics)
+            {
+                statistics.ProbesSent++;
+                statistics.LossRate += LossSmoothingFactor * ((rttMilliseconds == null ? 1.0 : 0.0) - statistics.LossRate);
+                if (rttMilliseconds != null)
+                {
+                    statistics.ProbesAcknowledged++;
+                    statistics.RttMilliseconds = statistics.RttMilliseconds == null ? rttMilliseconds : statistics.RttMilliseconds + RttSmoothingFactor * (rttMilliseconds - statistics.RttMilliseconds);
+                    statistics.LastAcknowledged = DateTime.UtcNow;
+                }
+            }
+            probe.Completion.TrySetResult(rttMilliseconds != null);
+        }
+
+        public void Dispose()
+        {
+            _cancellationTokenSource.Cancel();
+            _expiryTimer.Dispose();
+            _socket.Dispose();
+
+            // Fail any outstanding probes.
+            foreach (var pendingProbe in _pendingProbes)
+            {
+                if (_pendingProbes.TryRemove(pendingProbe.Key, out _))
+                    pendingProbe.Value.Completion.TrySetResult(false);
+            }
+        }
+        #endregion
+
+        #region Classes
+        /// <summary>
+        /// A probe awaiting acknowledgement.
+        /// </summary>
+        private class PendingProbe
+        {
+            public IPEndPoint Endpoint { get; }
+            public long SentTimestamp { get; }
+            public long ExpiryTimestamp { get; }
+            public TaskCompletionSource<bool> Completion { get; }
+
+            public PendingProbe(IPEndPoint endpoint, long sentTimestamp, long expiryTimestamp)
+            {
+                Endpoint = endpoint;
+                SentTimestamp = sentTimestamp;
+                ExpiryTimestamp = expiryTimestamp;
+                Completion = new TaskCompletionSource<bool>(TaskCreationOptions.RunContinuationsAsynchronously);
+            }
+        }
+
+        /// <summary>
+        /// Probe statistics for a game server endpoint.
+        /// </summary>
+        public class ProbeStatistics
+        {
+            /// <summary>
+            /// The smoothed round trip time of acknowledged probes, in milliseconds, or null if none were acknowledged.
+            /// </summary>
+            public double? RttMilliseconds { get; internal set; }
+            /// <summary>
+            /// The smoothed portion of probes which were not acknowledged in time (0.0-1.0).
+            /// </summary>
+            public double LossRate { get; internal set; }
+            /// <summary>
+            /// The amount of probes which have completed.
+            /// </summary>
+            public ulong ProbesSent { get; internal set; }
+            /// <summary>
+            /// The amount of probes which were acknowledged in time.
+            /// </summary>
+            public ulong ProbesAcknowledged { get; internal set; }
+            /// <summary>
+            /// The time at which a probe was last acknowledged, or null if none were acknowledged.
+            /// </summary>
+            public DateTime? LastAcknowledged { get; internal set; }
+        }
+        #endregion
+    }
+}
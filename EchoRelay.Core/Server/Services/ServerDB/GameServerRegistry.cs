@@ -1,6 +1,7 @@
 ﻿using EchoRelay.Core.Game;
 using EchoRelay.Core.Server.Messages.ServerDB;
 using EchoRelay.Core.Utils;
+using Jitbit.Utils;
 using System.Collections.Concurrent;
 using static EchoRelay.Core.Server.Messages.ServerDB.ERGameServerStartSession;
 
@@ -10,8 +11,51 @@ namespace EchoRelay.Core.Server.Services.ServerDB
     {
         #region Properties
         public static readonly Guid ZeroGuid = new Guid("00000000-0000-0000-0000-000000000000");
+        /// <summary>
+        /// The amount of time a user's observed round trip time to a game server is retained after it was last reported.
+        /// </summary>
+        public static readonly TimeSpan ObservedPingLifetime = TimeSpan.FromHours(1);
+        /// <summary>
+        /// The amount of samples a user's observed round trip time to a game server must have before it is retained.
+        /// Entrants are sampled about once a second.
+        /// </summary>
+        public const uint ObservedPingMinSamples = 10;
         public ConcurrentDictionary<ulong, RegisteredGameServer> RegisteredGameServers { get; }
         public ConcurrentDictionary<Guid, RegisteredGameServer> RegisteredGameServersBySessionId { get; }
+        /// <summary>
+        /// Indicates whether filtering uses the indexes, rather than scanning every registered game server. This is only
+        /// disabled to benchmark the indexes against a scan.
+        /// </summary>
+        internal bool UseIndexes { get; set; } = true;
+        #endregion
+
+        #region Fields
+        /// <summary>
+        /// An index of game servers which have not started a session, and can serve any request.
+        /// </summary>
+        private ConcurrentDictionary<ulong, RegisteredGameServer> _idleGameServers;
+        /// <summary>
+        /// An index of game servers with a started session, keyed by the session's game type symbol.
+        /// </summary>
+        private ConcurrentDictionary<long, ConcurrentDictionary<ulong, RegisteredGameServer>> _gameServersByGameType;
+        /// <summary>
+        /// An index of game servers keyed by their internal and external addresses, as provided in ping results.
+        /// </summary>
+        private ConcurrentDictionary<(uint InternalAddr, uint ExternalAddr), ConcurrentDictionary<ulong, RegisteredGameServer>> _gameServersByAddress;
+        /// <summary>
+        /// The game type symbol each game server is currently indexed under, or null if it is idle or its session has no game type.
+        /// This is only accessed while holding <see cref="_indexLock"/>.
+        /// </summary>
+        private Dictionary<ulong, long?> _indexedGameTypes;
+        /// <summary>
+        /// A lock used to serialize index updates. Readers of the index do not take this lock.
+        /// </summary>
+        private object _indexLock;
+        /// <summary>
+        /// The round trip times users observed in sessions on game servers, keyed by the user and the game server's
+        /// addresses (matching the granularity of ping results).
+        /// </summary>
+        private FastCache<(ulong PlatformCode, ulong AccountId, uint InternalAddr, uint ExternalAddr), ERGameServerPingSummary.EntrantPingSummary> _observedPings;
         #endregion
 
         #region Events
@@ -35,14 +79,27 @@ namespace EchoRelay.Core.Server.Services.ServerDB
         {
             RegisteredGameServers = new ConcurrentDictionary<ulong, RegisteredGameServer>();
             RegisteredGameServersBySessionId = new ConcurrentDictionary<Guid, RegisteredGameServer>();
+            _idleGameServers = new ConcurrentDictionary<ulong, RegisteredGameServer>();
+            _gameServersByGameType = new ConcurrentDictionary<long, ConcurrentDictionary<ulong, RegisteredGameServer>>();
+            _gameServersByAddress = new ConcurrentDictionary<(uint, uint), ConcurrentDictionary<ulong, RegisteredGameServer>>();
+            _indexedGameTypes = new Dictionary<ulong, long?>();
+            _indexLock = new object();
+            _observedPings = new FastCache<(ulong, ulong, uint, uint), ERGameServerPingSummary.EntrantPingSummary>();
         }
         #endregion
 
         #region Functions
         public RegisteredGameServer AddGameServer(RegisteredGameServer registeredGameServer)
         {
-            // Add the game server to our lookup
-            RegisteredGameServers[registeredGameServer.ServerId] = registeredGameServer;
+            // Add the game server to our lookup, replacing any previous registration with the same identifier in our indexes.
+            lock (_indexLock)
+            {
+                if (RegisteredGameServers.TryGetValue(registeredGameServer.ServerId, out var previousGameServer))
+                    RemoveFromIndex(previousGameServer);
+                RegisteredGameServers[registeredGameServer.ServerId] = registeredGameServer;
+                _gameServersByAddress.GetOrAdd(GetAddressKey(registeredGameServer), _ => new ConcurrentDictionary<ulong, RegisteredGameServer>())[registeredGameServer.ServerId] = registeredGameServer;
+                UpdateIndex(registeredGameServer);
+            }
 
             // Fire the relevant event for the game server being registered.
             OnGameServerRegistered?.Invoke(registeredGameServer);
@@ -68,20 +125,153 @@ namespace EchoRelay.Core.Server.Services.ServerDB
         public void RemoveGameServer(ulong serverId)
         {
             // Try to remove any registered game server with this server identifier.
-            RegisteredGameServers.Remove(serverId, out var unregisteredGameServer);
+            RegisteredGameServer? unregisteredGameServer;
+            lock (_indexLock)
+            {
+                RegisteredGameServers.Remove(serverId, out unregisteredGameServer);
+                if (unregisteredGameServer != null)
+                    RemoveFromIndex(unregisteredGameServer);
+            }
 
             // Fire the relevant event for the game server being registered.
             if (unregisteredGameServer != null)
                 OnGameServerUnregistered?.Invoke(unregisteredGameServer);
         }
 
+        /// <summary>
+        /// Updates the indexes for a game server after its session was started or ended. Game servers which are no longer
+        /// registered are ignored.
+        /// </summary>
+        /// <param name="registeredGameServer">The game server whose session state changed.</param>
+        public void UpdateIndex(RegisteredGameServer registeredGameServer)
+        {
+            lock (_indexLock)
+            {
+                // If this game server is not (or no longer) registered, it should not be indexed.
+                if (!RegisteredGameServers.TryGetValue(registeredGameServer.ServerId, out var current) || current != registeredGameServer)
+                    return;
+
+                // Remove the game server from the game type index it is currently in.
+                ulong serverId = registeredGameServer.ServerId;
+                _idleGameServers.Remove(serverId, out _);
+                if (_indexedGameTypes.Remove(serverId, out long? previousGameType) && previousGameType != null && _gameServersByGameType.TryGetValue(previousGameType.Value, out var previousBucket))
+                    previousBucket.Remove(serverId, out _);
+
+                // Add it to the index for its current state. Started sessions without a game type only match requests which
+                // do not filter by game type, so they are only found by scanning all game servers.
+                long? gameType = registeredGameServer.SessionStarted ? registeredGameServer.SessionGameTypeSymbol : null;
+                if (!registeredGameServer.SessionStarted)
+                    _idleGameServers[serverId] = registeredGameServer;
+                else if (gameType != null)
+                    _gameServersByGameType.GetOrAdd(gameType.Value, _ => new ConcurrentDictionary<ulong, RegisteredGameServer>())[serverId] = registeredGameServer;
+                _indexedGameTypes[serverId] = gameType;
+            }
+        }
+
+        /// <summary>
+        /// Removes a game server from all indexes. This must be called while holding <see cref="_indexLock"/>.
+        /// </summary>
+        /// <param name="registeredGameServer">The game server to remove.</param>
+        private void RemoveFromIndex(RegisteredGameServer registeredGameServer)
+        {
+            ulong serverId = registeredGameServer.ServerId;
+            _idleGameServers.Remove(serverId, out _);
+            if (_indexedGameTypes.Remove(serverId, out long? gameType) && gameType != null && _gameServersByGameType.TryGetValue(gameType.Value, out var bucket))
+                bucket.Remove(serverId, out _);
+            if (_gameServersByAddress.TryGetValue(GetAddressKey(registeredGameServer), out var addressBucket))
+                addressBucket.Remove(serverId, out _);
+        }
+
+        /// <summary>
+        /// Records the round trip times each entrant observed in a game server's session, so they can be accounted for when
+        /// the same users are matched to the game server again. Entrants with too few samples are ignored.
+        /// </summary>
+        /// <param name="registeredGameServer">The game server the session is hosted on.</param>
+        /// <param name="pingSummary">The summary of the session's round trip times.</param>
+        public void RecordObservedPings(RegisteredGameServer registeredGameServer, ERGameServerPingSummary pingSummary)
+        {
+            var address = GetAddressKey(registeredGameServer);
+            foreach (var entrant in pingSummary.Entrants)
+            {
+                if (entrant.SampleCount >= ObservedPingMinSamples)
+                    _observedPings.AddOrUpdate(((ulong)entrant.UserId.PlatformCode, entrant.UserId.AccountId, address.InternalAddr, address.ExternalAddr), entrant, ObservedPingLifetime);
+            }
+        }
+
+        /// <summary>
+        /// Obtains the round trip times a user most recently observed in a session on a game server's host.
+        /// </summary>
+        /// <param name="userId">The identifier of the user.</param>
+        /// <param name="registeredGameServer">The game server to obtain the user's round trip times to.</param>
+        /// <param name="observedPing">The round trip times the user observed, if any.</param>
+        /// <returns>Returns true if the user has observed round trip times to the game server's host recently, false otherwise.</returns>
+        public bool TryGetObservedPing(XPlatformId userId, RegisteredGameServer registeredGameServer, out ERGameServerPingSummary.EntrantPingSummary observedPing)
+        {
+            var address = GetAddressKey(registeredGameServer);
+            return _observedPings.TryGet(((ulong)userId.PlatformCode, userId.AccountId, address.InternalAddr, address.ExternalAddr), out observedPing);
+        }
+
+        /// <summary>
+        /// Obtains the key used to index a game server by its addresses.
+        /// </summary>
+        /// <param name="registeredGameServer">The game server to obtain the key for.</param>
+        /// <returns>The game server's internal and external addresses.</returns>
+        private static (uint InternalAddr, uint ExternalAddr) GetAddressKey(RegisteredGameServer registeredGameServer)
+        {
+            return (registeredGameServer.InternalAddress.ToUInt32(), registeredGameServer.ExternalAddress.ToUInt32());
+        }
+
+        /// <summary>
+        /// Obtains the game servers which may match a filter, using the most selective index available, so that matching
+        /// does not scan every registered game server. The candidates must still be checked against the full filter.
+        /// </summary>
+        /// <param name="serverId">The server identifier to filter by, if any.</param>
+        /// <param name="addresses">The addresses to filter by, if any.</param>
+        /// <param name="gameTypeSymbol">The game type symbol to filter by, if any.</param>
+        /// <returns>The candidate game servers.</returns>
+        private IEnumerable<RegisteredGameServer> GetCandidateGameServers(ulong? serverId, HashSet<(uint InternalAddr, uint ExternalAddr)>? addresses, long? gameTypeSymbol)
+        {
+            if (!UseIndexes)
+                return EnumerateIndex(RegisteredGameServers);
+            else if (serverId != null)
+            {
+                RegisteredGameServer? gameServer = GetGameServer(serverId.Value);
+                return gameServer != null ? new RegisteredGameServer[] { gameServer } : Array.Empty<RegisteredGameServer>();
+            }
+            else if (addresses != null)
+            {
+                return addresses.SelectMany(address => _gameServersByAddress.TryGetValue(address, out var bucket) ? EnumerateIndex(bucket) : Enumerable.Empty<RegisteredGameServer>());
+            }
+            else if (gameTypeSymbol != null)
+            {
+                // Prefer game servers with a started session, then idle ones. A game server which is being moved between
+                // indexes may briefly appear in both, so we remove duplicates.
+                var startedGameServers = _gameServersByGameType.TryGetValue(gameTypeSymbol.Value, out var bucket) ? EnumerateIndex(bucket) : Enumerable.Empty<RegisteredGameServer>();
+                return startedGameServers.Concat(EnumerateIndex(_idleGameServers)).Distinct();
+            }
+            return EnumerateIndex(RegisteredGameServers);
+        }
+
+        /// <summary>
+        /// Enumerates the game servers in an index as they are needed. The index's Values property copies every game server
+        /// while holding all of its locks, so a filter which stops after finding a limited amount would still visit them all.
+        /// Enumerating the index itself takes no locks, and may reflect changes made during enumeration.
+        /// </summary>
+        /// <param name="index">The index to enumerate.</param>
+        /// <returns>The game servers in the index.</returns>
+        private static IEnumerable<RegisteredGameServer> EnumerateIndex(ConcurrentDictionary<ulong, RegisteredGameServer> index)
+        {
+            foreach (var entry in index)
+                yield return entry.Value;
+        }
+
         public IEnumerable<RegisteredGameServer> FilterGameServers(int? findMax = null, ulong? serverId = null, Guid? sessionId = null,
             HashSet<(uint InternalAddr, uint ExternalAddr)>? addresses = null, ushort? port = null,
-            long? gameTypeSymbol = null, long? levelSymbol = null, Guid? channel = null, bool? locked = null, LobbyType[]? lobbyTypes = null, TeamIndex? requestedTeam = null, bool unfilledServerOnly = true)
+            long? gameTypeSymbol = null, long? levelSymbol = null, Guid? channel = null, bool? locked = null, LobbyType[]? lobbyTypes = null, TeamIndex? requestedTeam = null, bool unfilledServerOnly = true, bool reachableOnly = false)
         {
-            // Filter through all game servers
+            // Filter through all candidate game servers
             List<RegisteredGameServer> filteredGameServers = new List<RegisteredGameServer>();
-            foreach(RegisteredGameServer gameServer in RegisteredGameServers.Values)
+            foreach(RegisteredGameServer gameServer in GetCandidateGameServers(serverId, addresses, gameTypeSymbol))
             {
                 // If we hit any set limit for game servers found, stop.
                 if (findMax != null && filteredGameServers.Count >= findMax)
@@ -94,6 +284,8 @@ namespace EchoRelay.Core.Server.Services.ServerDB
                     continue;
                 else if (port != null && gameServer.Peer.Port != port)
                     continue;
+                else if (reachableOnly && gameServer.ProbeUnreachable)
+                    continue;
 
                 // If the session is started, filter on that criteria.
                 if (gameServer.SessionStarted)
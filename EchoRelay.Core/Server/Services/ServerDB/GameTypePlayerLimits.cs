@@ -83,30 +83,51 @@ namespace EchoRelay.Core.Server.Services.ServerDB
 
             public bool CheckTeamAvailability(TeamIndex[] peerRequestedTeams, TeamIndex requestedTeam)
             {
-                // Check if the total player limit was hit.
-                if (peerRequestedTeams.Length >= TotalPlayerLimit)
-                    return false;
+                return GetAvailableSlots(peerRequestedTeams, requestedTeam) > 0;
+            }
+
+            /// <summary>
+            /// Obtains the amount of players which can still join on a given team.
+            /// </summary>
+            /// <param name="peerTeams">The team of every player in the game (or the team they requested, if they have not joined yet).</param>
+            /// <param name="requestedTeam">The team to obtain the available slots of.</param>
+            /// <returns>The amount of available slots on the team.</returns>
+            public int GetAvailableSlots(TeamIndex[] peerTeams, TeamIndex requestedTeam)
+            {
+                // Obtain the slots remaining under the total player limit.
+                int availableSlots = TotalPlayerLimit - peerTeams.Length;
 
-                // If there is no fixed participant target, there is availability then.
+                // If there is no fixed participant target, every remaining slot is available.
                 if (FixedActiveGameParticipantTarget == null)
-                    return true;
+                    return Math.Max(availableSlots, 0);
 
                 // Check active game participant count
                 int activeGameParticipants = 0;
-                foreach(TeamIndex peerRequestedTeam in peerRequestedTeams)
+                int requestedTeamParticipants = 0;
+                foreach(TeamIndex peerTeam in peerTeams)
                 {
                     // When requesting "any" team, you get assigned to blue/orange in a real match, or to the social participant team in a social lobby.
                     // This logic below doesn't support social lobbies, but we don't enforce fixed active game participants for them.
-                    if (peerRequestedTeam == TeamIndex.Any || peerRequestedTeam == TeamIndex.Blue || peerRequestedTeam == TeamIndex.Orange)
+                    if (peerTeam == TeamIndex.Any || peerTeam == TeamIndex.Blue || peerTeam == TeamIndex.Orange)
                         activeGameParticipants++;
+                    if (peerTeam == requestedTeam)
+                        requestedTeamParticipants++;
                 }
-                int nonActiveGameParticipants = peerRequestedTeams.Length - activeGameParticipants;
+                int nonActiveGameParticipants = peerTeams.Length - activeGameParticipants;
 
-                // Check if we're requesting an active team, or a non active one, then return if there is availability.
+                // Check if we're requesting an active team, or a non active one, then limit the available slots accordingly.
+                // Blue and orange teams are each limited to half of the active participants.
                 if (requestedTeam == TeamIndex.Any || requestedTeam == TeamIndex.Blue || requestedTeam == TeamIndex.Orange)
-                    return FixedActiveGameParticipantTarget - activeGameParticipants > 0;
+                {
+                    availableSlots = Math.Min(availableSlots, FixedActiveGameParticipantTarget.Value - activeGameParticipants);
+                    if (requestedTeam != TeamIndex.Any)
+                        availableSlots = Math.Min(availableSlots, (FixedActiveGameParticipantTarget.Value / 2) - requestedTeamParticipants);
+                }
                 else
-                    return (TotalPlayerLimit - FixedActiveGameParticipantTarget) - nonActiveGameParticipants > 0;
+                {
+                    availableSlots = Math.Min(availableSlots, (TotalPlayerLimit - FixedActiveGameParticipantTarget.Value) - nonActiveGameParticipants);
+                }
+                return Math.Max(availableSlots, 0);
             }
         }
         #endregion
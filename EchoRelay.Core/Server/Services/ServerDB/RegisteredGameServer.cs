@@ -81,6 +81,13 @@ namespace EchoRelay.Core.Server.Services.ServerDB
             get { return _registrationRequest.Port; }
         }
         /// <summary>
+        /// The public/external UDP endpoint of the game server.
+        /// </summary>
+        public IPEndPoint ExternalEndpoint
+        {
+            get { return new IPEndPoint(ExternalAddress, Port); }
+        }
+        /// <summary>
         /// A symbol indicating the region of the server.
         /// </summary>
         public long RegionSymbol
@@ -137,19 +144,142 @@ namespace EchoRelay.Core.Server.Services.ServerDB
                 return SessionId != null;
             }
         }
+        /// <summary>
+        /// Indicates whether the game server has acknowledged the current session is ready for players.
+        /// </summary>
+        public bool SessionReady { get; private set; }
+        /// <summary>
+        /// The time the game server took from receiving the last start session request to the session being ready for players,
+        /// or null if it has not reported one.
+        /// </summary>
+        public TimeSpan? LastSessionStartLatency { get; private set; }
+        /// <summary>
+        /// The most recent summary of round trip times the game server reported for the current session, or null if it has not
+        /// reported one.
+        /// </summary>
+        public ERGameServerPingSummary? SessionPingSummary { get; private set; }
+
+        /// <summary>
+        /// The entrant slot of the current session's lobby owner, as reported by the game server, or null if it has not reported one.
+        /// </summary>
+        public ushort? SessionOwnerSlot => _occupancy.OwnerSlot;
 
         /// <summary>
-        /// The current amount of players in the server.
+        /// The current amount of players in the server, including players which were issued a player session but have not joined yet.
         /// </summary>
         public byte SessionPlayerCount
         {
-            get { return (byte)_playerSessions.Count; }
+            get { return (byte)_occupancy.PlayerCount; }
+        }
+        /// <summary>
+        /// The amount of buckets the fill ratio of a game server's session is divided into, for <see cref="PopulationBucket"/>.
+        /// </summary>
+        public const int PopulationBucketCount = 8;
+        /// <summary>
+        /// The fill ratio of the game server's session, quantized into one of <see cref="PopulationBucketCount"/> buckets (plus one
+        /// for full servers). Game servers of similar population compare equal, so they can be ordered by a secondary key such as <see cref="LoadFactor"/>.
+        /// </summary>
+        public int PopulationBucket
+        {
+            get
+            {
+                int limit = SessionPlayerLimits.TotalPlayerLimit;
+                return limit > 0 ? SessionPlayerCount * PopulationBucketCount / limit : 0;
+            }
+        }
+
+        /// <summary>
+        /// The most recent load heartbeat received from the game server (null if one has not been received).
+        /// </summary>
+        public ERGameServerHeartbeat? LastHeartbeat { get; private set; }
+        /// <summary>
+        /// The time at which <see cref="LastHeartbeat"/> was received.
+        /// </summary>
+        public DateTime? LastHeartbeatTime { get; private set; }
+        /// <summary>
+        /// The age after which a heartbeat no longer describes the game server's load. Game servers send heartbeats every
+        /// 5 seconds (HEARTBEAT_INTERVAL_MS), so this allows for two to be missed.
+        /// </summary>
+        public static readonly TimeSpan HeartbeatExpiry = TimeSpan.FromSeconds(15);
+        /// <summary>
+        /// A relative load score for the game server, derived from its most recent heartbeat. Lower values indicate
+        /// a less loaded game server. This is the 95th percentile tick time in microseconds, scaled up by process CPU usage.
+        /// Game servers which have not sent a heartbeat have a score of zero. Game servers whose heartbeats stopped (the most
+        /// recent is older than <see cref="HeartbeatExpiry"/>) may be stalled, so they have the highest score.
+        /// </summary>
+        public double LoadFactor
+        {
+            get
+            {
+                ERGameServerHeartbeat? heartbeat = LastHeartbeat;
+                DateTime? heartbeatTime = LastHeartbeatTime;
+                if (heartbeat == null || heartbeatTime == null)
+                    return 0;
+                if (DateTime.UtcNow - heartbeatTime.Value > HeartbeatExpiry)
+                    return double.PositiveInfinity;
+                return heartbeat.TickTimeP95 * (1 + (heartbeat.CpuUsage / 10000.0));
+            }
         }
 
         /// <summary>
-        /// Represents the active player sessions in the server.
+        /// The smoothed loss rate above which a probed game server is considered unreachable, and is not matched to. With the
+        /// default smoothing, this is reached after about seven consecutive probes are lost.
         /// </summary>
-        private Dictionary<Guid, (Peer peer, TeamIndex requestedTeam)> _playerSessions;
+        public const double ProbeLossRateLimit = 0.5;
+        /// <summary>
+        /// The round trip time and loss measured by ServerDB's probes to the game server, or null if it has not been probed.
+        /// Game servers are only probed while endpoint validation is enabled.
+        /// </summary>
+        public GameServerProber.ProbeStatistics? ProbeStatistics
+        {
+            get { return Server.ServerDBService.Prober.GetStatistics(ExternalEndpoint); }
+        }
+        /// <summary>
+        /// Indicates whether ServerDB's probes to the game server are mostly being lost (the smoothed loss rate exceeds
+        /// <see cref="ProbeLossRateLimit"/>), so players are unlikely to be able to connect to it.
+        /// </summary>
+        public bool ProbeUnreachable
+        {
+            get
+            {
+                GameServerProber.ProbeStatistics? statistics = ProbeStatistics;
+                return statistics != null && statistics.LossRate > ProbeLossRateLimit;
+            }
+        }
+
+        /// <summary>
+        /// The player sessions and entrants occupying the current session.
+        /// </summary>
+        private SessionOccupancy _occupancy;
+
+        /// <summary>
+        /// Indicates whether the current session is being traced.
+        /// </summary>
+        private bool _sessionTraced;
+        /// <summary>
+        /// The time the current traced session was started.
+        /// </summary>
+        private DateTime _sessionTraceStart;
+        /// <summary>
+        /// The current phase of the traced session, the time it started, and the game server span it corresponds to.
+        /// </summary>
+        private (string name, DateTime start, ulong? gameSpanId)? _sessionTracePhase;
+        /// <summary>
+        /// The start times of traced joins which have not been assigned a player session yet, keyed by the matching peer.
+        /// </summary>
+        private Dictionary<Peer, (int index, DateTime start)> _pendingJoinTracesByPeer;
+        /// <summary>
+        /// The start times of traced joins awaiting acceptance by the game server, keyed by player session.
+        /// </summary>
+        private Dictionary<Guid, (int index, DateTime start)> _pendingJoinTraces;
+        /// <summary>
+        /// The amount of joins traced for the current session, used to identify each join.
+        /// </summary>
+        private int _joinTraceCount;
+        /// <summary>
+        /// A lock used for tracing state, which is updated from both locked and unlocked paths.
+        /// </summary>
+        private object _traceLock;
       
         /// <summary>
         /// A lock used for asynchronous/awaitable concurrent access to this object.
@@ -201,7 +331,10 @@ namespace EchoRelay.Core.Server.Services.ServerDB
             _registrationRequest = registrationRequest;
             SessionLobbyType = ERGameServerStartSession.LobbyType.Unassigned;
             SessionPlayerLimits = GameTypePlayerLimits.DefaultLimits;
-            _playerSessions = new Dictionary<Guid, (Peer, TeamIndex)>();
+            _occupancy = new SessionOccupancy();
+            _pendingJoinTracesByPeer = new Dictionary<Peer, (int, DateTime)>();
+            _pendingJoinTraces = new Dictionary<Guid, (int, DateTime)>();
+            _traceLock = new object();
             _accessLock = new AsyncLock();
         }
         #endregion
@@ -214,7 +347,17 @@ namespace EchoRelay.Core.Server.Services.ServerDB
                 return true;
 
             // Otherwise check availability.
-            return SessionPlayerLimits.CheckTeamAvailability(_playerSessions.Values.Select(x => x.requestedTeam).ToArray(), requestedTeam);
+            return SessionPlayerLimits.CheckTeamAvailability(_occupancy.OccupiedTeams, requestedTeam);
+        }
+
+        /// <summary>
+        /// Obtains the amount of players which can still join the current session on a given team.
+        /// </summary>
+        /// <param name="team">The team to obtain the free slots of.</param>
+        /// <returns>The amount of free slots on the team.</returns>
+        public int GetFreeSlots(TeamIndex team)
+        {
+            return SessionPlayerLimits.GetAvailableSlots(_occupancy.OccupiedTeams, team);
         }
         public async Task StartSession(XPlatformId requester, ERGameServerStartSession.LobbyType lobbyType, Guid channel, long? gameTypeSymbol, long? levelSymbol, ERGameServerStartSession.SessionSettings? settings)
         {
@@ -236,14 +379,17 @@ namespace EchoRelay.Core.Server.Services.ServerDB
 
             // Set up our session variables
             SessionId = SecureGuidGenerator.Generate();
+            TraceSessionStart();
             SessionLobbyType = lobbyType;
             SessionChannel = channel;
             SessionGameTypeSymbol = gameTypeSymbol;
             SessionLevelSymbol = levelSymbol;
             SessionPlayerLimits = GameTypePlayerLimits.DefaultLimits;
 
-            _playerSessions.Clear();
+            _occupancy.Clear();
             SessionLocked = false;
+            SessionReady = false;
+            SessionPingSummary = null;
 
             // Merge session settings information and send a "start session" message to the game server.
             var mergedSessionSettings = new ERGameServerStartSession.SessionSettings(
@@ -288,8 +434,9 @@ namespace EchoRelay.Core.Server.Services.ServerDB
             // Send the start session message to the game server.
             await Peer.Send(new ERGameServerStartSession(SessionId.Value, SessionChannel.Value, (byte)SessionPlayerLimits.TotalPlayerLimit, SessionLobbyType, mergedSessionSettings, entrantDescriptors.ToArray()));
 
-            // Add the new session id to the parent registry's lookup.
+            // Add the new session id to the parent registry's lookup, and index our new session state.
             Registry.RegisteredGameServersBySessionId[SessionId.Value] = this;
+            Registry.UpdateIndex(this);
         }
         public async Task ProcessLobbySessionRequest(Peer matchingPeer)
         {
@@ -392,6 +539,7 @@ namespace EchoRelay.Core.Server.Services.ServerDB
                 // Send the success messages to the server (so it knows to expect a new connection with these packet encoder settings).
                 await Peer.Send(sessionSuccessv4);
                 await Peer.Send(sessionSuccessv5);
+                TraceJoinRequested(matchingPeer);
 
                 // Send the success messages to the peer (so it can connect).
                 await matchingPeer.Send(sessionSuccessv4);
@@ -435,7 +583,8 @@ namespace EchoRelay.Core.Server.Services.ServerDB
                         await matchingPeer.Send(new LobbyPlayerSessionsSuccessv3(0xFF, matchingSession.UserId, playerSessions[0], (short)matchingSession.TeamIndex, 0, 0));
 
                         // Add the pending player session associated to this peer.
-                        _playerSessions[playerSessions[0]] = (matchingPeer, matchingSession.TeamIndex);
+                        _occupancy.AddPlayerSession(playerSessions[0], matchingPeer, matchingSession.UserId, matchingSession.TeamIndex);
+                        TraceJoinPlayerSession(matchingPeer, playerSessions[0]);
                     }
 
                 }
@@ -447,10 +596,13 @@ namespace EchoRelay.Core.Server.Services.ServerDB
         /// Sets the locked status on the game server, controlling whether new players can join or not.
         /// </summary>
         /// <param name="locked">The locked status to set for the lobby/session.</param>
-        public void SetLockedStatus(bool locked)
+        /// <param name="traceContext">The game server's trace context for the status change, if it provided one.</param>
+        public void SetLockedStatus(bool locked, ERTraceContext? traceContext = null)
         {
             // Determine if the locked status will change
             bool changed = SessionLocked != locked;
+            if (changed)
+                TraceSessionPhase(locked ? "locked" : "open_for_players", traceContext);
 
             // Set the locked status
             SessionLocked = locked;
@@ -460,14 +612,87 @@ namespace EchoRelay.Core.Server.Services.ServerDB
                 OnSessionStateChanged?.Invoke(this);
         }
 
+        /// <summary>
+        /// Marks the current session as ready for players, following the game server's acknowledgement that it started.
+        /// </summary>
+        /// <param name="sessionStarted">The game server's acknowledgement.</param>
+        public void SetSessionReady(ERGameServerSessionStarted sessionStarted)
+        {
+            // If the acknowledgement is for a session other than our current one, it arrived late and is ignored.
+            if (!SessionStarted || (sessionStarted.TraceContext != null && sessionStarted.TraceContext.TraceId != SessionId))
+                return;
+
+            // Record the time the game server took to start the session.
+            if (sessionStarted.Timing != null)
+                LastSessionStartLatency = sessionStarted.Timing.StartLatency;
+
+            // Set the ready status and fire the relevant event handler.
+            bool changed = !SessionReady;
+            SessionReady = true;
+            if (changed)
+                OnSessionStateChanged?.Invoke(this);
+        }
+
+        /// <summary>
+        /// Updates the round trip times tracked for the current session, and records those observed by each entrant.
+        /// </summary>
+        /// <param name="pingSummary">The summary of round trip times received from the game server.</param>
+        public void UpdatePingSummary(ERGameServerPingSummary pingSummary)
+        {
+            // If the summary is for a session other than our current one, it arrived late and is ignored.
+            if (!SessionStarted || (pingSummary.TraceContext != null && pingSummary.TraceContext.TraceId != SessionId))
+                return;
+
+            SessionPingSummary = pingSummary;
+            Registry.RecordObservedPings(this, pingSummary);
+        }
+
+        /// <summary>
+        /// Applies changes in the occupancy of the current session's entrant slots, reported by the game server, so the players
+        /// and teams tracked for the session match the game's. Player sessions of users which left are removed, as the game
+        /// does not report players which disconnect silently.
+        /// </summary>
+        /// <param name="occupancyEvents">The batch of occupancy changes received from the game server.</param>
+        public async Task ApplyOccupancyEvents(ERGameServerOccupancyEvents occupancyEvents)
+        {
+            // Lock throughout this method.
+            List<(Guid playerSession, Peer? peer)> removedPlayers = new List<(Guid, Peer?)>();
+            await _accessLock.ExecuteLocked(() =>
+            {
+                // If the events are for a session other than our current one, they arrived late and are ignored.
+                if (!SessionStarted || (occupancyEvents.TraceContext != null && occupancyEvents.TraceContext.TraceId != SessionId))
+                    return Task.CompletedTask;
+
+                // If a user left and we hit 0 players, expect end of session, set server as not ready to match. Their player
+                // session may have been removed before they left, so this does not depend on it being removed here.
+                if (_occupancy.ApplyEvents(occupancyEvents.Events, removedPlayers))
+                    SessionLocked = true;
+
+                return Task.CompletedTask;
+            });
+
+            // Fire the event for each player removed.
+            foreach (var removedPlayer in removedPlayers)
+                OnPlayerRemoved?.Invoke(this, removedPlayer.playerSession, removedPlayer.peer);
+        }
+
+        /// <summary>
+        /// Updates the load information tracked for the game server.
+        /// </summary>
+        /// <param name="heartbeat">The heartbeat received from the game server.</param>
+        public void UpdateLoad(ERGameServerHeartbeat heartbeat)
+        {
+            LastHeartbeatTime = DateTime.UtcNow;
+            LastHeartbeat = heartbeat;
+        }
+
         public async Task<Peer?> GetPeer(Guid playerSession)
         {
             // Lock throughout this method and grab the peer for this session.
             Peer? peer = null;
             await _accessLock.ExecuteLocked(() =>
             {
-                if (_playerSessions.TryGetValue(playerSession, out var playerInfo))
-                    peer = playerInfo.peer;
+                peer = _occupancy.GetPeer(playerSession);
                 return Task.CompletedTask;
             });
             return peer;
@@ -479,7 +704,7 @@ namespace EchoRelay.Core.Server.Services.ServerDB
             var playersInfo = Array.Empty<(Guid playerSession, Peer? peer)>();
             await _accessLock.ExecuteLocked(() =>
             {
-                playersInfo = _playerSessions.AsEnumerable().Select(x => (x.Key, (Peer?)x.Value.peer)).ToArray();
+                playersInfo = _occupancy.GetPlayerSessions();
                 return Task.CompletedTask;
             });
             return playersInfo;
@@ -497,6 +722,7 @@ namespace EchoRelay.Core.Server.Services.ServerDB
 
                 // Signal for the game server to accept the players.
                 await Peer.Send(new ERGameServerPlayersAccepted(playerSessions));
+                TraceJoinsAccepted(playerSessions);
 
                 // Obtain every added player session and the associated peer.
                 addedPlayersInfo = new (Guid playerSession, Peer? peer)[playerSessions.Length];
@@ -505,8 +731,7 @@ namespace EchoRelay.Core.Server.Services.ServerDB
                 for (int i = 0; i < addedPlayersInfo.Length; i++)
                 {
                     var playerSession = playerSessions[i];
-                    if (_playerSessions.TryGetValue(playerSession, out var playerInfo))
-                        addedPlayersInfo[i] = (playerSessions[i], playerInfo.peer);
+                    addedPlayersInfo[i] = (playerSessions[i], _occupancy.GetPeer(playerSession));
                 }
             });
 
@@ -529,12 +754,8 @@ namespace EchoRelay.Core.Server.Services.ServerDB
             // Lock throughout this method.
             await _accessLock.ExecuteLocked(() =>
             {
-                // Try to get the existing peer for this player session.
-                if(_playerSessions.TryGetValue(playerSession, out var playerInfo))
-                    peer = playerInfo.peer;
-
-                // Remove this player session from our lookup if it exists.
-                _playerSessions.Remove(playerSession);
+                // Remove this player session from our lookup if it exists, obtaining its peer.
+                _occupancy.RemovePlayerSession(playerSession, out peer);
 
                 // If we hit 0 players, expect end of session, set server as not ready to match.
                 if (SessionStarted && SessionPlayerCount == 0)
@@ -547,10 +768,13 @@ namespace EchoRelay.Core.Server.Services.ServerDB
             OnPlayerRemoved?.Invoke(this, playerSession, peer);
         }
 
-        public async Task EndSession()
+        public async Task EndSession(ERTraceContext? traceContext = null)
         {
             // Lock throughout this method.
             await _accessLock.ExecuteLocked(() => {
+                // End the session trace before our session identifier is cleared.
+                TraceSessionEnd(traceContext, true);
+
                 // Reset all variables
                 SessionId = null;
                 SessionLobbyType = ERGameServerStartSession.LobbyType.Unassigned;
@@ -558,8 +782,11 @@ namespace EchoRelay.Core.Server.Services.ServerDB
                 SessionGameTypeSymbol = null;
                 SessionLevelSymbol = null;
                 SessionLocked = false;
+                SessionReady = false;
+                SessionPingSummary = null;
                 SessionPlayerLimits = GameTypePlayerLimits.DefaultLimits;
-                _playerSessions.Clear();
+                _occupancy.Clear();
+                Registry.UpdateIndex(this);
 
                 return Task.CompletedTask;
             });
@@ -568,5 +795,146 @@ namespace EchoRelay.Core.Server.Services.ServerDB
             OnSessionStateChanged?.Invoke(this);
         }
         #endregion
+
+        #region Tracing
+        /// <summary>
+        /// Begins tracing the current session if it is sampled, ending the trace of any previous session which never ended.
+        /// </summary>
+        private void TraceSessionStart()
+        {
+            lock (_traceLock)
+            {
+                TraceSessionEnd(null, false);
+                SessionTraceWriter? sessionTrace = Server.ServerDBService.SessionTrace;
+                _sessionTraced = SessionId != null && sessionTrace != null && sessionTrace.ShouldSample(SessionId.Value);
+                if (!_sessionTraced)
+                    return;
+
+                // The session is open to players from the moment it is started, until the game server locks it.
+                _sessionTraceStart = DateTime.UtcNow;
+                _sessionTracePhase = ("open_for_players", _sessionTraceStart, null);
+                _joinTraceCount = 0;
+            }
+        }
+
+        /// <summary>
+        /// Transitions the traced session to a new phase, writing the span for the previous phase.
+        /// </summary>
+        /// <param name="phase">The name of the phase to transition to, or null if the session is ending.</param>
+        /// <param name="traceContext">The game server's trace context for the transition, if it provided one.</param>
+        /// <param name="completed">Indicates whether the previous phase ended normally, rather than being cut short.</param>
+        private void TraceSessionPhase(string? phase, ERTraceContext? traceContext, bool completed = true)
+        {
+            lock (_traceLock)
+            {
+                SessionTraceWriter? sessionTrace = Server.ServerDBService.SessionTrace;
+                if (!_sessionTraced || sessionTrace == null || SessionId == null)
+                    return;
+
+                // Write the previous phase, along with the game server span it corresponds to.
+                DateTime now = DateTime.UtcNow;
+                if (_sessionTracePhase != null)
+                {
+                    var previous = _sessionTracePhase.Value;
+                    sessionTrace.WriteSpan(previous.name, SessionId.Value.ToString(), SessionId.Value, previous.start, now, completed, GetTraceArgs(previous.gameSpanId));
+                }
+                _sessionTracePhase = phase != null ? (phase, now, traceContext?.TraceId == SessionId ? traceContext?.SpanId : null) : null;
+            }
+        }
+
+        /// <summary>
+        /// Ends the trace of the current session, writing any joins which were never accepted as incomplete.
+        /// </summary>
+        /// <param name="traceContext">The game server's trace context for the end of the session, if it provided one.</param>
+        /// <param name="completed">Indicates whether the session ended normally, rather than being cut short.</param>
+        private void TraceSessionEnd(ERTraceContext? traceContext, bool completed)
+        {
+            lock (_traceLock)
+            {
+                SessionTraceWriter? sessionTrace = Server.ServerDBService.SessionTrace;
+                if (_sessionTraced && sessionTrace != null && SessionId != null)
+                {
+                    DateTime now = DateTime.UtcNow;
+                    foreach (var join in _pendingJoinTracesByPeer.Values.Concat(_pendingJoinTraces.Values))
+                        sessionTrace.WriteSpan("join", $"{SessionId.Value}.join.{join.index}", SessionId.Value, join.start, now, false);
+
+                    // End the current phase (in the session's track), then the session itself.
+                    TraceSessionPhase(null, null, completed);
+                    ulong? gameSpanId = traceContext?.TraceId == SessionId ? traceContext?.SpanId : null;
+                    sessionTrace.WriteSpan("session", SessionId.Value.ToString(), SessionId.Value, _sessionTraceStart, now, completed, GetTraceArgs(gameSpanId));
+                }
+
+                _sessionTraced = false;
+                _sessionTracePhase = null;
+                _pendingJoinTracesByPeer.Clear();
+                _pendingJoinTraces.Clear();
+            }
+        }
+
+        /// <summary>
+        /// Begins tracing a join for the current session, once the game server has been sent the join's connection parameters.
+        /// </summary>
+        /// <param name="matchingPeer">The matching peer which is joining.</param>
+        private void TraceJoinRequested(Peer matchingPeer)
+        {
+            lock (_traceLock)
+            {
+                if (_sessionTraced)
+                    _pendingJoinTracesByPeer[matchingPeer] = (_joinTraceCount++, DateTime.UtcNow);
+            }
+        }
+
+        /// <summary>
+        /// Associates a traced join with the player session created for it, so it can be ended when the player is accepted.
+        /// </summary>
+        /// <param name="matchingPeer">The matching peer which is joining.</param>
+        /// <param name="playerSession">The player session created for the peer.</param>
+        private void TraceJoinPlayerSession(Peer matchingPeer, Guid playerSession)
+        {
+            lock (_traceLock)
+            {
+                if (_pendingJoinTracesByPeer.Remove(matchingPeer, out var join))
+                    _pendingJoinTraces[playerSession] = join;
+            }
+        }
+
+        /// <summary>
+        /// Ends the traced joins for player sessions which the game server accepted.
+        /// </summary>
+        /// <param name="playerSessions">The player sessions which were accepted.</param>
+        private void TraceJoinsAccepted(Guid[] playerSessions)
+        {
+            lock (_traceLock)
+            {
+                SessionTraceWriter? sessionTrace = Server.ServerDBService.SessionTrace;
+                if (!_sessionTraced || sessionTrace == null || SessionId == null)
+                    return;
+
+                DateTime now = DateTime.UtcNow;
+                foreach (Guid playerSession in playerSessions)
+                {
+                    if (_pendingJoinTraces.Remove(playerSession, out var join))
+                    {
+                        sessionTrace.WriteSpan("join", $"{SessionId.Value}.join.{join.index}", SessionId.Value, join.start, now, true,
+                            new Dictionary<string, object?>() { { "player_session", playerSession.ToString() } });
+                    }
+                }
+            }
+        }
+
+        /// <summary>
+        /// Obtains the arguments to attach to a session span.
+        /// </summary>
+        /// <param name="gameSpanId">The game server span the span corresponds to, if known.</param>
+        /// <returns>The arguments to attach to the span.</returns>
+        private Dictionary<string, object?> GetTraceArgs(ulong? gameSpanId)
+        {
+            return new Dictionary<string, object?>()
+            {
+                { "server_id", ServerId },
+                { "game_span_id", gameSpanId },
+            };
+        }
+        #endregion
     }
 }
@@ -1,6 +1,7 @@
 ﻿using EchoRelay.Core.Server.Messages;
 using EchoRelay.Core.Server.Messages.Common;
 using EchoRelay.Core.Server.Messages.ServerDB;
+using EchoRelay.Core.Utils;
 using System.Collections.Specialized;
 using System.Web;
 using static EchoRelay.Core.Server.Services.ServerDB.ServerDBService;
@@ -9,11 +10,35 @@ namespace EchoRelay.Core.Server.Services.ServerDB
 {
     public class ServerDBService : Service
     {
+        #region Constants
+        /// <summary>
+        /// The interval at which all registered game servers are re-probed when endpoint validation is enabled, in milliseconds.
+        /// </summary>
+        private const int ProbeRefreshIntervalMilliseconds = 10000;
+        #endregion
+
         #region Properties
         /// <summary>
         /// The registry maintaining all registered game servers.
         /// </summary>
         public GameServerRegistry Registry { get; }
+
+        /// <summary>
+        /// The writer for session lifecycle spans, or null if session tracing is disabled.
+        /// </summary>
+        public SessionTraceWriter? SessionTrace { get; }
+
+        /// <summary>
+        /// The prober used to validate game server endpoints and track their round trip time and loss.
+        /// </summary>
+        public GameServerProber Prober { get; }
+        #endregion
+
+        #region Fields
+        /// <summary>
+        /// A timer which periodically re-probes all registered game servers, or null if it is not running.
+        /// </summary>
+        private Timer? _probeRefreshTimer;
         #endregion
 
         #region Events
@@ -37,11 +62,40 @@ namespace EchoRelay.Core.Server.Services.ServerDB
         public ServerDBService(Server server) : base(server, "SERVERDB")
         {
             Registry = new GameServerRegistry();
+            if (server.Settings.SessionTraceDirectory != null && server.Settings.SessionTraceSampleRate > 0)
+                SessionTrace = new SessionTraceWriter(server.Settings.SessionTraceDirectory, server.Settings.SessionTraceSampleRate);
+            Prober = new GameServerProber();
+            Registry.OnGameServerUnregistered += (gameServer) => Prober.RemoveStatistics(gameServer.ExternalEndpoint);
             OnPeerDisconnected += ServerDBService_OnPeerDisconnected;
+            server.OnServerStarted += ServerDBService_OnServerStarted;
+            server.OnServerStopped += ServerDBService_OnServerStopped;
         }
         #endregion
 
         #region Functions
+        private void ServerDBService_OnServerStarted(Server server)
+        {
+            // If we validate game server endpoints, keep probing registered game servers so their availability stays current.
+            // Game servers whose probes are mostly lost are not matched to (see RegisteredGameServer.ProbeUnreachable).
+            if (Server.Settings.ServerDBValidateServerEndpoint)
+                _probeRefreshTimer = new Timer(_ => RefreshProbes(), null, ProbeRefreshIntervalMilliseconds, ProbeRefreshIntervalMilliseconds);
+        }
+
+        private void ServerDBService_OnServerStopped(Server server)
+        {
+            _probeRefreshTimer?.Dispose();
+            _probeRefreshTimer = null;
+        }
+
+        /// <summary>
+        /// Sends a probe to every registered game server. Results are reflected in <see cref="Prober"/>'s statistics, which each
+        /// game server exposes as <see cref="RegisteredGameServer.ProbeStatistics"/>.
+        /// </summary>
+        private void RefreshProbes()
+        {
+            Prober.ProbeAll(Registry.RegisteredGameServers.Values.Select(x => x.ExternalEndpoint), Server.Settings.ServerDBValidateServerEndpointTimeout);
+        }
+
         private void ServerDBService_OnPeerDisconnected(Service service, Peer peer)
         {
             ClearPeerRegistration(peer);
@@ -94,6 +148,15 @@ namespace EchoRelay.Core.Server.Services.ServerDB
                     case ERGameServerRemovePlayer removePlayer:
                         await ProcessRemovePlayer(sender, removePlayer);
                         break;
+                    case ERGameServerHeartbeat heartbeat:
+                        await ProcessHeartbeat(sender, heartbeat);
+                        break;
+                    case ERGameServerPingSummary pingSummary:
+                        await ProcessPingSummary(sender, pingSummary);
+                        break;
+                    case ERGameServerOccupancyEvents occupancyEvents:
+                        await ProcessOccupancyEvents(sender, occupancyEvents);
+                        break;
 
                 }
             }
@@ -124,7 +187,7 @@ namespace EchoRelay.Core.Server.Services.ServerDB
 
             // Create the game server object, then validate it.
             RegisteredGameServer registeredGameServer = new RegisteredGameServer(Registry, sender, request);
-            if (Server.Settings.ServerDBValidateServerEndpoint && !(await GameServerPingClient.CheckAvailable(registeredGameServer, Server.Settings.ServerDBValidateServerEndpointTimeout)))
+            if (Server.Settings.ServerDBValidateServerEndpoint && !(await Prober.Probe(registeredGameServer.ExternalEndpoint, Server.Settings.ServerDBValidateServerEndpointTimeout)))
             {
                 OnGameServerRegistrationFailure?.Invoke(sender, request, "Raw ping request/acknowledgement failed. The game server could not be connected to. It may not have exposed its ports properly.");
                 await sender.Send(new LobbyRegistrationFailure(LobbyRegistrationFailure.FailureCode.ConnectionFailed));
@@ -149,7 +212,13 @@ namespace EchoRelay.Core.Server.Services.ServerDB
         /// <param name="request">The request contents.</param>
         private async Task ProcessSessionStarted(Peer sender, ERGameServerSessionStarted request)
         {
-            // This is here if we need it, but we assume the session started when a session start message is sent.
+            // Obtain the registered game server
+            RegisteredGameServer? registeredGameServer = sender.GetSessionData<RegisteredGameServer>();
+            if (registeredGameServer == null)
+                return;
+
+            // Update the session ready status.
+            registeredGameServer.SetSessionReady(request);
         }
 
         /// <summary>
@@ -165,7 +234,7 @@ namespace EchoRelay.Core.Server.Services.ServerDB
                 return;
 
             // Update the session started status.
-            await registeredGameServer.EndSession();
+            await registeredGameServer.EndSession(request.TraceContext);
         }
 
         /// <summary>
@@ -181,7 +250,7 @@ namespace EchoRelay.Core.Server.Services.ServerDB
                 return;
 
             // Update the locked status.
-            registeredGameServer.SetLockedStatus(true);
+            registeredGameServer.SetLockedStatus(true, request.TraceContext);
         }
 
         /// <summary>
@@ -197,7 +266,7 @@ namespace EchoRelay.Core.Server.Services.ServerDB
                 return;
 
             // Update the locked status.
-            registeredGameServer.SetLockedStatus(false);
+            registeredGameServer.SetLockedStatus(false, request.TraceContext);
         }
 
         /// <summary>
@@ -231,6 +300,54 @@ namespace EchoRelay.Core.Server.Services.ServerDB
             // Remove the provided player session from the associated game server.
             await registeredGameServer.RemovePlayer(request.PlayerSession);
         }
+
+        /// <summary>
+        /// Processes a <see cref="ERGameServerHeartbeat"/>.
+        /// </summary>
+        /// <param name="sender">The sender of the request.</param>
+        /// <param name="request">The request contents.</param>
+        private async Task ProcessHeartbeat(Peer sender, ERGameServerHeartbeat request)
+        {
+            // Obtain the registered game server
+            RegisteredGameServer? registeredGameServer = sender.GetSessionData<RegisteredGameServer>();
+            if (registeredGameServer == null)
+                return;
+
+            // Update the load information for the game server.
+            registeredGameServer.UpdateLoad(request);
+        }
+
+        /// <summary>
+        /// Processes a <see cref="ERGameServerPingSummary"/>.
+        /// </summary>
+        /// <param name="sender">The sender of the request.</param>
+        /// <param name="request">The request contents.</param>
+        private async Task ProcessPingSummary(Peer sender, ERGameServerPingSummary request)
+        {
+            // Obtain the registered game server
+            RegisteredGameServer? registeredGameServer = sender.GetSessionData<RegisteredGameServer>();
+            if (registeredGameServer == null)
+                return;
+
+            // Update the round trip times for the game server's session and its entrants.
+            registeredGameServer.UpdatePingSummary(request);
+        }
+
+        /// <summary>
+        /// Processes a <see cref="ERGameServerOccupancyEvents"/>.
+        /// </summary>
+        /// <param name="sender">The sender of the request.</param>
+        /// <param name="request">The request contents.</param>
+        private async Task ProcessOccupancyEvents(Peer sender, ERGameServerOccupancyEvents request)
+        {
+            // Obtain the registered game server
+            RegisteredGameServer? registeredGameServer = sender.GetSessionData<RegisteredGameServer>();
+            if (registeredGameServer == null)
+                return;
+
+            // Apply the changes in occupancy to the game server's session.
+            await registeredGameServer.ApplyOccupancyEvents(request);
+        }
         #endregion
     }
 }
@@ -0,0 +1,181 @@
+﻿using EchoRelay.Core.Game;
+using EchoRelay.Core.Server.Messages.ServerDB;
+
+namespace EchoRelay.Core.Server.Services.ServerDB
+{
+    /// <summary>
+    /// Tracks the players occupying a <see cref="RegisteredGameServer"/>'s session: the player sessions issued for it, and the
+    /// entrants the game server reports occupying its slots. This is not thread safe, the owning game server serializes access
+    /// to it, with the exception of <see cref="OccupiedTeams"/>, which can be read without locking.
+    /// </summary>
+    public class SessionOccupancy
+    {
+        #region Properties
+        /// <summary>
+        /// The team of every player in the session: the current team of each entrant reported by the game server, and the
+        /// requested team of each player session which has not joined yet. This is replaced (not modified) when either changes,
+        /// so it can be read without locking.
+        /// </summary>
+        public TeamIndex[] OccupiedTeams { get; private set; }
+        /// <summary>
+        /// The current amount of players in the session, including players which were issued a player session but have not joined yet.
+        /// </summary>
+        public int PlayerCount => OccupiedTeams.Length;
+        /// <summary>
+        /// The entrant slot of the session's lobby owner, as reported by the game server, or null if it has not reported one.
+        /// </summary>
+        public ushort? OwnerSlot { get; private set; }
+        /// <summary>
+        /// The amount of entrants the game server reported occupying a slot.
+        /// </summary>
+        public int EntrantCount => _entrants.Count;
+        #endregion
+
+        #region Fields
+        /// <summary>
+        /// Represents the active player sessions in the session.
+        /// </summary>
+        private Dictionary<Guid, (Peer? peer, XPlatformId userId, TeamIndex requestedTeam, bool joined)> _playerSessions;
+        /// <summary>
+        /// The users the game server reported occupying each entrant slot, and their current team. This is empty for game
+        /// servers which do not report occupancy.
+        /// </summary>
+        private Dictionary<ushort, (XPlatformId userId, TeamIndex team)> _entrants;
+        #endregion
+
+        #region Constructor
+        public SessionOccupancy()
+        {
+            OccupiedTeams = Array.Empty<TeamIndex>();
+            _playerSessions = new Dictionary<Guid, (Peer?, XPlatformId, TeamIndex, bool)>();
+            _entrants = new Dictionary<ushort, (XPlatformId, TeamIndex)>();
+        }
+        #endregion
+
+        #region Functions
+        /// <summary>
+        /// Removes every player session and entrant, as the session ended or a new one started.
+        /// </summary>
+        public void Clear()
+        {
+            _playerSessions.Clear();
+            _entrants.Clear();
+            OwnerSlot = null;
+            UpdateOccupiedTeams();
+        }
+
+        /// <summary>
+        /// Adds a player session which was issued to a user, holding a slot on its requested team until the user joins.
+        /// </summary>
+        /// <param name="playerSession">The player session issued.</param>
+        /// <param name="peer">The peer the player session was issued to.</param>
+        /// <param name="userId">The identifier of the user the player session was issued to.</param>
+        /// <param name="requestedTeam">The team the user requested.</param>
+        public void AddPlayerSession(Guid playerSession, Peer? peer, XPlatformId userId, TeamIndex requestedTeam)
+        {
+            _playerSessions[playerSession] = (peer, userId, requestedTeam, false);
+            UpdateOccupiedTeams();
+        }
+
+        /// <summary>
+        /// Removes a player session, following the game server reporting the player was removed.
+        /// </summary>
+        /// <param name="playerSession">The player session to remove.</param>
+        /// <param name="peer">The peer the player session was issued to, or null if it did not exist.</param>
+        /// <returns>Indicates whether the player session existed.</returns>
+        public bool RemovePlayerSession(Guid playerSession, out Peer? peer)
+        {
+            peer = null;
+            if (!_playerSessions.Remove(playerSession, out var playerInfo))
+                return false;
+            peer = playerInfo.peer;
+            UpdateOccupiedTeams();
+            return true;
+        }
+
+        /// <summary>
+        /// Obtains the peer a player session was issued to.
+        /// </summary>
+        /// <param name="playerSession">The player session to obtain the peer for.</param>
+        /// <returns>The peer, or null if the player session does not exist.</returns>
+        public Peer? GetPeer(Guid playerSession)
+        {
+            return _playerSessions.TryGetValue(playerSession, out var playerInfo) ? playerInfo.peer : null;
+        }
+
+        /// <summary>
+        /// Obtains every player session and the peer it was issued to.
+        /// </summary>
+        /// <returns>The player sessions and their peers.</returns>
+        public (Guid PlayerSession, Peer? Peer)[] GetPlayerSessions()
+        {
+            return _playerSessions.Select(x => (x.Key, x.Value.peer)).ToArray();
+        }
+
+        /// <summary>
+        /// Applies changes in the occupancy of the session's entrant slots, reported by the game server, so the players and teams
+        /// tracked match the game's. Player sessions of users which left are removed, as the game does not report players which
+        /// disconnect silently.
+        /// </summary>
+        /// <param name="occupancyEvents">The occupancy changes to apply, in the order they occurred.</param>
+        /// <param name="removedPlayers">The player sessions removed as their users left, and their peers.</param>
+        /// <returns>Indicates whether a user left and no players remain, so the session is expected to end.</returns>
+        public bool ApplyEvents(IEnumerable<ERGameServerOccupancyEvents.OccupancyEvent> occupancyEvents, List<(Guid playerSession, Peer? peer)> removedPlayers)
+        {
+            bool left = false;
+            foreach (ERGameServerOccupancyEvents.OccupancyEvent occupancyEvent in occupancyEvents)
+            {
+                switch (occupancyEvent.Type)
+                {
+                    case ERGameServerOccupancyEvents.OccupancyEventType.Join:
+                        // The user now occupies the slot. If they joined with a player session, it no longer holds a slot of its own.
+                        _entrants[occupancyEvent.Slot] = (occupancyEvent.UserId, occupancyEvent.TeamIndex);
+                        foreach (var playerSession in _playerSessions)
+                        {
+                            if (!playerSession.Value.joined && playerSession.Value.userId == occupancyEvent.UserId)
+                            {
+                                _playerSessions[playerSession.Key] = (playerSession.Value.peer, playerSession.Value.userId, playerSession.Value.requestedTeam, true);
+                                break;
+                            }
+                        }
+                        break;
+
+                    case ERGameServerOccupancyEvents.OccupancyEventType.Leave:
+                        // The user left the slot. Remove the player sessions they joined with, in case they disconnected silently.
+                        // Their player session may already have been removed, in which case only the slot is freed.
+                        left = true;
+                        _entrants.Remove(occupancyEvent.Slot);
+                        foreach (var playerSession in _playerSessions.Where(x => x.Value.joined && x.Value.userId == occupancyEvent.UserId).ToArray())
+                        {
+                            _playerSessions.Remove(playerSession.Key);
+                            removedPlayers.Add((playerSession.Key, playerSession.Value.peer));
+                        }
+                        break;
+
+                    case ERGameServerOccupancyEvents.OccupancyEventType.TeamChange:
+                        _entrants[occupancyEvent.Slot] = (occupancyEvent.UserId, occupancyEvent.TeamIndex);
+                        break;
+
+                    case ERGameServerOccupancyEvents.OccupancyEventType.OwnerChange:
+                        OwnerSlot = occupancyEvent.Slot != ERGameServerOccupancyEvents.NoSlot ? occupancyEvent.Slot : null;
+                        break;
+                }
+            }
+            UpdateOccupiedTeams();
+            return left && PlayerCount == 0;
+        }
+
+        /// <summary>
+        /// Updates the teams of the players in the session, following a change in its entrants or player sessions.
+        /// </summary>
+        private void UpdateOccupiedTeams()
+        {
+            // Entrants reported by the game server occupy their current team. Player sessions which have not joined yet hold a
+            // slot on the team they requested, so players being matched concurrently do not overfill it.
+            OccupiedTeams = _entrants.Values.Select(x => x.team)
+                .Concat(_playerSessions.Values.Where(x => !x.joined).Select(x => x.requestedTeam))
+                .ToArray();
+        }
+        #endregion
+    }
+}
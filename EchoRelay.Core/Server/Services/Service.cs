@@ -159,7 +159,7 @@ namespace EchoRelay.Core.Server.Services
                     }
 
                     // Obtain the packet buffer without the trailing unused space.
-                    byte[] packetBuffer = receiveBuffer.Take(totalSize).ToArray();
+                    byte[] packetBuffer = receiveBuffer.AsSpan(0, totalSize).ToArray();
                     switch (messageType)
                     {
                         case WebSocketMessageType.Binary:
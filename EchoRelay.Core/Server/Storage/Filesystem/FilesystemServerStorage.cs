@@ -11,11 +11,16 @@ namespace EchoRelay.Core.Server.Storage.Filesystem
         /// </summary>
         public string RootDirectory { get; }
 
+        /// <summary>
+        /// Indicates whether accounts are stored in a single append-only log, rather than as individual files.
+        /// </summary>
+        public bool UseAccountLog { get; }
+
         public override ResourceProvider<AccessControlListResource> AccessControlList => _accessControlList;
         private FilesystemResourceProvider<AccessControlListResource> _accessControlList;
 
         public override ResourceCollectionProvider<XPlatformId, AccountResource> Accounts => _accounts;
-        private FilesystemResourceCollectionProvider<XPlatformId, AccountResource> _accounts;
+        private ResourceCollectionProvider<XPlatformId, AccountResource> _accounts;
 
         public override ResourceProvider<ChannelInfoResource> ChannelInfo => _channelInfo;
         private FilesystemResourceProvider<ChannelInfoResource> _channelInfo;
@@ -35,16 +40,24 @@ namespace EchoRelay.Core.Server.Storage.Filesystem
 
         private readonly object _symbolCacheLock = new object();
 
-        public FilesystemServerStorage(string rootDirectory)
+        /// <summary>
+        /// Initializes a new <see cref="FilesystemServerStorage"/> in the given directory.
+        /// </summary>
+        /// <param name="rootDirectory">The root directory to store resources in.</param>
+        /// <param name="useAccountLog">Indicates whether accounts should be stored in a single append-only log, rather than as individual
+        /// files. When the log is first created, any existing account files are imported into it.</param>
+        public FilesystemServerStorage(string rootDirectory, bool useAccountLog = false)
         {
             // Verify our root directory exists
             Directory.CreateDirectory(rootDirectory);
 
             // Set our properties
             RootDirectory = rootDirectory;
+            UseAccountLog = useAccountLog;
             var accountsDirectory = Path.Join(RootDirectory, "accounts");
             var configResourceDirectory = Path.Join(RootDirectory, "configs");
             var documentResourceDirectory = Path.Join(RootDirectory, "documents");
+            var accountsLogFilePath = Path.Join(RootDirectory, "accounts.log");
             var accessControlListFilePath = Path.Join(RootDirectory, "access_control_list.json");
             var channelInfoFilePath = Path.Join(RootDirectory, "channel_info.json");
             var loginSettingsFilePath = Path.Join(RootDirectory, "login_settings.json");
@@ -52,7 +65,10 @@ namespace EchoRelay.Core.Server.Storage.Filesystem
 
             // Create our resource containers
             _accessControlList = new FilesystemResourceProvider<AccessControlListResource>(this, accessControlListFilePath);
-            _accounts = new FilesystemResourceCollectionProvider<XPlatformId, AccountResource>(this, accountsDirectory, "*.json", x => $"{x}.json", 0x100);
+            if (useAccountLog)
+                _accounts = new LogResourceCollectionProvider<XPlatformId, AccountResource>(this, accountsLogFilePath, accountsDirectory);
+            else
+                _accounts = new FilesystemResourceCollectionProvider<XPlatformId, AccountResource>(this, accountsDirectory, "*.json", x => $"{x}.json", 0x100);
             _channelInfo = new FilesystemResourceProvider<ChannelInfoResource>(this, channelInfoFilePath);
             _configs = new FilesystemResourceCollectionProvider<(string Type, string Identifier), ConfigResource>(this, configResourceDirectory, "*.json", x => $"{x.Identifier}.json", 0x100);
             _documents = new FilesystemResourceCollectionProvider<(string Type, string Language), DocumentResource>(this, documentResourceDirectory, "*.json", x => $"{x.Type}_{x.Language}.json", 0x100);
@@ -0,0 +1,480 @@
+﻿using EchoRelay.Core.Server.Storage.Types;
+using EchoRelay.Core.Utils;
+using Microsoft.Win32.SafeHandles;
+using Newtonsoft.Json;
+using System.Text;
+
+namespace EchoRelay.Core.Server.Storage.Filesystem
+{
+    /// <summary>
+    /// A filesystem <see cref="ResourceCollectionProvider{K, V}"/> which stores a given type of keyed resource as compressed records
+    /// in a single append-only log file. An in-memory index maps each key to its latest record, so reading a resource costs a
+    /// single positioned read and a decompression, regardless of how many resources are stored. Writes are appended and made
+    /// visible immediately, while flushes to disk are grouped on an interval. Space held by overwritten or deleted records is
+    /// reclaimed by compacting the log in the background.
+    /// </summary>
+    /// <typeparam name="K">The type of key which is used to index the resource.</typeparam>
+    /// <typeparam name="V">The type of resources which should be managed by this provider.</typeparam>
+    internal class LogResourceCollectionProvider<K, V> : ResourceCollectionProvider<K, V>
+        where K : notnull
+        where V : IKeyedResource<K>
+    {
+        #region Constants
+        /// <summary>
+        /// The magic value at the start of a log file ("ERLG").
+        /// </summary>
+        private const uint LogMagic = 0x474C5245;
+        /// <summary>
+        /// The version of the log file format.
+        /// </summary>
+        private const uint LogVersion = 1;
+        /// <summary>
+        /// The size of the log file header, in bytes.
+        /// </summary>
+        private const int LogHeaderSize = 8;
+        /// <summary>
+        /// The size of a record header (record length, record type, key length), in bytes.
+        /// </summary>
+        private const int RecordHeaderSize = 7;
+        /// <summary>
+        /// The default minimum amount of space held by stale records before the log is compacted, in bytes.
+        /// </summary>
+        private const long DefaultCompactionMinimumStaleBytes = 4 * 1024 * 1024;
+        #endregion
+
+        #region Properties
+        /// <summary>
+        /// The file path of the log.
+        /// </summary>
+        public string FilePath { get; }
+        /// <summary>
+        /// A directory of JSON resources to import when the log is first created, or null to start empty.
+        /// </summary>
+        public string? ImportDirectory { get; }
+        /// <summary>
+        /// The interval at which appended records are flushed to disk, in milliseconds.
+        /// </summary>
+        public int FlushIntervalMilliseconds { get; }
+        /// <summary>
+        /// The minimum amount of space held by stale records before the log is compacted, in bytes.
+        /// </summary>
+        public long CompactionMinimumStaleBytes { get; }
+        #endregion
+
+        #region Fields
+        /// <summary>
+        /// The log file stream, or null if the provider is closed. Writes are unbuffered, so appended records are visible to
+        /// positioned reads immediately.
+        /// </summary>
+        private FileStream? _stream;
+        /// <summary>
+        /// The location of the latest record for each key.
+        /// </summary>
+        private Dictionary<K, RecordLocation> _index;
+        /// <summary>
+        /// The amount of bytes in the log held by records which are no longer indexed.
+        /// </summary>
+        private long _staleBytes;
+        /// <summary>
+        /// Indicates whether records were appended since the last flush to disk.
+        /// </summary>
+        private bool _dirty;
+        /// <summary>
+        /// A lock which allows concurrent reads, but serializes appends and compaction.
+        /// </summary>
+        private ReaderWriterLockSlim _lock;
+        /// <summary>
+        /// A timer which flushes appended records to disk and compacts the log.
+        /// </summary>
+        private Timer? _flushTimer;
+        #endregion
+
+        #region Constructor
+        public LogResourceCollectionProvider(ServerStorage storage, string filePath, string? importDirectory = null, int flushIntervalMilliseconds = 100, long compactionMinimumStaleBytes = DefaultCompactionMinimumStaleBytes) : base(storage)
+        {
+            FilePath = filePath;
+            ImportDirectory = importDirectory;
+            FlushIntervalMilliseconds = flushIntervalMilliseconds;
+            CompactionMinimumStaleBytes = compactionMinimumStaleBytes;
+            _index = new Dictionary<K, RecordLocation>();
+            _lock = new ReaderWriterLockSlim();
+        }
+        #endregion
+
+        #region Functions
+        protected override void OpenInternal()
+        {
+            _lock.EnterWriteLock();
+            try
+            {
+                // Create the log if it does not exist, then rebuild our index from it.
+                string? parentDirectory = Path.GetDirectoryName(FilePath);
+                if (parentDirectory != null)
+                    Directory.CreateDirectory(parentDirectory);
+                if (!File.Exists(FilePath))
+                    CreateLog();
+                _stream = OpenLogStream(FilePath);
+                LoadIndex();
+            }
+            catch
+            {
+                CloseLog();
+                throw;
+            }
+            finally
+            {
+                _lock.ExitWriteLock();
+            }
+
+            // Start flushing and compacting in the background.
+            _flushTimer = new Timer(_ => Update(), null, FlushIntervalMilliseconds, FlushIntervalMilliseconds);
+        }
+
+        protected override void CloseInternal()
+        {
+            _flushTimer?.Dispose();
+            _flushTimer = null;
+
+            _lock.EnterWriteLock();
+            try
+            {
+                CloseLog();
+            }
+            finally
+            {
+                _lock.ExitWriteLock();
+            }
+        }
+
+        public override K[] Keys()
+        {
+            _lock.EnterReadLock();
+            try
+            {
+                return _index.Keys.ToArray();
+            }
+            finally
+            {
+                _lock.ExitReadLock();
+            }
+        }
+        public override bool Exists(K key)
+        {
+            _lock.EnterReadLock();
+            try
+            {
+                return _index.ContainsKey(key);
+            }
+            finally
+            {
+                _lock.ExitReadLock();
+            }
+        }
+
+        protected override V? GetInternal(K key)
+        {
+            // Read the compressed resource from its latest record.
+            byte[] compressedData;
+            _lock.EnterReadLock();
+            try
+            {
+                if (_stream == null || !_index.TryGetValue(key, out RecordLocation location))
+                    return default;
+                compressedData = new byte[location.DataLength];
+                RandomAccess.Read(_stream.SafeFileHandle, compressedData, location.DataOffset);
+            }
+            finally
+            {
+                _lock.ExitReadLock();
+            }
+
+            // Decompress and deserialize it outside of the lock.
+            return JsonConvert.DeserializeObject<V>(Encoding.UTF8.GetString(Compression.DecompressZstd(compressedData)));
+        }
+        protected override void SetInternal(K key, V resource)
+        {
+            _lock.EnterWriteLock();
+            try
+            {
+                Append(key, resource);
+            }
+            finally
+            {
+                _lock.ExitWriteLock();
+            }
+        }
+        protected override V? DeleteInternal(K key)
+        {
+            // Obtain the resource we are removing, so it can be returned.
+            V? resource = GetInternal(key);
+            if (resource == null)
+                return default;
+
+            _lock.EnterWriteLock();
+            try
+            {
+                Append(key, default);
+            }
+            finally
+            {
+                _lock.ExitWriteLock();
+            }
+            return resource;
+        }
+
+        /// <summary>
+        /// Creates a new log, importing any resources from the import directory into it. The log is built under a temporary
+        /// name and only moved into place once it is complete and flushed, so an import which fails or is interrupted is
+        /// retried in full on the next open, rather than leaving a log which is missing resources.
+        /// </summary>
+        private void CreateLog()
+        {
+            string importFilePath = FilePath + ".import";
+            try
+            {
+                _stream = new FileStream(importFilePath, FileMode.Create, FileAccess.ReadWrite, FileShare.None, 0);
+                byte[] header = new byte[LogHeaderSize];
+                BitConverter.TryWriteBytes(header.AsSpan(0), LogMagic);
+                BitConverter.TryWriteBytes(header.AsSpan(4), LogVersion);
+                _stream.Write(header);
+
+                // Import any resources from the provided directory.
+                if (ImportDirectory != null && Directory.Exists(ImportDirectory))
+                {
+                    foreach (string resourceFilePath in Directory.GetFiles(ImportDirectory, "*.json"))
+                    {
+                        V? resource = JsonConvert.DeserializeObject<V>(File.ReadAllText(resourceFilePath));
+                        if (resource == null)
+                            throw new InvalidDataException($"Could not import resource {typeof(V).Name}: '{resourceFilePath}'");
+                        Append(resource.Key(), resource);
+                    }
+                }
+                _stream.Flush(true);
+            }
+            catch
+            {
+                CloseLog();
+                File.Delete(importFilePath);
+                throw;
+            }
+
+            // Move the complete log into place. The index is rebuilt once it is reopened.
+            CloseLog();
+            File.Move(importFilePath, FilePath);
+        }
+
+        /// <summary>
+        /// Opens a log file for reading and appending. Writes are unbuffered, so appended records are visible to positioned
+        /// reads immediately.
+        /// </summary>
+        /// <param name="filePath">The file path of the log.</param>
+        /// <returns>The log file stream.</returns>
+        private static FileStream OpenLogStream(string filePath)
+        {
+            return new FileStream(filePath, FileMode.Open, FileAccess.ReadWrite, FileShare.Read, 0);
+        }
+
+        /// <summary>
+        /// Appends a record for a key to the log and updates the index. This must be called with the write lock held.
+        /// </summary>
+        /// <param name="key">The key of the resource.</param>
+        /// <param name="resource">The resource to store, or null/default to record its deletion.</param>
+        private void Append(K key, V? resource)
+        {
+            if (_stream == null)
+                throw new InvalidOperationException("The resource log is not open.");
+
+            // Build the record: [length][type][key length][key][compressed resource]
+            byte[] keyData = Encoding.UTF8.GetBytes(JsonConvert.SerializeObject(key));
+            byte[] compressedData = resource != null
+                ? Compression.CompressZstd(Encoding.UTF8.GetBytes(JsonConvert.SerializeObject(resource, Formatting.None, StreamIO.JsonSerializerSettings)))
+                : Array.Empty<byte>();
+            byte[] record = new byte[RecordHeaderSize + keyData.Length + compressedData.Length];
+            BitConverter.TryWriteBytes(record.AsSpan(0), record.Length - 4);
+            record[4] = (byte)(resource != null ? RecordType.Set : RecordType.Delete);
+            BitConverter.TryWriteBytes(record.AsSpan(5), (ushort)keyData.Length);
+            keyData.CopyTo(record, RecordHeaderSize);
+            compressedData.CopyTo(record, RecordHeaderSize + keyData.Length);
+
+            // Append it and update our index. Deletion records are stale as soon as they are written.
+            long recordOffset = _stream.Length;
+            RandomAccess.Write(_stream.SafeFileHandle, record, recordOffset);
+            _dirty = true;
+            if (_index.Remove(key, out RecordLocation previousLocation))
+                _staleBytes += previousLocation.RecordLength;
+            if (resource != null)
+                _index[key] = new RecordLocation(recordOffset, record.Length, RecordHeaderSize + keyData.Length, compressedData.Length);
+            else
+                _staleBytes += record.Length;
+        }
+
+        /// <summary>
+        /// Rebuilds the index by scanning every record in the log. A partially written record at the end of the log, left by an
+        /// interrupted write, is truncated. This must be called with the write lock held.
+        /// </summary>
+        private void LoadIndex()
+        {
+            SafeFileHandle handle = _stream!.SafeFileHandle;
+            long length = _stream.Length;
+
+            // Verify the header.
+            byte[] header = new byte[LogHeaderSize];
+            if (RandomAccess.Read(handle, header, 0) != LogHeaderSize || BitConverter.ToUInt32(header, 0) != LogMagic || BitConverter.ToUInt32(header, 4) != LogVersion)
+                throw new InvalidDataException($"'{FilePath}' is not a valid resource log.");
+
+            // Scan each record, indexing the latest record for each key.
+            _index.Clear();
+            _staleBytes = 0;
+            byte[] recordHeader = new byte[RecordHeaderSize];
+            long offset = LogHeaderSize;
+            while (offset < length)
+            {
+                // Read the record header, stopping at a truncated record.
+                if (length - offset < RecordHeaderSize || RandomAccess.Read(handle, recordHeader, offset) != RecordHeaderSize)
+                    break;
+                int recordLength = BitConverter.ToInt32(recordHeader, 0) + 4;
+                RecordType recordType = (RecordType)recordHeader[4];
+                int keyLength = BitConverter.ToUInt16(recordHeader, 5);
+                if (recordLength < RecordHeaderSize + keyLength || recordLength > length - offset)
+                    break;
+
+                // Read the key and update the index.
+                byte[] keyData = new byte[keyLength];
+                RandomAccess.Read(handle, keyData, offset + RecordHeaderSize);
+                K key = JsonConvert.DeserializeObject<K>(Encoding.UTF8.GetString(keyData))!;
+                if (_index.Remove(key, out RecordLocation previousLocation))
+                    _staleBytes += previousLocation.RecordLength;
+                if (recordType == RecordType.Set)
+                    _index[key] = new RecordLocation(offset, recordLength, RecordHeaderSize + keyLength, recordLength - RecordHeaderSize - keyLength);
+                else
+                    _staleBytes += recordLength;
+
+                offset += recordLength;
+            }
+
+            // Discard any partially written record.
+            if (offset < length)
+                _stream.SetLength(offset);
+        }
+
+        /// <summary>
+        /// Flushes appended records to disk, then compacts the log if enough of it is held by stale records.
+        /// </summary>
+        private void Update()
+        {
+            _lock.EnterWriteLock();
+            try
+            {
+                if (_stream == null)
+                    return;
+
+                // Flush all records appended since the last flush together.
+                if (_dirty)
+                {
+                    _stream.Flush(true);
+                    _dirty = false;
+                }
+
+                // Compact once stale records make up most of the log.
+                if (_staleBytes >= CompactionMinimumStaleBytes && _staleBytes > _stream.Length / 2)
+                    Compact();
+            }
+            catch (IOException)
+            {
+                // We'll retry on the next update.
+            }
+            finally
+            {
+                _lock.ExitWriteLock();
+            }
+        }
+
+        /// <summary>
+        /// Rewrites the log with only its indexed records, then replaces the original. This must be called with the write
+        /// lock held.
+        /// </summary>
+        private void Compact()
+        {
+            // Copy each indexed record to a new log, tracking its new location.
+            string compactedFilePath = FilePath + ".compact";
+            Dictionary<K, RecordLocation> compactedIndex = new Dictionary<K, RecordLocation>(_index.Count);
+            using (FileStream compactedStream = new FileStream(compactedFilePath, FileMode.Create, FileAccess.Write, FileShare.None))
+            {
+                byte[] header = new byte[LogHeaderSize];
+                RandomAccess.Read(_stream!.SafeFileHandle, header, 0);
+                compactedStream.Write(header);
+                foreach (var indexEntry in _index)
+                {
+                    RecordLocation location = indexEntry.Value;
+                    byte[] record = new byte[location.RecordLength];
+                    RandomAccess.Read(_stream.SafeFileHandle, record, location.RecordOffset);
+                    compactedIndex[indexEntry.Key] = location with { RecordOffset = compactedStream.Position };
+                    compactedStream.Write(record);
+                }
+                compactedStream.Flush(true);
+            }
+
+            // Replace the log with the compacted one. The log must be closed to be replaced, so it is reopened whether or not
+            // the replacement succeeded, and the compacted index is only used once the compacted log is in place.
+            bool replaced = false;
+            _stream.Dispose();
+            try
+            {
+                File.Move(compactedFilePath, FilePath, true);
+                replaced = true;
+            }
+            finally
+            {
+                _stream = OpenLogStream(FilePath);
+                if (replaced)
+                {
+                    _index = compactedIndex;
+                    _staleBytes = 0;
+                }
+            }
+        }
+
+        /// <summary>
+        /// Flushes and closes the log, clearing the index. This must be called with the write lock held.
+        /// </summary>
+        private void CloseLog()
+        {
+            if (_stream != null)
+            {
+                _stream.Flush(true);
+                _stream.Dispose();
+                _stream = null;
+            }
+            _index.Clear();
+            _staleBytes = 0;
+            _dirty = false;
+        }
+        #endregion
+
+        #region Classes
+        /// <summary>
+        /// The location of a record within the log.
+        /// </summary>
+        /// <param name="RecordOffset">The offset of the record in the log.</param>
+        /// <param name="RecordLength">The length of the entire record.</param>
+        /// <param name="DataRelativeOffset">The offset of the compressed resource within the record.</param>
+        /// <param name="DataLength">The length of the compressed resource.</param>
+        private readonly record struct RecordLocation(long RecordOffset, int RecordLength, int DataRelativeOffset, int DataLength)
+        {
+            /// <summary>
+            /// The offset of the compressed resource in the log.
+            /// </summary>
+            public long DataOffset => RecordOffset + DataRelativeOffset;
+        }
+
+        /// <summary>
+        /// The type of a record in the log.
+        /// </summary>
+        private enum RecordType : byte
+        {
+            Set = 1,
+            Delete = 2,
+        }
+        #endregion
+    }
+}
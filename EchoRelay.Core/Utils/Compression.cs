@@ -8,6 +8,15 @@ namespace EchoRelay.Core.Utils
     /// </summary>
     public abstract class Compression
     {
+        /// <summary>
+        /// The zstd contexts used by the calling thread. Creating a context allocates its working buffers, which costs more than
+        /// compressing a small resource, so each thread reuses its own.
+        /// </summary>
+        [ThreadStatic]
+        private static Compressor? _zstdCompressor;
+        [ThreadStatic]
+        private static Decompressor? _zstdDecompressor;
+
         /// <summary>
         /// Compresses a buffer with zlib compression.
         /// </summary>
@@ -35,7 +44,8 @@ namespace EchoRelay.Core.Utils
         /// <returns>Returns the zstd compressed buffer.</returns>
         public static byte[] CompressZstd(byte[] data)
         {
-            return new Compressor().Wrap(data).ToArray();
+            _zstdCompressor ??= new Compressor();
+            return _zstdCompressor.Wrap(data).ToArray();
         }
 
         /// <summary>
@@ -45,7 +55,8 @@ namespace EchoRelay.Core.Utils
         /// <returns>Returns the decompressed buffer.</returns>
         public static byte[] DecompressZstd(byte[] data)
         {
-            return new Decompressor().Unwrap(data).ToArray();
+            _zstdDecompressor ??= new Decompressor();
+            return _zstdDecompressor.Unwrap(data).ToArray();
         }
     }
 }
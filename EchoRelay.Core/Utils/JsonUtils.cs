@@ -1,5 +1,6 @@
 ﻿using Newtonsoft.Json;
 using Newtonsoft.Json.Linq;
+using System.Buffers;
 
 namespace EchoRelay.Core.Utils
 {
@@ -58,6 +59,29 @@ namespace EchoRelay.Core.Utils
         #endregion
 
         #region Classes
+        /// <summary>
+        /// A <see cref="IArrayPool{T}"/> which lends JSON readers and writers their character buffers from the shared array pool,
+        /// so they are not allocated for each value read or written.
+        /// </summary>
+        public class CharArrayPool : IArrayPool<char>
+        {
+            /// <summary>
+            /// The shared instance of the pool.
+            /// </summary>
+            public static readonly CharArrayPool Instance = new CharArrayPool();
+
+            public char[] Rent(int minimumLength)
+            {
+                return ArrayPool<char>.Shared.Rent(minimumLength);
+            }
+
+            public void Return(char[]? array)
+            {
+                if (array != null)
+                    ArrayPool<char>.Shared.Return(array);
+            }
+        }
+
         /// <summary>
         /// A <see cref="JsonConverter"/> used to serialize/deserialize <see cref="HashSet{T}"/> types.
         /// </summary>
@@ -0,0 +1,197 @@
+﻿using Newtonsoft.Json;
+
+namespace EchoRelay.Core.Utils
+{
+    /// <summary>
+    /// Writes session lifecycle spans to a rotating Chrome trace event file, which can be opened in chrome://tracing or Perfetto.
+    /// Sessions are sampled deterministically from their identifier (the trace identifier), using the same rule as the game server,
+    /// so both sides trace the same sessions when configured with the same sample rate. Timestamps are wall-clock time, so service-side
+    /// and game-side trace files can be concatenated and viewed on one timeline.
+    /// </summary>
+    public class SessionTraceWriter : IDisposable
+    {
+        #region Constants
+        /// <summary>
+        /// The resolution of the sample rate. A sample rate of 1.0 corresponds to this value.
+        /// </summary>
+        public const uint SampleScale = 10000;
+        #endregion
+
+        #region Properties
+        /// <summary>
+        /// The directory which trace files are written to.
+        /// </summary>
+        public string Directory { get; }
+        /// <summary>
+        /// The portion of sessions which are traced (0.0-1.0).
+        /// </summary>
+        public double SampleRate { get; }
+        /// <summary>
+        /// The size after which a trace file is rotated, in bytes.
+        /// </summary>
+        public long MaxFileSize { get; }
+        /// <summary>
+        /// The amount of trace files retained. Older files are deleted when rotating.
+        /// </summary>
+        public int MaxFiles { get; }
+        #endregion
+
+        #region Fields
+        /// <summary>
+        /// The sample rate, in parts per <see cref="SampleScale"/>.
+        /// </summary>
+        private uint _sampleRate;
+        /// <summary>
+        /// A lock used to serialize writes from concurrent game server handlers.
+        /// </summary>
+        private object _writeLock;
+        /// <summary>
+        /// The current trace file being written, or null if none has been opened.
+        /// </summary>
+        private StreamWriter? _writer;
+        /// <summary>
+        /// The index of the current trace file.
+        /// </summary>
+        private int _fileIndex;
+        #endregion
+
+        #region Constructor
+        /// <summary>
+        /// Initializes a new <see cref="SessionTraceWriter"/>. No file is created until the first span is written.
+        /// </summary>
+        /// <param name="directory">The directory to write trace files to.</param>
+        /// <param name="sampleRate">The portion of sessions which are traced (0.0-1.0).</param>
+        /// <param name="maxFileSize">The size after which a trace file is rotated, in bytes.</param>
+        /// <param name="maxFiles">The amount of trace files retained.</param>
+        public SessionTraceWriter(string directory, double sampleRate, long maxFileSize = 16 * 1024 * 1024, int maxFiles = 4)
+        {
+            Directory = directory;
+            SampleRate = Math.Clamp(sampleRate, 0.0, 1.0);
+            MaxFileSize = maxFileSize;
+            MaxFiles = maxFiles;
+            _sampleRate = (uint)Math.Round(SampleRate * SampleScale);
+            _writeLock = new object();
+        }
+        #endregion
+
+        #region Functions
+        /// <summary>
+        /// Determines whether a session should be traced. This must match the sampling performed by the game server.
+        /// </summary>
+        /// <param name="traceId">The trace identifier (session identifier) of the session.</param>
+        /// <param name="sampleRate">The sample rate, in parts per <see cref="SampleScale"/>.</param>
+        /// <returns>True if the session should be traced, false otherwise.</returns>
+        public static bool ShouldSample(Guid traceId, uint sampleRate)
+        {
+            // Mix the first half of the identifier (splitmix64 finalizer), so any non-random bits don't bias sampling.
+            ulong value = BitConverter.ToUInt64(traceId.ToByteArray(), 0);
+            value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9UL;
+            value = (value ^ (value >> 27)) * 0x94D049BB133111EBUL;
+            value = value ^ (value >> 31);
+            return (value % SampleScale) < sampleRate;
+        }
+
+        /// <summary>
+        /// Determines whether a session should be traced, according to the configured sample rate.
+        /// </summary>
+        /// <param name="traceId">The trace identifier (session identifier) of the session.</param>
+        /// <returns>True if the session should be traced, false otherwise.</returns>
+        public bool ShouldSample(Guid traceId)
+        {
+            return _sampleRate != 0 && ShouldSample(traceId, _sampleRate);
+        }
+
+        /// <summary>
+        /// Writes a span to the trace file. Spans are written as async spans grouped by the provided identifier, as spans from
+        /// many game servers overlap.
+        /// </summary>
+        /// <param name="name">The name of the span.</param>
+        /// <param name="id">The identifier of the track to group the span in.</param>
+        /// <param name="traceId">The trace identifier (session identifier) the span belongs to.</param>
+        /// <param name="start">The time the span started.</param>
+        /// <param name="end">The time the span ended.</param>
+        /// <param name="completed">Indicates whether the span ended normally, rather than being cut short.</param>
+        /// <param name="args">Additional arguments to attach to the span.</param>
+        public void WriteSpan(string name, string id, Guid traceId, DateTime start, DateTime end, bool completed, IDictionary<string, object?>? args = null)
+        {
+            // Build our arguments.
+            Dictionary<string, object?> beginArgs = new Dictionary<string, object?>() { { "trace_id", traceId.ToString() } };
+            if (args != null)
+                foreach (var arg in args)
+                    beginArgs[arg.Key] = arg.Value;
+
+            // Serialize the begin/end event pair.
+            string events =
+                JsonConvert.SerializeObject(new { name, cat = "serverdb", ph = "b", id, ts = ToUnixMicroseconds(start), pid = Environment.ProcessId, tid = 0, args = beginArgs }) + ",\n" +
+                JsonConvert.SerializeObject(new { name, cat = "serverdb", ph = "e", id, ts = ToUnixMicroseconds(end), pid = Environment.ProcessId, tid = 0, args = new { completed } }) + ",\n";
+
+            lock (_writeLock)
+            {
+                try
+                {
+                    // Open our file if we haven't, then write the events, rotating the file if it has grown too large.
+                    if (_writer == null)
+                        OpenFile();
+                    _writer!.Write(events);
+                    if (_writer.BaseStream.Length >= MaxFileSize)
+                    {
+                        _writer.Dispose();
+                        _writer = null;
+                        _fileIndex++;
+                    }
+                }
+                catch (IOException)
+                {
+                    // Tracing is best-effort and must never interrupt service operation.
+                    _writer?.Dispose();
+                    _writer = null;
+                }
+            }
+        }
+
+        /// <summary>
+        /// Opens the next trace file, deleting the oldest file if we have exceeded our retention limit.
+        /// </summary>
+        private void OpenFile()
+        {
+            System.IO.Directory.CreateDirectory(Directory);
+            if (_fileIndex >= MaxFiles)
+                File.Delete(GetFilePath(_fileIndex - MaxFiles));
+
+            // Each file is a standalone JSON array trace. The closing bracket is never written, as both chrome://tracing and
+            // Perfetto accept a truncated array, which allows the file to be read while it is being written.
+            _writer = new StreamWriter(GetFilePath(_fileIndex), false) { AutoFlush = true };
+            _writer.Write("[\n" + JsonConvert.SerializeObject(new { name = "process_name", ph = "M", pid = Environment.ProcessId, args = new { name = "EchoRelay (ServerDB)" } }) + ",\n");
+        }
+
+        /// <summary>
+        /// Obtains the path of a trace file.
+        /// </summary>
+        /// <param name="index">The index of the trace file.</param>
+        /// <returns>The path of the trace file.</returns>
+        private string GetFilePath(int index)
+        {
+            return Path.Combine(Directory, $"session.serverdb.{Environment.ProcessId}.{index}.json");
+        }
+
+        /// <summary>
+        /// Converts a time to a trace timestamp.
+        /// </summary>
+        /// <param name="time">The time to convert.</param>
+        /// <returns>The time, in microseconds since the Unix epoch.</returns>
+        private static long ToUnixMicroseconds(DateTime time)
+        {
+            return (time.ToUniversalTime() - DateTime.UnixEpoch).Ticks / TimeSpan.TicksPerMicrosecond;
+        }
+
+        public void Dispose()
+        {
+            lock (_writeLock)
+            {
+                _writer?.Dispose();
+                _writer = null;
+            }
+        }
+        #endregion
+    }
+}
@@ -60,6 +60,15 @@ namespace EchoRelay.Core.Utils
             DateTimeZoneHandling = DateTimeZoneHandling.Utc,
         };
         /// <summary>
+        /// The JSON serializer used to stream JSON values, created from <see cref="JsonSerializerSettings"/>.
+        /// Additional content is checked for to match <see cref="JsonConvert.DeserializeObject(string, JsonSerializerSettings)"/>.
+        /// </summary>
+        private static readonly JsonSerializer _jsonSerializer = CreateJsonSerializer();
+        /// <summary>
+        /// The encoding used to write JSON values into the stream (UTF-8, without a byte order mark).
+        /// </summary>
+        private static readonly UTF8Encoding _jsonEncoding = new UTF8Encoding(false);
+        /// <summary>
         /// The underlying stream which this provider wraps.
         /// </summary>
         private MemoryStream _stream;
@@ -113,8 +122,8 @@ namespace EchoRelay.Core.Utils
         }
         public StreamIO(byte[] data, ByteOrder defaultByteOrder = ByteOrder.LittleEndian, StreamMode streamMode = StreamMode.Read)
         {
-            // Set our stream parameters
-            _stream = new MemoryStream(data);
+            // Set our stream parameters. The buffer is exposed so strings can be located and decoded in place.
+            _stream = new MemoryStream(data, 0, data.Length, true, true);
             _machineByteOrder = BitConverter.IsLittleEndian ? ByteOrder.LittleEndian : ByteOrder.BigEndian;
             DefaultByteOrder = defaultByteOrder;
             StreamMode = streamMode;
@@ -135,6 +144,42 @@ namespace EchoRelay.Core.Utils
         {
             return _stream.ToArray();
         }
+        /// <summary>
+        /// Obtains the stream data from the current position to the end of the stream, without copying it.
+        /// </summary>
+        /// <returns>Returns the remaining stream data.</returns>
+        private ArraySegment<byte> GetRemainingData()
+        {
+            _stream.TryGetBuffer(out ArraySegment<byte> buffer);
+            return buffer.Slice((int)Position);
+        }
+        /// <summary>
+        /// Obtains the size of the string at the current position, scanning for its null terminator if it has one.
+        /// </summary>
+        /// <param name="remaining">The remaining stream data, obtained from <see cref="GetRemainingData"/>.</param>
+        /// <param name="nullTerminated">Indicates whether the string is null terminated. If not, it spans the remaining data.</param>
+        /// <returns>Returns the size of the string in bytes, excluding its null terminator.</returns>
+        /// <exception cref="IOException">An exception thrown if the end of stream has been reached before a null terminator.</exception>
+        private static int GetStringSize(ArraySegment<byte> remaining, bool nullTerminated)
+        {
+            // IndexOf is vectorized, so this scans many bytes at a time.
+            if (!nullTerminated)
+                return remaining.Count;
+            int size = remaining.AsSpan().IndexOf((byte)0);
+            if (size < 0)
+                throw new IOException($"StreamIO failed to read null terminated string, reached the end of stream");
+            return size;
+        }
+        /// <summary>
+        /// Creates the JSON serializer used to stream JSON values.
+        /// </summary>
+        /// <returns>Returns the created serializer.</returns>
+        private static JsonSerializer CreateJsonSerializer()
+        {
+            JsonSerializer serializer = JsonSerializer.CreateDefault(JsonSerializerSettings);
+            serializer.CheckAdditionalContent = true;
+            return serializer;
+        }
         #endregion
 
         #region Read Methods
@@ -281,27 +326,13 @@ namespace EchoRelay.Core.Utils
         }
         public string ReadString(bool nullTerminated = true)
         {
-            // Read bytes until end of file or null termination.
-            List<byte> valueBytes = new List<byte>();
-            while (true)
-            {
-                // If we're at the end of the stream and not reading a null terminated string, stop
-                if (!nullTerminated && Position >= Length)
-                    break;
-
-                // Read a byte
-                byte valueByte = ReadByte();
-
-                // If the byte is a null terminator and this is a null terminated string, stop.
-                if (nullTerminated && valueByte == 0)
-                    break;
+            // Locate the end of the string, then decode it in place.
+            ArraySegment<byte> remaining = GetRemainingData();
+            int size = GetStringSize(remaining, nullTerminated);
+            string value = Encoding.UTF8.GetString(remaining.AsSpan(0, size));
 
-                // Add the byte to our list
-                valueBytes.Add(valueByte);
-            }
-
-            // Convert the bytes to a string and return them
-            string value = Encoding.UTF8.GetString(valueBytes.ToArray());
+            // Advance past the string and its null terminator.
+            Position += size + (nullTerminated ? 1 : 0);
             return value;
         }
         public string ReadString(int size)
@@ -345,9 +376,17 @@ namespace EchoRelay.Core.Utils
             // If there is no compression, we simply read the underlying value.
             if (compressionMode == JSONCompressionMode.None)
             {
-                // Read and deserialize the JSON encoded value.
-                string encodedJson = ReadString(nullTerminated);
-                T? value = JsonConvert.DeserializeObject<T>(encodedJson, JsonSerializerSettings);
+                // Locate the end of the JSON encoded value, then deserialize it in place, rather than decoding it to a string first.
+                ArraySegment<byte> remaining = GetRemainingData();
+                int size = GetStringSize(remaining, nullTerminated);
+                T? value;
+                using (MemoryStream jsonStream = new MemoryStream(remaining.Array!, remaining.Offset, size, false))
+                using (StreamReader streamReader = new StreamReader(jsonStream, Encoding.UTF8, false))
+                using (JsonTextReader jsonReader = new JsonTextReader(streamReader) { ArrayPool = JsonUtils.CharArrayPool.Instance })
+                {
+                    value = _jsonSerializer.Deserialize<T>(jsonReader);
+                }
+                Position += size + (nullTerminated ? 1 : 0);
 
                 // If we successfully deserialized the value of our desired type, set it. Otherwise throw an exception. 
                 if (value == null)
@@ -536,11 +575,18 @@ namespace EchoRelay.Core.Utils
             // If there is no compression, we simply write the underlying value.
             if (compressionMode == JSONCompressionMode.None)
             {
-                // JSON encode the value
-                string encodedJson = JsonConvert.SerializeObject(value, JsonSerializerSettings);
+                // JSON encode the value directly into the stream, rather than encoding it to a string first.
+                using (StreamWriter streamWriter = new StreamWriter(_stream, _jsonEncoding, 1024, true))
+                using (JsonTextWriter jsonWriter = new JsonTextWriter(streamWriter) { ArrayPool = JsonUtils.CharArrayPool.Instance, Formatting = _jsonSerializer.Formatting })
+                {
+                    _jsonSerializer.Serialize(jsonWriter, value);
+                }
 
-                // Write it as a null terminated string
-                Write(encodedJson, nullTerminated);
+                // Write its null terminator
+                if (nullTerminated)
+                {
+                    Write((byte)0x00);
+                }
                 return;
             }
             else if (compressionMode == JSONCompressionMode.Zlib)
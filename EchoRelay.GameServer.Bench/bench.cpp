@@ -0,0 +1,944 @@
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <algorithm>
+#include "pch.h"
+
+// The game server library is compiled directly into the host, so the game's unexported functions which it calls (see
+// echovrunexported.h) can be bound to the host's stand-ins below.
+#include "gameserver.cpp"
+
+/// <summary>
+/// The flight recorder for the game server library, which the library expects its host module to define.
+/// </summary>
+FlightRecorder g_FlightRecorder;
+
+/// <summary>
+/// The amount of entrant slots the host's lobby provides.
+/// </summary>
+const UINT32 BENCH_ENTRANT_SLOTS = 16;
+
+/// <summary>
+/// The amount of leading bytes reserved before each ServerDB message payload. The library shifts the session success
+/// message back by this amount when forwarding it (see OnTcpMsgSessionSuccessv5).
+/// </summary>
+const UINT64 BENCH_PAYLOAD_LEADING_BYTES = 0x10;
+
+/// <summary>
+/// The size of the synthetic ServerDB message payloads in the built-in script, in bytes.
+/// </summary>
+const UINT64 BENCH_SYNTHETIC_PAYLOAD_SIZE = 128;
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Allocation counting
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// <summary>
+/// Counters for heap allocations made through operator new. Allocations made directly through malloc or the Win32
+/// heap functions are not counted.
+/// </summary>
+struct BenchAllocations
+{
+    UINT64 count;
+    UINT64 bytes;
+};
+BenchAllocations g_Allocations;
+
+VOID* operator new(size_t size)
+{
+    g_Allocations.count++;
+    g_Allocations.bytes += size;
+    VOID* result = malloc(size != 0 ? size : 1);
+    if (result == NULL)
+        throw std::bad_alloc();
+    return result;
+}
+
+VOID* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+VOID operator delete(VOID* ptr) noexcept
+{
+    free(ptr);
+}
+
+VOID operator delete[](VOID* ptr) noexcept
+{
+    free(ptr);
+}
+
+VOID operator delete(VOID* ptr, size_t size) noexcept
+{
+    free(ptr);
+}
+
+VOID operator delete[](VOID* ptr, size_t size) noexcept
+{
+    free(ptr);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Callback measurements
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// <summary>
+/// The game server library callbacks which are measured by the host.
+/// </summary>
+enum class BenchCallbackId : UINT32
+{
+    Initialize,
+    RequestRegistration,
+    Update,
+    OnRegistrationSuccess,
+    OnRegistrationFailure,
+    OnStartSession,
+    OnSessionStarting,
+    OnSessionSuccess,
+    OnPlayersAccepted,
+    OnPlayersRejected,
+    AcceptPlayerSessions,
+    RemovePlayerSession,
+    LockPlayerSessions,
+    UnlockPlayerSessions,
+    EndSession,
+    Terminate,
+    Count
+};
+
+/// <summary>
+/// The display names of the measured callbacks, indexed by <see cref="BenchCallbackId"/>.
+/// </summary>
+const CHAR* BENCH_CALLBACK_NAMES[(UINT32)BenchCallbackId::Count] =
+{
+    "GameServerLib::Initialize",
+    "GameServerLib::RequestRegistration",
+    "GameServerLib::Update",
+    "OnTcpMsgRegistrationSuccess",
+    "OnTcpMsgRegistrationFailure",
+    "OnTcpMessageStartSession",
+    "OnMsgSessionStarting",
+    "OnTcpMsgSessionSuccessv5",
+    "OnTcpMsgPlayersAccepted",
+    "OnTcpMsgPlayersRejected",
+    "GameServerLib::AcceptPlayerSessions",
+    "GameServerLib::RemovePlayerSession",
+    "GameServerLib::LockPlayerSessions",
+    "GameServerLib::UnlockPlayerSessions",
+    "GameServerLib::EndSession",
+    "GameServerLib::Terminate",
+};
+
+/// <summary>
+/// The measurements taken for a single callback.
+/// </summary>
+struct BenchCallback
+{
+    std::vector<LONGLONG> samples; // performance counter ticks, per invocation
+    UINT64 allocations;
+    UINT64 allocatedBytes;
+};
+BenchCallback g_Callbacks[(UINT32)BenchCallbackId::Count];
+
+/// <summary>
+/// Invokes a callback, measuring its duration and the allocations it made.
+/// </summary>
+/// <param name="id">The callback being invoked.</param>
+/// <param name="func">A function which invokes the callback.</param>
+/// <returns>None</returns>
+template<typename F>
+VOID Measure(BenchCallbackId id, F func)
+{
+    BenchCallback* callback = &g_Callbacks[(UINT32)id];
+    BenchAllocations allocations = g_Allocations;
+    LARGE_INTEGER start, end;
+    QueryPerformanceCounter(&start);
+    func();
+    QueryPerformanceCounter(&end);
+    callback->allocations += g_Allocations.count - allocations.count;
+    callback->allocatedBytes += g_Allocations.bytes - allocations.bytes;
+    callback->samples.push_back(end.QuadPart - start.QuadPart);
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Game stand-ins
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// <summary>
+/// A listener registered with one of the host's broadcasters.
+/// </summary>
+struct HostListener
+{
+    EchoVR::SymbolId symbol;
+    EchoVR::DelegateProxy proxy;
+    BOOL active;
+};
+
+/// <summary>
+/// A configuration value provided to the library through the host's JsonValueAsString stand-in.
+/// </summary>
+struct HostConfigValue
+{
+    std::string key;
+    std::string value;
+};
+
+/// <summary>
+/// A stand-in for the game's TCP broadcaster, which connects to ServerDB. Peers are never actually connected, and sent
+/// messages are only counted. Peers are reported connected until the host drops them, to drive ServerDB failover.
+/// </summary>
+class HostTcpBroadcasterData : public EchoVR::TcpBroadcasterData
+{
+public:
+    VOID __Unknown0() {}
+    ~HostTcpBroadcasterData() {}
+    VOID Shutdown() {}
+    UINT32 IsServer() { return FALSE; }
+    VOID AddPeerFromBuffer(EchoVR::PoolBuffer* buffer) {}
+    UINT64 GetPeerCount() { return peerCount; }
+    UINT32 HasPeer(EchoVR::TcpPeer peer) { return peer.index < peerCount; }
+    UINT32 IsPeerConnecting(EchoVR::TcpPeer peer) { return FALSE; }
+    UINT32 IsPeerConnected(EchoVR::TcpPeer peer) { return HasPeer(peer) && peer.index >= droppedPeerCount; }
+    UINT32 IsPeerDisconnecting(EchoVR::TcpPeer peer) { return FALSE; }
+    EchoVR::AddressInfo* GetPeerAddress(EchoVR::AddressInfo* result, EchoVR::TcpPeer peer) { memset(result, 0, sizeof(*result)); return result; }
+    VOID __Unknown1() {}
+    const CHAR* GetPeerDisplayName(EchoVR::TcpPeer peer) { return "serverdb"; }
+    EchoVR::TcpPeer* GetPeerByAddress(EchoVR::TcpPeer* result, const EchoVR::AddressInfo* address) { *result = EchoVR::TcpPeer_InvalidPeer; return result; }
+    EchoVR::TcpPeer* GetPeerByIndex(EchoVR::TcpPeer* result, UINT32 index) { *result = index < peerCount ? EchoVR::TcpPeer{ index, 0 } : EchoVR::TcpPeer_InvalidPeer; return result; }
+    VOID FreePeer(EchoVR::TcpPeer peer) {}
+    VOID DisconnectPeer(EchoVR::TcpPeer peer) {}
+    VOID DisconnectAllPeers() {}
+    VOID __Unknown2() {}
+    EchoVR::TcpPeer* CreatePeer(EchoVR::TcpPeer* result, const EchoVR::UriContainer* uri)
+    {
+        // Note the time of the first connection created after peers were dropped, as the library has failed over.
+        if (dropTime != 0 && failoverTime == 0)
+        {
+            LARGE_INTEGER now;
+            QueryPerformanceCounter(&now);
+            failoverTime = now.QuadPart;
+        }
+        strncpy_s(lastPeerUri, (const CHAR*)uri->_unk0, _TRUNCATE);
+        *result = { (UINT32)peerCount++, 0 };
+        return result;
+    }
+    VOID DestroyPeer(EchoVR::TcpPeer peer) {}
+    VOID SendToPeer(EchoVR::TcpPeer peer, EchoVR::SymbolId msgtype, const VOID* item, UINT64 itemSize, const VOID* buffer, UINT64 bufferSize)
+    {
+        messagesSent++;
+        bytesSent += itemSize + bufferSize;
+        if (msgtype == SYMBOL_TCPBROADCASTER_LOBBY_HEARTBEAT)
+            heartbeatsSent++;
+    }
+    VOID Update() {}
+    UINT32 Update_2(UINT32 a, UINT32 b) { return 0; }
+    UINT32 HandlePeer(EchoVR::SymbolId msgtype, EchoVR::TcpPeer peer, const VOID* msg, UINT64 msgSize) { return 0; }
+    const EchoVR::TcpPeerConnectionStats* GetPeerConnectionStats(EchoVR::TcpPeer peer) { return NULL; }
+    EchoVR::TcpPeerConnectionStats* GetPeerConnectionStats_0(EchoVR::TcpPeer peer) { return NULL; }
+
+    UINT64 peerCount;
+    UINT64 droppedPeerCount; // peers with a lower index are reported disconnected
+    CHAR lastPeerUri[SERVERDB_MAX_URI_LENGTH];
+    LONGLONG dropTime; // performance counter ticks
+    LONGLONG failoverTime; // performance counter ticks
+    UINT64 messagesSent;
+    UINT64 bytesSent;
+    UINT64 heartbeatsSent;
+};
+
+EchoVR::TcpBroadcasterData::~TcpBroadcasterData() {}
+
+/// <summary>
+/// The state of the host, which stands in for the game process the library is normally loaded into.
+/// </summary>
+struct Host
+{
+    // Game structures provided to the library.
+    EchoVR::Lobby lobby;
+    EchoVR::Broadcaster broadcaster;
+    EchoVR::BroadcasterData broadcasterData;
+    EchoVR::TcpBroadcaster tcpBroadcaster;
+    HostTcpBroadcasterData tcpBroadcasterData;
+    std::vector<EchoVR::Lobby::EntrantData> entrants;
+    SOCKET broadcastSocket;
+    std::vector<SOCKET> serverDbStandIns;
+
+    // Listeners registered by the library.
+    std::vector<HostListener> broadcasterListeners;
+    std::vector<HostListener> tcpListeners;
+
+    // Configuration provided to the library.
+    std::vector<HostConfigValue> config;
+    BOOL verbose;
+
+    // Local events raised by the library, and the game's pending reactions to them.
+    UINT64 localEvents;
+    BOOL sessionStartingPending;
+};
+Host g_Host;
+
+/// <summary>
+/// Stands in for the game's BroadcasterListen, registering the listener with the host.
+/// </summary>
+UINT16 HostBroadcasterListen(EchoVR::Broadcaster* broadcaster, EchoVR::SymbolId messageId, BOOL isReliableMsgType, VOID* px, BOOL prepend)
+{
+    g_Host.broadcasterListeners.push_back({ messageId, *(EchoVR::DelegateProxy*)px, TRUE });
+    return (UINT16)(g_Host.broadcasterListeners.size() - 1);
+}
+
+/// <summary>
+/// Stands in for the game's BroadcasterUnlisten, unregistering the listener from the host.
+/// </summary>
+UINT64 HostBroadcasterUnlisten(EchoVR::Broadcaster* broadcaster, UINT16 cbResult)
+{
+    if (cbResult < g_Host.broadcasterListeners.size())
+        g_Host.broadcasterListeners[cbResult].active = FALSE;
+    return 0;
+}
+
+/// <summary>
+/// Stands in for the game's TcpBroadcasterListen, registering the listener with the host.
+/// </summary>
+UINT16 HostTcpBroadcasterListen(EchoVR::TcpBroadcaster* broadcaster, EchoVR::SymbolId messageId, INT64 unk1, INT64 unk2, INT64 unk3, VOID* delegateProxy, BOOL prepend)
+{
+    g_Host.tcpListeners.push_back({ messageId, *(EchoVR::DelegateProxy*)delegateProxy, TRUE });
+    return (UINT16)(g_Host.tcpListeners.size() - 1);
+}
+
+/// <summary>
+/// Stands in for the game's BroadcasterReceiveLocalEvent. The game's reaction to a started session (raising the session
+/// starting event on the following tick) is emulated, as the library listens for it.
+/// </summary>
+UINT64 HostBroadcasterReceiveLocalEvent(EchoVR::Broadcaster* broadcaster, EchoVR::SymbolId messageId, const CHAR* msgName, VOID* msg, UINT64 msgSize)
+{
+    g_Host.localEvents++;
+    if (messageId == SYMBOL_BROADCASTER_LOBBY_START_SESSION_V4)
+        g_Host.sessionStartingPending = TRUE;
+    return 0;
+}
+
+/// <summary>
+/// Stands in for the game's JsonValueAsString, resolving top-level keys from the host's configuration.
+/// </summary>
+CHAR* HostJsonValueAsString(EchoVR::Json* root, CHAR* keyName, CHAR* defaultValue, BOOL reportFailure)
+{
+    for (HostConfigValue& value : g_Host.config)
+    {
+        if (value.key == keyName)
+            return (CHAR*)value.value.c_str();
+    }
+    return defaultValue;
+}
+
+/// <summary>
+/// Stands in for the game's UriContainerParse. The URI is only retained, as the host's TCP broadcaster never connects.
+/// </summary>
+HRESULT HostUriContainerParse(EchoVR::UriContainer* uriContainer, CHAR* uri)
+{
+    strncpy_s((CHAR*)uriContainer->_unk0, sizeof(uriContainer->_unk0), uri, _TRUNCATE);
+    return ERROR_SUCCESS;
+}
+
+/// <summary>
+/// Stands in for the game's WriteLog, printing log messages if the host is verbose.
+/// </summary>
+VOID HostWriteLog(EchoVR::LogLevel logLevel, UINT64 unk, const CHAR* format, va_list vl)
+{
+    if (!g_Host.verbose)
+        return;
+    vprintf(format, vl);
+    printf("\n");
+}
+
+/// <summary>
+/// Binds the game's unexported functions used by the library to the host's stand-ins.
+/// </summary>
+/// <returns>None</returns>
+VOID HostBindUnexported()
+{
+    EchoVR::BroadcasterListen = HostBroadcasterListen;
+    EchoVR::BroadcasterUnlisten = HostBroadcasterUnlisten;
+    EchoVR::TcpBroadcasterListen = HostTcpBroadcasterListen;
+    EchoVR::BroadcasterReceiveLocalEvent = HostBroadcasterReceiveLocalEvent;
+    EchoVR::JsonValueAsString = HostJsonValueAsString;
+    EchoVR::UriContainerParse = HostUriContainerParse;
+    EchoVR::WriteLog = HostWriteLog;
+}
+
+/// <summary>
+/// Sets up the host's game structures. The broadcaster is given a real UDP socket, so the library's socket statistics
+/// are sampled as they would be in the game.
+/// </summary>
+/// <returns>TRUE if the host was set up, FALSE otherwise.</returns>
+BOOL HostInitialize()
+{
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0)
+        return FALSE;
+    g_Host.broadcastSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    INT32 addressSize = sizeof(address);
+    if (g_Host.broadcastSocket == INVALID_SOCKET || bind(g_Host.broadcastSocket, (sockaddr*)&address, sizeof(address)) != 0 ||
+        getsockname(g_Host.broadcastSocket, (sockaddr*)&address, &addressSize) != 0)
+        return FALSE;
+
+    memset(&g_Host.broadcasterData, 0, sizeof(g_Host.broadcasterData));
+    g_Host.broadcasterData.owner = &g_Host.broadcaster;
+    g_Host.broadcasterData.broadcastSocketInfo.port = ntohs(address.sin_port);
+    g_Host.broadcasterData.broadcastSocketInfo.socket = (UINT64)g_Host.broadcastSocket;
+    memcpy(&g_Host.broadcasterData.addr, &address, sizeof(address));
+    g_Host.broadcaster.data = &g_Host.broadcasterData;
+    g_Host.tcpBroadcaster.data = &g_Host.tcpBroadcasterData;
+    g_Host.tcpBroadcasterData.owner = &g_Host.tcpBroadcaster;
+
+    g_Host.entrants.resize(BENCH_ENTRANT_SLOTS);
+    memset(&g_Host.lobby, 0, sizeof(g_Host.lobby));
+    g_Host.lobby.broadcaster = &g_Host.broadcaster;
+    g_Host.lobby.tcpBroadcaster = &g_Host.tcpBroadcaster;
+    g_Host.lobby.maxEntrants = BENCH_ENTRANT_SLOTS;
+    g_Host.lobby.entrantData.items = g_Host.entrants.data();
+    g_Host.lobby.entrantData.count = g_Host.entrants.size();
+    return TRUE;
+}
+
+/// <summary>
+/// Opens a TCP socket on an ephemeral loopback port.
+/// </summary>
+/// <param name="listening">Indicates whether the socket should accept connections.</param>
+/// <param name="port">The port the socket was bound to, in host order.</param>
+/// <returns>The socket, or INVALID_SOCKET if it could not be opened.</returns>
+SOCKET HostOpenLoopbackTcpSocket(BOOL listening, UINT16* port)
+{
+    SOCKET tcpSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    INT32 addressSize = sizeof(address);
+    if (tcpSocket == INVALID_SOCKET || bind(tcpSocket, (sockaddr*)&address, sizeof(address)) != 0 ||
+        getsockname(tcpSocket, (sockaddr*)&address, &addressSize) != 0 || (listening && listen(tcpSocket, SOMAXCONN) != 0))
+    {
+        if (tcpSocket != INVALID_SOCKET)
+            closesocket(tcpSocket);
+        return INVALID_SOCKET;
+    }
+    *port = ntohs(address.sin_port);
+    return tcpSocket;
+}
+
+/// <summary>
+/// Opens stand-ins for ServerDB hosts, which accept connections on the loopback interface but never respond, and provides
+/// them to the library as its ServerDB hosts. An unreachable host is listed first, so the library must select past it.
+/// </summary>
+/// <param name="count">The amount of stand-ins to open.</param>
+/// <returns>TRUE if the stand-ins were opened, FALSE otherwise.</returns>
+BOOL HostOpenServerDbStandIns(UINT32 count)
+{
+    // Obtain a port nothing is listening on, by binding a socket without listening and closing it.
+    UINT16 port;
+    SOCKET unreachable = HostOpenLoopbackTcpSocket(FALSE, &port);
+    if (unreachable == INVALID_SOCKET)
+        return FALSE;
+    closesocket(unreachable);
+    CHAR uri[SERVERDB_MAX_URI_LENGTH];
+    sprintf_s(uri, "ws://127.0.0.1:%u/serverdb", port);
+    std::string uris = uri;
+
+    for (UINT32 i = 0; i < count; i++)
+    {
+        SOCKET standIn = HostOpenLoopbackTcpSocket(TRUE, &port);
+        if (standIn == INVALID_SOCKET)
+            return FALSE;
+        g_Host.serverDbStandIns.push_back(standIn);
+        sprintf_s(uri, ",ws://127.0.0.1:%u/serverdb", port);
+        uris += uri;
+    }
+    g_Host.config.push_back({ "serverdb_hosts", uris });
+    return TRUE;
+}
+
+/// <summary>
+/// Releases the host's game structures.
+/// </summary>
+/// <returns>None</returns>
+VOID HostShutdown()
+{
+    if (g_Host.broadcastSocket != INVALID_SOCKET)
+        closesocket(g_Host.broadcastSocket);
+    for (SOCKET standIn : g_Host.serverDbStandIns)
+        closesocket(standIn);
+    WSACleanup();
+}
+
+/// <summary>
+/// Finds the active listener for a given symbol.
+/// </summary>
+/// <param name="listeners">The listeners to search.</param>
+/// <param name="symbol">The symbol to find the listener for.</param>
+/// <returns>The listener, or NULL if there is none.</returns>
+HostListener* HostFindListener(std::vector<HostListener>* listeners, EchoVR::SymbolId symbol)
+{
+    for (HostListener& listener : *listeners)
+    {
+        if (listener.active && listener.symbol == symbol)
+            return &listener;
+    }
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Scripts
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// <summary>
+/// An action taken by a script, either on behalf of ServerDB or of the game.
+/// </summary>
+enum class ScriptAction : UINT32
+{
+    ServerDbMessage, // ServerDB sends a message to the game server
+    AcceptPlayer, // the game accepts a player into its session
+    RemovePlayer, // the game removes a player from its session
+    LockPlayerSessions, // the game locks its session
+    UnlockPlayerSessions, // the game unlocks its session
+    EndSession, // the game ends its session
+};
+
+/// <summary>
+/// A single step of a script, taken at a given tick.
+/// </summary>
+struct ScriptStep
+{
+    UINT64 tick;
+    ScriptAction action;
+    EchoVR::SymbolId symbol; // ServerDB messages only
+    std::vector<BYTE> payload; // prefixed by BENCH_PAYLOAD_LEADING_BYTES for ServerDB messages
+};
+
+/// <summary>
+/// Adds a step to a script.
+/// </summary>
+/// <param name="script">The script to add the step to.</param>
+/// <param name="tick">The tick to take the step at.</param>
+/// <param name="action">The action to take.</param>
+/// <param name="symbol">The symbol of the message sent by ServerDB, if the action is a ServerDB message.</param>
+/// <param name="payload">The payload for the step, or NULL if it has none.</param>
+/// <param name="payloadSize">The size of the payload, in bytes.</param>
+/// <returns>None</returns>
+VOID ScriptAdd(std::vector<ScriptStep>* script, UINT64 tick, ScriptAction action, EchoVR::SymbolId symbol, const VOID* payload, UINT64 payloadSize)
+{
+    ScriptStep step;
+    step.tick = tick;
+    step.action = action;
+    step.symbol = symbol;
+    UINT64 leadingBytes = action == ScriptAction::ServerDbMessage ? BENCH_PAYLOAD_LEADING_BYTES : 0;
+    step.payload.resize(leadingBytes + payloadSize);
+    if (payload != NULL)
+        memcpy(step.payload.data() + leadingBytes, payload, payloadSize);
+    script->push_back(std::move(step));
+}
+
+/// <summary>
+/// Builds the built-in script: a registration followed by a series of sessions, each of which fills up with players,
+/// is locked and unlocked, loses a player and ends.
+/// </summary>
+/// <param name="script">The script to build.</param>
+/// <param name="tickRate">The tick rate the script is paced for, in ticks per second.</param>
+/// <param name="sessions">The amount of sessions to script.</param>
+/// <param name="players">The amount of players which join each session.</param>
+/// <returns>None</returns>
+VOID ScriptBuildSynthetic(std::vector<ScriptStep>* script, UINT32 tickRate, UINT32 sessions, UINT32 players)
+{
+    BYTE payload[BENCH_SYNTHETIC_PAYLOAD_SIZE];
+    memset(payload, 0, sizeof(payload));
+    ScriptAdd(script, 1, ScriptAction::ServerDbMessage, SYMBOL_TCPBROADCASTER_LOBBY_REGISTRATION_SUCCESS, payload, sizeof(payload));
+
+    UINT64 sessionTicks = (UINT64)tickRate * 10;
+    for (UINT32 session = 0; session < sessions; session++)
+    {
+        // Each session and player is given a distinct identifier, which leads the relevant messages.
+        UINT64 start = 2 + session * sessionTicks;
+        GUID sessionId = { session + 1, 0, 0, { 'E', 'R', 'B', 'E', 'N', 'C', 'H', 0 } };
+        memcpy(payload, &sessionId, sizeof(sessionId));
+        ScriptAdd(script, start, ScriptAction::ServerDbMessage, SYMBOL_TCPBROADCASTER_LOBBY_START_SESSION, payload, sizeof(payload));
+        for (UINT32 player = 0; player < players; player++)
+        {
+            UINT64 joinTick = start + tickRate + player * (tickRate / 4);
+            GUID playerId = { player + 1, (UINT16)session, 0, { 'E', 'R', 'P', 'L', 'A', 'Y', 'E', 'R' } };
+            memcpy(payload, &playerId, sizeof(playerId));
+            ScriptAdd(script, joinTick, ScriptAction::ServerDbMessage, SYMBOL_TCPBROADCASTER_LOBBY_SESSION_SUCCESS_V5, payload, sizeof(payload));
+            ScriptAdd(script, joinTick + 1, ScriptAction::AcceptPlayer, 0, &playerId, sizeof(playerId));
+            ScriptAdd(script, joinTick + 2, ScriptAction::ServerDbMessage, SYMBOL_TCPBROADCASTER_LOBBY_PLAYERS_ACCEPTED, &playerId, sizeof(playerId));
+        }
+        GUID leavingPlayerId = { 1, (UINT16)session, 0, { 'E', 'R', 'P', 'L', 'A', 'Y', 'E', 'R' } };
+        ScriptAdd(script, start + sessionTicks / 2, ScriptAction::LockPlayerSessions, 0, NULL, 0);
+        ScriptAdd(script, start + (sessionTicks * 3) / 4, ScriptAction::UnlockPlayerSessions, 0, NULL, 0);
+        ScriptAdd(script, start + (sessionTicks * 3) / 4 + 1, ScriptAction::RemovePlayer, 0, &leavingPlayerId, sizeof(leavingPlayerId));
+        ScriptAdd(script, start + sessionTicks - 1, ScriptAction::EndSession, 0, NULL, 0);
+    }
+}
+
+/// <summary>
+/// Builds a script from a session capture. Messages received from ServerDB are replayed as they were received, and the
+/// game's calls into the library are reconstructed from the messages the library sent to ServerDB in response to them.
+/// As captures begin when a session starts, a registration success is scripted ahead of the capture.
+/// </summary>
+/// <param name="script">The script to build.</param>
+/// <param name="tickRate">The tick rate the script is paced for, in ticks per second.</param>
+/// <param name="path">The path of the capture file.</param>
+/// <returns>TRUE if the capture was read, FALSE otherwise.</returns>
+BOOL ScriptBuildFromCapture(std::vector<ScriptStep>* script, UINT32 tickRate, const CHAR* path)
+{
+    CaptureReader reader;
+    if (!CaptureReaderOpen(&reader, path))
+    {
+        CaptureReaderClose(&reader);
+        return FALSE;
+    }
+
+    BYTE registrationPayload[BENCH_SYNTHETIC_PAYLOAD_SIZE];
+    memset(registrationPayload, 0, sizeof(registrationPayload));
+    ScriptAdd(script, 1, ScriptAction::ServerDbMessage, SYMBOL_TCPBROADCASTER_LOBBY_REGISTRATION_SUCCESS, registrationPayload, sizeof(registrationPayload));
+
+    CaptureRecordHeader header;
+    const BYTE* payload;
+    while (CaptureReaderNext(&reader, &header, &payload))
+    {
+        UINT64 tick = 2 + (UINT64)max(header.timestamp - reader.header.startTimestamp, 0LL) * tickRate / reader.header.frequency;
+        if (header.stream == CaptureStream::ServerDbReceive)
+        {
+            ScriptAdd(script, tick, ScriptAction::ServerDbMessage, header.symbol, payload, header.size);
+            continue;
+        }
+        if (header.stream != CaptureStream::ServerDbSend)
+            continue;
+        switch (header.symbol)
+        {
+        case SYMBOL_TCPBROADCASTER_LOBBY_ACCEPT_PLAYERS:
+            for (UINT32 offset = 0; offset + sizeof(GUID) <= header.size; offset += sizeof(GUID))
+                ScriptAdd(script, tick, ScriptAction::AcceptPlayer, 0, payload + offset, sizeof(GUID));
+            break;
+        case SYMBOL_TCPBROADCASTER_LOBBY_PLAYERS_REMOVE_PLAYER:
+            if (header.size >= sizeof(GUID))
+                ScriptAdd(script, tick, ScriptAction::RemovePlayer, 0, payload, sizeof(GUID));
+            break;
+        case SYMBOL_TCPBROADCASTER_LOBBY_PLAYER_SESSIONS_LOCKED:
+            ScriptAdd(script, tick, ScriptAction::LockPlayerSessions, 0, NULL, 0);
+            break;
+        case SYMBOL_TCPBROADCASTER_LOBBY_PLAYER_SESSIONS_UNLOCKED:
+            ScriptAdd(script, tick, ScriptAction::UnlockPlayerSessions, 0, NULL, 0);
+            break;
+        case SYMBOL_TCPBROADCASTER_LOBBY_END_SESSION:
+            ScriptAdd(script, tick, ScriptAction::EndSession, 0, NULL, 0);
+            break;
+        }
+    }
+    CaptureReaderClose(&reader);
+    std::stable_sort(script->begin(), script->end(), [](const ScriptStep& a, const ScriptStep& b) { return a.tick < b.tick; });
+    return TRUE;
+}
+
+/// <summary>
+/// Obtains the measured callback which handles a given ServerDB message.
+/// </summary>
+/// <param name="symbol">The symbol of the ServerDB message.</param>
+/// <returns>The callback which handles the message, or BenchCallbackId::Count if the library does not handle it.</returns>
+BenchCallbackId GetServerDbMessageCallback(EchoVR::SymbolId symbol)
+{
+    switch (symbol)
+    {
+    case SYMBOL_TCPBROADCASTER_LOBBY_REGISTRATION_SUCCESS: return BenchCallbackId::OnRegistrationSuccess;
+    case SYMBOL_TCPBROADCASTER_LOBBY_REGISTRATION_FAILURE: return BenchCallbackId::OnRegistrationFailure;
+    case SYMBOL_TCPBROADCASTER_LOBBY_START_SESSION: return BenchCallbackId::OnStartSession;
+    case SYMBOL_TCPBROADCASTER_LOBBY_SESSION_SUCCESS_V5: return BenchCallbackId::OnSessionSuccess;
+    case SYMBOL_TCPBROADCASTER_LOBBY_PLAYERS_ACCEPTED: return BenchCallbackId::OnPlayersAccepted;
+    case SYMBOL_TCPBROADCASTER_LOBBY_PLAYERS_REJECTED: return BenchCallbackId::OnPlayersRejected;
+    default: return BenchCallbackId::Count;
+    }
+}
+
+/// <summary>
+/// Takes a script step, measuring the library callback it invokes.
+/// </summary>
+/// <param name="lib">The game server library being driven.</param>
+/// <param name="step">The step to take.</param>
+/// <returns>None</returns>
+VOID ScriptTakeStep(GameServerLib* lib, ScriptStep* step)
+{
+    switch (step->action)
+    {
+    case ScriptAction::ServerDbMessage:
+    {
+        // Deliver the message to the listener the library registered, as the TCP broadcaster would.
+        typedef VOID TcpMessageHandler(GameServerLib* self, VOID* proxymthd, EchoVR::TcpPeer sender, VOID* msg, VOID* unk, UINT64 msgSize);
+        HostListener* listener = HostFindListener(&g_Host.tcpListeners, step->symbol);
+        BenchCallbackId id = GetServerDbMessageCallback(step->symbol);
+        if (listener == NULL || id == BenchCallbackId::Count)
+            break;
+        TcpMessageHandler* handler = (TcpMessageHandler*)listener->proxy.proxyFunc;
+        VOID* msg = step->payload.data() + BENCH_PAYLOAD_LEADING_BYTES;
+        UINT64 msgSize = step->payload.size() - BENCH_PAYLOAD_LEADING_BYTES;
+        Measure(id, [&] { handler((GameServerLib*)listener->proxy.instance, NULL, lib->serverDbPeer, msg, NULL, msgSize); });
+        break;
+    }
+    case ScriptAction::AcceptPlayer:
+    {
+        // Occupy an entrant slot for the player, then accept them as the game would.
+        for (EchoVR::Lobby::EntrantData& entrant : g_Host.entrants)
+        {
+            if (entrant.userId.accountId != 0)
+                continue;
+            memset(&entrant, 0, sizeof(entrant));
+            entrant.userId.platformCode = 1;
+            entrant.userId.accountId = ((GUID*)step->payload.data())->Data1;
+            sprintf_s(entrant.displayName, "BenchPlayer%llu", entrant.userId.accountId);
+            entrant.ping = (UINT16)(20 + entrant.userId.accountId % 80);
+            entrant.teamIndex = (UINT16)(entrant.userId.accountId % 2);
+            break;
+        }
+        EchoVR::Array<GUID> playerUuids = { (GUID*)step->payload.data(), 1 };
+        Measure(BenchCallbackId::AcceptPlayerSessions, [&] { lib->AcceptPlayerSessions(&playerUuids); });
+        break;
+    }
+    case ScriptAction::RemovePlayer:
+    {
+        UINT64 accountId = ((GUID*)step->payload.data())->Data1;
+        for (EchoVR::Lobby::EntrantData& entrant : g_Host.entrants)
+        {
+            if (entrant.userId.accountId == accountId)
+                memset(&entrant, 0, sizeof(entrant));
+        }
+        Measure(BenchCallbackId::RemovePlayerSession, [&] { lib->RemovePlayerSession((GUID*)step->payload.data()); });
+        break;
+    }
+    case ScriptAction::LockPlayerSessions:
+        g_Host.lobby.entrantsLocked = TRUE;
+        Measure(BenchCallbackId::LockPlayerSessions, [&] { lib->LockPlayerSessions(); });
+        break;
+    case ScriptAction::UnlockPlayerSessions:
+        g_Host.lobby.entrantsLocked = FALSE;
+        Measure(BenchCallbackId::UnlockPlayerSessions, [&] { lib->UnlockPlayerSessions(); });
+        break;
+    case ScriptAction::EndSession:
+        for (EchoVR::Lobby::EntrantData& entrant : g_Host.entrants)
+            memset(&entrant, 0, sizeof(entrant));
+        g_Host.lobby.entrantsLocked = FALSE;
+        Measure(BenchCallbackId::EndSession, [&] { lib->EndSession(); });
+        break;
+    }
+}
+
+/// <summary>
+/// Raises the session starting event on the host's broadcaster if the game would have, measuring the library's listener.
+/// </summary>
+/// <param name="lib">The game server library being driven.</param>
+/// <returns>None</returns>
+VOID HostRaisePendingEvents(GameServerLib* lib)
+{
+    typedef VOID BroadcasterMessageHandler(GameServerLib* self, VOID* proxymthd, VOID* msg, UINT64 msgSize, EchoVR::Peer destination, EchoVR::Peer sender);
+    if (!g_Host.sessionStartingPending)
+        return;
+    g_Host.sessionStartingPending = FALSE;
+    HostListener* listener = HostFindListener(&g_Host.broadcasterListeners, SYMBOL_BROADCASTER_LOBBY_SESSION_STARTING);
+    if (listener == NULL)
+        return;
+    BroadcasterMessageHandler* handler = (BroadcasterMessageHandler*)listener->proxy.proxyFunc;
+    BYTE msg = 0;
+    Measure(BenchCallbackId::OnSessionStarting, [&] { handler((GameServerLib*)listener->proxy.instance, NULL, &msg, sizeof(msg), EchoVR::Peer_Self, EchoVR::Peer_Self); });
+}
+
+// ---------------------------------------------------------------------------------------------------------------------
+// Reporting
+// ---------------------------------------------------------------------------------------------------------------------
+
+/// <summary>
+/// Prints the measurements taken for each callback, in the style of Google Benchmark's console reporter.
+/// </summary>
+/// <param name="frequency">The performance counter frequency, in ticks per second.</param>
+/// <returns>None</returns>
+VOID PrintReport(LONGLONG frequency)
+{
+    printf("%-38s %10s %10s %10s %10s %10s %10s %10s\n", "Callback", "Iterations", "Mean ns", "P50 ns", "P99 ns", "Max ns", "Allocs/op", "Bytes/op");
+    printf("%s\n", std::string(38 + 7 * 11, '-').c_str());
+    for (UINT32 i = 0; i < (UINT32)BenchCallbackId::Count; i++)
+    {
+        BenchCallback* callback = &g_Callbacks[i];
+        UINT64 iterations = callback->samples.size();
+        if (iterations == 0)
+            continue;
+        std::vector<LONGLONG>& samples = callback->samples;
+        std::sort(samples.begin(), samples.end());
+        LONGLONG total = 0;
+        for (LONGLONG sample : samples)
+            total += sample;
+        auto toNanoseconds = [&](LONGLONG ticks) { return (ticks * 1000000000) / frequency; };
+        printf("%-38s %10llu %10lld %10lld %10lld %10lld %10.2f %10.1f\n", BENCH_CALLBACK_NAMES[i], iterations,
+            toNanoseconds(total / (LONGLONG)iterations), toNanoseconds(samples[(iterations - 1) / 2]), toNanoseconds(samples[((iterations - 1) * 99) / 100]),
+            toNanoseconds(samples.back()), (DOUBLE)callback->allocations / iterations, (DOUBLE)callback->allocatedBytes / iterations);
+    }
+}
+
+/// <summary>
+/// Prints the command line usage of the host.
+/// </summary>
+/// <returns>None</returns>
+VOID PrintUsage()
+{
+    printf("Usage: EchoRelay.GameServer.Bench.exe [-capture <capture file>] [-sessions <count>] [-players <count>] [-tickrate <hz>] [-unpaced]\n");
+    printf("                                      [-serverdb-standins <count>] [-serverdb-drop <seconds>] [-config <key>=<value>]... [-verbose]\n");
+}
+
+INT32 main(INT32 argc, CHAR* argv[])
+{
+    // Parse our arguments.
+    const CHAR* capturePath = NULL;
+    UINT32 sessions = 4;
+    UINT32 players = 8;
+    UINT32 tickRate = 60;
+    BOOL paced = TRUE;
+    UINT32 serverDbStandIns = 0;
+    UINT64 serverDbDropSeconds = 0;
+    for (INT32 i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-capture") == 0 && i + 1 < argc)
+            capturePath = argv[++i];
+        else if (strcmp(argv[i], "-sessions") == 0 && i + 1 < argc)
+            sessions = (UINT32)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-players") == 0 && i + 1 < argc)
+            players = min((UINT32)strtoul(argv[++i], NULL, 10), BENCH_ENTRANT_SLOTS);
+        else if (strcmp(argv[i], "-tickrate") == 0 && i + 1 < argc)
+            tickRate = max((UINT32)strtoul(argv[++i], NULL, 10), 1u);
+        else if (strcmp(argv[i], "-unpaced") == 0)
+            paced = FALSE;
+        else if (strcmp(argv[i], "-serverdb-standins") == 0 && i + 1 < argc)
+            serverDbStandIns = min((UINT32)strtoul(argv[++i], NULL, 10), SERVERDB_MAX_HOSTS - 1);
+        else if (strcmp(argv[i], "-serverdb-drop") == 0 && i + 1 < argc)
+            serverDbDropSeconds = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-config") == 0 && i + 1 < argc)
+        {
+            const CHAR* separator = strchr(argv[++i], '=');
+            if (separator == NULL)
+            {
+                PrintUsage();
+                return 1;
+            }
+            g_Host.config.push_back({ std::string(argv[i], separator - argv[i]), std::string(separator + 1) });
+        }
+        else if (strcmp(argv[i], "-verbose") == 0)
+            g_Host.verbose = TRUE;
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+
+    // Build our script.
+    std::vector<ScriptStep> script;
+    if (capturePath != NULL)
+    {
+        if (!ScriptBuildFromCapture(&script, tickRate, capturePath))
+        {
+            printf("Failed to read capture: %s\n", capturePath);
+            return 1;
+        }
+    }
+    else
+    {
+        ScriptBuildSynthetic(&script, tickRate, sessions, players);
+    }
+
+    // Set up the host, and bind the library's calls into the game to it.
+    FlightRecorderInitialize(&g_FlightRecorder, "EchoRelay.GameServer.Bench");
+    if (!HostInitialize())
+    {
+        printf("Failed to set up the host broadcaster socket\n");
+        HostShutdown();
+        return 1;
+    }
+    HostBindUnexported();
+    if (serverDbStandIns != 0 && !HostOpenServerDbStandIns(serverDbStandIns))
+    {
+        printf("Failed to open the ServerDB stand-ins\n");
+        HostShutdown();
+        return 1;
+    }
+
+    // Reserve room for our samples, so recording them does not allocate while the library is being driven.
+    UINT64 tickCount = (script.empty() ? 0 : script.back().tick) + (UINT64)tickRate * 2;
+    for (BenchCallback& callback : g_Callbacks)
+        callback.samples.reserve(script.size() + 16);
+    g_Callbacks[(UINT32)BenchCallbackId::Update].samples.reserve(tickCount);
+
+    // Initialize the library and request registration, as the game does on startup.
+    GameServerLib* lib = new GameServerLib();
+    EchoVR::Json localConfig = { NULL, NULL };
+    Measure(BenchCallbackId::Initialize, [&] { lib->Initialize(&g_Host.lobby, &g_Host.broadcaster, NULL, "bench.log"); });
+    Measure(BenchCallbackId::RequestRegistration, [&] { lib->RequestRegistration(1, (CHAR*)"bench", 0x1, 0x1, &localConfig); });
+
+    // Drive the library at our tick rate, taking each script step at its tick.
+    LARGE_INTEGER frequency, start, now;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+    UINT64 overruns = 0;
+    size_t stepIndex = 0;
+    for (UINT64 tick = 0; tick < tickCount; tick++)
+    {
+        if (paced)
+        {
+            // Wait for the tick's deadline, counting ticks which started late.
+            LONGLONG deadline = start.QuadPart + (LONGLONG)((tick * frequency.QuadPart) / tickRate);
+            QueryPerformanceCounter(&now);
+            if (now.QuadPart - deadline > frequency.QuadPart / tickRate)
+                overruns++;
+            while (now.QuadPart < deadline)
+            {
+                if (deadline - now.QuadPart > frequency.QuadPart / 500)
+                    Sleep(1);
+                QueryPerformanceCounter(&now);
+            }
+        }
+
+        for (; stepIndex < script.size() && script[stepIndex].tick <= tick; stepIndex++)
+            ScriptTakeStep(lib, &script[stepIndex]);
+        if (serverDbDropSeconds != 0 && tick == serverDbDropSeconds * tickRate)
+        {
+            // Drop the connections to ServerDB, so the library fails over.
+            g_Host.tcpBroadcasterData.droppedPeerCount = g_Host.tcpBroadcasterData.peerCount;
+            QueryPerformanceCounter(&now);
+            g_Host.tcpBroadcasterData.dropTime = now.QuadPart;
+        }
+        HostRaisePendingEvents(lib);
+        Measure(BenchCallbackId::Update, [&] { lib->Update(); });
+    }
+    QueryPerformanceCounter(&now);
+
+    // Terminate the library, as the game does on shutdown. Unregister is not driven, as it unlistens through the TCP
+    // broadcaster's internal listener pool, which the host does not stand in for.
+    Measure(BenchCallbackId::Terminate, [&] { lib->Terminate(); });
+    UINT64 messagesReceived = lib->messagesReceived;
+    UINT32 serverDbFailovers = lib->serverDbHosts.failovers;
+    delete lib;
+    HostShutdown();
+
+    // Report our measurements.
+    printf("ticks:          %llu at %u Hz (%s, %llu started late), %.2f s\n", tickCount, tickRate, paced ? "paced" : "unpaced", overruns,
+        (DOUBLE)(now.QuadPart - start.QuadPart) / frequency.QuadPart);
+    printf("script:         %s, %zu steps\n", capturePath != NULL ? capturePath : "built-in", script.size());
+    printf("serverdb:       sent=%llu (%llu B, %llu heartbeats) received=%llu local events=%llu\n", g_Host.tcpBroadcasterData.messagesSent,
+        g_Host.tcpBroadcasterData.bytesSent, g_Host.tcpBroadcasterData.heartbeatsSent, messagesReceived, g_Host.localEvents);
+    if (serverDbStandIns != 0 || serverDbDropSeconds != 0)
+    {
+        HostTcpBroadcasterData* tcp = &g_Host.tcpBroadcasterData;
+        printf("serverdb hosts: connections=%llu failovers=%u last=%s", tcp->peerCount, serverDbFailovers, tcp->lastPeerUri);
+        if (tcp->failoverTime != 0)
+            printf(" failover after drop=%lld ms", (tcp->failoverTime - tcp->dropTime) * 1000 / frequency.QuadPart);
+        printf("\n");
+    }
+    printf("\n");
+    PrintReport(frequency.QuadPart);
+    return 0;
+}
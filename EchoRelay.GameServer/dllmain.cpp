@@ -6,6 +6,23 @@
 // The initialized ServerLib which Echo VR will call upon to communicate with central services.
 EchoVR::IServerLib* g_ServerLib;
 
+// The flight recorder holding recent game server library events, dumped to disk when the process exits or crashes.
+FlightRecorder g_FlightRecorder;
+
+// The unhandled exception filter which was installed before ours, to be chained to.
+LPTOP_LEVEL_EXCEPTION_FILTER g_PreviousExceptionFilter;
+
+/// <summary>
+/// An unhandled exception filter which dumps the flight recorder before passing the exception on.
+/// </summary>
+/// <param name="exceptionInfo">Information about the unhandled exception.</param>
+/// <returns>The result of the previous exception filter, or EXCEPTION_CONTINUE_SEARCH if there was none.</returns>
+LONG WINAPI FlightRecorderExceptionFilter(EXCEPTION_POINTERS* exceptionInfo)
+{
+	FlightRecorderDump(&g_FlightRecorder, FlightRecorderDumpReason::Crash, exceptionInfo->ExceptionRecord);
+	return g_PreviousExceptionFilter != NULL ? g_PreviousExceptionFilter(exceptionInfo) : EXCEPTION_CONTINUE_SEARCH;
+}
+
 BOOL APIENTRY DllMain( HMODULE hModule,
                        DWORD  ul_reason_for_call,
                        LPVOID lpReserved
@@ -14,9 +31,20 @@ BOOL APIENTRY DllMain( HMODULE hModule,
     switch (ul_reason_for_call)
     {
     case DLL_PROCESS_ATTACH:
+        // Start recording events, and dump them if the process crashes.
+        FlightRecorderInitialize(&g_FlightRecorder, "EchoRelay.GameServer");
+        g_PreviousExceptionFilter = SetUnhandledExceptionFilter(FlightRecorderExceptionFilter);
+        break;
+    case DLL_PROCESS_DETACH:
+        // Dump recorded events, as the process is exiting (or the library is being unloaded).
+        FlightRecorderDump(&g_FlightRecorder, FlightRecorderDumpReason::Exit, NULL);
+
+        // If we're being unloaded rather than exiting, our exception filter must not outlive us.
+        if (lpReserved == NULL)
+            SetUnhandledExceptionFilter(g_PreviousExceptionFilter);
+        break;
     case DLL_THREAD_ATTACH:
     case DLL_THREAD_DETACH:
-    case DLL_PROCESS_DETACH:
         break;
     }
     return TRUE;
@@ -1,5 +1,9 @@
 #include <cstdio>
+#include <algorithm>
+#include <atomic>
+#include <vector>
 #include "pch.h"
+#include <psapi.h>
 #include "echovr.h"
 #include "echovrunexported.h"
 #include "messages.h"
@@ -71,6 +75,685 @@ VOID SendServerdbTcpMessage(GameServerLib* self, EchoVR::SymbolId msgId, VOID* m
 {
 	// Wrap the send call provided by the TCP broadcaster.
 	self->tcpBroadcasterData->SendToPeer(self->serverDbPeer, msgId, NULL, 0, msg, msgSize);
+	self->messagesSent++;
+	self->netStats.serverDbBytesSent += msgSize;
+	FlightRecorderRecord(&g_FlightRecorder, FlightRecorderEventType::ServerDbSend, msgId, msg, msgSize);
+	CaptureWriterRecord(&self->capture, CaptureStream::ServerDbSend, msgId, 0, msg, msgSize, NULL, 0);
+}
+
+/// <summary>
+/// Tracks a message received from the ServerDB websocket service, prior to it being handled.
+/// </summary>
+/// <param name="self">The game server library which received the message.</param>
+/// <param name="msgId">The 64-bit symbol used to describe the message type/identifier received.</param>
+/// <param name="msg">A pointer to the message data received.</param>
+/// <param name="msgSize">The size of the msg received, in bytes.</param>
+/// <returns>None</returns>
+VOID TrackServerdbTcpMessageReceived(GameServerLib* self, EchoVR::SymbolId msgId, VOID* msg, UINT64 msgSize)
+{
+	self->messagesReceived++;
+	self->netStats.serverDbBytesReceived += msgSize;
+	FlightRecorderRecord(&g_FlightRecorder, FlightRecorderEventType::ServerDbReceive, msgId, msg, msgSize);
+	CaptureWriterRecord(&self->capture, CaptureStream::ServerDbReceive, msgId, 0, msg, msgSize, NULL, 0);
+}
+
+/// <summary>
+/// Raises an event on the game server's own broadcaster, as if it were received from a peer.
+/// </summary>
+/// <param name="self">The game server library raising the event.</param>
+/// <param name="msgId">The 64-bit symbol used to describe the message type/identifier of the event.</param>
+/// <param name="msgName">The name of the message type of the event.</param>
+/// <param name="msg">A pointer to the message data of the event.</param>
+/// <param name="msgSize">The size of the msg, in bytes.</param>
+/// <returns>None</returns>
+VOID ReceiveLocalEvent(GameServerLib* self, EchoVR::SymbolId msgId, const CHAR* msgName, VOID* msg, UINT64 msgSize)
+{
+	CaptureWriterRecord(&self->capture, CaptureStream::BroadcasterLocalEvent, msgId, EchoVR::Peer_Self, msg, msgSize, NULL, 0);
+	EchoVR::BroadcasterReceiveLocalEvent(self->broadcaster, msgId, msgName, msg, msgSize);
+}
+
+/// <summary>
+/// Starts capturing the session which is starting, if any session captures remain. The capture identifier is published
+/// to the lobby snapshot, so the patch library captures the session's broadcaster traffic alongside ours.
+/// </summary>
+/// <param name="self">The game server library which is starting a session.</param>
+/// <returns>None</returns>
+VOID StartSessionCapture(GameServerLib* self)
+{
+	if (self->captureSessionsRemaining == 0)
+		return;
+	self->captureSessionsRemaining--;
+	self->captureCount++;
+	if (!CaptureWriterOpen(&self->capture, "EchoRelay.GameServer", self->captureCount, self->captureCapacity))
+	{
+		Log(EchoVR::LogLevel::Warning, "[ECHORELAY.GAMESERVER] Failed to open session capture");
+		return;
+	}
+	if (self->lobbySnapshot != NULL)
+		self->lobbySnapshot->captureId.store(self->captureCount, std::memory_order_relaxed);
+	Log(EchoVR::LogLevel::Info, "[ECHORELAY.GAMESERVER] Capturing session to " CAPTURE_DIRECTORY " (capture %u)", self->captureCount);
+}
+
+/// <summary>
+/// Stops capturing the current session, if it is being captured.
+/// </summary>
+/// <param name="self">The game server library which is ending a session.</param>
+/// <returns>None</returns>
+VOID StopSessionCapture(GameServerLib* self)
+{
+	if (self->capture.captureId.load(std::memory_order_relaxed) == 0)
+		return;
+	if (self->lobbySnapshot != NULL)
+		self->lobbySnapshot->captureId.store(0, std::memory_order_relaxed);
+	CaptureWriterClose(&self->capture);
+}
+
+/// <summary>
+/// Obtains the current time as a UTC file time.
+/// </summary>
+/// <returns>The current time, in 100-nanosecond intervals since January 1, 1601 (UTC).</returns>
+UINT64 GetFileTimeNow()
+{
+	FILETIME now;
+	GetSystemTimePreciseAsFileTime(&now);
+	return ((ULARGE_INTEGER*)&now)->QuadPart;
+}
+
+/// <summary>
+/// Acknowledges the session which is starting to ServerDB, as it is ready for players, along with the times at which it
+/// progressed through starting. This is sent at most once per started session.
+/// </summary>
+/// <param name="self">The game server library which is starting a session.</param>
+/// <returns>None</returns>
+VOID SendSessionStarted(GameServerLib* self)
+{
+	if (!self->sessionStartPending)
+		return;
+	self->sessionStartPending = FALSE;
+
+	ERLobbySessionStarted message;
+	memset(&message, 0, sizeof(message));
+	SessionTraceGetContext(&self->sessionTrace, SessionTracePhase::Session, &message.traceContext);
+	message.requestReceivedTime = self->sessionStartRequestTime;
+	message.levelLoadTime = self->sessionStartLevelLoadTime;
+	message.readyTime = GetFileTimeNow();
+	SendServerdbTcpMessage(self, SYMBOL_TCPBROADCASTER_LOBBY_SESSION_STARTED, &message, sizeof(message));
+	Log(EchoVR::LogLevel::Info, "[ECHORELAY.GAMESERVER] Session ready for players (%llu ms after start request)", (message.readyTime - message.requestReceivedTime) / 10000);
+}
+
+/// <summary>
+/// Tracks the session which is starting through the net game states published to the lobby snapshot by the patch library,
+/// noting when its level begins loading and acknowledging it once the game is ready. Without the patch library, the
+/// session is acknowledged by the session starting event alone.
+/// </summary>
+/// <param name="self">The game server library which is starting a session.</param>
+/// <returns>None</returns>
+VOID TrackSessionStart(GameServerLib* self)
+{
+	if (!self->sessionStartPending || self->lobbySnapshot == NULL)
+		return;
+	EchoVR::NetGameState state = (EchoVR::NetGameState)self->lobbySnapshot->netGameState.load(std::memory_order_relaxed);
+	if (state == EchoVR::NetGameState::LoadingLevel)
+	{
+		if (self->sessionStartLevelLoadTime == 0)
+			self->sessionStartLevelLoadTime = GetFileTimeNow();
+	}
+	else if (self->sessionStartLevelLoadTime != 0 && (state == EchoVR::NetGameState::ReadyForGame || state == EchoVR::NetGameState::InGame))
+	{
+		SendSessionStarted(self);
+	}
+}
+
+/// <summary>
+/// Records a game server library lifecycle event in the flight recorder.
+/// </summary>
+/// <param name="evt">The lifecycle event which occurred.</param>
+/// <param name="payload">The payload for the event, or NULL if there is none.</param>
+/// <param name="payloadSize">The size of the payload, in bytes.</param>
+/// <returns>None</returns>
+VOID RecordLifecycleEvent(FlightRecorderLifecycleEvent evt, const VOID* payload, UINT64 payloadSize)
+{
+	FlightRecorderRecord(&g_FlightRecorder, FlightRecorderEventType::Lifecycle, (UINT64)evt, payload, payloadSize);
+}
+
+/// <summary>
+/// Records the time elapsed since the previous game server library update, to be used in tick time percentiles.
+/// </summary>
+/// <param name="self">The game server library which is being updated.</param>
+/// <returns>None</returns>
+VOID RecordTickTime(GameServerLib* self)
+{
+	// Obtain the current high resolution time.
+	LARGE_INTEGER counter, frequency;
+	QueryPerformanceCounter(&counter);
+	QueryPerformanceFrequency(&frequency);
+
+	// If we have a previous update time, store the elapsed time (in microseconds) in our sample ring buffer.
+	if (self->lastUpdateCounter.QuadPart != 0)
+	{
+		ULONGLONG elapsedMicroseconds = ((counter.QuadPart - self->lastUpdateCounter.QuadPart) * 1000000) / frequency.QuadPart;
+		self->tickTimeSamples[self->tickTimeSampleIndex] = (UINT32)min(elapsedMicroseconds, (ULONGLONG)MAXUINT32);
+		LoadGovernorRecordTick(&self->loadGovernor, self->tickTimeSamples[self->tickTimeSampleIndex], GetTickCount64());
+		self->tickTimeSampleIndex = (self->tickTimeSampleIndex + 1) % HEARTBEAT_TICK_SAMPLE_COUNT;
+		if (self->tickTimeSampleCount < HEARTBEAT_TICK_SAMPLE_COUNT)
+			self->tickTimeSampleCount++;
+	}
+	self->lastUpdateCounter = counter;
+}
+
+/// <summary>
+/// Obtains the value at a given percentile of the tick time samples currently copied into the sort buffer.
+/// </summary>
+/// <param name="self">The game server library which holds the samples.</param>
+/// <param name="percentile">The percentile to obtain (0-100).</param>
+/// <returns>The tick time at the given percentile, in microseconds.</returns>
+UINT32 GetTickTimePercentile(GameServerLib* self, UINT32 percentile)
+{
+	// Partially sort the buffer so the element at our percentile's index is in place.
+	UINT32 index = ((self->tickTimeSampleCount - 1) * percentile) / 100;
+	std::nth_element(self->tickTimeSortBuffer, self->tickTimeSortBuffer + index, self->tickTimeSortBuffer + self->tickTimeSampleCount);
+	return self->tickTimeSortBuffer[index];
+}
+
+/// <summary>
+/// Samples network statistics from the operating system. This is executed on the worker thread.
+/// </summary>
+/// <param name="job">The game server library's network statistics job.</param>
+/// <returns>None</returns>
+VOID ExecuteNetStatsSample(WorkerJob* job)
+{
+	GameServerLib* self = (GameServerLib*)job->context;
+	NetStatsSample(&self->netStatsSample, (SOCKET)self->broadcaster->data->broadcastSocketInfo.socket);
+}
+
+/// <summary>
+/// Applies network statistics sampled on the worker thread. This is executed on the game thread.
+/// </summary>
+/// <param name="job">The game server library's network statistics job.</param>
+/// <returns>None</returns>
+VOID CompleteNetStatsSample(WorkerJob* job)
+{
+	GameServerLib* self = (GameServerLib*)job->context;
+	NetStatsApplySample(&self->netStats, &self->netStatsSample);
+	self->netStatsSamplePending = FALSE;
+}
+
+/// <summary>
+/// Submits a network statistics sample to the worker, if one is due and the last has been applied.
+/// </summary>
+/// <param name="self">The game server library sampling its network statistics.</param>
+/// <returns>None</returns>
+VOID SampleNetStats(GameServerLib* self)
+{
+	if (self->netStatsSamplePending || !NetStatsSampleDue(&self->netStats))
+		return;
+	self->netStatsSample = self->netStats;
+	self->netStatsSamplePending = TRUE;
+	WorkerSubmit(&self->worker, &self->netStatsJob);
+}
+
+/// <summary>
+/// Updates the worker statistics published to monitors, if the worker statistics interval has elapsed. Depth and
+/// counters are always current, while latency maxima cover the last interval.
+/// </summary>
+/// <param name="self">The game server library which owns the worker.</param>
+/// <returns>None</returns>
+VOID UpdateWorkerStats(GameServerLib* self)
+{
+	ULONGLONG now = GetTickCount64();
+	if (now - self->lastWorkerStatsTime >= WORKER_STATS_INTERVAL_MS)
+	{
+		self->lastWorkerStatsTime = now;
+		WorkerGetStats(&self->worker, &self->workerStats);
+		return;
+	}
+	UINT64 jobsSubmitted = self->worker.jobsSubmitted.load(std::memory_order_relaxed);
+	self->workerStats.jobsSubmitted = jobsSubmitted;
+	self->workerStats.jobsCompleted = self->worker.jobsCompleted;
+	self->workerStats.queueDepth = (UINT32)(jobsSubmitted - self->worker.jobsCompleted);
+}
+
+/// <summary>
+/// Describes the game server's state for a stall report. This is called on the stall detector's watchdog thread.
+/// </summary>
+/// <param name="context">The game server library which stalled.</param>
+/// <param name="buffer">The buffer to write the description to.</param>
+/// <param name="bufferSize">The size of the buffer.</param>
+/// <returns>None</returns>
+VOID DescribeStall(VOID* context, CHAR* buffer, size_t bufferSize)
+{
+	GameServerLib* self = (GameServerLib*)context;
+	GUID* sessionId = &self->lobby->gameSessionId;
+	sprintf_s(buffer, bufferSize, "server id: %llu\nregistered: %s\nsession: %s %08lX-%04hX-%04hX-%02hhX%02hhX-%02hhX%02hhX%02hhX%02hhX%02hhX%02hhX\nentrants: %llu\nupdates: %llu",
+		self->serverId, self->registered ? "yes" : "no", self->sessionActive ? "active" : "inactive",
+		sessionId->Data1, sessionId->Data2, sessionId->Data3, sessionId->Data4[0], sessionId->Data4[1], sessionId->Data4[2], sessionId->Data4[3],
+		sessionId->Data4[4], sessionId->Data4[5], sessionId->Data4[6], sessionId->Data4[7], self->lobby->entrantData.count, self->updateCount);
+}
+
+/// <summary>
+/// Logs stalls of the game thread which the stall detector has observed end since this was last called. Stalls are
+/// logged from the game thread, as the game's logger is not thread-safe.
+/// </summary>
+/// <param name="self">The game server library which owns the stall detector.</param>
+/// <returns>None</returns>
+VOID LogStalls(GameServerLib* self)
+{
+	UINT32 stallCount = self->stallDetector.stallCount.load(std::memory_order_acquire);
+	if (stallCount == self->stallsLogged)
+		return;
+	UINT32 durationMs = self->stallDetector.lastStallDurationMs;
+	if (self->stallDetector.lastReportPath[0] != '\0')
+		Log(EchoVR::LogLevel::Warning, "[ECHORELAY.GAMESERVER] Game thread stalled for %u ms (stacks written to %s)", durationMs, self->stallDetector.lastReportPath);
+	else
+		Log(EchoVR::LogLevel::Warning, "[ECHORELAY.GAMESERVER] Game thread stalled for %u ms", durationMs);
+	RecordLifecycleEvent(FlightRecorderLifecycleEvent::GameThreadStall, &durationMs, sizeof(durationMs));
+	self->stallsLogged = stallCount;
+}
+
+/// <summary>
+/// Obtains the portion of the host's CPU time spent busy since this was last called, across all processors.
+/// </summary>
+/// <param name="self">The game server library measuring CPU usage.</param>
+/// <returns>The CPU usage, in hundredths of a percent (0-10000), or zero on the first call.</returns>
+UINT32 GetSystemCpuUsage(GameServerLib* self)
+{
+	// Kernel time includes idle time, so busy time is kernel and user time, less idle time.
+	FILETIME idleTime, kernelTime, userTime;
+	if (!GetSystemTimes(&idleTime, &kernelTime, &userTime))
+		return 0;
+	ULONGLONG idle = ((ULARGE_INTEGER*)&idleTime)->QuadPart;
+	ULONGLONG busy = ((ULARGE_INTEGER*)&kernelTime)->QuadPart + ((ULARGE_INTEGER*)&userTime)->QuadPart - idle;
+	ULONGLONG idleDelta = idle - self->lastSystemIdleTime;
+	ULONGLONG busyDelta = busy - self->lastSystemBusyTime;
+	BOOL first = self->lastSystemIdleTime == 0 && self->lastSystemBusyTime == 0;
+	self->lastSystemIdleTime = idle;
+	self->lastSystemBusyTime = busy;
+	if (first || idleDelta + busyDelta == 0)
+		return 0;
+	return (UINT32)min((busyDelta * 10000) / (idleDelta + busyDelta), (ULONGLONG)10000);
+}
+
+/// <summary>
+/// Sends a player sessions locked or unlocked message to ServerDB for the current session.
+/// </summary>
+/// <param name="self">The game server library whose session is locked or unlocked.</param>
+/// <param name="locked">Indicates whether player sessions are locked.</param>
+/// <param name="phase">The session trace phase the change is reported under.</param>
+/// <returns>None</returns>
+VOID SendPlayerSessionsLocked(GameServerLib* self, BOOL locked, SessionTracePhase phase)
+{
+	if (locked)
+	{
+		ERLobbyPlayerSessionsLocked message;
+		memset(&message, 0, sizeof(message));
+		SessionTraceGetContext(&self->sessionTrace, phase, &message.traceContext);
+		SendServerdbTcpMessage(self, SYMBOL_TCPBROADCASTER_LOBBY_PLAYER_SESSIONS_LOCKED, &message, sizeof(message));
+	}
+	else
+	{
+		ERLobbyPlayerSessionsUnlocked message;
+		memset(&message, 0, sizeof(message));
+		SessionTraceGetContext(&self->sessionTrace, phase, &message.traceContext);
+		SendServerdbTcpMessage(self, SYMBOL_TCPBROADCASTER_LOBBY_PLAYER_SESSIONS_UNLOCKED, &message, sizeof(message));
+	}
+}
+
+/// <summary>
+/// Evaluates the load governor once its window has elapsed, and locks player sessions in the current session while it
+/// is shedding load, so ServerDB stops routing players to us. Sessions are unlocked once the governor recovers, unless
+/// the game has locked them itself, as the game's own lock is never undone by the governor.
+/// </summary>
+/// <param name="self">The game server library governing its load.</param>
+/// <returns>None</returns>
+VOID GovernLoad(GameServerLib* self)
+{
+	// Evaluate the governor if its window has elapsed.
+	LoadGovernor* governor = &self->loadGovernor;
+	ULONGLONG now = GetTickCount64();
+	if (!LoadGovernorEnabled(governor))
+		return;
+	if (LoadGovernorWindowDue(governor, now))
+	{
+		LoadGovernorAction action = LoadGovernorEvaluate(governor, GetSystemCpuUsage(self), now);
+		UINT32 payload[2] = { governor->overrunRate, governor->cpuUsage };
+		if (action == LoadGovernorAction::Shed)
+		{
+			Log(EchoVR::LogLevel::Warning, "[ECHORELAY.GAMESERVER] Shedding load (%u.%u%% of ticks overran, %u.%02u%% CPU)",
+				governor->overrunRate / 10, governor->overrunRate % 10, governor->cpuUsage / 100, governor->cpuUsage % 100);
+			RecordLifecycleEvent(FlightRecorderLifecycleEvent::LoadShedStart, payload, sizeof(payload));
+		}
+		else if (action == LoadGovernorAction::Recover)
+		{
+			Log(EchoVR::LogLevel::Info, "[ECHORELAY.GAMESERVER] Recovered from shedding load (%u.%u%% of ticks overran, %u.%02u%% CPU)",
+				governor->overrunRate / 10, governor->overrunRate % 10, governor->cpuUsage / 100, governor->cpuUsage % 100);
+			RecordLifecycleEvent(FlightRecorderLifecycleEvent::LoadShedEnd, payload, sizeof(payload));
+		}
+	}
+
+	// Bring the session's lock in line with the governor. This also locks sessions started while we are shedding load.
+	if (!self->sessionActive || self->gameSessionsLocked || self->loadShedLocked == (BOOL)governor->shedding)
+		return;
+	self->loadShedLocked = governor->shedding;
+	SendPlayerSessionsLocked(self, self->loadShedLocked, SessionTracePhase::Session);
+	Log(EchoVR::LogLevel::Info, "[ECHORELAY.GAMESERVER] Signaling game server %s to shed load", self->loadShedLocked ? "locked" : "unlocked");
+}
+
+/// <summary>
+/// Sends a heartbeat describing the game server's current load to ServerDB, if the heartbeat interval has elapsed.
+/// The heartbeat is encoded into a buffer held by the game server library, so no allocations occur.
+/// </summary>
+/// <param name="self">The game server library which is sending the heartbeat.</param>
+/// <returns>None</returns>
+VOID SendHeartbeat(GameServerLib* self)
+{
+	// Rate limit heartbeats, and only send them once we are registered with ServerDB.
+	ULONGLONG now = GetTickCount64();
+	if (!self->registered || now - self->lastHeartbeatTime < HEARTBEAT_INTERVAL_MS)
+		return;
+	self->lastHeartbeatTime = now;
+
+	// Compute our tick time percentiles from a copy of our samples.
+	ERLobbyHeartbeat* heartbeat = &self->heartbeat;
+	memset(heartbeat, 0, sizeof(*heartbeat));
+	if (self->tickTimeSampleCount > 0)
+	{
+		memcpy(self->tickTimeSortBuffer, self->tickTimeSamples, self->tickTimeSampleCount * sizeof(UINT32));
+		heartbeat->tickTimeP50 = GetTickTimePercentile(self, 50);
+		heartbeat->tickTimeP95 = GetTickTimePercentile(self, 95);
+		heartbeat->tickTimeP99 = GetTickTimePercentile(self, 99);
+		heartbeat->tickTimeMax = *std::max_element(self->tickTimeSortBuffer, self->tickTimeSortBuffer + self->tickTimeSampleCount);
+	}
+
+	// Count the entrants which are currently occupying a slot.
+	for (UINT64 i = 0; i < self->lobby->entrantData.count; i++)
+	{
+		if ((self->lobby->entrantData.items + i)->userId.accountId != 0)
+			heartbeat->entrantCount++;
+	}
+
+	// Compute our process CPU usage since the last heartbeat, as a portion of total system CPU time.
+	FILETIME creationTime, exitTime, kernelTime, userTime, wallTime;
+	if (GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime))
+	{
+		GetSystemTimeAsFileTime(&wallTime);
+		ULONGLONG processTime = ((ULARGE_INTEGER*)&kernelTime)->QuadPart + ((ULARGE_INTEGER*)&userTime)->QuadPart;
+		ULONGLONG currentWallTime = ((ULARGE_INTEGER*)&wallTime)->QuadPart;
+		if (self->lastCpuWallTime != 0 && currentWallTime > self->lastCpuWallTime)
+		{
+			SYSTEM_INFO systemInfo;
+			GetSystemInfo(&systemInfo);
+			ULONGLONG usage = ((processTime - self->lastCpuProcessTime) * 10000) / ((currentWallTime - self->lastCpuWallTime) * systemInfo.dwNumberOfProcessors);
+			heartbeat->cpuUsage = (UINT16)min(usage, (ULONGLONG)10000);
+		}
+		self->lastCpuProcessTime = processTime;
+		self->lastCpuWallTime = currentWallTime;
+	}
+
+	// Obtain our process working set size.
+	PROCESS_MEMORY_COUNTERS memoryCounters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &memoryCounters, sizeof(memoryCounters)))
+		heartbeat->workingSetBytes = memoryCounters.WorkingSetSize;
+
+	// Report our network statistics, so network saturation can be told apart from CPU saturation. Retransmits and
+	// receive errors are reported as the amount which occurred since the previous heartbeat. If a counter went
+	// backwards (e.g. our connection was re-established), we report its current value.
+	NetStats* netStats = &self->netStats;
+	heartbeat->outboundQueueDepth = netStats->serverDbQueueBytes;
+	heartbeat->serverDbRtt = netStats->serverDbRtt;
+	heartbeat->serverDbRetransmits = (UINT32)(netStats->serverDbRetransmits >= self->lastHeartbeatRetransmits ? netStats->serverDbRetransmits - self->lastHeartbeatRetransmits : netStats->serverDbRetransmits);
+	heartbeat->udpReceiveQueueBytes = netStats->udpReceiveQueueBytes;
+	heartbeat->udpReceiveErrors = (UINT32)(netStats->udpReceiveErrors >= self->lastHeartbeatReceiveErrors ? netStats->udpReceiveErrors - self->lastHeartbeatReceiveErrors : netStats->udpReceiveErrors);
+	heartbeat->netStatsFlags = netStats->flags;
+	self->lastHeartbeatRetransmits = netStats->serverDbRetransmits;
+	self->lastHeartbeatReceiveErrors = netStats->udpReceiveErrors;
+
+	// Send the heartbeat.
+	SendServerdbTcpMessage(self, SYMBOL_TCPBROADCASTER_LOBBY_HEARTBEAT, heartbeat, sizeof(*heartbeat));
+}
+
+/// <summary>
+/// Sends a summary of the round trip times of the session's entrants to ServerDB, if the report interval has elapsed.
+/// </summary>
+/// <param name="self">The game server library which is sending its ping summary.</param>
+/// <param name="force">Indicates whether the summary should be sent regardless of the report interval.</param>
+/// <returns>None</returns>
+VOID SendPingSummary(GameServerLib* self, BOOL force)
+{
+	// Rate limit summaries, and only send them for an active session which has been sampled.
+	ULONGLONG now = GetTickCount64();
+	if (!self->registered || !self->sessionActive || self->pingStats.session.sampleCount == 0)
+		return;
+	if (!force && now - self->pingStats.lastReportTime < PING_STATS_REPORT_INTERVAL_MS)
+		return;
+	self->pingStats.lastReportTime = now;
+
+	// Summarize the session so far and send it.
+	ERLobbyPingSummary* summary = &self->pingSummary;
+	UINT64 summarySize = PingStatsSummarize(&self->pingStats, summary);
+	SessionTraceGetContext(&self->sessionTrace, SessionTracePhase::Session, &summary->traceContext);
+	SendServerdbTcpMessage(self, SYMBOL_TCPBROADCASTER_LOBBY_PING_SUMMARY, summary, summarySize);
+}
+
+/// <summary>
+/// Sends the pending batch of occupancy events to ServerDB.
+/// </summary>
+/// <param name="self">The game server library which is sending its occupancy events.</param>
+/// <param name="now">The current tick count.</param>
+/// <returns>None</returns>
+VOID SendOccupancyEvents(GameServerLib* self, ULONGLONG now)
+{
+	ERLobbyOccupancyEvents* message = &self->occupancyEvents;
+	UINT64 messageSize = OccupancyFlush(&self->occupancy, message, now);
+	SessionTraceGetContext(&self->sessionTrace, SessionTracePhase::Session, &message->traceContext);
+	SendServerdbTcpMessage(self, SYMBOL_TCPBROADCASTER_LOBBY_OCCUPANCY_EVENTS, message, messageSize);
+}
+
+/// <summary>
+/// Observes changes in the occupancy of the session's entrant slots, and sends them to ServerDB in batches. ServerDB only
+/// learns of players through the player sessions it issues, so this lets it track entrants which disconnect silently,
+/// change team, or take ownership of the lobby.
+/// </summary>
+/// <param name="self">The game server library which is tracking its occupancy.</param>
+/// <returns>None</returns>
+VOID TrackOccupancy(GameServerLib* self)
+{
+	// Only track occupancy for an active session.
+	if (!self->registered || !self->sessionActive)
+		return;
+
+	// Diff the entrant slots, sending early if a batch fills, then send the batch if it is due.
+	ULONGLONG now = GetTickCount64();
+	while (OccupancyUpdate(&self->occupancy, self->lobby))
+		SendOccupancyEvents(self, now);
+	if (OccupancyFlushDue(&self->occupancy, now))
+		SendOccupancyEvents(self, now);
+}
+
+/// <summary>
+/// Publishes the current lobby state to the shared memory lobby snapshot, if the publishing interval has elapsed.
+/// External monitors read this without any interaction with the game thread.
+/// </summary>
+/// <param name="self">The game server library which is publishing its state.</param>
+/// <returns>None</returns>
+VOID PublishLobbySnapshot(GameServerLib* self)
+{
+	// Rate limit publishing, and only publish if we have a snapshot region.
+	ULONGLONG now = GetTickCount64();
+	if (self->lobbySnapshot == NULL || now - self->lastLobbySnapshotTime < LOBBY_SNAPSHOT_INTERVAL_MS)
+		return;
+	self->lastLobbySnapshotTime = now;
+
+	// Begin writing, signaling to readers that the data is inconsistent until we are done.
+	LobbySnapshot* snapshot = self->lobbySnapshot;
+	LobbySnapshotBeginWrite(snapshot);
+
+	// Write our session and registration state.
+	LobbySnapshotData* data = &snapshot->data;
+	memcpy(data->gameSessionId, &self->lobby->gameSessionId, sizeof(data->gameSessionId));
+	data->entrantsLocked = self->lobby->entrantsLocked;
+	data->registered = self->registered;
+	data->sessionActive = self->sessionActive;
+	data->serverId = self->serverId;
+	data->regionId = self->regionId;
+	data->versionLock = self->versionLock;
+	data->updateCount = self->updateCount;
+	data->messagesSent = self->messagesSent;
+	data->messagesReceived = self->messagesReceived;
+	data->publishTime = now;
+	data->serverDbBytesSent = self->netStats.serverDbBytesSent;
+	data->serverDbBytesReceived = self->netStats.serverDbBytesReceived;
+	data->serverDbRetransmits = self->netStats.serverDbRetransmits;
+	data->serverDbRtt = self->netStats.serverDbRtt;
+	data->serverDbQueueBytes = self->netStats.serverDbQueueBytes;
+	data->udpReceiveQueueBytes = self->netStats.udpReceiveQueueBytes;
+	data->netStatsFlags = self->netStats.flags;
+	data->udpReceiveErrors = self->netStats.udpReceiveErrors;
+	data->workerJobsSubmitted = self->workerStats.jobsSubmitted;
+	data->workerJobsCompleted = self->workerStats.jobsCompleted;
+	data->workerQueueDepth = self->workerStats.queueDepth;
+	data->workerQueueLatencyMean = self->workerStats.queueLatencyMean;
+	data->workerQueueLatencyMax = self->workerStats.queueLatencyMax;
+	data->workerTurnaroundMax = self->workerStats.turnaroundMax;
+
+	// Write every entrant which is currently occupying a slot.
+	data->entrantCount = 0;
+	for (UINT64 i = 0; i < self->lobby->entrantData.count && data->entrantCount < LOBBY_SNAPSHOT_MAX_ENTRANTS; i++)
+	{
+		EchoVR::Lobby::EntrantData* entrantData = (self->lobby->entrantData.items + i);
+		if (entrantData->userId.accountId == 0)
+			continue;
+
+		LobbySnapshotEntrant* entrant = &data->entrants[data->entrantCount++];
+		entrant->userId.platformCode = entrantData->userId.platformCode;
+		entrant->userId.accountId = entrantData->userId.accountId;
+		entrant->platformId = entrantData->platformId;
+		memcpy(entrant->displayName, entrantData->displayName, sizeof(entrant->displayName));
+		entrant->ping = entrantData->ping;
+		entrant->teamIndex = entrantData->teamIndex;
+		entrant->genIndex = entrantData->genIndex;
+	}
+
+	// Finish writing, publishing the data to readers.
+	LobbySnapshotEndWrite(snapshot);
+}
+
+/// <summary>
+/// Selects the ServerDB host to register with, connects to it and sends it a registration request.
+/// </summary>
+/// <param name="self">The game server library which is registering.</param>
+/// <returns>TRUE if the connection was created, FALSE otherwise.</returns>
+BOOL ConnectServerDb(GameServerLib* self)
+{
+	// Select the host to connect to and parse its URI.
+	INT32 hostIndex = ServerDbHostsSelect(&self->serverDbHosts, GetTickCount64());
+	if (hostIndex < 0)
+		return FALSE;
+	CHAR* serverDbServiceUri = self->serverDbHosts.hosts[hostIndex].uri;
+	EchoVR::UriContainer serverDbUriContainer;
+	memset(&serverDbUriContainer, 0, sizeof(serverDbUriContainer));
+	if (EchoVR::UriContainerParse(&serverDbUriContainer, serverDbServiceUri) != ERROR_SUCCESS)
+		return FALSE;
+
+	// Identify our ServerDB connection for network statistics.
+	NetStatsInitialize(&self->netStats, serverDbServiceUri);
+
+	// Connect to the serverdb websocket service
+	self->tcpBroadcasterData->CreatePeer(&self->serverDbPeer, (const EchoVR::UriContainer*)&serverDbUriContainer);
+
+	// Obtain address information about our game server broadcaster
+	sockaddr_in gameServerAddr = (*(sockaddr_in*)&self->broadcaster->data->addr);
+
+	// Create a registration request.
+	// Note: Only IP address is in network order (big endian).
+	ERLobbyRegistrationRequest regRequest;
+	regRequest.serverId = self->serverId;
+	regRequest.port = (UINT16)self->broadcaster->data->broadcastSocketInfo.port;
+	regRequest.internalIp = gameServerAddr.sin_addr.S_un.S_addr;
+	regRequest.regionId = self->regionId;
+	regRequest.versionLock = self->versionLock;
+
+	// Send the registration request, and begin tracking the connection.
+	SendServerdbTcpMessage(self, SYMBOL_TCPBROADCASTER_LOBBY_REGISTRATION_REQUEST, &regRequest, sizeof(regRequest));
+	ServerDbHostsConnecting(&self->serverDbHosts, GetTickCount64());
+	RecordLifecycleEvent(FlightRecorderLifecycleEvent::RequestRegistration, &regRequest, sizeof(regRequest));
+	Log(EchoVR::LogLevel::Info, "[ECHORELAY.GAMESERVER] Requested game server registration with %s", serverDbServiceUri);
+	return TRUE;
+}
+
+/// <summary>
+/// Probes the ServerDB hosts, measuring how quickly each accepts a connection. This is executed on the worker thread, as
+/// resolving host names may block for some time.
+/// </summary>
+/// <param name="job">The game server library's ServerDB probe job.</param>
+/// <returns>None</returns>
+VOID ExecuteServerDbProbe(WorkerJob* job)
+{
+	GameServerLib* self = (GameServerLib*)job->context;
+	ServerDbHostsProbe(&self->serverDbProbeHosts);
+}
+
+/// <summary>
+/// Applies the latencies measured by probing the ServerDB hosts, and connects to the fastest if registration is still
+/// awaiting them. This is executed on the game thread.
+/// </summary>
+/// <param name="job">The game server library's ServerDB probe job.</param>
+/// <returns>None</returns>
+VOID CompleteServerDbProbe(WorkerJob* job)
+{
+	GameServerLib* self = (GameServerLib*)job->context;
+	self->serverDbProbePending = FALSE;
+
+	// Apply the latencies to the hosts they were measured for, as the hosts may have been reconfigured since.
+	for (UINT32 i = 0; i < self->serverDbHosts.count; i++)
+	{
+		ServerDbHost* host = &self->serverDbHosts.hosts[i];
+		ServerDbHost* probed = &self->serverDbProbeHosts.hosts[i];
+		if (i >= self->serverDbProbeHosts.count || strcmp(host->uri, probed->uri) != 0)
+			continue;
+		host->connectLatencyMs = probed->connectLatencyMs;
+		if (host->connectLatencyMs != SERVERDB_LATENCY_UNREACHABLE)
+			Log(EchoVR::LogLevel::Info, "[ECHORELAY.GAMESERVER] ServerDB at %s accepted a connection in %u ms", host->uri, host->connectLatencyMs);
+		else
+			Log(EchoVR::LogLevel::Warning, "[ECHORELAY.GAMESERVER] ServerDB at %s did not accept a connection", host->uri);
+	}
+
+	// Connect to the selected host, unless we were unregistered while probing.
+	if (!self->serverDbConnectPending)
+		return;
+	self->serverDbConnectPending = FALSE;
+	ConnectServerDb(self);
+}
+
+/// <summary>
+/// Tracks the connection to ServerDB, failing over to another host if it has been disconnected for too long.
+/// </summary>
+/// <param name="self">The game server library which is registered.</param>
+/// <returns>None</returns>
+VOID TrackServerDbConnection(GameServerLib* self)
+{
+	INT32 hostIndex = self->serverDbHosts.current;
+	BOOL connected = hostIndex >= 0 && self->tcpBroadcasterData->IsPeerConnected(self->serverDbPeer);
+
+	// A session which is running belongs to the host which started it: another host would not know of the session, its
+	// players or its lock state. Failing over is deferred until the session ends, and is then due at once, as the
+	// connection was last seen before the session ended.
+	if (!connected && self->sessionActive && hostIndex >= 0)
+	{
+		if (!self->serverDbFailoverDeferred)
+			Log(EchoVR::LogLevel::Warning, "[ECHORELAY.GAMESERVER] Lost connection to ServerDB at %s, deferring failover until the session ends", self->serverDbHosts.hosts[hostIndex].uri);
+		self->serverDbFailoverDeferred = TRUE;
+		return;
+	}
+	self->serverDbFailoverDeferred = FALSE;
+	if (!ServerDbHostsShouldFailOver(&self->serverDbHosts, connected, GetTickCount64()))
+		return;
+
+	// Drop the connection and register with the next host.
+	Log(EchoVR::LogLevel::Warning, "[ECHORELAY.GAMESERVER] Lost connection to ServerDB at %s, failing over", self->serverDbHosts.hosts[hostIndex].uri);
+	RecordLifecycleEvent(FlightRecorderLifecycleEvent::ServerDbFailover, self->serverDbHosts.hosts[hostIndex].uri, strlen(self->serverDbHosts.hosts[hostIndex].uri));
+	self->tcpBroadcasterData->DestroyPeer(self->serverDbPeer);
+	self->registered = FALSE;
+	ConnectServerDb(self);
 }
 
 /// <summary>
@@ -80,11 +763,20 @@ VOID SendServerdbTcpMessage(GameServerLib* self, EchoVR::SymbolId msgId, VOID* m
 /// <returns>None</returns>
 VOID OnTcpMsgRegistrationSuccess(GameServerLib* self, VOID* proxymthd, EchoVR::TcpPeer sender, VOID* msg, VOID* unk, UINT64 msgSize)
 {
-	// Set the registration status
+	TrackServerdbTcpMessageReceived(self, SYMBOL_TCPBROADCASTER_LOBBY_REGISTRATION_SUCCESS, msg, msgSize);
+
+	// Set the registration status, and note how long the host took to respond.
 	self->registered = TRUE;
+	ServerDbHostsResponded(&self->serverDbHosts, GetTickCount64());
+
+	// Startup is complete once we first register, so write out the startup trace.
+	StartupTraceEnd(self->startupTrace, self->startupRegistrationPhase);
+	StartupTraceInstant(self->startupTrace, "gameserver", "Registered");
+	if (StartupTraceWrite(self->startupTrace))
+		Log(EchoVR::LogLevel::Info, "[ECHORELAY.GAMESERVER] Wrote startup trace to " TRACE_DIRECTORY);
 
 	// Forward the received registration success event to the internal broadcast.
-	EchoVR::BroadcasterReceiveLocalEvent(self->broadcaster, SYMBOL_BROADCASTER_LOBBY_REGISTRATION_SUCCESS, "SNSLobbyRegistrationSuccess", msg, msgSize);
+	ReceiveLocalEvent(self, SYMBOL_BROADCASTER_LOBBY_REGISTRATION_SUCCESS, "SNSLobbyRegistrationSuccess", msg, msgSize);
 }
 
 /// <summary>
@@ -94,11 +786,14 @@ VOID OnTcpMsgRegistrationSuccess(GameServerLib* self, VOID* proxymthd, EchoVR::T
 /// <returns>None</returns>
 VOID OnTcpMsgRegistrationFailure(GameServerLib* self, VOID* proxymthd, EchoVR::TcpPeer sender, VOID* msg, VOID* unk, UINT64 msgSize)
 {
+	TrackServerdbTcpMessageReceived(self, SYMBOL_TCPBROADCASTER_LOBBY_REGISTRATION_FAILURE, msg, msgSize);
+
 	// Set the registration status
 	self->registered = FALSE;
+	ServerDbHostsResponded(&self->serverDbHosts, GetTickCount64());
 
 	// Forward the received registration failure event to the internal broadcast.
-	EchoVR::BroadcasterReceiveLocalEvent(self->broadcaster, SYMBOL_BROADCASTER_LOBBY_REGISTRATION_FAILURE, "SNSLobbyRegistrationFailure", msg, msgSize);
+	ReceiveLocalEvent(self, SYMBOL_BROADCASTER_LOBBY_REGISTRATION_FAILURE, "SNSLobbyRegistrationFailure", msg, msgSize);
 }
 
 /// <summary>
@@ -108,12 +803,28 @@ VOID OnTcpMsgRegistrationFailure(GameServerLib* self, VOID* proxymthd, EchoVR::T
 /// <returns>None</returns>
 VOID OnTcpMessageStartSession(GameServerLib* self, VOID* proxymthd, EchoVR::TcpPeer sender, VOID* msg, VOID* unk, UINT64 msgSize)
 {
-	// Set our session to active.
+	// Start capturing the session if requested, so the start request leads the capture.
+	StopSessionCapture(self);
+	StartSessionCapture(self);
+	TrackServerdbTcpMessageReceived(self, SYMBOL_TCPBROADCASTER_LOBBY_START_SESSION, msg, msgSize);
+
+	// Set our session to active, and await it becoming ready for players.
 	self->sessionActive = TRUE;
+	self->sessionStartPending = TRUE;
+	self->sessionStartRequestTime = GetFileTimeNow();
+	self->sessionStartLevelLoadTime = 0;
+	self->gameSessionsLocked = FALSE;
+	self->loadShedLocked = FALSE;
+	PingStatsReset(&self->pingStats);
+	OccupancyReset(&self->occupancy);
+
+	// Begin tracing the session. The message leads with the session identifier, which we use as the trace identifier.
+	if (msgSize >= sizeof(GUID))
+		SessionTraceStartSession(&self->sessionTrace, (GUID*)msg);
 
 	// Forward the received start session event to the internal broadcast.
 	Log(EchoVR::LogLevel::Info, "[ECHORELAY.GAMESERVER] Starting new session");
-	EchoVR::BroadcasterReceiveLocalEvent(self->broadcaster, SYMBOL_BROADCASTER_LOBBY_START_SESSION_V4, "SNSLobbyStartSessionv4", msg, msgSize);
+	ReceiveLocalEvent(self, SYMBOL_BROADCASTER_LOBBY_START_SESSION_V4, "SNSLobbyStartSessionv4", msg, msgSize);
 }
 
 /// <summary>
@@ -124,8 +835,10 @@ VOID OnTcpMessageStartSession(GameServerLib* self, VOID* proxymthd, EchoVR::TcpP
 /// <returns>None</returns>
 VOID OnTcpMsgPlayersAccepted(GameServerLib* self, VOID* proxymthd, EchoVR::TcpPeer sender, VOID* msg, VOID* unk, UINT64 msgSize)
 {
+	TrackServerdbTcpMessageReceived(self, SYMBOL_TCPBROADCASTER_LOBBY_PLAYERS_ACCEPTED, msg, msgSize);
+
 	// Forward the received player acceptance success event to the internal broadcast.
-	EchoVR::BroadcasterReceiveLocalEvent(self->broadcaster, SYMBOL_BROADCASTER_LOBBY_ACCEPT_PLAYERS_SUCCESS_V2, "SNSLobbyAcceptPlayersSuccessv2", msg, msgSize);
+	ReceiveLocalEvent(self, SYMBOL_BROADCASTER_LOBBY_ACCEPT_PLAYERS_SUCCESS_V2, "SNSLobbyAcceptPlayersSuccessv2", msg, msgSize);
 }
 
 /// <summary>
@@ -136,8 +849,10 @@ VOID OnTcpMsgPlayersAccepted(GameServerLib* self, VOID* proxymthd, EchoVR::TcpPe
 /// <returns>None</returns>
 VOID OnTcpMsgPlayersRejected(GameServerLib* self, VOID* proxymthd, EchoVR::TcpPeer sender, VOID* msg, VOID* unk, UINT64 msgSize)
 {
+	TrackServerdbTcpMessageReceived(self, SYMBOL_TCPBROADCASTER_LOBBY_PLAYERS_REJECTED, msg, msgSize);
+
 	// Forward the received player acceptance failure event to the internal broadcast.
-	EchoVR::BroadcasterReceiveLocalEvent(self->broadcaster, SYMBOL_BROADCASTER_LOBBY_ACCEPT_PLAYERS_FAILURE_V2, "SNSLobbyAcceptPlayersFailurev2", msg, msgSize);
+	ReceiveLocalEvent(self, SYMBOL_BROADCASTER_LOBBY_ACCEPT_PLAYERS_FAILURE_V2, "SNSLobbyAcceptPlayersFailurev2", msg, msgSize);
 }
 
 /// <summary>
@@ -148,10 +863,13 @@ VOID OnTcpMsgPlayersRejected(GameServerLib* self, VOID* proxymthd, EchoVR::TcpPe
 /// <returns>None</returns>
 VOID OnTcpMsgSessionSuccessv5(GameServerLib* self, VOID* proxymthd, EchoVR::TcpPeer sender, VOID* msg, VOID* unk, UINT64 msgSize)
 {
+	TrackServerdbTcpMessageReceived(self, SYMBOL_TCPBROADCASTER_LOBBY_SESSION_SUCCESS_V5, msg, msgSize);
+	SessionTraceJoinRequested(&self->sessionTrace);
+
 	// Forward the received join session success event to the internal broadcast.
 	// NOTE: For some reason, currently the session success message for servers parses differently than clients by some offset when setting packet encoding settings.
 	// To account for this, we shift the message pointer, and its size. This is non-problematic for the delegate proxy method wrapper, which only validates minimum size.
-	EchoVR::BroadcasterReceiveLocalEvent(self->broadcaster, SYMBOL_BROADCASTER_LOBBY_SESSION_SUCCESS_V5, "SNSLobbySessionSuccessv5", (CHAR*)msg - 0x10, msgSize + 0x10);
+	ReceiveLocalEvent(self, SYMBOL_BROADCASTER_LOBBY_SESSION_SUCCESS_V5, "SNSLobbySessionSuccessv5", (CHAR*)msg - 0x10, msgSize + 0x10);
 }
 
 /// <summary>
@@ -164,6 +882,11 @@ VOID OnMsgSessionStarting(GameServerLib* self, VOID* proxymthd, VOID* msg, UINT6
 {
 	// NOTE: `msg` here has no substance (one uninitialized byte).
 	Log(EchoVR::LogLevel::Info, "[ECHORELAY.GAMESERVER] Session starting");
+	RecordLifecycleEvent(FlightRecorderLifecycleEvent::SessionStarting, NULL, 0);
+	SessionTraceTransition(&self->sessionTrace, SessionTracePhase::StartSession, SessionTracePhase::OpenForPlayers);
+
+	// Let ServerDB know the session is ready for players, if the net game state did not already indicate so.
+	SendSessionStarted(self);
 }
 
 /// <summary>
@@ -175,6 +898,7 @@ VOID OnMsgSessionError(GameServerLib* self, VOID* proxymthd, VOID* msg, UINT64 m
 {
 	// NOTE: `msg` here has no substance (one uninitialized byte).
 	Log(EchoVR::LogLevel::Error, "[ECHORELAY.GAMESERVER] Session error encountered");
+	RecordLifecycleEvent(FlightRecorderLifecycleEvent::SessionError, NULL, 0);
 }
 
 /// <summary>
@@ -200,6 +924,38 @@ INT64 GameServerLib::UnkFunc0(VOID* unk1, INT64 a2, INT64 a3)
 /// <returns>None</returns>
 VOID* GameServerLib::Initialize(EchoVR::Lobby* lobby, EchoVR::Broadcaster* broadcaster, VOID* unk2, const CHAR* logPath)
 {
+	// Join the startup trace started by the patch library (or start it, if we were loaded without it).
+	this->startupTrace = StartupTraceOpen(&this->startupTraceMapping);
+	UINT32 phase = StartupTraceBegin(this->startupTrace, "gameserver", "GameServerLib::Initialize");
+	this->startupRegistrationPhase = STARTUP_TRACE_INVALID_EVENT;
+
+	// Set up session tracing, which remains disabled until our sample rate is read from the config at registration.
+	SessionTraceInitialize(&this->sessionTrace, 0.0);
+	CaptureWriterInitialize(&this->capture);
+
+	// Our ServerDB hosts are read from the config at registration.
+	ServerDbHostsInitialize(&this->serverDbHosts, "", 0, 0);
+
+	// Set up our load governor, which remains disabled until its thresholds are read from the config at registration.
+	LoadGovernorConfig loadGovernorConfig;
+	memset(&loadGovernorConfig, 0, sizeof(loadGovernorConfig));
+	LoadGovernorInitialize(&this->loadGovernor, &loadGovernorConfig);
+
+	// Start our worker, for work which can be done off the game thread. Without it, the work is done inline.
+	this->netStatsJob.execute = ExecuteNetStatsSample;
+	this->netStatsJob.complete = CompleteNetStatsSample;
+	this->netStatsJob.context = this;
+	this->serverDbProbeJob.execute = ExecuteServerDbProbe;
+	this->serverDbProbeJob.complete = CompleteServerDbProbe;
+	this->serverDbProbeJob.context = this;
+	if (!WorkerStart(&this->worker))
+		Log(EchoVR::LogLevel::Warning, "[ECHORELAY.GAMESERVER] Failed to start worker thread");
+
+	// Watch the game thread (which we are called on) for stalls. The threshold is read from the config at registration.
+	this->stallsLogged = 0;
+	if (!StallDetectorStart(&this->stallDetector, STALL_DETECTOR_DEFAULT_THRESHOLD_MS, DescribeStall, this))
+		Log(EchoVR::LogLevel::Warning, "[ECHORELAY.GAMESERVER] Failed to start stall detector");
+
 	// Set up our game server state.
 	this->lobby = lobby;
 	this->broadcaster = broadcaster;
@@ -217,8 +973,15 @@ VOID* GameServerLib::Initialize(EchoVR::Lobby* lobby, EchoVR::Broadcaster* broad
 	this->tcpBroadcastPlayersRejectedCBHandle = ListenForTcpBroadcasterMessage(this, SYMBOL_TCPBROADCASTER_LOBBY_PLAYERS_REJECTED, (VOID*)OnTcpMsgPlayersRejected);
 	this->tcpBroadcastSessionSuccessCBHandle = ListenForTcpBroadcasterMessage(this, SYMBOL_TCPBROADCASTER_LOBBY_SESSION_SUCCESS_V5, (VOID*)OnTcpMsgSessionSuccessv5);
 
+	// Create the shared memory lobby snapshot for external monitors. Failure here is non-fatal.
+	this->lobbySnapshot = LobbySnapshotOpen(GetCurrentProcessId(), TRUE, &this->lobbySnapshotMapping);
+	if (this->lobbySnapshot == NULL)
+		Log(EchoVR::LogLevel::Warning, "[ECHORELAY.GAMESERVER] Failed to create lobby snapshot shared memory");
+
 	// Log the interaction.
 	Log(EchoVR::LogLevel::Info, "[ECHORELAY.GAMESERVER] Initialized game server");
+	RecordLifecycleEvent(FlightRecorderLifecycleEvent::Initialize, NULL, 0);
+	StartupTraceEnd(this->startupTrace, phase);
 	//lobby->hosting |= 0x1;
 
 	// If we built the module in debug mode, print the base address into logs for debugging purposes.
@@ -236,7 +999,23 @@ VOID* GameServerLib::Initialize(EchoVR::Lobby* lobby, EchoVR::Broadcaster* broad
 /// <returns>None</returns>
 VOID GameServerLib::Terminate() 
 {
+	// Release the lobby snapshot, startup trace and session trace.
+	LobbySnapshotClose(this->lobbySnapshot, this->lobbySnapshotMapping);
+	this->lobbySnapshot = NULL;
+	this->lobbySnapshotMapping = NULL;
+	StartupTraceClose(this->startupTrace, this->startupTraceMapping);
+	this->startupTrace = NULL;
+	this->startupTraceMapping = NULL;
+	SessionTraceClose(&this->sessionTrace);
+	CaptureWriterClose(&this->capture);
+
+	// Stop our worker, completing any outstanding work (without connecting to ServerDB), and our stall detector.
+	this->serverDbConnectPending = FALSE;
+	WorkerStop(&this->worker);
+	StallDetectorStop(&this->stallDetector);
+
 	Log(EchoVR::LogLevel::Info, "[ECHORELAY.GAMESERVER] Terminated game server");
+	RecordLifecycleEvent(FlightRecorderLifecycleEvent::Terminate, NULL, 0);
 }
 
 /// <summary>
@@ -245,6 +1024,27 @@ VOID GameServerLib::Terminate()
 /// <returns>None</returns>
 VOID GameServerLib::Update()
 {
+	// Apply the results of work completed off the game thread since our last tick.
+	WorkerDrainCompletions(&this->worker);
+	UpdateWorkerStats(this);
+
+	// Track our tick time (stamping the stall detector's heartbeat), and send a load heartbeat, ping summary and occupancy changes to ServerDB if they are due.
+	this->updateCount++;
+	RecordTickTime(this);
+	StallDetectorTick(&this->stallDetector, this->lastUpdateCounter.QuadPart);
+	LogStalls(this);
+	TrackServerDbConnection(this);
+	TrackSessionStart(this);
+	SampleNetStats(this);
+	SendHeartbeat(this);
+	GovernLoad(this);
+	PingStatsSample(&this->pingStats, this->lobby, GetTickCount64());
+	SendPingSummary(this, FALSE);
+	TrackOccupancy(this);
+
+	// Publish our lobby state for external monitors.
+	PublishLobbySnapshot(this);
+
 	// TODO: This is temporary code to test if the profile JSON is updated (but not sent to server).
 	// If it is not updated in this structure, one of the "apply loadout" or "save loadout" operations may trigger the update?
 	for (int i = 0; i < this->lobby->entrantData.count; i++)
@@ -282,41 +1082,93 @@ VOID GameServerLib::UnkFunc1(UINT64 unk)
 /// <returns>None</returns>
 VOID GameServerLib::RequestRegistration(INT64 serverId, CHAR* radId, EchoVR::SymbolId regionId, EchoVR::SymbolId versionLock, const EchoVR::Json* localConfig)
 {
+	UINT32 phase = StartupTraceBegin(this->startupTrace, "gameserver", "RequestRegistration");
+
 	// Store the registration information.
 	this->serverId = serverId;
 	this->regionId = regionId;
 	this->versionLock = versionLock;
 
-	// Obtain the serverdb URI from our config (or fallback to default)
+	// Obtain the serverdb URIs from our config (or fallback to the single URI, or default), along with the failover timings.
 	CHAR* serverDbServiceUri = EchoVR::JsonValueAsString((EchoVR::Json*)localConfig, (CHAR*)"serverdb_host", (CHAR*)"ws://localhost:777/serverdb", false);
-	EchoVR::UriContainer serverDbUriContainer;
-	memset(&serverDbUriContainer, 0, sizeof(serverDbUriContainer));
-	if (EchoVR::UriContainerParse(&serverDbUriContainer, serverDbServiceUri) != ERROR_SUCCESS)
+	CHAR* serverDbServiceUris = EchoVR::JsonValueAsString((EchoVR::Json*)localConfig, (CHAR*)"serverdb_hosts", serverDbServiceUri, false);
+	CHAR* serverDbProbeTimeout = EchoVR::JsonValueAsString((EchoVR::Json*)localConfig, (CHAR*)"serverdb_probe_timeout_ms", (CHAR*)"0", false);
+	CHAR* serverDbFailover = EchoVR::JsonValueAsString((EchoVR::Json*)localConfig, (CHAR*)"serverdb_failover_ms", (CHAR*)"0", false);
+	ServerDbHostsInitialize(&this->serverDbHosts, serverDbServiceUris, (UINT32)strtoul(serverDbProbeTimeout, NULL, 10), (UINT32)strtoul(serverDbFailover, NULL, 10));
+
+	// Drop any hosts with URIs we cannot parse.
+	UINT32 validHostCount = 0;
+	for (UINT32 i = 0; i < this->serverDbHosts.count; i++)
+	{
+		EchoVR::UriContainer serverDbUriContainer;
+		memset(&serverDbUriContainer, 0, sizeof(serverDbUriContainer));
+		if (EchoVR::UriContainerParse(&serverDbUriContainer, this->serverDbHosts.hosts[i].uri) == ERROR_SUCCESS)
+			this->serverDbHosts.hosts[validHostCount++] = this->serverDbHosts.hosts[i];
+		else
+			Log(EchoVR::LogLevel::Warning, "[ECHORELAY.GAMESERVER] Ignoring serverdb service URI which could not be parsed: %s", this->serverDbHosts.hosts[i].uri);
+	}
+	this->serverDbHosts.count = validHostCount;
+	if (this->serverDbHosts.count == 0)
 	{
 		Log(EchoVR::LogLevel::Error, "[ECHORELAY.GAMESERVER] Failed to register game server: error parsing serverdb service URI");
+		StartupTraceEnd(this->startupTrace, phase);
 		return;
 	}
 
-	// Connect to the serverdb websocket service
-	this->tcpBroadcasterData->CreatePeer(&this->serverDbPeer, (const EchoVR::UriContainer*)&serverDbUriContainer);
+	// Obtain the portion of sessions to trace from our config (or fallback to none).
+	CHAR* sessionTraceSampleRate = EchoVR::JsonValueAsString((EchoVR::Json*)localConfig, (CHAR*)"session_trace_sample_rate", (CHAR*)"0", false);
+	SessionTraceInitialize(&this->sessionTrace, atof(sessionTraceSampleRate));
 
-	// Obtain address information about our game server broadcaster
-	sockaddr_in gameServerAddr = (*(sockaddr_in*)&this->broadcaster->data->addr);
+	// Obtain the amount of sessions to capture, and the maximum size of each capture, from our config (or fallback to none).
+	CHAR* captureSessions = EchoVR::JsonValueAsString((EchoVR::Json*)localConfig, (CHAR*)"capture_sessions", (CHAR*)"0", false);
+	CHAR* captureMaxMb = EchoVR::JsonValueAsString((EchoVR::Json*)localConfig, (CHAR*)"capture_max_mb", (CHAR*)"0", false);
+	this->captureSessionsRemaining = (UINT32)strtoul(captureSessions, NULL, 10);
+	this->captureCapacity = strtoull(captureMaxMb, NULL, 10) * 1024 * 1024;
+	if (this->captureCapacity == 0)
+		this->captureCapacity = CAPTURE_DEFAULT_CAPACITY;
 
-	// Create a registration request.
-	// Note: Only IP address is in network order (big endian).
-	ERLobbyRegistrationRequest regRequest;
-	regRequest.serverId = this->serverId;
-	regRequest.port = (UINT16)this->broadcaster->data->broadcastSocketInfo.port;
-	regRequest.internalIp = gameServerAddr.sin_addr.S_un.S_addr;
-	regRequest.regionId = this->regionId;
-	regRequest.versionLock = this->versionLock;
+	// Obtain the amount of time a tick may take before the game thread is considered stalled (or fallback to our default).
+	CHAR* stallThreshold = EchoVR::JsonValueAsString((EchoVR::Json*)localConfig, (CHAR*)"stall_threshold_ms", (CHAR*)"", false);
+	if (stallThreshold[0] != '\0')
+		StallDetectorSetThreshold(&this->stallDetector, (UINT32)strtoul(stallThreshold, NULL, 10));
 
-	// Send the registration request.
-	SendServerdbTcpMessage(this, SYMBOL_TCPBROADCASTER_LOBBY_REGISTRATION_REQUEST, &regRequest, sizeof(regRequest));
+	// Obtain the load at which we stop accepting players from our config (or fallback to never shedding load). Recovery
+	// thresholds fallback to half the overrun rate, and 10% less CPU usage, so the governor does not oscillate.
+	CHAR* tickBudget = EchoVR::JsonValueAsString((EchoVR::Json*)localConfig, (CHAR*)"load_shed_tick_budget_us", (CHAR*)"", false);
+	CHAR* shedOverrun = EchoVR::JsonValueAsString((EchoVR::Json*)localConfig, (CHAR*)"load_shed_overrun_percent", (CHAR*)"0", false);
+	CHAR* recoverOverrun = EchoVR::JsonValueAsString((EchoVR::Json*)localConfig, (CHAR*)"load_recover_overrun_percent", (CHAR*)"", false);
+	CHAR* shedCpu = EchoVR::JsonValueAsString((EchoVR::Json*)localConfig, (CHAR*)"load_shed_cpu_percent", (CHAR*)"0", false);
+	CHAR* recoverCpu = EchoVR::JsonValueAsString((EchoVR::Json*)localConfig, (CHAR*)"load_recover_cpu_percent", (CHAR*)"", false);
+	CHAR* shedHold = EchoVR::JsonValueAsString((EchoVR::Json*)localConfig, (CHAR*)"load_shed_hold_ms", (CHAR*)"", false);
+	CHAR* recoverHold = EchoVR::JsonValueAsString((EchoVR::Json*)localConfig, (CHAR*)"load_recover_hold_ms", (CHAR*)"", false);
+	LoadGovernorConfig loadGovernorConfig;
+	loadGovernorConfig.tickBudgetUs = tickBudget[0] != '\0' ? (UINT32)strtoul(tickBudget, NULL, 10) : LOAD_GOVERNOR_DEFAULT_TICK_BUDGET_US;
+	loadGovernorConfig.shedOverrunRate = (UINT32)min(max(atof(shedOverrun) * 10, 0.0), 1000.0);
+	loadGovernorConfig.recoverOverrunRate = recoverOverrun[0] != '\0' ? (UINT32)min(max(atof(recoverOverrun) * 10, 0.0), 1000.0) : loadGovernorConfig.shedOverrunRate / 2;
+	loadGovernorConfig.shedCpuUsage = (UINT32)min(max(atof(shedCpu) * 100, 0.0), 10000.0);
+	loadGovernorConfig.recoverCpuUsage = recoverCpu[0] != '\0' ? (UINT32)min(max(atof(recoverCpu) * 100, 0.0), 10000.0) : loadGovernorConfig.shedCpuUsage - min(loadGovernorConfig.shedCpuUsage, 1000u);
+	loadGovernorConfig.shedHoldMs = shedHold[0] != '\0' ? strtoull(shedHold, NULL, 10) : LOAD_GOVERNOR_DEFAULT_SHED_HOLD_MS;
+	loadGovernorConfig.recoverHoldMs = recoverHold[0] != '\0' ? strtoull(recoverHold, NULL, 10) : LOAD_GOVERNOR_DEFAULT_RECOVER_HOLD_MS;
+	LoadGovernorInitialize(&this->loadGovernor, &loadGovernorConfig);
 
-	// Log the interaction.
-	Log(EchoVR::LogLevel::Info, "[ECHORELAY.GAMESERVER] Requested game server registration");
+	// If we have a choice of hosts, measure how quickly each accepts a connection on the worker, and register with the
+	// closest once it completes. Otherwise (or if a probe from an earlier registration is still running), connect now.
+	this->serverDbConnectPending = FALSE;
+	this->serverDbFailoverDeferred = FALSE;
+	if (this->serverDbHosts.count > 1 && !this->serverDbProbePending)
+	{
+		this->serverDbProbeHosts = this->serverDbHosts;
+		this->serverDbProbePending = TRUE;
+		this->serverDbConnectPending = TRUE;
+		WorkerSubmit(&this->worker, &this->serverDbProbeJob);
+		Log(EchoVR::LogLevel::Info, "[ECHORELAY.GAMESERVER] Probing %u ServerDB hosts", this->serverDbHosts.count);
+	}
+	else
+	{
+		ConnectServerDb(this);
+	}
+	StartupTraceEnd(this->startupTrace, phase);
+	this->startupRegistrationPhase = StartupTraceBegin(this->startupTrace, "gameserver", "Awaiting ServerDB registration");
 }
 
 /// <summary>
@@ -328,6 +1180,9 @@ VOID GameServerLib::Unregister() {
 	// Reset our game server library state.
 	registered = FALSE;
 	sessionActive = FALSE;
+	sessionStartPending = FALSE;
+	gameSessionsLocked = FALSE;
+	loadShedLocked = FALSE;
 	serverId = -1;
 	regionId = -1;
 	versionLock = -1;
@@ -347,11 +1202,15 @@ VOID GameServerLib::Unregister() {
 	EchoVR::TcpBroadcasterUnlisten(this->lobby->tcpBroadcaster, this->tcpBroadcastPlayersRejectedCBHandle);
 	EchoVR::TcpBroadcasterUnlisten(this->lobby->tcpBroadcaster, this->tcpBroadcastSessionSuccessCBHandle);
 
-	// Disconnect from server db.
+	// Disconnect from server db, or skip connecting if we are still probing its hosts.
 	this->tcpBroadcasterData->DestroyPeer(this->serverDbPeer);
+	this->serverDbHosts.current = -1;
+	this->serverDbConnectPending = FALSE;
+	this->serverDbFailoverDeferred = FALSE;
 
 	// Log the interaction.
 	Log(EchoVR::LogLevel::Info, "[ECHORELAY.GAMESERVER] Unregistered game server");
+	RecordLifecycleEvent(FlightRecorderLifecycleEvent::Unregister, NULL, 0);
 }
 
 /// <summary>
@@ -364,10 +1223,24 @@ VOID GameServerLib::EndSession() {
 	// If there is a running session, inform the websocket so it can track the state change.
 	if (sessionActive)
 	{
+		// Send a final summary of the session's round trip times ahead of it ending.
+		SendPingSummary(this, TRUE);
+
 		ERLobbyEndSession message;
+		memset(&message, 0, sizeof(message));
+		SessionTraceGetContext(&this->sessionTrace, SessionTracePhase::Session, &message.traceContext);
 		SendServerdbTcpMessage(this, SYMBOL_TCPBROADCASTER_LOBBY_END_SESSION, &message, sizeof(message));
 	}
 	Log(EchoVR::LogLevel::Info, "[ECHORELAY.GAMESERVER] Signaling end of session");
+	RecordLifecycleEvent(FlightRecorderLifecycleEvent::EndSession, NULL, 0);
+	SessionTraceEndSession(&this->sessionTrace);
+	StopSessionCapture(this);
+	PingStatsReset(&this->pingStats);
+	OccupancyReset(&this->occupancy);
+	sessionActive = FALSE;
+	sessionStartPending = FALSE;
+	gameSessionsLocked = FALSE;
+	loadShedLocked = FALSE;
 }
 
 /// <summary>
@@ -378,15 +1251,17 @@ VOID GameServerLib::EndSession() {
 /// </summary>
 /// <returns>None</returns>
 VOID GameServerLib::LockPlayerSessions() {
-	// If there is a running session, inform the websocket so it can track the state change.
+	// If there is a running session, inform the websocket so it can track the state change. The lock is now held by the
+	// game, rather than by our load governor.
+	SessionTraceTransition(&this->sessionTrace, SessionTracePhase::OpenForPlayers, SessionTracePhase::Locked);
 	if (sessionActive)
-	{
-		ERLobbyPlayerSessionsLocked message;
-		SendServerdbTcpMessage(this, SYMBOL_TCPBROADCASTER_LOBBY_PLAYER_SESSIONS_LOCKED, &message, sizeof(message));
-	}
+		SendPlayerSessionsLocked(this, TRUE, SessionTracePhase::Locked);
+	gameSessionsLocked = TRUE;
+	loadShedLocked = FALSE;
 
 	// Log the interaction.
 	Log(EchoVR::LogLevel::Info, "[ECHORELAY.GAMESERVER] Signaling game server locked");
+	RecordLifecycleEvent(FlightRecorderLifecycleEvent::LockPlayerSessions, NULL, 0);
 }
 
 /// <summary>
@@ -395,15 +1270,23 @@ VOID GameServerLib::LockPlayerSessions() {
 /// </summary>
 /// <returns>None</returns>
 VOID GameServerLib::UnlockPlayerSessions() {
-	// If there is a running session, inform the websocket so it can track the state change.
-	if (sessionActive)
+	// If there is a running session, inform the websocket so it can track the state change, unless our load governor is
+	// shedding load, in which case the session remains locked until it recovers.
+	SessionTraceTransition(&this->sessionTrace, SessionTracePhase::Locked, SessionTracePhase::OpenForPlayers);
+	gameSessionsLocked = FALSE;
+	if (sessionActive && loadGovernor.shedding)
 	{
-		ERLobbyPlayerSessionsUnlocked message;
-		SendServerdbTcpMessage(this, SYMBOL_TCPBROADCASTER_LOBBY_PLAYER_SESSIONS_UNLOCKED, &message, sizeof(message));
+		loadShedLocked = TRUE;
+		Log(EchoVR::LogLevel::Info, "[ECHORELAY.GAMESERVER] Game server remains locked to shed load");
+	}
+	else if (sessionActive)
+	{
+		SendPlayerSessionsLocked(this, FALSE, SessionTracePhase::OpenForPlayers);
 	}
 
 	// Log the interaction.
 	Log(EchoVR::LogLevel::Info, "[ECHORELAY.GAMESERVER] Signaling game server unlocked");
+	RecordLifecycleEvent(FlightRecorderLifecycleEvent::UnlockPlayerSessions, NULL, 0);
 }
 
 /// <summary>
@@ -427,6 +1310,8 @@ VOID GameServerLib::AcceptPlayerSessions(EchoVR::Array<GUID>* playerUuids) {
 
 	// Log the interaction.
 	Log(EchoVR::LogLevel::Info, "[ECHORELAY.GAMESERVER] Accepted %d players into game server", playerUuids->count);
+	RecordLifecycleEvent(FlightRecorderLifecycleEvent::AcceptPlayerSessions, playerUuids->items, playerUuids->count * sizeof(GUID));
+	SessionTraceJoinsAccepted(&this->sessionTrace, playerUuids->count);
 }
 
 /// <summary>
@@ -446,4 +1331,5 @@ VOID GameServerLib::RemovePlayerSession(GUID* playerUuid) {
 
 	// Log the interaction.
 	Log(EchoVR::LogLevel::Info, "[ECHORELAY.GAMESERVER] Removed a player from game server");
+	RecordLifecycleEvent(FlightRecorderLifecycleEvent::RemovePlayerSession, playerUuid, sizeof(GUID));
 }
@@ -2,12 +2,50 @@
 
 #include "pch.h"
 #include "echovr.h"
+#include "messages.h"
+#include "lobbysnapshot.h"
+#include "flightrecorder.h"
+#include "startuptrace.h"
+#include "sessiontrace.h"
+#include "netstats.h"
+#include "pingstats.h"
+#include "occupancy.h"
+#include "serverdbhosts.h"
+#include "worker.h"
+#include "stalldetector.h"
+#include "loadgovernor.h"
+#include "capture.h"
 
 /// <summary>
 /// A symbol representing the game server's special websocket service.
 /// </summary>
 const EchoVR::SymbolId SYMBOL_GAMESERVER_DB = 0x25E886012CED8064;
 
+/// <summary>
+/// The interval at which load heartbeats are sent to ServerDB, in milliseconds.
+/// </summary>
+const ULONGLONG HEARTBEAT_INTERVAL_MS = 5000;
+
+/// <summary>
+/// The interval at which the lobby snapshot is published to shared memory, in milliseconds.
+/// </summary>
+const ULONGLONG LOBBY_SNAPSHOT_INTERVAL_MS = 100;
+
+/// <summary>
+/// The interval over which worker queue latency maxima are measured, in milliseconds.
+/// </summary>
+const ULONGLONG WORKER_STATS_INTERVAL_MS = 5000;
+
+/// <summary>
+/// The amount of tick time samples retained to compute tick time percentiles for a heartbeat.
+/// </summary>
+const UINT32 HEARTBEAT_TICK_SAMPLE_COUNT = 1024;
+
+/// <summary>
+/// The flight recorder for the game server library, dumped to disk when the process exits or crashes.
+/// </summary>
+extern FlightRecorder g_FlightRecorder;
+
 /// <summary>
 /// A game server library implementation which connects to EchoRelay's ServerDB implementation.
 /// </summary>
@@ -38,7 +76,12 @@ public:
 	// ServerDB related fields
 
 	EchoVR::TcpPeer serverDbPeer;
+	ServerDbHosts serverDbHosts;
+	BOOL serverDbConnectPending; // a connection will be made once the hosts have been probed
+	BOOL serverDbFailoverDeferred; // the connection was lost during a session, and failover awaits the session ending
 	BOOL registered;
+	UINT64 messagesSent;
+	UINT64 messagesReceived;
 
 
 	// Session related fields.
@@ -47,6 +90,69 @@ public:
 	UINT64 serverId;
 	EchoVR::SymbolId regionId;
 	EchoVR::SymbolId versionLock;
+	BOOL sessionStartPending;
+	UINT64 sessionStartRequestTime;
+	UINT64 sessionStartLevelLoadTime;
+
+
+	// Heartbeat related fields.
+
+	ULONGLONG lastHeartbeatTime;
+	LARGE_INTEGER lastUpdateCounter;
+	UINT32 tickTimeSamples[HEARTBEAT_TICK_SAMPLE_COUNT];
+	UINT32 tickTimeSortBuffer[HEARTBEAT_TICK_SAMPLE_COUNT];
+	UINT32 tickTimeSampleIndex;
+	UINT32 tickTimeSampleCount;
+	ULONGLONG lastCpuProcessTime;
+	ULONGLONG lastCpuWallTime;
+	UINT64 lastHeartbeatRetransmits;
+	UINT64 lastHeartbeatReceiveErrors;
+	ERLobbyHeartbeat heartbeat;
+	PingStats pingStats;
+	ERLobbyPingSummary pingSummary;
+	OccupancyTracker occupancy;
+	ERLobbyOccupancyEvents occupancyEvents;
+
+
+	// Load shedding related fields.
+
+	LoadGovernor loadGovernor;
+	ULONGLONG lastSystemIdleTime;
+	ULONGLONG lastSystemBusyTime;
+	BOOL gameSessionsLocked; // the game has locked player sessions in the current session
+	BOOL loadShedLocked; // we have locked player sessions in the current session to shed load
+
+
+	// Monitoring related fields.
+
+	HANDLE lobbySnapshotMapping;
+	LobbySnapshot* lobbySnapshot;
+	ULONGLONG lastLobbySnapshotTime;
+	UINT64 updateCount;
+	HANDLE startupTraceMapping;
+	StartupTrace* startupTrace;
+	UINT32 startupRegistrationPhase;
+	SessionTrace sessionTrace;
+	NetStats netStats;
+	CaptureWriter capture;
+	UINT32 captureSessionsRemaining;
+	UINT32 captureCount;
+	UINT64 captureCapacity;
+	StallDetector stallDetector;
+	UINT32 stallsLogged;
+
+
+	// Worker related fields.
+
+	Worker worker;
+	WorkerStats workerStats;
+	ULONGLONG lastWorkerStatsTime;
+	WorkerJob netStatsJob;
+	NetStats netStatsSample;
+	BOOL netStatsSamplePending;
+	WorkerJob serverDbProbeJob;
+	ServerDbHosts serverDbProbeHosts;
+	BOOL serverDbProbePending;
 
 
 	// Callbacks
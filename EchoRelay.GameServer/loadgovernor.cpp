@@ -0,0 +1,59 @@
+#include <cstring>
+#include "loadgovernor.h"
+
+void LoadGovernorInitialize(LoadGovernor* governor, const LoadGovernorConfig* config)
+{
+	memset(governor, 0, sizeof(*governor));
+	governor->config = *config;
+}
+
+void LoadGovernorRecordTick(LoadGovernor* governor, uint32_t tickUs, uint64_t nowMs)
+{
+	if (governor->windowStartMs == 0)
+		governor->windowStartMs = nowMs;
+	governor->windowTicks++;
+	if (tickUs > governor->config.tickBudgetUs)
+		governor->windowOverruns++;
+}
+
+LoadGovernorAction LoadGovernorEvaluate(LoadGovernor* governor, uint32_t cpuUsage, uint64_t nowMs)
+{
+	// Close the window in progress, and begin the next.
+	const LoadGovernorConfig* config = &governor->config;
+	uint64_t windowStartMs = governor->windowStartMs;
+	governor->overrunRate = governor->windowTicks != 0 ? (uint32_t)((uint64_t)governor->windowOverruns * 1000 / governor->windowTicks) : 0;
+	governor->cpuUsage = cpuUsage;
+	governor->windowStartMs = nowMs;
+	governor->windowTicks = 0;
+	governor->windowOverruns = 0;
+
+	// The server is overloaded if either enabled signal crosses its shed threshold, and recovered once every enabled signal
+	// is at or below its recovery threshold. Between the two, neither condition is met, so the governor holds its state.
+	bool overrunEnabled = config->shedOverrunRate != 0;
+	bool cpuEnabled = config->shedCpuUsage != 0;
+	bool conditionMet;
+	if (!governor->shedding)
+	{
+		conditionMet = (overrunEnabled && governor->overrunRate >= config->shedOverrunRate) ||
+			(cpuEnabled && governor->cpuUsage >= config->shedCpuUsage);
+	}
+	else
+	{
+		conditionMet = (!overrunEnabled || governor->overrunRate <= config->recoverOverrunRate) &&
+			(!cpuEnabled || governor->cpuUsage <= config->recoverCpuUsage);
+	}
+
+	// The condition must hold across consecutive windows for its hold time (measured from the start of the first) before the governor changes state.
+	if (!conditionMet)
+	{
+		governor->conditionSinceMs = 0;
+		return LoadGovernorAction::None;
+	}
+	if (governor->conditionSinceMs == 0)
+		governor->conditionSinceMs = windowStartMs;
+	if (nowMs - governor->conditionSinceMs < (governor->shedding ? config->recoverHoldMs : config->shedHoldMs))
+		return LoadGovernorAction::None;
+	governor->shedding = !governor->shedding;
+	governor->conditionSinceMs = 0;
+	return governor->shedding ? LoadGovernorAction::Shed : LoadGovernorAction::Recover;
+}
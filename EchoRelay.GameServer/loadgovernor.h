@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+
+// This module has no platform dependencies, so the load shedding policy can be simulated (and tested) anywhere.
+
+/// <summary>
+/// The interval over which tick overruns are counted and CPU usage is measured before the governor evaluates them, in milliseconds.
+/// </summary>
+const uint64_t LOAD_GOVERNOR_WINDOW_MS = 1000;
+
+/// <summary>
+/// The default amount of time a tick may take before it is considered an overrun, in microseconds.
+/// </summary>
+const uint32_t LOAD_GOVERNOR_DEFAULT_TICK_BUDGET_US = 20000;
+
+/// <summary>
+/// The default amount of time the server must remain overloaded before it sheds load, in milliseconds.
+/// </summary>
+const uint64_t LOAD_GOVERNOR_DEFAULT_SHED_HOLD_MS = 5000;
+
+/// <summary>
+/// The default amount of time the server must remain recovered before it stops shedding load, in milliseconds.
+/// </summary>
+const uint64_t LOAD_GOVERNOR_DEFAULT_RECOVER_HOLD_MS = 30000;
+
+/// <summary>
+/// The thresholds at which the governor sheds load, and recovers from shedding it. Rates are in permille (0-1000) of ticks
+/// which overran their budget, and CPU usage is in hundredths of a percent (0-10000). A shed threshold of zero disables
+/// that signal. Recovery thresholds should be below their shed thresholds, so the governor does not oscillate.
+/// </summary>
+struct LoadGovernorConfig
+{
+	uint32_t tickBudgetUs;
+	uint32_t shedOverrunRate;
+	uint32_t recoverOverrunRate;
+	uint32_t shedCpuUsage;
+	uint32_t recoverCpuUsage;
+	uint64_t shedHoldMs; // how long the shed thresholds must be crossed before shedding
+	uint64_t recoverHoldMs; // how long both recovery thresholds must be met before recovering
+};
+
+/// <summary>
+/// A change in whether the governor is shedding load, returned when a window is evaluated.
+/// </summary>
+enum class LoadGovernorAction
+{
+	None = 0,
+	Shed = 1,
+	Recover = 2,
+};
+
+/// <summary>
+/// A load governor, which tracks the rate at which game server ticks overrun their budget and the host's CPU usage, and
+/// decides when the server should stop accepting players (shed load) and when it may accept them again.
+/// </summary>
+struct LoadGovernor
+{
+	LoadGovernorConfig config;
+	bool shedding;
+
+	// The window in progress.
+	uint64_t windowStartMs; // zero before the first tick
+	uint32_t windowTicks;
+	uint32_t windowOverruns;
+
+	// The last window evaluated.
+	uint32_t overrunRate;
+	uint32_t cpuUsage;
+
+	// The start of the first window in which the current condition (overloaded while not shedding, recovered while shedding) was met, or zero if it is not met.
+	uint64_t conditionSinceMs;
+};
+
+/// <summary>
+/// Initializes a governor, which is not shedding load.
+/// </summary>
+/// <param name="governor">The governor to initialize.</param>
+/// <param name="config">The governor's thresholds.</param>
+/// <returns>None</returns>
+void LoadGovernorInitialize(LoadGovernor* governor, const LoadGovernorConfig* config);
+
+/// <summary>
+/// Indicates whether a governor has any signal enabled, and so may shed load.
+/// </summary>
+/// <param name="governor">The governor to check.</param>
+/// <returns>true if the governor has a shed threshold configured, false otherwise.</returns>
+inline bool LoadGovernorEnabled(const LoadGovernor* governor)
+{
+	return governor->config.shedOverrunRate != 0 || governor->config.shedCpuUsage != 0;
+}
+
+/// <summary>
+/// Records the duration of a game server tick in the window in progress.
+/// </summary>
+/// <param name="governor">The governor to record the tick with.</param>
+/// <param name="tickUs">The duration of the tick, in microseconds.</param>
+/// <param name="nowMs">The current time, in milliseconds.</param>
+/// <returns>None</returns>
+void LoadGovernorRecordTick(LoadGovernor* governor, uint32_t tickUs, uint64_t nowMs);
+
+/// <summary>
+/// Indicates whether the window in progress has elapsed, and should be evaluated.
+/// </summary>
+/// <param name="governor">The governor to check.</param>
+/// <param name="nowMs">The current time, in milliseconds.</param>
+/// <returns>true if the window should be evaluated, false otherwise.</returns>
+inline bool LoadGovernorWindowDue(const LoadGovernor* governor, uint64_t nowMs)
+{
+	return governor->windowStartMs != 0 && nowMs - governor->windowStartMs >= LOAD_GOVERNOR_WINDOW_MS;
+}
+
+/// <summary>
+/// Evaluates the window in progress against the governor's thresholds, and begins the next window.
+/// </summary>
+/// <param name="governor">The governor to evaluate.</param>
+/// <param name="cpuUsage">The CPU usage measured over the window, in hundredths of a percent (0-10000).</param>
+/// <param name="nowMs">The current time, in milliseconds.</param>
+/// <returns>The change in whether the governor is shedding load, if any.</returns>
+LoadGovernorAction LoadGovernorEvaluate(LoadGovernor* governor, uint32_t cpuUsage, uint64_t nowMs);
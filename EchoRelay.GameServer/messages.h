@@ -38,6 +38,9 @@ const EchoVR::SymbolId SYMBOL_TCPBROADCASTER_LOBBY_PLAYERS_REJECTED = 0x77777777
 const EchoVR::SymbolId SYMBOL_TCPBROADCASTER_LOBBY_PLAYERS_REMOVE_PLAYER = 0x7777777777770800; // unofficial
 const EchoVR::SymbolId SYMBOL_TCPBROADCASTER_LOBBY_CHALLENGE_REQUEST = 0x7777777777770900; // unofficial
 const EchoVR::SymbolId SYMBOL_TCPBROADCASTER_LOBBY_CHALLENGE_RESPONSE = 0x7777777777770A00; // unofficial
+const EchoVR::SymbolId SYMBOL_TCPBROADCASTER_LOBBY_HEARTBEAT = 0x7777777777770B00; // unofficial
+const EchoVR::SymbolId SYMBOL_TCPBROADCASTER_LOBBY_PING_SUMMARY = 0x7777777777770C00; // unofficial
+const EchoVR::SymbolId SYMBOL_TCPBROADCASTER_LOBBY_OCCUPANCY_EVENTS = 0x7777777777770D00; // unofficial
 
 /// <summary>
 /// A message sent from game server to server to register the game server.
@@ -52,11 +55,42 @@ struct ERLobbyRegistrationRequest
 	EchoVR::SymbolId versionLock;
 };
 
+/// <summary>
+/// A flag within a trace context, indicating the session is being traced by the game server.
+/// </summary>
+const UINT32 TRACE_CONTEXT_FLAG_SAMPLED = 0x1;
+
+/// <summary>
+/// Tracing information appended to session state messages sent from game server to server, so that service-side
+/// spans can be correlated with the game server's spans for the same session.
+/// </summary>
+struct ERTraceContext {
+	GUID traceId; // the session identifier provided when the session was started
+	UINT64 spanId; // the game server span which was active when the message was sent
+	UINT32 flags;
+	BYTE padding[4];
+};
+
 /// <summary>
 /// A message sent from game server to server to indicate the current session has ended.
 /// </summary>
 struct ERLobbyEndSession {
 	CHAR unused;
+	BYTE padding[7];
+	ERTraceContext traceContext;
+};
+
+/// <summary>
+/// A message sent from game server to server to indicate the session it was directed to start is ready for players.
+/// Times are UTC file times (100-nanosecond intervals since January 1, 1601), so ServerDB can chart start latency.
+/// </summary>
+struct ERLobbySessionStarted {
+	CHAR unused;
+	BYTE padding[7];
+	ERTraceContext traceContext;
+	UINT64 requestReceivedTime; // the start session request was received
+	UINT64 levelLoadTime; // the level began loading, or zero if this was not observed
+	UINT64 readyTime; // the session became ready for players
 };
 
 /// <summary>
@@ -64,6 +98,8 @@ struct ERLobbyEndSession {
 /// </summary>
 struct ERLobbyPlayerSessionsLocked {
 	CHAR unused;
+	BYTE padding[7];
+	ERTraceContext traceContext;
 };
 
 /// <summary>
@@ -71,4 +107,107 @@ struct ERLobbyPlayerSessionsLocked {
 /// </summary>
 struct ERLobbyPlayerSessionsUnlocked {
 	CHAR unused;
+	BYTE padding[7];
+	ERTraceContext traceContext;
+};
+
+/// <summary>
+/// A message sent periodically from game server to server, describing the current load on the game server.
+/// </summary>
+struct ERLobbyHeartbeat {
+	UINT32 tickTimeP50; // microseconds
+	UINT32 tickTimeP95; // microseconds
+	UINT32 tickTimeP99; // microseconds
+	UINT32 tickTimeMax; // microseconds
+	UINT16 entrantCount;
+	UINT16 cpuUsage; // hundredths of a percent of total system CPU time (0-10000)
+	UINT32 outboundQueueDepth; // bytes queued or in flight to ServerDB
+	UINT64 workingSetBytes;
+	UINT32 serverDbRtt; // milliseconds
+	UINT32 serverDbRetransmits; // since the previous heartbeat
+	UINT32 udpReceiveQueueBytes;
+	UINT32 udpReceiveErrors; // system-wide, since the previous heartbeat
+	UINT32 netStatsFlags; // NET_STATS_FLAG_*
+	BYTE padding[4];
+};
+
+/// <summary>
+/// The maximum amount of entrants described by a ping summary.
+/// </summary>
+const UINT32 PING_SUMMARY_MAX_ENTRIES = 32;
+
+/// <summary>
+/// The round trip times observed for an entrant, within a ping summary. Times are in milliseconds.
+/// </summary>
+struct ERLobbyPingSummaryEntry {
+	EchoVR::XPlatformId userId;
+	UINT32 sampleCount;
+	UINT16 rttP50;
+	UINT16 rttP95;
+	UINT16 jitter; // mean difference between consecutive samples
+	BYTE padding[6];
+};
+
+/// <summary>
+/// A message sent periodically from game server to server while a session is active, summarizing the round trip times
+/// of its entrants as reported by the game, for the session so far. Only the entries in use are sent.
+/// </summary>
+struct ERLobbyPingSummary {
+	CHAR unused;
+	BYTE padding[7];
+	ERTraceContext traceContext;
+	UINT32 sampleCount; // across all entrants
+	UINT16 rttP50; // milliseconds, across all entrants
+	UINT16 rttP95; // milliseconds, across all entrants
+	UINT16 jitter; // milliseconds, across all entrants
+	UINT16 entryCount;
+	BYTE padding2[4];
+	ERLobbyPingSummaryEntry entries[PING_SUMMARY_MAX_ENTRIES];
+};
+
+/// <summary>
+/// The maximum amount of events carried by an occupancy event batch.
+/// </summary>
+const UINT32 OCCUPANCY_EVENTS_MAX_EVENTS = 64;
+
+/// <summary>
+/// A slot index in an occupancy event which indicates no entrant slot (e.g. the lobby has no owner).
+/// </summary>
+const UINT16 OCCUPANCY_EVENT_NO_SLOT = 0xFFFF;
+
+/// <summary>
+/// A type of change in the occupancy of the session's entrant slots.
+/// </summary>
+enum class OccupancyEventType : UINT16
+{
+	Join = 0, // an entrant took the slot
+	Leave = 1, // the entrant left the slot
+	TeamChange = 2, // the entrant in the slot changed team
+	OwnerChange = 3, // the lobby owner changed to the entrant in the slot
+};
+
+/// <summary>
+/// A change in the occupancy of an entrant slot, observed from the lobby's entrant data.
+/// </summary>
+struct ERLobbyOccupancyEvent {
+	EchoVR::XPlatformId userId; // the entrant the event describes (for a leave, the entrant which left)
+	OccupancyEventType type;
+	UINT16 slot;
+	INT16 teamIndex; // the entrant's team after the event (for a leave, the team they left)
+	INT16 previousTeamIndex; // the entrant's team before a team change, otherwise the same as teamIndex
+};
+
+/// <summary>
+/// A message sent from game server to server, carrying the changes in occupancy of the current session's entrant slots
+/// since the previous batch, in the order they were observed. Applied in sequence from the start of a session, these
+/// describe exactly which entrant occupies each slot, and their team.
+/// </summary>
+struct ERLobbyOccupancyEvents {
+	CHAR unused;
+	BYTE padding[7];
+	ERTraceContext traceContext;
+	UINT32 sequence; // the index of this batch within the session, starting from zero
+	UINT16 eventCount;
+	BYTE padding2[2];
+	ERLobbyOccupancyEvent events[OCCUPANCY_EVENTS_MAX_EVENTS];
 };
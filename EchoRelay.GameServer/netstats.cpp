@@ -0,0 +1,145 @@
+#include <cstdlib>
+#include <cstring>
+#include "pch.h"
+#include <iphlpapi.h>
+#include <tcpestats.h>
+#include "netstats.h"
+
+#pragma comment(lib, "Iphlpapi.lib")
+
+/// <summary>
+/// The maximum amount of connections to the ServerDB port which statistics are summed across.
+/// </summary>
+const UINT32 NET_STATS_MAX_SERVERDB_CONNECTIONS = 8;
+
+VOID NetStatsInitialize(NetStats* stats, const CHAR* serverDbUri)
+{
+	// Parse the port from the URI (scheme://host[:port][/path]), falling back to the scheme's default port.
+	const CHAR* authority = strstr(serverDbUri, "://");
+	BOOL secure = strncmp(serverDbUri, "wss", 3) == 0 || strncmp(serverDbUri, "https", 5) == 0;
+	stats->serverDbPort = secure ? 443 : 80;
+	if (authority != NULL)
+	{
+		authority += 3;
+		const CHAR* authorityEnd = strchr(authority, '/');
+		const CHAR* portSeparator = strrchr(authority, ':');
+		if (portSeparator != NULL && (authorityEnd == NULL || portSeparator < authorityEnd))
+			stats->serverDbPort = (UINT16)atoi(portSeparator + 1);
+	}
+}
+
+/// <summary>
+/// Samples the operating system's extended TCP statistics for our connections to the ServerDB port.
+/// Collection of extended statistics is enabled on each connection as it is found, which requires elevation.
+/// If it cannot be enabled, only the connection's existence is reported.
+/// </summary>
+/// <param name="stats">The statistics to update.</param>
+/// <returns>None</returns>
+VOID NetStatsSampleServerDb(NetStats* stats)
+{
+	stats->serverDbRtt = 0;
+	stats->serverDbQueueBytes = 0;
+	stats->serverDbRetransmits = 0;
+	stats->flags &= ~(NET_STATS_FLAG_SERVERDB_CONNECTION_FOUND | NET_STATS_FLAG_SERVERDB_EXTENDED_STATS);
+
+	// Obtain the table of TCP connections with their owning processes.
+	DWORD tableSize = 0;
+	if (GetExtendedTcpTable(NULL, &tableSize, FALSE, AF_INET, TCP_TABLE_OWNER_PID_CONNECTIONS, 0) != ERROR_INSUFFICIENT_BUFFER)
+		return;
+	MIB_TCPTABLE_OWNER_PID* table = (MIB_TCPTABLE_OWNER_PID*)malloc(tableSize);
+	if (table == NULL)
+		return;
+	if (GetExtendedTcpTable(table, &tableSize, FALSE, AF_INET, TCP_TABLE_OWNER_PID_CONNECTIONS, 0) != NO_ERROR)
+	{
+		free(table);
+		return;
+	}
+
+	// Sum the statistics of each of our established connections to the ServerDB port.
+	DWORD processId = GetCurrentProcessId();
+	UINT32 connectionCount = 0;
+	for (DWORD i = 0; i < table->dwNumEntries && connectionCount < NET_STATS_MAX_SERVERDB_CONNECTIONS; i++)
+	{
+		MIB_TCPROW_OWNER_PID* ownerRow = &table->table[i];
+		if (ownerRow->dwOwningPid != processId || ownerRow->dwState != MIB_TCP_STATE_ESTAB || ntohs((u_short)ownerRow->dwRemotePort) != stats->serverDbPort)
+			continue;
+		connectionCount++;
+		stats->flags |= NET_STATS_FLAG_SERVERDB_CONNECTION_FOUND;
+
+		MIB_TCPROW row;
+		row.dwState = ownerRow->dwState;
+		row.dwLocalAddr = ownerRow->dwLocalAddr;
+		row.dwLocalPort = ownerRow->dwLocalPort;
+		row.dwRemoteAddr = ownerRow->dwRemoteAddr;
+		row.dwRemotePort = ownerRow->dwRemotePort;
+
+		// Enable collection of the statistics we read. This is a no-op if collection is already enabled.
+		TCP_ESTATS_DATA_RW_v0 dataRw = { TRUE };
+		TCP_ESTATS_PATH_RW_v0 pathRw = { TRUE };
+		TCP_ESTATS_SEND_BUFF_RW_v0 sendBuffRw = { TRUE };
+		if (SetPerTcpConnectionEStats(&row, TcpConnectionEstatsData, (PUCHAR)&dataRw, 0, sizeof(dataRw), 0) != NO_ERROR ||
+			SetPerTcpConnectionEStats(&row, TcpConnectionEstatsPath, (PUCHAR)&pathRw, 0, sizeof(pathRw), 0) != NO_ERROR ||
+			SetPerTcpConnectionEStats(&row, TcpConnectionEstatsSendBuff, (PUCHAR)&sendBuffRw, 0, sizeof(sendBuffRw), 0) != NO_ERROR)
+			continue;
+
+		// Read the statistics.
+		TCP_ESTATS_DATA_ROD_v0 dataRod;
+		TCP_ESTATS_PATH_ROD_v0 pathRod;
+		TCP_ESTATS_SEND_BUFF_ROD_v0 sendBuffRod;
+		if (GetPerTcpConnectionEStats(&row, TcpConnectionEstatsData, NULL, 0, 0, NULL, 0, 0, (PUCHAR)&dataRod, 0, sizeof(dataRod)) != NO_ERROR ||
+			GetPerTcpConnectionEStats(&row, TcpConnectionEstatsPath, NULL, 0, 0, NULL, 0, 0, (PUCHAR)&pathRod, 0, sizeof(pathRod)) != NO_ERROR ||
+			GetPerTcpConnectionEStats(&row, TcpConnectionEstatsSendBuff, NULL, 0, 0, NULL, 0, 0, (PUCHAR)&sendBuffRod, 0, sizeof(sendBuffRod)) != NO_ERROR)
+			continue;
+
+		stats->flags |= NET_STATS_FLAG_SERVERDB_EXTENDED_STATS;
+		stats->serverDbRtt = max(stats->serverDbRtt, (UINT32)pathRod.SmoothedRtt);
+		stats->serverDbQueueBytes += (UINT32)(sendBuffRod.CurAppWQueue + (dataRod.SndNxt - dataRod.SndUna));
+		stats->serverDbRetransmits += pathRod.PktsRetrans;
+	}
+	free(table);
+}
+
+BOOL NetStatsSampleDue(NetStats* stats)
+{
+	// Rate limit sampling, as enumerating connections is relatively expensive.
+	ULONGLONG now = GetTickCount64();
+	if (now - stats->lastSampleTime < NET_STATS_SAMPLE_INTERVAL_MS)
+		return FALSE;
+	stats->lastSampleTime = now;
+	return TRUE;
+}
+
+VOID NetStatsSample(NetStats* stats, SOCKET broadcastSocket)
+{
+	// Sample the ServerDB link.
+	NetStatsSampleServerDb(stats);
+
+	// Obtain the amount of data waiting to be read from the UDP broadcast socket. A backlog here while the game thread
+	// has spare time indicates network saturation, rather than CPU saturation.
+	u_long receiveQueueBytes = 0;
+	if (ioctlsocket(broadcastSocket, FIONREAD, &receiveQueueBytes) == 0)
+	{
+		stats->udpReceiveQueueBytes = (UINT32)receiveQueueBytes;
+		stats->flags |= NET_STATS_FLAG_UDP_RECEIVE_QUEUE;
+	}
+	else
+	{
+		stats->udpReceiveQueueBytes = 0;
+		stats->flags &= ~NET_STATS_FLAG_UDP_RECEIVE_QUEUE;
+	}
+
+	// Obtain the system-wide UDP receive errors, which include datagrams dropped due to full receive buffers.
+	MIB_UDPSTATS udpStats;
+	if (GetUdpStatistics(&udpStats) == NO_ERROR)
+		stats->udpReceiveErrors = udpStats.dwInErrors;
+}
+
+VOID NetStatsApplySample(NetStats* stats, const NetStats* sample)
+{
+	stats->flags = sample->flags;
+	stats->serverDbRtt = sample->serverDbRtt;
+	stats->serverDbQueueBytes = sample->serverDbQueueBytes;
+	stats->serverDbRetransmits = sample->serverDbRetransmits;
+	stats->udpReceiveQueueBytes = sample->udpReceiveQueueBytes;
+	stats->udpReceiveErrors = sample->udpReceiveErrors;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "pch.h"
+#include "echovr.h"
+
+/// <summary>
+/// The interval at which network statistics are sampled, in milliseconds.
+/// </summary>
+const ULONGLONG NET_STATS_SAMPLE_INTERVAL_MS = 2000;
+
+/// <summary>
+/// Flags describing which network statistics were available when they were last sampled.
+/// </summary>
+const UINT32 NET_STATS_FLAG_SERVERDB_CONNECTION_FOUND = 0x1;
+const UINT32 NET_STATS_FLAG_SERVERDB_EXTENDED_STATS = 0x2;
+const UINT32 NET_STATS_FLAG_UDP_RECEIVE_QUEUE = 0x4;
+
+/// <summary>
+/// Network statistics for the game server, sampled periodically from the game thread.
+/// TcpPeerConnectionStats has not been mapped out, so statistics for the ServerDB websocket link are obtained from the
+/// operating system's extended TCP statistics for the connection instead. As central services commonly share a single
+/// host and port, statistics are summed across all of our established connections to the ServerDB port.
+/// </summary>
+struct NetStats
+{
+	// Configuration
+	UINT16 serverDbPort; // host order, parsed from the ServerDB URI
+	ULONGLONG lastSampleTime;
+	UINT32 flags; // NET_STATS_FLAG_*
+
+	// ServerDB link, as seen by the game server library.
+	UINT64 serverDbBytesSent; // message payload bytes
+	UINT64 serverDbBytesReceived; // message payload bytes
+
+	// ServerDB link, as seen by the operating system (zero unless NET_STATS_FLAG_SERVERDB_EXTENDED_STATS is set).
+	UINT32 serverDbRtt; // smoothed round trip time, milliseconds (largest across connections)
+	UINT32 serverDbQueueBytes; // bytes written but not yet sent, plus bytes sent but not yet acknowledged
+	UINT64 serverDbRetransmits; // segments retransmitted, cumulative
+
+	// UDP game traffic. Per-peer throughput is held within the broadcaster, which has not been mapped out.
+	UINT32 udpReceiveQueueBytes; // bytes waiting to be read from the broadcast socket
+	UINT64 udpReceiveErrors; // system-wide UDP receive errors (e.g. buffer overflows), cumulative
+};
+
+/// <summary>
+/// Initializes network statistics for a ServerDB connection. Counters are retained, so this may be called again when
+/// re-registering.
+/// </summary>
+/// <param name="stats">The statistics to initialize.</param>
+/// <param name="serverDbUri">The URI of the ServerDB websocket service, used to identify its connection.</param>
+/// <returns>None</returns>
+VOID NetStatsInitialize(NetStats* stats, const CHAR* serverDbUri);
+
+/// <summary>
+/// Determines whether network statistics are due to be sampled, as the sample interval has elapsed since they last were.
+/// </summary>
+/// <param name="stats">The statistics to check.</param>
+/// <returns>TRUE if a sample is due, FALSE otherwise.</returns>
+BOOL NetStatsSampleDue(NetStats* stats);
+
+/// <summary>
+/// Samples network statistics from the operating system. Enumerating connections is relatively expensive, so this is
+/// intended to be run off the game thread, sampling into a copy of the statistics which is then applied.
+/// </summary>
+/// <param name="stats">The statistics to sample into, copied from the statistics being sampled for.</param>
+/// <param name="broadcastSocket">The UDP socket used by the game server broadcaster.</param>
+/// <returns>None</returns>
+VOID NetStatsSample(NetStats* stats, SOCKET broadcastSocket);
+
+/// <summary>
+/// Applies the operating system statistics from a sample, retaining the counters tracked by the game server library.
+/// </summary>
+/// <param name="stats">The statistics to update.</param>
+/// <param name="sample">The sample to apply.</param>
+/// <returns>None</returns>
+VOID NetStatsApplySample(NetStats* stats, const NetStats* sample);
@@ -0,0 +1,115 @@
+#include <cstring>
+#include <cstddef>
+#include "pch.h"
+#include "occupancy.h"
+
+VOID OccupancyReset(OccupancyTracker* tracker)
+{
+	memset(tracker, 0, sizeof(*tracker));
+	tracker->ownerSlot = OCCUPANCY_EVENT_NO_SLOT;
+}
+
+/// <summary>
+/// Appends an event to the pending batch.
+/// </summary>
+/// <param name="tracker">The tracker holding the pending batch.</param>
+/// <param name="type">The type of event.</param>
+/// <param name="slot">The slot the event describes.</param>
+/// <param name="userId">The entrant the event describes.</param>
+/// <param name="teamIndex">The entrant's team after the event.</param>
+/// <param name="previousTeamIndex">The entrant's team before the event.</param>
+/// <returns>TRUE if the event was appended, FALSE if the batch is full.</returns>
+static BOOL OccupancyAppend(OccupancyTracker* tracker, OccupancyEventType type, UINT16 slot, const EchoVR::XPlatformId* userId, INT16 teamIndex, INT16 previousTeamIndex)
+{
+	if (tracker->eventCount >= OCCUPANCY_EVENTS_MAX_EVENTS)
+		return FALSE;
+	ERLobbyOccupancyEvent* event = &tracker->events[tracker->eventCount++];
+	event->userId = *userId;
+	event->type = type;
+	event->slot = slot;
+	event->teamIndex = teamIndex;
+	event->previousTeamIndex = previousTeamIndex;
+	return TRUE;
+}
+
+BOOL OccupancyUpdate(OccupancyTracker* tracker, EchoVR::Lobby* lobby)
+{
+	// Compare each slot against its last observed occupant. A slot's observed state is only updated once its events are
+	// appended, so changes which do not fit in the batch are observed again after it is flushed.
+	UINT64 slotCount = min(lobby->entrantData.count, (UINT64)OCCUPANCY_MAX_SLOTS);
+	for (UINT16 i = 0; i < OCCUPANCY_MAX_SLOTS; i++)
+	{
+		OccupancySlot* slot = &tracker->slots[i];
+		EchoVR::XPlatformId userId = {};
+		INT16 teamIndex = 0;
+		if (i < slotCount)
+		{
+			EchoVR::Lobby::EntrantData* entrantData = (lobby->entrantData.items + i);
+			if (entrantData->userId.accountId != 0)
+			{
+				userId = entrantData->userId;
+				teamIndex = (INT16)entrantData->teamIndex;
+			}
+		}
+
+		// If the slot's occupant changed, the previous occupant left (including those which disconnected without their
+		// player session being removed), and the new one joined.
+		BOOL occupied = slot->userId.accountId != 0;
+		if (slot->userId.accountId != userId.accountId || slot->userId.platformCode != userId.platformCode)
+		{
+			if (tracker->eventCount + (occupied ? 1 : 0) + (userId.accountId != 0 ? 1 : 0) > OCCUPANCY_EVENTS_MAX_EVENTS)
+				return TRUE;
+			if (occupied)
+				OccupancyAppend(tracker, OccupancyEventType::Leave, i, &slot->userId, slot->teamIndex, slot->teamIndex);
+			slot->userId = userId;
+			slot->teamIndex = teamIndex;
+			if (userId.accountId != 0)
+				OccupancyAppend(tracker, OccupancyEventType::Join, i, &userId, teamIndex, teamIndex);
+		}
+		else if (occupied && slot->teamIndex != teamIndex)
+		{
+			if (!OccupancyAppend(tracker, OccupancyEventType::TeamChange, i, &userId, teamIndex, slot->teamIndex))
+				return TRUE;
+			slot->teamIndex = teamIndex;
+		}
+	}
+
+	// Compare the lobby owner, after the slots so the event describes the owner's current occupant.
+	UINT16 ownerSlot = lobby->ownerSlot < slotCount ? (UINT16)lobby->ownerSlot : OCCUPANCY_EVENT_NO_SLOT;
+	if (ownerSlot != tracker->ownerSlot || lobby->ownerChanged != tracker->ownerChanged)
+	{
+		EchoVR::XPlatformId userId = {};
+		INT16 teamIndex = 0;
+		if (ownerSlot != OCCUPANCY_EVENT_NO_SLOT)
+		{
+			userId = tracker->slots[ownerSlot].userId;
+			teamIndex = tracker->slots[ownerSlot].teamIndex;
+		}
+		if (!OccupancyAppend(tracker, OccupancyEventType::OwnerChange, ownerSlot, &userId, teamIndex, teamIndex))
+			return TRUE;
+		tracker->ownerSlot = ownerSlot;
+		tracker->ownerChanged = lobby->ownerChanged;
+	}
+	return FALSE;
+}
+
+BOOL OccupancyFlushDue(OccupancyTracker* tracker, ULONGLONG now)
+{
+	if (tracker->eventCount == 0)
+		return FALSE;
+	return tracker->eventCount >= OCCUPANCY_EVENTS_MAX_EVENTS || now - tracker->lastFlushTime >= OCCUPANCY_FLUSH_INTERVAL_MS;
+}
+
+UINT64 OccupancyFlush(OccupancyTracker* tracker, ERLobbyOccupancyEvents* message, ULONGLONG now)
+{
+	// Move the pending events into the message.
+	memset(message, 0, offsetof(ERLobbyOccupancyEvents, events));
+	message->sequence = tracker->sequence++;
+	message->eventCount = (UINT16)tracker->eventCount;
+	memcpy(message->events, tracker->events, tracker->eventCount * sizeof(ERLobbyOccupancyEvent));
+
+	// Begin the next batch.
+	tracker->eventCount = 0;
+	tracker->lastFlushTime = now;
+	return offsetof(ERLobbyOccupancyEvents, events) + (message->eventCount * sizeof(ERLobbyOccupancyEvent));
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "pch.h"
+#include "echovr.h"
+#include "messages.h"
+
+/// <summary>
+/// The interval at which pending occupancy events are batched before they are sent to ServerDB, in milliseconds.
+/// </summary>
+const ULONGLONG OCCUPANCY_FLUSH_INTERVAL_MS = 100;
+
+/// <summary>
+/// The maximum amount of entrant slots tracked. Slots beyond this are ignored.
+/// </summary>
+const UINT32 OCCUPANCY_MAX_SLOTS = 32;
+
+/// <summary>
+/// The last observed occupant of an entrant slot.
+/// </summary>
+struct OccupancySlot
+{
+	EchoVR::XPlatformId userId; // zero if the slot is unoccupied
+	INT16 teamIndex;
+};
+
+/// <summary>
+/// Tracks the occupancy of the lobby's entrant slots (EntrantData) and its owner, by diffing them every tick, and batches
+/// the changes observed into events for ServerDB. This observes entrants which join, leave (including those which disconnect
+/// without the game removing their player session), change team, or take ownership of the lobby.
+/// </summary>
+struct OccupancyTracker
+{
+	OccupancySlot slots[OCCUPANCY_MAX_SLOTS];
+	UINT16 ownerSlot;
+	UINT32 ownerChanged;
+	ULONGLONG lastFlushTime;
+	UINT32 sequence; // the sequence of the next batch
+	UINT32 eventCount;
+	ERLobbyOccupancyEvent events[OCCUPANCY_EVENTS_MAX_EVENTS]; // events pending since the last flush
+};
+
+/// <summary>
+/// Resets an occupancy tracker, so every slot is unoccupied and the next batch is the first of the session. This should be
+/// called when a session starts.
+/// </summary>
+/// <param name="tracker">The tracker to reset.</param>
+/// <returns>None</returns>
+VOID OccupancyReset(OccupancyTracker* tracker);
+
+/// <summary>
+/// Compares the lobby's entrant slots and owner against those last observed, appending an event to the pending batch for
+/// each change. If the batch fills, the remaining changes are left unobserved, so they are recorded once it is flushed.
+/// </summary>
+/// <param name="tracker">The tracker to update.</param>
+/// <param name="lobby">The lobby to observe.</param>
+/// <returns>TRUE if the pending batch filled before every change was recorded, FALSE otherwise.</returns>
+BOOL OccupancyUpdate(OccupancyTracker* tracker, EchoVR::Lobby* lobby);
+
+/// <summary>
+/// Indicates whether the pending batch should be flushed: it holds events and either the batching interval has elapsed,
+/// or it is full.
+/// </summary>
+/// <param name="tracker">The tracker to check.</param>
+/// <param name="now">The current tick count.</param>
+/// <returns>TRUE if the batch should be flushed, FALSE otherwise.</returns>
+BOOL OccupancyFlushDue(OccupancyTracker* tracker, ULONGLONG now);
+
+/// <summary>
+/// Moves the pending events into a batch message, and begins the next batch. The trace context is left for the caller to populate.
+/// </summary>
+/// <param name="tracker">The tracker holding the pending events.</param>
+/// <param name="message">The batch message to populate.</param>
+/// <param name="now">The current tick count.</param>
+/// <returns>The size of the message to send, in bytes, covering only the events in use.</returns>
+UINT64 OccupancyFlush(OccupancyTracker* tracker, ERLobbyOccupancyEvents* message, ULONGLONG now);
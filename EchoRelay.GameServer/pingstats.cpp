@@ -0,0 +1,148 @@
+#include <cstring>
+#include <cstddef>
+#include "pch.h"
+#include "pingstats.h"
+
+/// <summary>
+/// Obtains the histogram bucket for a ping.
+/// </summary>
+/// <param name="ping">The ping, in milliseconds.</param>
+/// <returns>The index of the bucket.</returns>
+UINT32 PingStatsGetBucket(UINT16 ping)
+{
+	if (ping < 64)
+		return ping / 4;
+	if (ping >= 1024)
+		return PING_STATS_BUCKET_COUNT - 1;
+
+	// Find the power of two, then the eighth of it the ping lies within.
+	UINT32 exponent = 6;
+	while ((ping >> (exponent + 1)) != 0)
+		exponent++;
+	return 16 + ((exponent - 6) * 8) + ((ping >> (exponent - 3)) & 7);
+}
+
+/// <summary>
+/// Obtains the ping represented by a histogram bucket, which is the middle of the range it covers.
+/// </summary>
+/// <param name="bucket">The index of the bucket.</param>
+/// <returns>The ping, in milliseconds.</returns>
+UINT16 PingStatsGetBucketValue(UINT32 bucket)
+{
+	if (bucket < 16)
+		return (UINT16)((bucket * 4) + 2);
+	if (bucket >= PING_STATS_BUCKET_COUNT - 1)
+		return 1024;
+	UINT32 exponent = 6 + ((bucket - 16) / 8);
+	UINT32 width = 1 << (exponent - 3);
+	return (UINT16)(((8 + ((bucket - 16) % 8)) * width) + (width / 2));
+}
+
+/// <summary>
+/// Obtains a percentile from a ping histogram.
+/// </summary>
+/// <param name="histogram">The histogram to obtain the percentile from.</param>
+/// <param name="percentile">The percentile to obtain (0-100).</param>
+/// <returns>The ping at the given percentile in milliseconds, or zero if there are no samples.</returns>
+UINT16 PingStatsGetPercentile(const PingHistogram* histogram, UINT32 percentile)
+{
+	if (histogram->sampleCount == 0)
+		return 0;
+	UINT64 rank = (((UINT64)histogram->sampleCount * percentile) + 99) / 100;
+	UINT64 cumulative = 0;
+	for (UINT32 i = 0; i < PING_STATS_BUCKET_COUNT; i++)
+	{
+		cumulative += histogram->counts[i];
+		if (cumulative >= rank && cumulative != 0)
+			return PingStatsGetBucketValue(i);
+	}
+	return PingStatsGetBucketValue(PING_STATS_BUCKET_COUNT - 1);
+}
+
+/// <summary>
+/// Obtains the mean jitter from a ping histogram.
+/// </summary>
+/// <param name="histogram">The histogram to obtain the jitter from.</param>
+/// <returns>The mean difference between consecutive samples in milliseconds, or zero if there are none.</returns>
+UINT16 PingStatsGetJitter(const PingHistogram* histogram)
+{
+	if (histogram->jitterCount == 0)
+		return 0;
+	return (UINT16)min(histogram->jitterSum / histogram->jitterCount, (UINT64)0xFFFF);
+}
+
+/// <summary>
+/// Adds a ping sample to a histogram.
+/// </summary>
+/// <param name="histogram">The histogram to add the sample to.</param>
+/// <param name="ping">The ping sampled, in milliseconds.</param>
+/// <param name="lastPing">The previous ping sampled for the same entrant, or zero if there was none.</param>
+/// <returns>None</returns>
+VOID PingStatsAddSample(PingHistogram* histogram, UINT16 ping, UINT16 lastPing)
+{
+	histogram->counts[PingStatsGetBucket(ping)]++;
+	histogram->sampleCount++;
+	if (lastPing != 0)
+	{
+		histogram->jitterSum += ping > lastPing ? ping - lastPing : lastPing - ping;
+		histogram->jitterCount++;
+	}
+}
+
+VOID PingStatsReset(PingStats* stats)
+{
+	ULONGLONG lastSampleTime = stats->lastSampleTime;
+	memset(stats, 0, sizeof(*stats));
+	stats->lastSampleTime = lastSampleTime;
+}
+
+VOID PingStatsSample(PingStats* stats, EchoVR::Lobby* lobby, ULONGLONG now)
+{
+	// Rate limit sampling. The game updates pings far less often than we tick.
+	if (now - stats->lastSampleTime < PING_STATS_SAMPLE_INTERVAL_MS)
+		return;
+	stats->lastSampleTime = now;
+
+	for (UINT64 i = 0; i < lobby->entrantData.count && i < PING_SUMMARY_MAX_ENTRIES; i++)
+	{
+		EchoVR::Lobby::EntrantData* entrantData = (lobby->entrantData.items + i);
+		if (entrantData->userId.accountId == 0 || entrantData->ping == 0)
+			continue;
+
+		// If the slot was taken by another entrant, start over for them.
+		PingStatsEntrant* entrant = &stats->entrants[i];
+		if (entrant->userId.accountId != entrantData->userId.accountId || entrant->userId.platformCode != entrantData->userId.platformCode)
+		{
+			memset(entrant, 0, sizeof(*entrant));
+			entrant->userId = entrantData->userId;
+		}
+
+		PingStatsAddSample(&entrant->histogram, entrantData->ping, entrant->lastPing);
+		PingStatsAddSample(&stats->session, entrantData->ping, entrant->lastPing);
+		entrant->lastPing = entrantData->ping;
+	}
+}
+
+UINT64 PingStatsSummarize(PingStats* stats, ERLobbyPingSummary* summary)
+{
+	memset(summary, 0, sizeof(*summary));
+	summary->sampleCount = stats->session.sampleCount;
+	summary->rttP50 = PingStatsGetPercentile(&stats->session, 50);
+	summary->rttP95 = PingStatsGetPercentile(&stats->session, 95);
+	summary->jitter = PingStatsGetJitter(&stats->session);
+
+	for (UINT32 i = 0; i < PING_SUMMARY_MAX_ENTRIES; i++)
+	{
+		PingStatsEntrant* entrant = &stats->entrants[i];
+		if (entrant->histogram.sampleCount == 0)
+			continue;
+
+		ERLobbyPingSummaryEntry* entry = &summary->entries[summary->entryCount++];
+		entry->userId = entrant->userId;
+		entry->sampleCount = entrant->histogram.sampleCount;
+		entry->rttP50 = PingStatsGetPercentile(&entrant->histogram, 50);
+		entry->rttP95 = PingStatsGetPercentile(&entrant->histogram, 95);
+		entry->jitter = PingStatsGetJitter(&entrant->histogram);
+	}
+	return offsetof(ERLobbyPingSummary, entries) + (summary->entryCount * sizeof(ERLobbyPingSummaryEntry));
+}
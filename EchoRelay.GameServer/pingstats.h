@@ -0,0 +1,80 @@
+#pragma once
+
+#include "pch.h"
+#include "echovr.h"
+#include "messages.h"
+
+/// <summary>
+/// The interval at which entrant pings are sampled, in milliseconds.
+/// </summary>
+const ULONGLONG PING_STATS_SAMPLE_INTERVAL_MS = 1000;
+
+/// <summary>
+/// The interval at which ping summaries are sent to ServerDB while a session is active, in milliseconds.
+/// </summary>
+const ULONGLONG PING_STATS_REPORT_INTERVAL_MS = 15000;
+
+/// <summary>
+/// The amount of buckets in a ping histogram. Pings below 64ms are bucketed every 4ms, and pings up to 1024ms
+/// into eight buckets per power of two (within 12.5%). Larger pings share the last bucket.
+/// </summary>
+const UINT32 PING_STATS_BUCKET_COUNT = 49;
+
+/// <summary>
+/// A histogram of ping samples.
+/// </summary>
+struct PingHistogram
+{
+	UINT32 counts[PING_STATS_BUCKET_COUNT];
+	UINT32 sampleCount;
+	UINT64 jitterSum; // sum of the differences between consecutive samples of each entrant, milliseconds
+	UINT32 jitterCount;
+};
+
+/// <summary>
+/// The ping samples of an entrant slot. These are retained after the entrant leaves, until the slot is taken by another
+/// entrant or the session ends, so the entrant is still described by the summary at the end of the session.
+/// </summary>
+struct PingStatsEntrant
+{
+	EchoVR::XPlatformId userId; // zero if the slot has not been occupied this session
+	PingHistogram histogram;
+	UINT16 lastPing; // zero if no sample has been taken
+};
+
+/// <summary>
+/// Samples the pings the game maintains for each entrant in the lobby (EntrantData::ping), into per-entrant and
+/// per-session histograms, which are summarized for ServerDB.
+/// </summary>
+struct PingStats
+{
+	ULONGLONG lastSampleTime;
+	ULONGLONG lastReportTime;
+	PingHistogram session;
+	PingStatsEntrant entrants[PING_SUMMARY_MAX_ENTRIES];
+};
+
+/// <summary>
+/// Resets ping statistics, discarding all samples. This should be called when a session starts.
+/// </summary>
+/// <param name="stats">The statistics to reset.</param>
+/// <returns>None</returns>
+VOID PingStatsReset(PingStats* stats);
+
+/// <summary>
+/// Samples the ping of each entrant in the lobby, if the sample interval has elapsed. Entrants which have not reported
+/// a ping yet are skipped.
+/// </summary>
+/// <param name="stats">The statistics to sample into.</param>
+/// <param name="lobby">The lobby to sample entrants from.</param>
+/// <param name="now">The current tick count.</param>
+/// <returns>None</returns>
+VOID PingStatsSample(PingStats* stats, EchoVR::Lobby* lobby, ULONGLONG now);
+
+/// <summary>
+/// Summarizes the samples taken this session. The trace context is left for the caller to populate.
+/// </summary>
+/// <param name="stats">The statistics to summarize.</param>
+/// <param name="summary">The summary to populate.</param>
+/// <returns>The size of the summary to send, in bytes, covering only the entries in use.</returns>
+UINT64 PingStatsSummarize(PingStats* stats, ERLobbyPingSummary* summary);
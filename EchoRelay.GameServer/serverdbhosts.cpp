@@ -0,0 +1,237 @@
+#include <cstdlib>
+#include <cstring>
+#include "pch.h"
+#include <ws2tcpip.h>
+#include "serverdbhosts.h"
+
+/// <summary>
+/// The weight given to each new response latency observed for a host, out of 4.
+/// </summary>
+const UINT32 SERVERDB_RESPONSE_LATENCY_WEIGHT = 1;
+
+/// <summary>
+/// Parses the host name and port from a URI (scheme://host[:port][/path]), falling back to the scheme's default port.
+/// </summary>
+/// <param name="uri">The URI to parse.</param>
+/// <param name="hostName">The buffer to copy the host name into.</param>
+/// <param name="hostNameSize">The size of the host name buffer.</param>
+/// <param name="port">The parsed port, as a string.</param>
+/// <param name="portSize">The size of the port buffer.</param>
+/// <returns>TRUE if the URI was parsed, FALSE otherwise.</returns>
+BOOL ServerDbHostParseAuthority(const CHAR* uri, CHAR* hostName, size_t hostNameSize, CHAR* port, size_t portSize)
+{
+	const CHAR* authority = strstr(uri, "://");
+	if (authority == NULL)
+		return FALSE;
+	BOOL secure = strncmp(uri, "wss", 3) == 0 || strncmp(uri, "https", 5) == 0;
+	authority += 3;
+	size_t authorityLength = strcspn(authority, "/");
+	const CHAR* portSeparator = (const CHAR*)memchr(authority, ':', authorityLength);
+	size_t hostNameLength = portSeparator != NULL ? (size_t)(portSeparator - authority) : authorityLength;
+	if (hostNameLength == 0 || hostNameLength >= hostNameSize)
+		return FALSE;
+	memcpy(hostName, authority, hostNameLength);
+	hostName[hostNameLength] = '\0';
+	if (portSeparator != NULL)
+		sprintf_s(port, portSize, "%.*s", (INT32)(authority + authorityLength - portSeparator - 1), portSeparator + 1);
+	else
+		strcpy_s(port, portSize, secure ? "443" : "80");
+	return TRUE;
+}
+
+VOID ServerDbHostsInitialize(ServerDbHosts* hosts, const CHAR* uris, UINT32 probeTimeoutMs, UINT32 failoverMs)
+{
+	memset(hosts, 0, sizeof(*hosts));
+	hosts->probeTimeoutMs = probeTimeoutMs != 0 ? probeTimeoutMs : SERVERDB_DEFAULT_PROBE_TIMEOUT_MS;
+	hosts->failoverMs = failoverMs != 0 ? failoverMs : SERVERDB_DEFAULT_FAILOVER_MS;
+	hosts->current = -1;
+
+	// Split the list, trimming whitespace around each entry.
+	const CHAR* cursor = uris;
+	while (*cursor != '\0' && hosts->count < SERVERDB_MAX_HOSTS)
+	{
+		while (*cursor == ' ' || *cursor == '\t')
+			cursor++;
+		size_t length = strcspn(cursor, ",");
+		size_t trimmedLength = length;
+		while (trimmedLength > 0 && (cursor[trimmedLength - 1] == ' ' || cursor[trimmedLength - 1] == '\t'))
+			trimmedLength--;
+		if (trimmedLength > 0 && trimmedLength < SERVERDB_MAX_URI_LENGTH)
+		{
+			ServerDbHost* host = &hosts->hosts[hosts->count++];
+			memcpy(host->uri, cursor, trimmedLength);
+			host->uri[trimmedLength] = '\0';
+			host->connectLatencyMs = SERVERDB_LATENCY_UNREACHABLE;
+			host->responseLatencyMs = SERVERDB_LATENCY_UNREACHABLE;
+		}
+		cursor += length;
+		if (*cursor == ',')
+			cursor++;
+	}
+}
+
+VOID ServerDbHostsProbe(ServerDbHosts* hosts)
+{
+	// Begin a non-blocking connection to each host.
+	SOCKET sockets[SERVERDB_MAX_HOSTS];
+	for (UINT32 i = 0; i < hosts->count; i++)
+	{
+		sockets[i] = INVALID_SOCKET;
+		hosts->hosts[i].connectLatencyMs = SERVERDB_LATENCY_UNREACHABLE;
+
+		CHAR hostName[SERVERDB_MAX_URI_LENGTH];
+		CHAR port[16];
+		addrinfo hints;
+		addrinfo* addresses = NULL;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_protocol = IPPROTO_TCP;
+		if (!ServerDbHostParseAuthority(hosts->hosts[i].uri, hostName, sizeof(hostName), port, sizeof(port)) ||
+			getaddrinfo(hostName, port, &hints, &addresses) != 0 || addresses == NULL)
+			continue;
+
+		SOCKET probe = socket(addresses->ai_family, addresses->ai_socktype, addresses->ai_protocol);
+		u_long nonBlocking = 1;
+		if (probe != INVALID_SOCKET && ioctlsocket(probe, FIONBIO, &nonBlocking) == 0 &&
+			(connect(probe, addresses->ai_addr, (INT32)addresses->ai_addrlen) == 0 || WSAGetLastError() == WSAEWOULDBLOCK))
+		{
+			sockets[i] = probe;
+		}
+		else if (probe != INVALID_SOCKET)
+		{
+			closesocket(probe);
+		}
+		freeaddrinfo(addresses);
+	}
+
+	// Wait for the connections to complete, recording the time each took.
+	LARGE_INTEGER frequency, start, now;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&start);
+	while (TRUE)
+	{
+		fd_set connected, failed;
+		FD_ZERO(&connected);
+		FD_ZERO(&failed);
+		UINT32 pending = 0;
+		for (UINT32 i = 0; i < hosts->count; i++)
+		{
+			if (sockets[i] == INVALID_SOCKET)
+				continue;
+			FD_SET(sockets[i], &connected);
+			FD_SET(sockets[i], &failed);
+			pending++;
+		}
+		QueryPerformanceCounter(&now);
+		LONGLONG elapsedMs = (now.QuadPart - start.QuadPart) * 1000 / frequency.QuadPart;
+		if (pending == 0 || elapsedMs >= hosts->probeTimeoutMs)
+			break;
+
+		timeval timeout;
+		timeout.tv_sec = (LONG)((hosts->probeTimeoutMs - elapsedMs) / 1000);
+		timeout.tv_usec = (LONG)(((hosts->probeTimeoutMs - elapsedMs) % 1000) * 1000);
+		if (select(0, NULL, &connected, &failed, &timeout) == SOCKET_ERROR)
+			break;
+		QueryPerformanceCounter(&now);
+		for (UINT32 i = 0; i < hosts->count; i++)
+		{
+			if (sockets[i] == INVALID_SOCKET)
+				continue;
+			if (FD_ISSET(sockets[i], &connected))
+				hosts->hosts[i].connectLatencyMs = (UINT32)((now.QuadPart - start.QuadPart) * 1000 / frequency.QuadPart);
+			else if (!FD_ISSET(sockets[i], &failed))
+				continue;
+			closesocket(sockets[i]);
+			sockets[i] = INVALID_SOCKET;
+		}
+	}
+
+	// Any connections still pending did not complete in time.
+	for (UINT32 i = 0; i < hosts->count; i++)
+	{
+		if (sockets[i] != INVALID_SOCKET)
+			closesocket(sockets[i]);
+	}
+}
+
+INT32 ServerDbHostsSelect(ServerDbHosts* hosts, ULONGLONG now)
+{
+	// Select the healthy host with the lowest latency. Unreachable hosts are still candidates, after reachable ones,
+	// as they may have become reachable since they were probed.
+	INT32 selected = -1;
+	UINT32 selectedLatency = 0;
+	for (UINT32 i = 0; i < hosts->count; i++)
+	{
+		ServerDbHost* host = &hosts->hosts[i];
+		if (host->unhealthyUntil > now)
+			continue;
+		UINT32 latency = host->responseLatencyMs != SERVERDB_LATENCY_UNREACHABLE ? host->responseLatencyMs : host->connectLatencyMs;
+		if (selected < 0 || latency < selectedLatency)
+		{
+			selected = (INT32)i;
+			selectedLatency = latency;
+		}
+	}
+
+	// If every host is unhealthy, select the one which has been passed over for the longest.
+	if (selected < 0 && hosts->count > 0)
+	{
+		selected = 0;
+		for (UINT32 i = 1; i < hosts->count; i++)
+		{
+			if (hosts->hosts[i].unhealthyUntil < hosts->hosts[selected].unhealthyUntil)
+				selected = (INT32)i;
+		}
+	}
+	hosts->current = selected;
+	return selected;
+}
+
+VOID ServerDbHostsConnecting(ServerDbHosts* hosts, ULONGLONG now)
+{
+	hosts->connectTime = now;
+	hosts->lastConnectedTime = 0;
+	hosts->registrationRequestTime = now;
+}
+
+VOID ServerDbHostsResponded(ServerDbHosts* hosts, ULONGLONG now)
+{
+	if (hosts->current < 0 || hosts->registrationRequestTime == 0)
+		return;
+
+	// Smooth the response latency, so a single slow response does not cause a host to be passed over.
+	ServerDbHost* host = &hosts->hosts[hosts->current];
+	UINT32 latency = (UINT32)(now - hosts->registrationRequestTime);
+	if (host->responseLatencyMs == SERVERDB_LATENCY_UNREACHABLE)
+		host->responseLatencyMs = latency;
+	else
+		host->responseLatencyMs = (host->responseLatencyMs * (4 - SERVERDB_RESPONSE_LATENCY_WEIGHT) + latency * SERVERDB_RESPONSE_LATENCY_WEIGHT) / 4;
+	hosts->registrationRequestTime = 0;
+}
+
+BOOL ServerDbHostsShouldFailOver(ServerDbHosts* hosts, BOOL connected, ULONGLONG now)
+{
+	if (hosts->current < 0)
+		return FALSE;
+	if (connected)
+	{
+		hosts->lastConnectedTime = now;
+		return FALSE;
+	}
+
+	// Fail over once we have gone without a connection for too long.
+	ULONGLONG since = hosts->lastConnectedTime != 0 ? hosts->lastConnectedTime : hosts->connectTime;
+	if (now - since < hosts->failoverMs)
+		return FALSE;
+
+	// Pass over the host for a while. A host which never responded to registration is also considered unreachable.
+	ServerDbHost* host = &hosts->hosts[hosts->current];
+	host->failures++;
+	host->unhealthyUntil = now + SERVERDB_HOST_RETRY_MS;
+	if (hosts->registrationRequestTime != 0)
+		host->responseLatencyMs = SERVERDB_LATENCY_UNREACHABLE;
+	hosts->failovers++;
+	hosts->current = -1;
+	return TRUE;
+}
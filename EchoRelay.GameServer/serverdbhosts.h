@@ -0,0 +1,121 @@
+#pragma once
+
+#include "pch.h"
+
+/// <summary>
+/// The maximum amount of ServerDB hosts which can be configured. Hosts beyond this are ignored.
+/// </summary>
+const UINT32 SERVERDB_MAX_HOSTS = 8;
+
+/// <summary>
+/// The maximum length of a ServerDB host URI, including the null terminator. Longer URIs are ignored.
+/// </summary>
+const UINT32 SERVERDB_MAX_URI_LENGTH = 256;
+
+/// <summary>
+/// The default amount of time to wait for ServerDB hosts to accept a connection when probing them, in milliseconds.
+/// </summary>
+const UINT32 SERVERDB_DEFAULT_PROBE_TIMEOUT_MS = 1000;
+
+/// <summary>
+/// The default amount of time the ServerDB connection may remain disconnected before failing over to another host, in milliseconds.
+/// </summary>
+const UINT32 SERVERDB_DEFAULT_FAILOVER_MS = 5000;
+
+/// <summary>
+/// The amount of time a host is passed over for after it has been failed over from, in milliseconds.
+/// </summary>
+const ULONGLONG SERVERDB_HOST_RETRY_MS = 60000;
+
+/// <summary>
+/// A latency which indicates a host did not respond.
+/// </summary>
+const UINT32 SERVERDB_LATENCY_UNREACHABLE = 0xFFFFFFFF;
+
+/// <summary>
+/// A ServerDB host which the game server may register with.
+/// </summary>
+struct ServerDbHost
+{
+	CHAR uri[SERVERDB_MAX_URI_LENGTH];
+	UINT32 connectLatencyMs; // time taken to accept a connection when probed, or SERVERDB_LATENCY_UNREACHABLE
+	UINT32 responseLatencyMs; // time taken to respond to our last registration request, or SERVERDB_LATENCY_UNREACHABLE
+	ULONGLONG unhealthyUntil; // tick count the host is passed over until, after being failed over from
+	UINT32 failures; // the amount of times the host has been failed over from
+};
+
+/// <summary>
+/// The ServerDB hosts which the game server may register with, and the state of the connection to the selected host.
+/// Times are tick counts (milliseconds) provided by the caller, so selection and failover can be driven by a host.
+/// </summary>
+struct ServerDbHosts
+{
+	// Configuration
+	UINT32 count;
+	ServerDbHost hosts[SERVERDB_MAX_HOSTS];
+	UINT32 probeTimeoutMs;
+	UINT32 failoverMs;
+
+	// Connection to the selected host.
+	INT32 current; // index of the selected host, or -1 if none is selected
+	ULONGLONG connectTime; // tick count the connection to the selected host was created
+	ULONGLONG lastConnectedTime; // tick count the connection was last seen connected, or zero if it has not been
+	ULONGLONG registrationRequestTime; // tick count the last registration request was sent, or zero if it was answered
+	UINT32 failovers;
+};
+
+/// <summary>
+/// Initializes the ServerDB host list from a comma-separated list of URIs. Empty and overlong entries are skipped.
+/// </summary>
+/// <param name="hosts">The host list to initialize.</param>
+/// <param name="uris">The comma-separated list of host URIs.</param>
+/// <param name="probeTimeoutMs">The amount of time to wait for hosts to accept a connection when probing them, in milliseconds.</param>
+/// <param name="failoverMs">The amount of time the connection may remain disconnected before failing over, in milliseconds.</param>
+/// <returns>None</returns>
+VOID ServerDbHostsInitialize(ServerDbHosts* hosts, const CHAR* uris, UINT32 probeTimeoutMs, UINT32 failoverMs);
+
+/// <summary>
+/// Probes each host by opening a TCP connection to it, recording the time each took to accept. Connections are made
+/// concurrently, so once host names are resolved this blocks for at most the probe timeout. Hosts which do not accept
+/// within it are marked unreachable. Name resolution is not bounded, so this should not be called from the game thread.
+/// </summary>
+/// <param name="hosts">The host list to probe.</param>
+/// <returns>None</returns>
+VOID ServerDbHostsProbe(ServerDbHosts* hosts);
+
+/// <summary>
+/// Selects the host to register with: the healthy host with the lowest latency, preferring the response latency of our
+/// registration requests where one was observed, over the connect latency from probing. If every host is unhealthy, the
+/// one which has been passed over for the longest is selected. The selected host is not connected to.
+/// </summary>
+/// <param name="hosts">The host list to select from.</param>
+/// <param name="now">The current tick count.</param>
+/// <returns>The index of the selected host, or -1 if there are no hosts.</returns>
+INT32 ServerDbHostsSelect(ServerDbHosts* hosts, ULONGLONG now);
+
+/// <summary>
+/// Records that a connection to the selected host was created, and a registration request sent over it.
+/// </summary>
+/// <param name="hosts">The host list.</param>
+/// <param name="now">The current tick count.</param>
+/// <returns>None</returns>
+VOID ServerDbHostsConnecting(ServerDbHosts* hosts, ULONGLONG now);
+
+/// <summary>
+/// Records the selected host's response to our registration request, updating its response latency.
+/// </summary>
+/// <param name="hosts">The host list.</param>
+/// <param name="now">The current tick count.</param>
+/// <returns>None</returns>
+VOID ServerDbHostsResponded(ServerDbHosts* hosts, ULONGLONG now);
+
+/// <summary>
+/// Tracks the state of the connection to the selected host, deciding whether it should be failed over from. A failover is
+/// due once the connection has not been seen connected for the failover time, whether it dropped or never connected.
+/// If so, the host is passed over for a while, and another should be selected.
+/// </summary>
+/// <param name="hosts">The host list.</param>
+/// <param name="connected">Indicates whether the connection to the selected host is currently connected.</param>
+/// <param name="now">The current tick count.</param>
+/// <returns>TRUE if the selected host should be failed over from, FALSE otherwise.</returns>
+BOOL ServerDbHostsShouldFailOver(ServerDbHosts* hosts, BOOL connected, ULONGLONG now);
@@ -0,0 +1,266 @@
+#include <cstdio>
+#include "pch.h"
+#include "sessiontrace.h"
+#include "startuptrace.h"
+
+/// <summary>
+/// The display names of each session phase, indexed by <see cref="SessionTracePhase"/>.
+/// </summary>
+static const CHAR* SESSION_TRACE_PHASE_NAMES[(UINT32)SessionTracePhase::Count] = { "session", "start_session", "open_for_players", "locked" };
+
+BOOL SessionTraceShouldSample(const GUID* traceId, UINT32 sampleRate)
+{
+	// Mix the first half of the identifier (splitmix64 finalizer), so any non-random bits don't bias sampling.
+	UINT64 value;
+	memcpy(&value, traceId, sizeof(value));
+	value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+	value = value ^ (value >> 31);
+	return (value % SESSION_TRACE_SAMPLE_SCALE) < sampleRate;
+}
+
+/// <summary>
+/// Converts a timestamp to wall-clock time.
+/// </summary>
+/// <param name="trace">The trace the timestamp was recorded for.</param>
+/// <param name="counter">The QueryPerformanceCounter timestamp to convert.</param>
+/// <returns>The time, in microseconds since the Unix epoch.</returns>
+static INT64 SessionTraceToUnixMicroseconds(const SessionTrace* trace, INT64 counter)
+{
+	INT64 delta = counter - trace->baseCounter;
+	return trace->baseUnixMicroseconds + (delta / trace->frequency) * 1000000 + ((delta % trace->frequency) * 1000000) / trace->frequency;
+}
+
+/// <summary>
+/// Opens the next session trace file, deleting the oldest file if we have exceeded our retention limit.
+/// </summary>
+/// <param name="trace">The trace to open the file for.</param>
+/// <returns>None</returns>
+static VOID SessionTraceOpenFile(SessionTrace* trace)
+{
+	CHAR path[MAX_PATH];
+	if (trace->fileIndex >= SESSION_TRACE_MAX_FILES)
+	{
+		sprintf_s(path, TRACE_DIRECTORY "\\session.%u.%u.json", trace->processId, trace->fileIndex - SESSION_TRACE_MAX_FILES);
+		DeleteFileA(path);
+	}
+
+	// Each file is a standalone JSON array trace. The closing bracket is never written, as both chrome://tracing and
+	// Perfetto accept a truncated array, which allows the file to be read (or survive a crash) while it is being written.
+	CreateDirectoryA("_local", NULL);
+	CreateDirectoryA(TRACE_DIRECTORY, NULL);
+	sprintf_s(path, TRACE_DIRECTORY "\\session.%u.%u.json", trace->processId, trace->fileIndex);
+	trace->fileSize = 0;
+	if (fopen_s(&trace->file, path, "w") != 0 || trace->file == NULL)
+	{
+		trace->file = NULL;
+		return;
+	}
+	int written = fprintf(trace->file, "[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"echovr.exe (game server)\"}},\n", trace->processId);
+	trace->fileSize += written > 0 ? written : 0;
+}
+
+/// <summary>
+/// Writes a span for the current session to the trace file, rotating the file if it has grown too large.
+/// </summary>
+/// <param name="trace">The trace to write to.</param>
+/// <param name="name">The name of the span.</param>
+/// <param name="span">The span to write.</param>
+/// <param name="parentSpanId">The identifier of the span's parent, or zero if it has none.</param>
+/// <param name="end">The timestamp at which the span ended.</param>
+/// <param name="completed">Indicates whether the span ended normally, rather than being cut short.</param>
+/// <param name="async">Indicates whether the span may overlap its siblings, and should be written as an async span.</param>
+/// <returns>None</returns>
+static VOID SessionTraceWriteSpan(SessionTrace* trace, const CHAR* name, const SessionTraceSpan* span, UINT64 parentSpanId, INT64 end, BOOL completed, BOOL async)
+{
+	if (trace->file == NULL)
+		return;
+
+	// Format our trace identifier the same way ServerDB does, so spans can be matched by it.
+	CHAR traceId[40];
+	const GUID* id = &trace->traceId;
+	sprintf_s(traceId, "%08lx-%04hx-%04hx-%02x%02x-%02x%02x%02x%02x%02x%02x", id->Data1, id->Data2, id->Data3,
+		id->Data4[0], id->Data4[1], id->Data4[2], id->Data4[3], id->Data4[4], id->Data4[5], id->Data4[6], id->Data4[7]);
+
+	INT64 begin = SessionTraceToUnixMicroseconds(trace, span->begin);
+	INT64 duration = SessionTraceToUnixMicroseconds(trace, end) - begin;
+	int written;
+	if (async)
+	{
+		written = fprintf(trace->file,
+			"{\"name\":\"%s\",\"cat\":\"gameserver\",\"ph\":\"b\",\"id\":\"0x%llx\",\"ts\":%lld,\"pid\":%u,\"tid\":%u,\"args\":{\"trace_id\":\"%s\",\"span_id\":%llu,\"parent_span_id\":%llu}},\n"
+			"{\"name\":\"%s\",\"cat\":\"gameserver\",\"ph\":\"e\",\"id\":\"0x%llx\",\"ts\":%lld,\"pid\":%u,\"tid\":%u,\"args\":{\"completed\":%s}},\n",
+			name, span->spanId, begin, trace->processId, GetCurrentThreadId(), traceId, span->spanId, parentSpanId,
+			name, span->spanId, begin + duration, trace->processId, GetCurrentThreadId(), completed ? "true" : "false");
+	}
+	else
+	{
+		written = fprintf(trace->file,
+			"{\"name\":\"%s\",\"cat\":\"gameserver\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%lld,\"pid\":%u,\"tid\":%u,\"args\":{\"trace_id\":\"%s\",\"span_id\":%llu,\"parent_span_id\":%llu,\"completed\":%s}},\n",
+			name, begin, duration, trace->processId, GetCurrentThreadId(), traceId, span->spanId, parentSpanId, completed ? "true" : "false");
+	}
+	fflush(trace->file);
+
+	// Rotate the file if it has grown too large.
+	trace->fileSize += written > 0 ? written : 0;
+	if (trace->fileSize >= SESSION_TRACE_MAX_FILE_SIZE)
+	{
+		fclose(trace->file);
+		trace->file = NULL;
+		trace->fileIndex++;
+		SessionTraceOpenFile(trace);
+	}
+}
+
+/// <summary>
+/// Begins a span for the current session, if it is being traced.
+/// </summary>
+/// <param name="trace">The trace to record in.</param>
+/// <param name="span">The span to begin.</param>
+/// <returns>None</returns>
+static VOID SessionTraceBeginSpan(SessionTrace* trace, SessionTraceSpan* span)
+{
+	if (!trace->sampled)
+		return;
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	span->spanId = trace->nextSpanId++;
+	span->begin = now.QuadPart;
+}
+
+/// <summary>
+/// Ends a session phase span if it is open, writing it to the trace file.
+/// </summary>
+/// <param name="trace">The trace to record in.</param>
+/// <param name="phase">The phase to end.</param>
+/// <param name="completed">Indicates whether the phase ended normally, rather than being cut short.</param>
+/// <returns>None</returns>
+static VOID SessionTraceEndPhase(SessionTrace* trace, SessionTracePhase phase, BOOL completed)
+{
+	SessionTraceSpan* span = &trace->phases[(UINT32)phase];
+	if (span->spanId == 0)
+		return;
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	UINT64 parentSpanId = phase == SessionTracePhase::Session ? 0 : trace->phases[(UINT32)SessionTracePhase::Session].spanId;
+	SessionTraceWriteSpan(trace, SESSION_TRACE_PHASE_NAMES[(UINT32)phase], span, parentSpanId, now.QuadPart, completed, FALSE);
+	span->spanId = 0;
+}
+
+/// <summary>
+/// Ends all open spans for the current session, writing joins which were never accepted as incomplete.
+/// </summary>
+/// <param name="trace">The trace to record in.</param>
+/// <param name="completed">Indicates whether the session ended normally, rather than being cut short.</param>
+/// <returns>None</returns>
+static VOID SessionTraceEndAll(SessionTrace* trace, BOOL completed)
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	for (UINT32 i = 0; i < trace->pendingJoinCount; i++)
+	{
+		const SessionTraceSpan* join = &trace->pendingJoins[(trace->pendingJoinHead + i) % SESSION_TRACE_MAX_PENDING_JOINS];
+		SessionTraceWriteSpan(trace, "join", join, trace->phases[(UINT32)SessionTracePhase::Session].spanId, now.QuadPart, FALSE, TRUE);
+	}
+	trace->pendingJoinHead = 0;
+	trace->pendingJoinCount = 0;
+
+	// End the child phases before the session, so they are written in order.
+	for (UINT32 i = (UINT32)SessionTracePhase::Count - 1; i < (UINT32)SessionTracePhase::Count; i--)
+		SessionTraceEndPhase(trace, (SessionTracePhase)i, completed);
+	trace->sampled = FALSE;
+}
+
+VOID SessionTraceInitialize(SessionTrace* trace, DOUBLE sampleRate)
+{
+	// Clamp our sample rate.
+	sampleRate = sampleRate < 0.0 ? 0.0 : (sampleRate > 1.0 ? 1.0 : sampleRate);
+	trace->sampleRate = (UINT32)(sampleRate * SESSION_TRACE_SAMPLE_SCALE + 0.5);
+	trace->processId = GetCurrentProcessId();
+	trace->nextSpanId = 1;
+
+	// Capture a pair of high resolution and wall-clock times, so we can cheaply convert timestamps to wall-clock time.
+	LARGE_INTEGER frequency, counter;
+	FILETIME currentTime;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+	GetSystemTimePreciseAsFileTime(&currentTime);
+	trace->frequency = frequency.QuadPart;
+	trace->baseCounter = counter.QuadPart;
+	trace->baseUnixMicroseconds = (INT64)((((ULONGLONG)currentTime.dwHighDateTime << 32) | currentTime.dwLowDateTime) - 116444736000000000ULL) / 10;
+}
+
+VOID SessionTraceClose(SessionTrace* trace)
+{
+	SessionTraceEndAll(trace, FALSE);
+	if (trace->file != NULL)
+	{
+		fclose(trace->file);
+		trace->file = NULL;
+	}
+}
+
+VOID SessionTraceStartSession(SessionTrace* trace, const GUID* traceId)
+{
+	// End any session which never ended, then determine if we're tracing this one.
+	SessionTraceEndAll(trace, FALSE);
+	trace->traceId = *traceId;
+	trace->sampled = trace->sampleRate != 0 && SessionTraceShouldSample(traceId, trace->sampleRate);
+	if (!trace->sampled)
+		return;
+
+	// Open our trace file if this is the first sampled session.
+	if (trace->file == NULL)
+		SessionTraceOpenFile(trace);
+
+	SessionTraceBeginSpan(trace, &trace->phases[(UINT32)SessionTracePhase::Session]);
+	SessionTraceBeginSpan(trace, &trace->phases[(UINT32)SessionTracePhase::StartSession]);
+}
+
+VOID SessionTraceEndSession(SessionTrace* trace)
+{
+	SessionTraceEndAll(trace, TRUE);
+}
+
+VOID SessionTraceTransition(SessionTrace* trace, SessionTracePhase from, SessionTracePhase to)
+{
+	SessionTraceEndPhase(trace, from, TRUE);
+	if (trace->phases[(UINT32)to].spanId == 0)
+		SessionTraceBeginSpan(trace, &trace->phases[(UINT32)to]);
+}
+
+VOID SessionTraceJoinRequested(SessionTrace* trace)
+{
+	// If our queue is full, the oldest join was likely never accepted, so we drop it.
+	if (!trace->sampled)
+		return;
+	if (trace->pendingJoinCount == SESSION_TRACE_MAX_PENDING_JOINS)
+	{
+		trace->pendingJoinHead = (trace->pendingJoinHead + 1) % SESSION_TRACE_MAX_PENDING_JOINS;
+		trace->pendingJoinCount--;
+	}
+	SessionTraceBeginSpan(trace, &trace->pendingJoins[(trace->pendingJoinHead + trace->pendingJoinCount) % SESSION_TRACE_MAX_PENDING_JOINS]);
+	trace->pendingJoinCount++;
+}
+
+VOID SessionTraceJoinsAccepted(SessionTrace* trace, UINT64 count)
+{
+	// Accepted players carry no reference to the join which matched them, so joins are paired in the order they arrived.
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	for (UINT64 i = 0; i < count && trace->pendingJoinCount > 0; i++)
+	{
+		const SessionTraceSpan* join = &trace->pendingJoins[trace->pendingJoinHead];
+		SessionTraceWriteSpan(trace, "join", join, trace->phases[(UINT32)SessionTracePhase::Session].spanId, now.QuadPart, TRUE, TRUE);
+		trace->pendingJoinHead = (trace->pendingJoinHead + 1) % SESSION_TRACE_MAX_PENDING_JOINS;
+		trace->pendingJoinCount--;
+	}
+}
+
+VOID SessionTraceGetContext(const SessionTrace* trace, SessionTracePhase phase, ERTraceContext* context)
+{
+	memset(context, 0, sizeof(*context));
+	context->traceId = trace->traceId;
+	context->spanId = trace->phases[(UINT32)phase].spanId;
+	context->flags = trace->sampled ? TRACE_CONTEXT_FLAG_SAMPLED : 0;
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <cstdio>
+#include "pch.h"
+#include "echovr.h"
+#include "messages.h"
+
+/// <summary>
+/// The resolution of the session trace sample rate. A sample rate of 1.0 corresponds to this value.
+/// </summary>
+const UINT32 SESSION_TRACE_SAMPLE_SCALE = 10000;
+
+/// <summary>
+/// The size after which a session trace file is rotated, in bytes.
+/// </summary>
+const UINT64 SESSION_TRACE_MAX_FILE_SIZE = 16 * 1024 * 1024;
+
+/// <summary>
+/// The amount of session trace files retained for a process. Older files are deleted when rotating.
+/// </summary>
+const UINT32 SESSION_TRACE_MAX_FILES = 4;
+
+/// <summary>
+/// The maximum amount of joins awaiting player acceptance which are tracked at once.
+/// </summary>
+const UINT32 SESSION_TRACE_MAX_PENDING_JOINS = 64;
+
+/// <summary>
+/// The phases of a session tracked by a session trace. Each phase is a span, nested within the session span.
+/// </summary>
+enum class SessionTracePhase : UINT32
+{
+	Session = 0, // StartSession received -> EndSession
+	StartSession = 1, // StartSession received -> session starting
+	OpenForPlayers = 2, // session starting or unlocked -> LockPlayerSessions
+	Locked = 3, // LockPlayerSessions -> UnlockPlayerSessions or EndSession
+	Count = 4,
+};
+
+/// <summary>
+/// A span which is currently open in a session trace.
+/// </summary>
+struct SessionTraceSpan
+{
+	UINT64 spanId; // zero if the span is not open
+	INT64 begin; // QueryPerformanceCounter
+};
+
+/// <summary>
+/// Traces the lifecycle of sessions hosted by the game server, writing spans to a rotating Chrome trace event file
+/// which can be opened in chrome://tracing or Perfetto. The session identifier provided by ServerDB is used as the
+/// trace identifier, and sessions are sampled deterministically from it, so ServerDB configured with the same sample
+/// rate traces the same sessions. Timestamps are written as wall-clock time so traces from both sides line up.
+/// </summary>
+struct SessionTrace
+{
+	// Configuration
+	UINT32 sampleRate; // parts per SESSION_TRACE_SAMPLE_SCALE
+	UINT32 processId;
+	INT64 frequency; // QueryPerformanceFrequency
+	INT64 baseCounter; // QueryPerformanceCounter at initialization
+	INT64 baseUnixMicroseconds; // wall-clock time at initialization
+
+	// Output
+	FILE* file;
+	UINT32 fileIndex;
+	UINT64 fileSize;
+
+	// Current session
+	GUID traceId;
+	BOOL sampled;
+	UINT64 nextSpanId;
+	SessionTraceSpan phases[(UINT32)SessionTracePhase::Count];
+	SessionTraceSpan pendingJoins[SESSION_TRACE_MAX_PENDING_JOINS];
+	UINT32 pendingJoinHead;
+	UINT32 pendingJoinCount;
+};
+
+/// <summary>
+/// Determines whether a session should be traced. This must match the sampling performed by ServerDB.
+/// </summary>
+/// <param name="traceId">The trace identifier (session identifier) of the session.</param>
+/// <param name="sampleRate">The sample rate, in parts per SESSION_TRACE_SAMPLE_SCALE.</param>
+/// <returns>TRUE if the session should be traced, FALSE otherwise.</returns>
+BOOL SessionTraceShouldSample(const GUID* traceId, UINT32 sampleRate);
+
+/// <summary>
+/// Initializes a session trace. No output is written until a sampled session starts.
+/// </summary>
+/// <param name="trace">The trace to initialize.</param>
+/// <param name="sampleRate">The portion of sessions to trace (0.0-1.0).</param>
+/// <returns>None</returns>
+VOID SessionTraceInitialize(SessionTrace* trace, DOUBLE sampleRate);
+
+/// <summary>
+/// Closes the current session trace file, ending any open spans.
+/// </summary>
+/// <param name="trace">The trace to close.</param>
+/// <returns>None</returns>
+VOID SessionTraceClose(SessionTrace* trace);
+
+/// <summary>
+/// Starts tracing a new session, opening its session and start session spans. Any spans left open by a previous
+/// session are written as incomplete.
+/// </summary>
+/// <param name="trace">The trace to record in.</param>
+/// <param name="traceId">The trace identifier (session identifier) of the session.</param>
+/// <returns>None</returns>
+VOID SessionTraceStartSession(SessionTrace* trace, const GUID* traceId);
+
+/// <summary>
+/// Ends the current session, closing all of its open spans.
+/// </summary>
+/// <param name="trace">The trace to record in.</param>
+/// <returns>None</returns>
+VOID SessionTraceEndSession(SessionTrace* trace);
+
+/// <summary>
+/// Transitions the current session from one phase to another, ending the former and beginning the latter.
+/// </summary>
+/// <param name="trace">The trace to record in.</param>
+/// <param name="from">The phase to end, if it is open.</param>
+/// <param name="to">The phase to begin.</param>
+/// <returns>None</returns>
+VOID SessionTraceTransition(SessionTrace* trace, SessionTracePhase from, SessionTracePhase to);
+
+/// <summary>
+/// Records a join (SNSLobbySessionSuccessv5) which is awaiting acceptance of the player by the game.
+/// </summary>
+/// <param name="trace">The trace to record in.</param>
+/// <returns>None</returns>
+VOID SessionTraceJoinRequested(SessionTrace* trace);
+
+/// <summary>
+/// Records the acceptance of players by the game, ending the oldest pending join span for each player.
+/// </summary>
+/// <param name="trace">The trace to record in.</param>
+/// <param name="count">The amount of players accepted.</param>
+/// <returns>None</returns>
+VOID SessionTraceJoinsAccepted(SessionTrace* trace, UINT64 count);
+
+/// <summary>
+/// Obtains the trace context to send to ServerDB for the current session.
+/// </summary>
+/// <param name="trace">The trace to obtain the context from.</param>
+/// <param name="phase">The phase whose span the context should refer to.</param>
+/// <param name="context">The context to fill out.</param>
+/// <returns>None</returns>
+VOID SessionTraceGetContext(const SessionTrace* trace, SessionTracePhase phase, ERTraceContext* context);
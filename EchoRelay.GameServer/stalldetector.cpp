@@ -0,0 +1,260 @@
+#include <cstdarg>
+#include <cstdio>
+#include "pch.h"
+#include "stackcapture.h"
+#include "stalldetector.h"
+
+/// <summary>
+/// Obtains the time elapsed between two QueryPerformanceCounter values, in milliseconds.
+/// </summary>
+/// <param name="detector">The detector holding the counter frequency.</param>
+/// <param name="start">The earlier counter value.</param>
+/// <param name="end">The later counter value.</param>
+/// <returns>The elapsed time, in milliseconds.</returns>
+static UINT32 StallDetectorElapsedMs(StallDetector* detector, INT64 start, INT64 end)
+{
+	return (UINT32)min((end - start) * 1000 / detector->frequency, (INT64)MAXUINT32);
+}
+
+/// <summary>
+/// Appends formatted text to the stall report, truncating it if the report is full.
+/// </summary>
+/// <param name="detector">The detector holding the report.</param>
+/// <param name="length">The length of the report so far, updated with the appended text.</param>
+/// <param name="format">The format string.</param>
+/// <returns>None</returns>
+static VOID StallDetectorAppend(StallDetector* detector, size_t* length, const CHAR* format, ...)
+{
+	if (*length >= sizeof(detector->report) - 1)
+		return;
+	va_list args;
+	va_start(args, format);
+	INT32 written = vsnprintf(detector->report + *length, sizeof(detector->report) - *length, format, args);
+	va_end(args);
+	if (written > 0)
+		*length = min(*length + (size_t)written, sizeof(detector->report) - 1);
+}
+
+/// <summary>
+/// Appends a frame to the stall report, symbolized as an offset within the module containing it.
+/// </summary>
+/// <param name="detector">The detector holding the report.</param>
+/// <param name="length">The length of the report so far, updated with the appended text.</param>
+/// <param name="index">The index of the frame within its sample.</param>
+/// <param name="address">The address of the frame.</param>
+/// <returns>None</returns>
+static VOID StallDetectorAppendFrame(StallDetector* detector, size_t* length, UINT32 index, UINT64 address)
+{
+	HMODULE module = NULL;
+	CHAR path[MAX_PATH];
+	if (GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS | GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT, (LPCSTR)address, &module) &&
+		GetModuleFileNameA(module, path, sizeof(path)) != 0)
+	{
+		const CHAR* name = strrchr(path, '\\');
+		StallDetectorAppend(detector, length, "  #%02u %s+0x%llX\n", index, name != NULL ? name + 1 : path, address - (UINT64)module);
+	}
+	else
+	{
+		StallDetectorAppend(detector, length, "  #%02u 0x%llX\n", index, address);
+	}
+}
+
+/// <summary>
+/// Writes a report of the stall in progress, with the stacks captured so far and the game server's state. This only uses
+/// kernel32 file functions, as the game's logger is not thread-safe.
+/// </summary>
+/// <param name="detector">The detector observing the stall.</param>
+/// <param name="durationMs">The duration of the stall so far, in milliseconds.</param>
+/// <param name="ended">Indicates whether the stall has ended.</param>
+/// <returns>None</returns>
+static VOID StallDetectorWriteReport(StallDetector* detector, UINT32 durationMs, BOOL ended)
+{
+	detector->reportWritten = TRUE;
+	detector->lastReportPath[0] = '\0';
+	if (detector->reportCount >= STALL_DETECTOR_MAX_REPORTS)
+		return;
+
+	// Describe the stall and the game server's state.
+	size_t length = 0;
+	StallDetectorAppend(detector, &length, "Game thread stall\nprocess: %u\nthread: %u\nthreshold: %u ms\nduration: %u ms%s\n",
+		GetCurrentProcessId(), detector->gameThreadId, detector->thresholdMs.load(std::memory_order_relaxed), durationMs, ended ? "" : " (ongoing)");
+	if (detector->describe != NULL)
+	{
+		CHAR description[1024];
+		description[0] = '\0';
+		detector->describe(detector->describeContext, description, sizeof(description));
+		StallDetectorAppend(detector, &length, "%s\n", description);
+	}
+
+	// Symbolize each sample.
+	for (UINT32 i = 0; i < detector->sampleCount; i++)
+	{
+		StallSample* sample = &detector->samples[i];
+		StallDetectorAppend(detector, &length, "\nsample %u (+%u ms):\n", i, sample->offsetMs);
+		for (UINT32 j = 0; j < sample->frameCount; j++)
+			StallDetectorAppendFrame(detector, &length, j, sample->frames[j]);
+	}
+
+	// Write the report, named by process and stall.
+	CHAR path[MAX_PATH];
+	CreateDirectoryA("_local", NULL);
+	CreateDirectoryA(STALL_DETECTOR_DUMP_DIRECTORY, NULL);
+	sprintf_s(path, STALL_DETECTOR_DUMP_DIRECTORY "\\stall.%u.%u.txt", GetCurrentProcessId(), detector->reportCount);
+	HANDLE hFile = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return;
+	DWORD written = 0;
+	BOOL success = WriteFile(hFile, detector->report, (DWORD)length, &written, NULL);
+	CloseHandle(hFile);
+	if (!success)
+		return;
+	detector->reportCount++;
+	strcpy_s(detector->lastReportPath, path);
+}
+
+/// <summary>
+/// Records the end of a stall, appending its final duration to a report written while it was ongoing, and publishes it to the game thread.
+/// </summary>
+/// <param name="detector">The detector observing the stall.</param>
+/// <param name="nextTick">The heartbeat of the tick which followed the stall.</param>
+/// <returns>None</returns>
+static VOID StallDetectorEndStall(StallDetector* detector, INT64 nextTick)
+{
+	UINT32 durationMs = StallDetectorElapsedMs(detector, detector->stallTick, nextTick);
+	if (!detector->reportWritten)
+	{
+		StallDetectorWriteReport(detector, durationMs, TRUE);
+	}
+	else if (detector->lastReportPath[0] != '\0')
+	{
+		HANDLE hFile = CreateFileA(detector->lastReportPath, FILE_APPEND_DATA, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (hFile != INVALID_HANDLE_VALUE)
+		{
+			CHAR line[64];
+			DWORD written = 0;
+			INT32 lineLength = sprintf_s(line, "\nended after %u ms\n", durationMs);
+			WriteFile(hFile, line, (DWORD)max(lineLength, 0), &written, NULL);
+			CloseHandle(hFile);
+		}
+	}
+
+	detector->lastStallDurationMs = durationMs;
+	detector->stallCount.fetch_add(1, std::memory_order_release);
+	detector->stallTick = 0;
+}
+
+/// <summary>
+/// Checks the game thread's heartbeat, sampling its stack and reporting if it has stalled.
+/// </summary>
+/// <param name="detector">The detector observing the game thread.</param>
+/// <returns>The amount of time to wait before checking again, in milliseconds.</returns>
+static DWORD StallDetectorCheck(StallDetector* detector)
+{
+	// If the stalled tick has finished, the stall has ended.
+	INT64 lastTick = detector->lastTick.load(std::memory_order_relaxed);
+	if (detector->stallTick != 0 && lastTick != detector->stallTick)
+		StallDetectorEndStall(detector, lastTick);
+
+	// Wait until the current tick would exceed the threshold.
+	UINT32 thresholdMs = detector->thresholdMs.load(std::memory_order_relaxed);
+	if (lastTick == 0 || thresholdMs == 0)
+		return STALL_DETECTOR_IDLE_INTERVAL_MS;
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	UINT32 elapsedMs = StallDetectorElapsedMs(detector, lastTick, now.QuadPart);
+	if (elapsedMs < thresholdMs)
+		return thresholdMs - elapsedMs;
+
+	// The tick has stalled. Sample its stack until we have enough to report, then wait for it to end.
+	if (detector->stallTick != lastTick)
+	{
+		detector->stallTick = lastTick;
+		detector->sampleCount = 0;
+		detector->reportWritten = FALSE;
+	}
+	if (detector->sampleCount < STALL_DETECTOR_MAX_SAMPLES)
+	{
+		StallSample* sample = &detector->samples[detector->sampleCount++];
+		BOOL truncated;
+		sample->offsetMs = elapsedMs;
+		sample->frameCount = StackCapture(detector->gameThread, detector->stackCopy, STALL_DETECTOR_STACK_COPY_SIZE, sample->frames, STALL_DETECTOR_MAX_FRAMES, FALSE, &truncated);
+		if (detector->sampleCount == STALL_DETECTOR_MAX_SAMPLES)
+			StallDetectorWriteReport(detector, elapsedMs, FALSE);
+	}
+	return STALL_DETECTOR_SAMPLE_INTERVAL_MS;
+}
+
+/// <summary>
+/// The watchdog thread's entry point, which checks the game thread's heartbeat until the detector is stopped.
+/// </summary>
+/// <param name="parameter">The detector.</param>
+/// <returns>Zero.</returns>
+static DWORD WINAPI StallDetectorThreadProc(LPVOID parameter)
+{
+	StallDetector* detector = (StallDetector*)parameter;
+	DWORD waitMs = 0;
+	while (WaitForSingleObject(detector->stopEvent, waitMs) == WAIT_TIMEOUT)
+		waitMs = StallDetectorCheck(detector);
+	return 0;
+}
+
+BOOL StallDetectorStart(StallDetector* detector, UINT32 thresholdMs, StallDetectorDescribeFunc* describe, VOID* describeContext)
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	detector->frequency = frequency.QuadPart;
+	detector->lastTick.store(0, std::memory_order_relaxed);
+	detector->thresholdMs.store(thresholdMs, std::memory_order_relaxed);
+	detector->describe = describe;
+	detector->describeContext = describeContext;
+	detector->stallTick = 0;
+	detector->sampleCount = 0;
+	detector->reportCount = 0;
+	detector->stallCount.store(0, std::memory_order_relaxed);
+	detector->lastStallDurationMs = 0;
+	detector->lastReportPath[0] = '\0';
+
+	// Open the calling (game) thread so we can suspend it, and reserve the buffer its stack is copied into.
+	detector->gameThreadId = GetCurrentThreadId();
+	detector->gameThread = OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_QUERY_INFORMATION, FALSE, detector->gameThreadId);
+	detector->stackCopy = (BYTE*)VirtualAlloc(NULL, STALL_DETECTOR_STACK_COPY_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	detector->stopEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+	detector->thread = NULL;
+	if (detector->gameThread != NULL && detector->stackCopy != NULL && detector->stopEvent != NULL)
+		detector->thread = CreateThread(NULL, 0, StallDetectorThreadProc, detector, 0, NULL);
+
+	// The watchdog should run while the game is saturating the CPU, which is when stalls occur.
+	if (detector->thread != NULL)
+	{
+		SetThreadPriority(detector->thread, THREAD_PRIORITY_ABOVE_NORMAL);
+		return TRUE;
+	}
+	StallDetectorStop(detector);
+	return FALSE;
+}
+
+VOID StallDetectorStop(StallDetector* detector)
+{
+	if (detector->thread != NULL)
+	{
+		SetEvent(detector->stopEvent);
+		WaitForSingleObject(detector->thread, INFINITE);
+		CloseHandle(detector->thread);
+		detector->thread = NULL;
+	}
+	if (detector->stopEvent != NULL)
+	{
+		CloseHandle(detector->stopEvent);
+		detector->stopEvent = NULL;
+	}
+	if (detector->gameThread != NULL)
+	{
+		CloseHandle(detector->gameThread);
+		detector->gameThread = NULL;
+	}
+	if (detector->stackCopy != NULL)
+	{
+		VirtualFree(detector->stackCopy, 0, MEM_RELEASE);
+		detector->stackCopy = NULL;
+	}
+}
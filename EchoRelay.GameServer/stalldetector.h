@@ -0,0 +1,136 @@
+#pragma once
+
+#include <atomic>
+#include "pch.h"
+
+/// <summary>
+/// The directory (relative to the game's working directory) stall reports are written to.
+/// </summary>
+#define STALL_DETECTOR_DUMP_DIRECTORY "_local\\stalls"
+
+/// <summary>
+/// The default amount of time a game thread tick may take before it is considered a stall, in milliseconds.
+/// </summary>
+const UINT32 STALL_DETECTOR_DEFAULT_THRESHOLD_MS = 2000;
+
+/// <summary>
+/// The interval at which the game thread's stack is captured during a stall, in milliseconds.
+/// </summary>
+const UINT32 STALL_DETECTOR_SAMPLE_INTERVAL_MS = 250;
+
+/// <summary>
+/// The interval at which the watchdog checks for a heartbeat while the game thread has not yet ticked, or detection is disabled, in milliseconds.
+/// </summary>
+const UINT32 STALL_DETECTOR_IDLE_INTERVAL_MS = 1000;
+
+/// <summary>
+/// The amount of stack samples captured during a single stall. The report is written once these have been captured.
+/// </summary>
+const UINT32 STALL_DETECTOR_MAX_SAMPLES = 8;
+
+/// <summary>
+/// The maximum amount of frames retained for each stack sample.
+/// </summary>
+const UINT32 STALL_DETECTOR_MAX_FRAMES = 48;
+
+/// <summary>
+/// The maximum amount of the game thread's stack copied for each sample, in bytes. Deeper frames are not unwound.
+/// </summary>
+const UINT32 STALL_DETECTOR_STACK_COPY_SIZE = 512 * 1024;
+
+/// <summary>
+/// The maximum amount of stall reports written by a process, so a server which stalls repeatedly does not fill its disk.
+/// </summary>
+const UINT32 STALL_DETECTOR_MAX_REPORTS = 16;
+
+/// <summary>
+/// The size of the buffer a stall report is formatted in, in bytes.
+/// </summary>
+const UINT32 STALL_DETECTOR_REPORT_SIZE = 32 * 1024;
+
+/// <summary>
+/// A function which describes the game server's state (such as its session) for a stall report. This is called on the
+/// watchdog thread while the game thread is stalled, so it must only read plain fields.
+/// </summary>
+typedef VOID StallDetectorDescribeFunc(VOID* context, CHAR* buffer, size_t bufferSize);
+
+/// <summary>
+/// A stack of the game thread, captured during a stall.
+/// </summary>
+struct StallSample
+{
+	UINT32 offsetMs; // time since the stalled tick began
+	UINT32 frameCount;
+	UINT64 frames[STALL_DETECTOR_MAX_FRAMES]; // instruction pointer, followed by return addresses
+};
+
+/// <summary>
+/// A watchdog which observes a heartbeat stamped by the game thread each tick. When a tick exceeds the threshold, the game
+/// thread's stack is captured several times during the stall, and a report symbolized against module offsets is written to
+/// <see cref="STALL_DETECTOR_DUMP_DIRECTORY"/>. Unlike the game's own deadlock monitor, the process is left running.
+/// </summary>
+struct StallDetector
+{
+	std::atomic<INT64> lastTick; // QueryPerformanceCounter at the start of the game thread's last tick, or zero before the first
+	std::atomic<UINT32> thresholdMs; // zero disables detection
+	HANDLE thread;
+	HANDLE stopEvent;
+	HANDLE gameThread;
+	DWORD gameThreadId;
+	INT64 frequency; // QueryPerformanceFrequency
+	StallDetectorDescribeFunc* describe;
+	VOID* describeContext;
+
+	// The stall in progress (watchdog only).
+	INT64 stallTick; // the heartbeat of the stalled tick, or zero if the game thread is not stalled
+	UINT32 sampleCount;
+	BOOL reportWritten;
+	StallSample samples[STALL_DETECTOR_MAX_SAMPLES];
+	BYTE* stackCopy;
+	CHAR report[STALL_DETECTOR_REPORT_SIZE];
+	UINT32 reportCount;
+
+	// The last stall which ended, published to the game thread by stallCount.
+	std::atomic<UINT32> stallCount;
+	UINT32 lastStallDurationMs;
+	CHAR lastReportPath[MAX_PATH]; // empty if no report was written
+};
+
+/// <summary>
+/// Starts the watchdog thread, observing the calling thread as the game thread.
+/// </summary>
+/// <param name="detector">The detector to start.</param>
+/// <param name="thresholdMs">The amount of time a tick may take before it is considered a stall, in milliseconds, or zero to disable detection.</param>
+/// <param name="describe">A function which describes the game server's state for stall reports (optional).</param>
+/// <param name="describeContext">The context passed to the describe function.</param>
+/// <returns>TRUE if the watchdog thread was started, FALSE otherwise.</returns>
+BOOL StallDetectorStart(StallDetector* detector, UINT32 thresholdMs, StallDetectorDescribeFunc* describe, VOID* describeContext);
+
+/// <summary>
+/// Stops the watchdog thread. Stalls which have not ended are not reported further.
+/// </summary>
+/// <param name="detector">The detector to stop.</param>
+/// <returns>None</returns>
+VOID StallDetectorStop(StallDetector* detector);
+
+/// <summary>
+/// Sets the amount of time a tick may take before it is considered a stall. This may be called from any thread.
+/// </summary>
+/// <param name="detector">The detector to configure.</param>
+/// <param name="thresholdMs">The threshold, in milliseconds, or zero to disable detection.</param>
+/// <returns>None</returns>
+inline VOID StallDetectorSetThreshold(StallDetector* detector, UINT32 thresholdMs)
+{
+	detector->thresholdMs.store(thresholdMs, std::memory_order_relaxed);
+}
+
+/// <summary>
+/// Stamps the heartbeat for a game thread tick. This is a single atomic store.
+/// </summary>
+/// <param name="detector">The detector observing the game thread.</param>
+/// <param name="counter">The QueryPerformanceCounter value at the start of the tick.</param>
+/// <returns>None</returns>
+inline VOID StallDetectorTick(StallDetector* detector, INT64 counter)
+{
+	detector->lastTick.store(counter, std::memory_order_relaxed);
+}
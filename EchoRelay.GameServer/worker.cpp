@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <cstdint>
+#include "pch.h"
+#include "worker.h"
+
+/// <summary>
+/// The weight given to each new queue latency sample in the smoothed mean, out of 16.
+/// </summary>
+const UINT32 WORKER_LATENCY_MEAN_WEIGHT = 1;
+
+/// <summary>
+/// Initializes an empty job queue.
+/// </summary>
+/// <param name="queue">The queue to initialize.</param>
+/// <returns>None</returns>
+static VOID WorkerQueueInitialize(WorkerQueue* queue)
+{
+	queue->stub.next.store(NULL, std::memory_order_relaxed);
+	queue->head.store(&queue->stub, std::memory_order_relaxed);
+	queue->tail = &queue->stub;
+}
+
+/// <summary>
+/// Pushes a job onto a queue. This may be called from any thread.
+/// </summary>
+/// <param name="queue">The queue to push onto.</param>
+/// <param name="job">The job to push.</param>
+/// <returns>None</returns>
+static VOID WorkerQueuePush(WorkerQueue* queue, WorkerJob* job)
+{
+	// Claim the head, then link the previous head to us. Until the link is stored, the consumer sees the queue end at the
+	// previous head, so a consumer racing with this will find the job on its next pop.
+	job->next.store(NULL, std::memory_order_relaxed);
+	WorkerJob* previous = queue->head.exchange(job, std::memory_order_acq_rel);
+	previous->next.store(job, std::memory_order_release);
+}
+
+/// <summary>
+/// Pops the oldest job from a queue. This must only be called from the queue's single consumer.
+/// </summary>
+/// <param name="queue">The queue to pop from.</param>
+/// <returns>The oldest job, or NULL if the queue is empty or a push is still linking its job.</returns>
+static WorkerJob* WorkerQueuePop(WorkerQueue* queue)
+{
+	// Skip past the stub, if it is at the tail.
+	WorkerJob* tail = queue->tail;
+	WorkerJob* next = tail->next.load(std::memory_order_acquire);
+	if (tail == &queue->stub)
+	{
+		if (next == NULL)
+			return NULL;
+		queue->tail = next;
+		tail = next;
+		next = next->next.load(std::memory_order_acquire);
+	}
+	if (next != NULL)
+	{
+		queue->tail = next;
+		return tail;
+	}
+
+	// The tail is the last linked job. If it is not also the head, a push is in progress, so try again later.
+	if (tail != queue->head.load(std::memory_order_acquire))
+		return NULL;
+
+	// Otherwise, push the stub behind it so the tail can be popped while leaving a node in the queue.
+	WorkerQueuePush(queue, &queue->stub);
+	next = tail->next.load(std::memory_order_acquire);
+	if (next == NULL)
+		return NULL;
+	queue->tail = next;
+	return tail;
+}
+
+/// <summary>
+/// Executes a job and hands it to the completion queue, recording how long it waited to be executed.
+/// </summary>
+/// <param name="worker">The worker executing the job.</param>
+/// <param name="job">The job to execute.</param>
+/// <returns>None</returns>
+static VOID WorkerExecute(Worker* worker, WorkerJob* job)
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	job->startTime = now.QuadPart;
+	UINT32 latency = (UINT32)min((now.QuadPart - job->submitTime) * 1000000 / worker->frequency, (INT64)UINT32_MAX);
+	UINT32 latencyMax = worker->queueLatencyMax.load(std::memory_order_relaxed);
+	while (latency > latencyMax && !worker->queueLatencyMax.compare_exchange_weak(latencyMax, latency, std::memory_order_relaxed));
+	UINT32 mean = worker->queueLatencyMean.load(std::memory_order_relaxed);
+	worker->queueLatencyMean.store((UINT32)(((UINT64)mean * (16 - WORKER_LATENCY_MEAN_WEIGHT) + (UINT64)latency * WORKER_LATENCY_MEAN_WEIGHT) / 16), std::memory_order_relaxed);
+
+	job->execute(job);
+	WorkerQueuePush(&worker->completions, job);
+}
+
+/// <summary>
+/// The worker thread's entry point, which executes submitted jobs until the worker is stopped.
+/// </summary>
+/// <param name="parameter">The worker.</param>
+/// <returns>Zero.</returns>
+static DWORD WINAPI WorkerThreadProc(LPVOID parameter)
+{
+	Worker* worker = (Worker*)parameter;
+	while (TRUE)
+	{
+		WorkerJob* job = WorkerQueuePop(&worker->submissions);
+		if (job != NULL)
+		{
+			WorkerExecute(worker, job);
+			continue;
+		}
+
+		// Submitters signal the event after their push is linked, so we never sleep through a job.
+		if (worker->stopping.load(std::memory_order_acquire))
+			break;
+		WaitForSingleObject(worker->wakeEvent, INFINITE);
+	}
+	return 0;
+}
+
+BOOL WorkerStart(Worker* worker)
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	worker->frequency = frequency.QuadPart;
+	worker->stopping.store(FALSE, std::memory_order_relaxed);
+	WorkerQueueInitialize(&worker->submissions);
+	WorkerQueueInitialize(&worker->completions);
+	worker->jobsSubmitted.store(0, std::memory_order_relaxed);
+	worker->jobsCompleted = 0;
+	worker->queueLatencyMax.store(0, std::memory_order_relaxed);
+	worker->queueLatencyMean.store(0, std::memory_order_relaxed);
+	worker->turnaroundMax = 0;
+
+	worker->wakeEvent = CreateEventA(NULL, FALSE, FALSE, NULL);
+	worker->thread = worker->wakeEvent != NULL ? CreateThread(NULL, 0, WorkerThreadProc, worker, 0, NULL) : NULL;
+	if (worker->thread == NULL && worker->wakeEvent != NULL)
+	{
+		CloseHandle(worker->wakeEvent);
+		worker->wakeEvent = NULL;
+	}
+	return worker->thread != NULL;
+}
+
+VOID WorkerStop(Worker* worker)
+{
+	if (worker->thread != NULL)
+	{
+		worker->stopping.store(TRUE, std::memory_order_release);
+		SetEvent(worker->wakeEvent);
+		WaitForSingleObject(worker->thread, INFINITE);
+		CloseHandle(worker->thread);
+		CloseHandle(worker->wakeEvent);
+		worker->thread = NULL;
+		worker->wakeEvent = NULL;
+	}
+	WorkerDrainCompletions(worker);
+}
+
+VOID WorkerSubmit(Worker* worker, WorkerJob* job)
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	job->submitTime = now.QuadPart;
+	worker->jobsSubmitted.fetch_add(1, std::memory_order_relaxed);
+
+	// Without a worker thread, execute the job now. It is still completed when completions are next drained.
+	if (worker->thread == NULL)
+	{
+		WorkerExecute(worker, job);
+		return;
+	}
+	WorkerQueuePush(&worker->submissions, job);
+	SetEvent(worker->wakeEvent);
+}
+
+VOID WorkerDrainCompletions(Worker* worker)
+{
+	WorkerJob* job;
+	while ((job = WorkerQueuePop(&worker->completions)) != NULL)
+	{
+		LARGE_INTEGER now;
+		QueryPerformanceCounter(&now);
+		worker->turnaroundMax = max(worker->turnaroundMax, (UINT32)min((now.QuadPart - job->submitTime) * 1000000 / worker->frequency, (INT64)UINT32_MAX));
+		worker->jobsCompleted++;
+		if (job->complete != NULL)
+			job->complete(job);
+	}
+}
+
+VOID WorkerGetStats(Worker* worker, WorkerStats* stats)
+{
+	stats->jobsSubmitted = worker->jobsSubmitted.load(std::memory_order_relaxed);
+	stats->jobsCompleted = worker->jobsCompleted;
+	stats->queueDepth = (UINT32)(stats->jobsSubmitted - stats->jobsCompleted);
+	stats->queueLatencyMax = worker->queueLatencyMax.exchange(0, std::memory_order_relaxed);
+	stats->queueLatencyMean = worker->queueLatencyMean.load(std::memory_order_relaxed);
+	stats->turnaroundMax = worker->turnaroundMax;
+	worker->turnaroundMax = 0;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <atomic>
+#include "pch.h"
+
+struct WorkerJob;
+
+/// <summary>
+/// A function run for a worker job, on either the worker thread or the game thread.
+/// </summary>
+typedef VOID WorkerJobFunc(WorkerJob* job);
+
+/// <summary>
+/// A unit of work handed to the worker. Jobs are owned by the submitter, which typically embeds them alongside the
+/// inputs and outputs of the work, so submitting one never allocates. A job must not be resubmitted until it has completed.
+/// </summary>
+struct WorkerJob
+{
+	std::atomic<WorkerJob*> next;
+	WorkerJobFunc* execute; // run on the worker thread
+	WorkerJobFunc* complete; // run on the game thread once executed, to apply the results (optional)
+	VOID* context;
+	INT64 submitTime; // QueryPerformanceCounter
+	INT64 startTime; // QueryPerformanceCounter
+};
+
+/// <summary>
+/// An intrusive, lock-free multi-producer single-consumer queue of jobs. Producers only perform a single exchange,
+/// and the consumer never blocks them. A stub node is held by the queue, so it is never empty of nodes.
+/// </summary>
+struct WorkerQueue
+{
+	std::atomic<WorkerJob*> head; // the most recently pushed job
+	WorkerJob* tail; // the next job to pop, or the stub (consumer only)
+	WorkerJob stub;
+};
+
+/// <summary>
+/// Statistics describing the worker's queues. Times are in microseconds.
+/// </summary>
+struct WorkerStats
+{
+	UINT64 jobsSubmitted;
+	UINT64 jobsCompleted;
+	UINT32 queueDepth; // jobs submitted but not yet completed
+	UINT32 queueLatencyMax; // time jobs waited before executing, largest since the last call
+	UINT32 queueLatencyMean; // time jobs waited before executing, smoothed
+	UINT32 turnaroundMax; // time from submission to completion on the game thread, largest since the last call
+};
+
+/// <summary>
+/// A background worker which runs jobs submitted from the game thread (or any thread) off the game thread. Executed
+/// jobs are handed back through a completion queue, which the game thread drains each tick to apply their results.
+/// If the worker thread could not be started, jobs are executed as they are submitted.
+/// </summary>
+struct Worker
+{
+	HANDLE thread;
+	HANDLE wakeEvent;
+	std::atomic<BOOL> stopping;
+	WorkerQueue submissions;
+	WorkerQueue completions;
+	INT64 frequency; // QueryPerformanceFrequency
+
+	// Statistics
+	std::atomic<UINT64> jobsSubmitted;
+	UINT64 jobsCompleted; // game thread only
+	std::atomic<UINT32> queueLatencyMax; // microseconds, reset when read
+	std::atomic<UINT32> queueLatencyMean; // microseconds
+	UINT32 turnaroundMax; // microseconds, game thread only, reset when read
+};
+
+/// <summary>
+/// Starts the worker thread.
+/// </summary>
+/// <param name="worker">The worker to start.</param>
+/// <returns>TRUE if the worker thread was started, FALSE if jobs will be executed as they are submitted.</returns>
+BOOL WorkerStart(Worker* worker);
+
+/// <summary>
+/// Stops the worker thread once it has executed every job submitted, then completes them on the calling thread.
+/// Jobs must not be submitted from other threads while the worker is stopping.
+/// </summary>
+/// <param name="worker">The worker to stop.</param>
+/// <returns>None</returns>
+VOID WorkerStop(Worker* worker);
+
+/// <summary>
+/// Submits a job to be executed by the worker thread. This may be called from any thread.
+/// </summary>
+/// <param name="worker">The worker to submit the job to.</param>
+/// <param name="job">The job to submit, with its execute function, and optionally its complete function and context, set.</param>
+/// <returns>None</returns>
+VOID WorkerSubmit(Worker* worker, WorkerJob* job);
+
+/// <summary>
+/// Completes the jobs which the worker thread has executed since this was last called, running their complete function.
+/// This should be called from the game thread each tick.
+/// </summary>
+/// <param name="worker">The worker to drain completed jobs from.</param>
+/// <returns>None</returns>
+VOID WorkerDrainCompletions(Worker* worker);
+
+/// <summary>
+/// Obtains statistics describing the worker's queues, resetting the maxima. This should be called from the game thread.
+/// </summary>
+/// <param name="worker">The worker to obtain statistics for.</param>
+/// <param name="stats">The statistics to populate.</param>
+/// <returns>None</returns>
+VOID WorkerGetStats(Worker* worker, WorkerStats* stats);
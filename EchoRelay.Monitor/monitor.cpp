@@ -0,0 +1,742 @@
+#include <iostream>
+#include <vector>
+#include <algorithm>
+#include "pch.h"
+#include "lobbysnapshot.h"
+#include "flightrecorder.h"
+#include "egressstats.h"
+#include "capture.h"
+#include "logsegments.h"
+#include "profiler.h"
+#include "messages.h"
+#include "netstats.h"
+#include <winhttp.h>
+
+#pragma comment(lib, "Winhttp.lib")
+
+/// <summary>
+/// Prints a lobby snapshot to the console.
+/// </summary>
+/// <param name="snapshot">The snapshot region, used to obtain the net game state.</param>
+/// <param name="data">A consistent copy of the snapshot data.</param>
+/// <returns>None</returns>
+VOID PrintSnapshot(const LobbySnapshot* snapshot, const LobbySnapshotData* data)
+{
+    INT32 netGameState = snapshot->netGameState.load(std::memory_order_relaxed);
+    const GUID* id = (const GUID*)data->gameSessionId;
+    printf("process:        %u\n", snapshot->processId);
+    printf("net game state: %s (%d)\n", EchoVR::GetNetGameStateName((EchoVR::NetGameState)netGameState), netGameState);
+    printf("registered:     %s (server id: %llu, region: 0x%llX, version lock: 0x%llX)\n", data->registered ? "yes" : "no", data->serverId, data->regionId, data->versionLock);
+    printf("session:        %s %08lX-%04hX-%04hX-%02hhX%02hhX-%02hhX%02hhX%02hhX%02hhX%02hhX%02hhX\n", data->sessionActive ? "active" : "inactive",
+        id->Data1, id->Data2, id->Data3, id->Data4[0], id->Data4[1], id->Data4[2], id->Data4[3], id->Data4[4], id->Data4[5], id->Data4[6], id->Data4[7]);
+    printf("locked:         %s\n", data->entrantsLocked ? "yes" : "no");
+    UINT32 captureId = snapshot->captureId.load(std::memory_order_relaxed);
+    if (captureId != 0)
+        printf("capturing:      yes (capture %u)\n", captureId);
+    printf("counters:       updates=%llu serverdb_sent=%llu serverdb_received=%llu\n", data->updateCount, data->messagesSent, data->messagesReceived);
+    printf("serverdb link:  sent=%llu B received=%llu B", data->serverDbBytesSent, data->serverDbBytesReceived);
+    if (data->netStatsFlags & NET_STATS_FLAG_SERVERDB_EXTENDED_STATS)
+        printf(" rtt=%u ms queued=%u B retransmits=%llu\n", data->serverDbRtt, data->serverDbQueueBytes, data->serverDbRetransmits);
+    else
+        printf(" (%s)\n", (data->netStatsFlags & NET_STATS_FLAG_SERVERDB_CONNECTION_FOUND) ? "extended TCP stats unavailable, run elevated" : "connection not found");
+    printf("udp:            receive_queue=%u B receive_errors=%llu (system-wide)\n", data->udpReceiveQueueBytes, data->udpReceiveErrors);
+    printf("worker:         jobs=%llu completed=%llu depth=%u queue_latency=%u us (max %u us) turnaround_max=%u us\n", data->workerJobsSubmitted,
+        data->workerJobsCompleted, data->workerQueueDepth, data->workerQueueLatencyMean, data->workerQueueLatencyMax, data->workerTurnaroundMax);
+    printf("snapshot age:   %llu ms\n", GetTickCount64() - data->publishTime);
+    printf("entrants:       %u\n", data->entrantCount);
+    for (UINT32 i = 0; i < data->entrantCount && i < LOBBY_SNAPSHOT_MAX_ENTRANTS; i++)
+    {
+        const LobbySnapshotEntrant* entrant = &data->entrants[i];
+        printf("  [%2u] team=%hu ping=%4hu ms platform=%llu account=%llu name=%.36s\n", i, entrant->teamIndex, entrant->ping,
+            entrant->userId.platformCode, entrant->userId.accountId, entrant->displayName);
+    }
+}
+
+/// <summary>
+/// Obtains a display name for a given flight recorder lifecycle event.
+/// </summary>
+/// <param name="evt">The lifecycle event to obtain the name for.</param>
+/// <returns>The name of the lifecycle event.</returns>
+const CHAR* GetLifecycleEventName(UINT64 evt)
+{
+    switch ((FlightRecorderLifecycleEvent)evt)
+    {
+    case FlightRecorderLifecycleEvent::Initialize: return "Initialize";
+    case FlightRecorderLifecycleEvent::Terminate: return "Terminate";
+    case FlightRecorderLifecycleEvent::RequestRegistration: return "RequestRegistration";
+    case FlightRecorderLifecycleEvent::Unregister: return "Unregister";
+    case FlightRecorderLifecycleEvent::EndSession: return "EndSession";
+    case FlightRecorderLifecycleEvent::LockPlayerSessions: return "LockPlayerSessions";
+    case FlightRecorderLifecycleEvent::UnlockPlayerSessions: return "UnlockPlayerSessions";
+    case FlightRecorderLifecycleEvent::AcceptPlayerSessions: return "AcceptPlayerSessions";
+    case FlightRecorderLifecycleEvent::RemovePlayerSession: return "RemovePlayerSession";
+    case FlightRecorderLifecycleEvent::SessionStarting: return "SessionStarting";
+    case FlightRecorderLifecycleEvent::SessionError: return "SessionError";
+    case FlightRecorderLifecycleEvent::ServerDbFailover: return "ServerDbFailover";
+    case FlightRecorderLifecycleEvent::GameThreadStall: return "GameThreadStall";
+    case FlightRecorderLifecycleEvent::LoadShedStart: return "LoadShedStart";
+    case FlightRecorderLifecycleEvent::LoadShedEnd: return "LoadShedEnd";
+    case FlightRecorderLifecycleEvent::PatchInitialize: return "PatchInitialize";
+    case FlightRecorderLifecycleEvent::FatalError: return "FatalError";
+    case FlightRecorderLifecycleEvent::LoadFailedReset: return "LoadFailedReset";
+    case FlightRecorderLifecycleEvent::PluginShutdownExit: return "PluginShutdownExit";
+    default: return "Unknown";
+    }
+}
+
+/// <summary>
+/// Obtains a display name for a given ServerDB websocket message type symbol.
+/// </summary>
+/// <param name="symbol">The message type symbol to obtain the name for.</param>
+/// <returns>The name of the message type.</returns>
+const CHAR* GetServerDbMessageName(EchoVR::SymbolId symbol)
+{
+    switch (symbol)
+    {
+    case SYMBOL_TCPBROADCASTER_LOBBY_REGISTRATION_REQUEST: return "RegistrationRequest";
+    case SYMBOL_TCPBROADCASTER_LOBBY_REGISTRATION_SUCCESS: return "RegistrationSuccess";
+    case SYMBOL_TCPBROADCASTER_LOBBY_REGISTRATION_FAILURE: return "RegistrationFailure";
+    case SYMBOL_TCPBROADCASTER_LOBBY_SESSION_SUCCESS_V5: return "SessionSuccessv5";
+    case SYMBOL_TCPBROADCASTER_LOBBY_START_SESSION: return "StartSession";
+    case SYMBOL_TCPBROADCASTER_LOBBY_SESSION_STARTED: return "SessionStarted";
+    case SYMBOL_TCPBROADCASTER_LOBBY_END_SESSION: return "EndSession";
+    case SYMBOL_TCPBROADCASTER_LOBBY_PLAYER_SESSIONS_LOCKED: return "PlayerSessionsLocked";
+    case SYMBOL_TCPBROADCASTER_LOBBY_PLAYER_SESSIONS_UNLOCKED: return "PlayerSessionsUnlocked";
+    case SYMBOL_TCPBROADCASTER_LOBBY_ACCEPT_PLAYERS: return "AcceptPlayers";
+    case SYMBOL_TCPBROADCASTER_LOBBY_PLAYERS_ACCEPTED: return "PlayersAccepted";
+    case SYMBOL_TCPBROADCASTER_LOBBY_PLAYERS_REJECTED: return "PlayersRejected";
+    case SYMBOL_TCPBROADCASTER_LOBBY_PLAYERS_REMOVE_PLAYER: return "RemovePlayer";
+    case SYMBOL_TCPBROADCASTER_LOBBY_HEARTBEAT: return "Heartbeat";
+    default: return "Unknown";
+    }
+}
+
+/// <summary>
+/// Decodes a flight recorder dump and prints its events to the console, oldest first.
+/// </summary>
+/// <param name="path">The file path of the dump to decode.</param>
+/// <returns>Zero if the dump was decoded successfully, non-zero otherwise.</returns>
+int DecodeFlightRecorderDump(const CHAR* path)
+{
+    // Read the header and validate it.
+    std::ifstream file(path, std::ios::binary);
+    FlightRecorderHeader header;
+    if (!file.read((CHAR*)&header, sizeof(header)) || header.magic != FLIGHT_RECORDER_MAGIC || header.version != FLIGHT_RECORDER_VERSION
+        || header.eventSize != sizeof(FlightRecorderEvent) || header.capacity == 0 || header.frequency == 0)
+    {
+        std::cerr << "Failed to read flight recorder dump " << path << ". It may be corrupt, or from an incompatible version." << std::endl;
+        return 1;
+    }
+
+    // Read the ring, keeping only events which were fully written. An event's sequence is its index plus one, so it must
+    // match the slot it is in. Events which were being written during the dump may be torn, and are discarded.
+    std::vector<FlightRecorderEvent> events(header.capacity);
+    if (!file.read((CHAR*)events.data(), header.capacity * sizeof(FlightRecorderEvent)))
+    {
+        std::cerr << "Flight recorder dump " << path << " is truncated." << std::endl;
+        return 1;
+    }
+    std::vector<const FlightRecorderEvent*> ordered;
+    for (UINT32 i = 0; i < header.capacity; i++)
+    {
+        UINT64 sequence = events[i].sequence.load(std::memory_order_relaxed);
+        if (sequence != 0 && sequence <= header.eventCount && ((sequence - 1) % header.capacity) == i)
+            ordered.push_back(&events[i]);
+    }
+    std::sort(ordered.begin(), ordered.end(), [](const FlightRecorderEvent* a, const FlightRecorderEvent* b) { return a->sequence.load(std::memory_order_relaxed) < b->sequence.load(std::memory_order_relaxed); });
+
+    // Print the dump information.
+    SYSTEMTIME startTime;
+    FileTimeToSystemTime(&header.startTime, &startTime);
+    printf("module:         %.32s\n", header.module);
+    printf("process:        %u\n", header.processId);
+    printf("started:        %04hu-%02hu-%02hu %02hu:%02hu:%02hu.%03hu UTC\n", startTime.wYear, startTime.wMonth, startTime.wDay, startTime.wHour, startTime.wMinute, startTime.wSecond, startTime.wMilliseconds);
+    printf("dumped:         +%.6fs (%s)\n", (double)(header.dumpTimestamp - header.startTimestamp) / header.frequency, header.dumpReason == FlightRecorderDumpReason::Crash ? "crash" : "exit");
+    if (header.dumpReason == FlightRecorderDumpReason::Crash)
+        printf("exception:      code=0x%08X address=0x%llX\n", header.exceptionCode, header.exceptionAddress);
+    printf("events:         %zu retained of %llu recorded (%u dropped)\n\n", ordered.size(), header.eventCount, header.droppedCount);
+
+    // Print each event, with its time relative to the recorder starting.
+    for (const FlightRecorderEvent* pEvt : ordered)
+    {
+        const FlightRecorderEvent& evt = *pEvt;
+        printf("+%12.6fs [%5u] ", (double)(evt.timestamp - header.startTimestamp) / header.frequency, evt.threadId);
+        switch (evt.type)
+        {
+        case FlightRecorderEventType::Lifecycle:
+            printf("lifecycle      %-24s", GetLifecycleEventName(evt.symbol));
+            break;
+        case FlightRecorderEventType::ServerDbSend:
+            printf("serverdb send  %-24s", GetServerDbMessageName((EchoVR::SymbolId)evt.symbol));
+            break;
+        case FlightRecorderEventType::ServerDbReceive:
+            printf("serverdb recv  %-24s", GetServerDbMessageName((EchoVR::SymbolId)evt.symbol));
+            break;
+        case FlightRecorderEventType::NetGameStateChange:
+            printf("net game state %-24s", EchoVR::GetNetGameStateName((EchoVR::NetGameState)evt.symbol));
+            break;
+        default:
+            printf("unknown (%hu)   0x%-22llX", (UINT16)evt.type, evt.symbol);
+            break;
+        }
+
+        // Print the retained payload, noting if it was truncated.
+        printf(" size=%-5u", evt.originalSize);
+        for (UINT16 i = 0; i < evt.payloadSize && i < FLIGHT_RECORDER_PAYLOAD_SIZE; i++)
+            printf("%02X", evt.payload[i]);
+        if (evt.originalSize > evt.payloadSize)
+            printf("...");
+        printf("\n");
+    }
+    return 0;
+}
+
+/// <summary>
+/// The amount of talkers printed for each grouping of egress statistics.
+/// </summary>
+const size_t EGRESS_TOP_TALKERS = 10;
+
+/// <summary>
+/// Prints a peer identifier, naming the special broadcast peers.
+/// </summary>
+/// <param name="peer">The peer to print.</param>
+/// <returns>None</returns>
+VOID PrintPeer(EchoVR::Peer peer)
+{
+    switch (peer)
+    {
+    case EchoVR::Peer_Self: printf("%-16s", "self"); break;
+    case EchoVR::Peer_AllPeers: printf("%-16s", "all"); break;
+    case EchoVR::Peer_SelfAndAllPeers: printf("%-16s", "self+all"); break;
+    case EchoVR::Peer_InvalidPeer: printf("%-16s", "invalid"); break;
+    default: printf("%-16llu", peer); break;
+    }
+}
+
+/// <summary>
+/// Prints the largest talkers in a game server's egress statistics to the console.
+/// </summary>
+/// <param name="stats">The egress statistics to print.</param>
+/// <returns>None</returns>
+VOID PrintEgressStats(const EgressStats* stats)
+{
+    // Sum the totals and recording overhead across all threads.
+    UINT64 messages = stats->untrackedMessages.load(std::memory_order_relaxed), bytes = stats->untrackedBytes.load(std::memory_order_relaxed);
+    UINT64 overflowMessages = 0, overheadTicks = 0, overheadSamples = 0;
+    UINT32 threadCount = min(stats->threadCount.load(std::memory_order_relaxed), EGRESS_STATS_MAX_THREADS);
+    for (UINT32 i = 0; i < threadCount; i++)
+    {
+        const EgressStatsThreadTable* table = &stats->threads[i];
+        overflowMessages += table->overflowMessages.load(std::memory_order_relaxed);
+        messages += table->overflowMessages.load(std::memory_order_relaxed);
+        bytes += table->overflowBytes.load(std::memory_order_relaxed);
+        overheadTicks += table->overheadTicks.load(std::memory_order_relaxed);
+        overheadSamples += table->overheadSamples.load(std::memory_order_relaxed);
+        for (const EgressStatsEntry& entry : table->entries)
+        {
+            messages += entry.messages.load(std::memory_order_relaxed);
+            bytes += entry.bytes.load(std::memory_order_relaxed);
+        }
+    }
+    printf("egress:         messages=%llu bytes=%llu threads=%u overflowed=%llu untracked=%llu\n", messages, bytes, stats->threadCount.load(std::memory_order_relaxed),
+        overflowMessages, stats->untrackedMessages.load(std::memory_order_relaxed));
+    printf("shaping:        dropped=%llu coalesced=%llu unshaped=%llu\n", stats->droppedMessages.load(std::memory_order_relaxed), stats->coalescedMessages.load(std::memory_order_relaxed),
+        stats->unshapedMessages.load(std::memory_order_relaxed));
+    if (overheadSamples != 0)
+        printf("overhead:       %.1f ns/send (%llu samples)\n", (double)overheadTicks * 1000000000.0 / stats->frequency / overheadSamples, overheadSamples);
+
+    // Print the largest talkers by message type, by peer, and by both.
+    std::vector<EgressStatsTalker> talkers;
+    EgressStatsTopTalkers(stats, EgressStatsGroupBy::Symbol, EGRESS_TOP_TALKERS, &talkers);
+    printf("\ntop symbols:    %-18s %-16s %12s %14s\n", "symbol", "", "messages", "bytes");
+    for (const EgressStatsTalker& talker : talkers)
+        printf("                0x%016llX %-16s %12llu %14llu\n", talker.symbol, "", talker.messages, talker.bytes);
+
+    EgressStatsTopTalkers(stats, EgressStatsGroupBy::Peer, EGRESS_TOP_TALKERS, &talkers);
+    printf("\ntop peers:      %-18s %-16s %12s %14s\n", "", "peer", "messages", "bytes");
+    for (const EgressStatsTalker& talker : talkers)
+    {
+        printf("                %-18s ", "");
+        PrintPeer(talker.peer);
+        printf(" %12llu %14llu\n", talker.messages, talker.bytes);
+    }
+
+    EgressStatsTopTalkers(stats, EgressStatsGroupBy::SymbolAndPeer, EGRESS_TOP_TALKERS, &talkers);
+    printf("\ntop talkers:    %-18s %-16s %12s %14s\n", "symbol", "peer", "messages", "bytes");
+    for (const EgressStatsTalker& talker : talkers)
+    {
+        printf("                0x%016llX ", talker.symbol);
+        PrintPeer(talker.peer);
+        printf(" %12llu %14llu\n", talker.messages, talker.bytes);
+    }
+}
+
+/// <summary>
+/// The header identifier which leads each message in a packet sent to central services.
+/// </summary>
+const UINT64 PACKET_HEADER_ID = 0xBB8CE7A278BB40F6;
+
+/// <summary>
+/// Obtains a display name for a capture stream.
+/// </summary>
+/// <param name="stream">The stream to obtain the name for.</param>
+/// <returns>The name of the stream.</returns>
+const CHAR* GetCaptureStreamName(CaptureStream stream)
+{
+    switch (stream)
+    {
+    case CaptureStream::ServerDbSend: return "serverdb send";
+    case CaptureStream::ServerDbReceive: return "serverdb recv";
+    case CaptureStream::BroadcasterSend: return "broadcast send";
+    case CaptureStream::BroadcasterLocalEvent: return "local event";
+    default: return "unknown";
+    }
+}
+
+/// <summary>
+/// Connects to a websocket service (such as a stand-in ServerDB).
+/// </summary>
+/// <param name="uri">The ws:// or wss:// URI of the service.</param>
+/// <param name="hSession">The WinHTTP session handle, to be closed by the caller.</param>
+/// <param name="hConnect">The WinHTTP connection handle, to be closed by the caller.</param>
+/// <returns>The websocket handle, or NULL if the connection failed.</returns>
+HINTERNET ConnectWebSocket(const CHAR* uri, HINTERNET* hSession, HINTERNET* hConnect)
+{
+    // WinHTTP only parses http(s) URIs, so we map the websocket scheme onto its equivalent.
+    std::string httpUri = uri;
+    if (httpUri.compare(0, 5, "ws://") == 0)
+        httpUri.replace(0, 2, "http");
+    else if (httpUri.compare(0, 6, "wss://") == 0)
+        httpUri.replace(0, 3, "https");
+    WCHAR wideUri[2048];
+    if (MultiByteToWideChar(CP_UTF8, 0, httpUri.c_str(), -1, wideUri, 2048) == 0)
+        return NULL;
+    WCHAR host[256], path[2048];
+    URL_COMPONENTS components;
+    memset(&components, 0, sizeof(components));
+    components.dwStructSize = sizeof(components);
+    components.lpszHostName = host;
+    components.dwHostNameLength = 256;
+    components.lpszUrlPath = path;
+    components.dwUrlPathLength = 2048;
+    components.dwExtraInfoLength = 1;
+    if (!WinHttpCrackUrl(wideUri, 0, 0, &components))
+        return NULL;
+    std::wstring pathAndQuery(path, components.dwUrlPathLength);
+    if (components.lpszExtraInfo != NULL)
+        pathAndQuery.append(components.lpszExtraInfo, components.dwExtraInfoLength);
+
+    // Open the connection and upgrade it to a websocket.
+    *hSession = WinHttpOpen(L"EchoRelay.Monitor", WINHTTP_ACCESS_TYPE_DEFAULT_PROXY, WINHTTP_NO_PROXY_NAME, WINHTTP_NO_PROXY_BYPASS, 0);
+    *hConnect = *hSession != NULL ? WinHttpConnect(*hSession, host, components.nPort, 0) : NULL;
+    if (*hConnect == NULL)
+        return NULL;
+    HINTERNET hRequest = WinHttpOpenRequest(*hConnect, L"GET", pathAndQuery.c_str(), NULL, WINHTTP_NO_REFERER, WINHTTP_DEFAULT_ACCEPT_TYPES,
+        components.nScheme == INTERNET_SCHEME_HTTPS ? WINHTTP_FLAG_SECURE : 0);
+    if (hRequest == NULL)
+        return NULL;
+    HINTERNET hWebSocket = NULL;
+    if (WinHttpSetOption(hRequest, WINHTTP_OPTION_UPGRADE_TO_WEB_SOCKET, NULL, 0) &&
+        WinHttpSendRequest(hRequest, WINHTTP_NO_ADDITIONAL_HEADERS, 0, WINHTTP_NO_REQUEST_DATA, 0, 0, 0) &&
+        WinHttpReceiveResponse(hRequest, NULL))
+        hWebSocket = WinHttpWebSocketCompleteUpgrade(hRequest, 0);
+    WinHttpCloseHandle(hRequest);
+    return hWebSocket;
+}
+
+/// <summary>
+/// Requests a game process write the profile its sampling profiler has collected so far.
+/// </summary>
+/// <param name="processId">The identifier of the game process.</param>
+/// <returns>Zero if the profile was requested, non-zero otherwise.</returns>
+int RequestProfile(DWORD processId)
+{
+    CHAR name[64];
+    sprintf_s(name, PROFILER_DUMP_EVENT_NAME_FORMAT, processId);
+    HANDLE hEvent = OpenEventA(EVENT_MODIFY_STATE, FALSE, name);
+    if (hEvent == NULL)
+    {
+        std::cerr << "Failed to open the sampling profiler for process " << processId << ". It may not be a game server, or may not have profiler_rate_hz set." << std::endl;
+        return 1;
+    }
+    SetEvent(hEvent);
+    CloseHandle(hEvent);
+    printf("Requested a profile from process %u. It will be written to " PROFILER_DUMP_DIRECTORY " in the game's directory.\n", processId);
+    return 0;
+}
+
+/// <summary>
+/// Replays a capture file, pacing records by their original timing (scaled by a speed factor). Records are either printed
+/// to the console with their full payload (for codec tools to consume), or, if a ServerDB URI is provided, the game server's
+/// ServerDB messages are sent to it, as if the game server were sending them.
+/// </summary>
+/// <param name="path">The file path of the capture to replay.</param>
+/// <param name="speed">The speed factor to replay at (e.g. 2.0 for twice as fast), or zero to replay as fast as possible.</param>
+/// <param name="serverDbUri">The websocket URI of a stand-in ServerDB to send messages to, or NULL to print records.</param>
+/// <returns>Zero if the capture was replayed successfully, non-zero otherwise.</returns>
+int ReplayCapture(const CHAR* path, double speed, const CHAR* serverDbUri)
+{
+    // Open the capture.
+    CaptureReader reader;
+    if (!CaptureReaderOpen(&reader, path))
+    {
+        std::cerr << "Failed to read capture " << path << ". It may be corrupt, or from an incompatible version." << std::endl;
+        return 1;
+    }
+    const CaptureFileHeader* header = &reader.header;
+    SYSTEMTIME startTime;
+    FileTimeToSystemTime(&header->startTime, &startTime);
+    printf("module:         %.32s\n", header->module);
+    printf("process:        %u (capture %u)\n", header->processId, header->captureId);
+    printf("started:        %04hu-%02hu-%02hu %02hu:%02hu:%02hu.%03hu UTC\n", startTime.wYear, startTime.wMonth, startTime.wDay, startTime.wHour, startTime.wMinute, startTime.wSecond, startTime.wMilliseconds);
+    printf("records:        %llu (%llu dropped)\n\n", header->recordCount, header->droppedRecords);
+
+    // Connect to the stand-in ServerDB, if one was provided.
+    HINTERNET hSession = NULL, hConnect = NULL, hWebSocket = NULL;
+    if (serverDbUri != NULL)
+    {
+        hWebSocket = ConnectWebSocket(serverDbUri, &hSession, &hConnect);
+        if (hWebSocket == NULL)
+        {
+            std::cerr << "Failed to connect to ServerDB at " << serverDbUri << "." << std::endl;
+            if (hConnect != NULL)
+                WinHttpCloseHandle(hConnect);
+            if (hSession != NULL)
+                WinHttpCloseHandle(hSession);
+            CaptureReaderClose(&reader);
+            return 1;
+        }
+    }
+
+    // Replay each record at its original time, relative to the start of the replay.
+    LARGE_INTEGER replayStart, now;
+    QueryPerformanceCounter(&replayStart);
+    CaptureRecordHeader record;
+    const BYTE* payload = NULL;
+    UINT64 replayed = 0;
+    std::vector<BYTE> packet;
+    int result = 0;
+    while (CaptureReaderNext(&reader, &record, &payload))
+    {
+        double recordTime = (double)(record.timestamp - header->startTimestamp) / header->frequency;
+        if (speed > 0)
+        {
+            double dueTime = recordTime / speed;
+            QueryPerformanceCounter(&now);
+            double elapsed = (double)(now.QuadPart - replayStart.QuadPart) / header->frequency;
+            if (dueTime > elapsed)
+                Sleep((DWORD)((dueTime - elapsed) * 1000));
+        }
+
+        if (hWebSocket != NULL)
+        {
+            // Only the game server's own ServerDB messages are sent. Each is framed as a single message packet.
+            if (record.stream != CaptureStream::ServerDbSend)
+                continue;
+            UINT64 size = record.size;
+            packet.resize(sizeof(UINT64) * 3 + size);
+            memcpy(packet.data(), &PACKET_HEADER_ID, sizeof(UINT64));
+            memcpy(packet.data() + sizeof(UINT64), &record.symbol, sizeof(UINT64));
+            memcpy(packet.data() + sizeof(UINT64) * 2, &size, sizeof(UINT64));
+            memcpy(packet.data() + sizeof(UINT64) * 3, payload, size);
+            if (WinHttpWebSocketSend(hWebSocket, WINHTTP_WEB_SOCKET_BINARY_MESSAGE_BUFFER_TYPE, packet.data(), (DWORD)packet.size()) != NO_ERROR)
+            {
+                std::cerr << "Failed to send to ServerDB, stopping replay." << std::endl;
+                result = 1;
+                break;
+            }
+            printf("+%12.6fs sent %-24s size=%u\n", recordTime, GetServerDbMessageName(record.symbol), record.size);
+        }
+        else
+        {
+            // Print the record with its full payload.
+            BOOL serverDbStream = record.stream == CaptureStream::ServerDbSend || record.stream == CaptureStream::ServerDbReceive;
+            printf("+%12.6fs %-14s 0x%016llX %-24s peer=%-20lld size=%-5u ", recordTime, GetCaptureStreamName(record.stream), record.symbol,
+                serverDbStream ? GetServerDbMessageName(record.symbol) : "", (INT64)record.peer, record.size);
+            for (UINT32 i = 0; i < record.size; i++)
+                printf("%02X", payload[i]);
+            printf("\n");
+        }
+        replayed++;
+    }
+    printf("\nreplayed:       %llu records\n", replayed);
+
+    // Close the connection and capture.
+    if (hWebSocket != NULL)
+    {
+        WinHttpWebSocketClose(hWebSocket, WINHTTP_WEB_SOCKET_SUCCESS_CLOSE_STATUS, NULL, 0);
+        WinHttpCloseHandle(hWebSocket);
+        WinHttpCloseHandle(hConnect);
+        WinHttpCloseHandle(hSession);
+    }
+    CaptureReaderClose(&reader);
+    return result;
+}
+
+/// <summary>
+/// Parses a UTC time given as "YYYY-MM-DD HH:MM:SS" (or "YYYY-MM-DDTHH:MM:SS"), with the time optional.
+/// </summary>
+/// <param name="text">The text to parse.</param>
+/// <param name="time">The parsed time (FILETIME, UTC).</param>
+/// <returns>TRUE if the time was parsed, FALSE otherwise.</returns>
+BOOL ParseUtcTime(const CHAR* text, UINT64* time)
+{
+    SYSTEMTIME systemTime;
+    memset(&systemTime, 0, sizeof(systemTime));
+    CHAR separator;
+    INT32 fields = sscanf_s(text, "%hu-%hu-%hu%c%hu:%hu:%hu", &systemTime.wYear, &systemTime.wMonth, &systemTime.wDay, &separator, 1,
+        &systemTime.wHour, &systemTime.wMinute, &systemTime.wSecond);
+    FILETIME fileTime;
+    if ((fields != 3 && fields != 7) || !SystemTimeToFileTime(&systemTime, &fileTime))
+        return FALSE;
+    *time = ((ULARGE_INTEGER*)&fileTime)->QuadPart;
+    return TRUE;
+}
+
+/// <summary>
+/// Prints the lines of a log segment logged within a time range. Only the blocks which overlap the range are decompressed.
+/// </summary>
+/// <param name="path">The file path of the log segment.</param>
+/// <param name="from">The start of the range (FILETIME, UTC).</param>
+/// <param name="to">The end of the range (FILETIME, UTC).</param>
+/// <returns>Zero if the segment was read successfully, non-zero otherwise.</returns>
+int PrintLogSegment(const CHAR* path, UINT64 from, UINT64 to)
+{
+    LogSegmentReader reader;
+    if (!LogSegmentReaderOpen(&reader, path))
+    {
+        std::cerr << "Failed to read log segment " << path << ". It may be corrupt, or from an incompatible version." << std::endl;
+        return 1;
+    }
+    if (!reader.indexed)
+        std::cerr << "Log segment " << path << " has no index (its process may have crashed), so its blocks were walked instead." << std::endl;
+
+    LogSegmentReaderSeek(&reader, from);
+    LogRecordHeader record;
+    const CHAR* text = NULL;
+    while (LogSegmentReaderNext(&reader, &record, &text) && record.time <= to)
+    {
+        if (record.time < from)
+            continue;
+        SYSTEMTIME time;
+        FileTimeToSystemTime((FILETIME*)&record.time, &time);
+        const CHAR* level = record.level == EchoVR::LogLevel::Debug ? "DEBUG" : record.level == EchoVR::LogLevel::Warning ? "WARNING" :
+            record.level == EchoVR::LogLevel::Error ? "ERROR" : "INFO";
+        printf("%04hu-%02hu-%02hu %02hu:%02hu:%02hu.%03hu %-7s %.*s\n", time.wYear, time.wMonth, time.wDay, time.wHour, time.wMinute, time.wSecond,
+            time.wMilliseconds, level, (INT32)record.size, text);
+    }
+    LogSegmentReaderClose(&reader);
+    return 0;
+}
+
+/// <summary>
+/// Compresses a recorded log in log segment blocks with each algorithm of the Windows Compression API, printing the ratio and
+/// throughput of each, to choose the log_compression setting for a host.
+/// </summary>
+/// <param name="path">The file path of a recorded (plain text) log.</param>
+/// <returns>Zero if the log was benchmarked, non-zero otherwise.</returns>
+int BenchmarkLogCompression(const CHAR* path)
+{
+    // Read the log, and split it into blocks as the log sink would.
+    std::ifstream file(path, std::ios::binary);
+    std::vector<BYTE> log((std::istreambuf_iterator<CHAR>(file)), std::istreambuf_iterator<CHAR>());
+    if (log.empty())
+    {
+        std::cerr << "Failed to read log " << path << "." << std::endl;
+        return 1;
+    }
+    printf("log:            %s (%llu bytes, %u byte blocks)\n\n", path, (UINT64)log.size(), LOG_SEGMENT_BLOCK_SIZE);
+    printf("%-12s %10s %8s %14s %14s\n", "algorithm", "bytes", "ratio", "compress MB/s", "decompress MB/s");
+
+    const CHAR* names[] = { "xpress", "xpress_huff", "mszip", "lzms" };
+    DWORD algorithms[] = { COMPRESS_ALGORITHM_XPRESS, COMPRESS_ALGORITHM_XPRESS_HUFF, COMPRESS_ALGORITHM_MSZIP, COMPRESS_ALGORITHM_LZMS };
+    std::vector<BYTE> compressed(LOG_SEGMENT_BLOCK_SIZE);
+    std::vector<BYTE> decompressed(LOG_SEGMENT_BLOCK_SIZE);
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency(&frequency);
+    for (UINT32 i = 0; i < ARRAYSIZE(algorithms); i++)
+    {
+        COMPRESSOR_HANDLE compressor = NULL;
+        DECOMPRESSOR_HANDLE decompressor = NULL;
+        if (!CreateCompressor(algorithms[i] | COMPRESS_RAW, NULL, &compressor) || !CreateDecompressor(algorithms[i] | COMPRESS_RAW, NULL, &decompressor))
+        {
+            printf("%-12s unavailable\n", names[i]);
+            if (compressor != NULL)
+                CloseCompressor(compressor);
+            continue;
+        }
+
+        // Compress and decompress each block, as a reader would. Blocks which do not compress are stored as-is.
+        UINT64 compressedTotal = 0;
+        LONGLONG compressTicks = 0, decompressTicks = 0;
+        for (UINT64 offset = 0; offset < log.size(); offset += LOG_SEGMENT_BLOCK_SIZE)
+        {
+            SIZE_T blockSize = (SIZE_T)min((UINT64)LOG_SEGMENT_BLOCK_SIZE, log.size() - offset);
+            SIZE_T compressedSize = 0, decompressedSize = 0;
+            QueryPerformanceCounter(&start);
+            BOOL stored = !Compress(compressor, log.data() + offset, blockSize, compressed.data(), compressed.size(), &compressedSize) || compressedSize >= blockSize;
+            QueryPerformanceCounter(&end);
+            compressTicks += end.QuadPart - start.QuadPart;
+            compressedTotal += sizeof(LogSegmentBlockHeader) + (stored ? blockSize : compressedSize);
+            if (stored)
+                continue;
+            QueryPerformanceCounter(&start);
+            Decompress(decompressor, compressed.data(), compressedSize, decompressed.data(), blockSize, &decompressedSize);
+            QueryPerformanceCounter(&end);
+            decompressTicks += end.QuadPart - start.QuadPart;
+        }
+        double megabytes = (double)log.size() / (1024 * 1024);
+        printf("%-12s %10llu %7.2fx %14.1f %14.1f\n", names[i], compressedTotal, (double)log.size() / compressedTotal,
+            compressTicks != 0 ? megabytes * frequency.QuadPart / compressTicks : 0.0, decompressTicks != 0 ? megabytes * frequency.QuadPart / decompressTicks : 0.0);
+        CloseCompressor(compressor);
+        CloseDecompressor(decompressor);
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    // Verify we were provided a process identifier or dump to decode.
+    if (argc < 2)
+    {
+        std::cerr << "Usage: EchoRelay.Monitor.exe <game server process id> [-egress] [-watch <interval ms>]" << std::endl;
+        std::cerr << "       EchoRelay.Monitor.exe <game server process id> -profile" << std::endl;
+        std::cerr << "       EchoRelay.Monitor.exe -decode <flight recorder dump>" << std::endl;
+        std::cerr << "       EchoRelay.Monitor.exe -replay <capture> [-speed <factor>] [-serverdb <websocket uri>]" << std::endl;
+        std::cerr << "       EchoRelay.Monitor.exe -logs <log segment> [-from <utc time>] [-to <utc time>]" << std::endl;
+        std::cerr << "       EchoRelay.Monitor.exe -logbench <recorded log>" << std::endl;
+        return 1;
+    }
+
+    // If we're reading a log segment, do so and stop.
+    if (strcmp(argv[1], "-logs") == 0)
+    {
+        if (argc < 3)
+        {
+            std::cerr << "No log segment was provided to read." << std::endl;
+            return 1;
+        }
+        UINT64 from = 0;
+        UINT64 to = MAXUINT64;
+        for (int i = 3; i + 1 < argc; i++)
+        {
+            if ((strcmp(argv[i], "-from") == 0 && !ParseUtcTime(argv[++i], &from)) || (strcmp(argv[i], "-to") == 0 && !ParseUtcTime(argv[++i], &to)))
+            {
+                std::cerr << "Failed to parse time " << argv[i] << ". Times are given in UTC, as YYYY-MM-DD HH:MM:SS." << std::endl;
+                return 1;
+            }
+        }
+        return PrintLogSegment(argv[2], from, to);
+    }
+
+    // If we're benchmarking log compression, do so and stop.
+    if (strcmp(argv[1], "-logbench") == 0)
+    {
+        if (argc < 3)
+        {
+            std::cerr << "No recorded log was provided to benchmark." << std::endl;
+            return 1;
+        }
+        return BenchmarkLogCompression(argv[2]);
+    }
+
+    // If we're replaying a capture, do so and stop.
+    if (strcmp(argv[1], "-replay") == 0)
+    {
+        if (argc < 3)
+        {
+            std::cerr << "No capture was provided to replay." << std::endl;
+            return 1;
+        }
+        double speed = 1.0;
+        const CHAR* serverDbUri = NULL;
+        for (int i = 3; i + 1 < argc; i++)
+        {
+            if (strcmp(argv[i], "-speed") == 0)
+                speed = atof(argv[++i]);
+            else if (strcmp(argv[i], "-serverdb") == 0)
+                serverDbUri = argv[++i];
+        }
+        return ReplayCapture(argv[2], speed, serverDbUri);
+    }
+
+    // If we're decoding a flight recorder dump, do so and stop.
+    if (strcmp(argv[1], "-decode") == 0)
+    {
+        if (argc < 3)
+        {
+            std::cerr << "No flight recorder dump was provided to decode." << std::endl;
+            return 1;
+        }
+        return DecodeFlightRecorderDump(argv[2]);
+    }
+    DWORD processId = strtoul(argv[1], NULL, 10);
+
+    // If we're requesting a profile, do so and stop.
+    if (argc > 2 && strcmp(argv[2], "-profile") == 0)
+        return RequestProfile(processId);
+    DWORD watchInterval = 0;
+    BOOL printEgress = FALSE;
+    for (int i = 2; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-watch") == 0 && i + 1 < argc)
+            watchInterval = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-egress") == 0)
+            printEgress = TRUE;
+    }
+
+    // Open the game server's lobby snapshot.
+    HANDLE hMapping = NULL;
+    LobbySnapshot* snapshot = LobbySnapshotOpen(processId, FALSE, &hMapping);
+    if (snapshot == NULL)
+    {
+        std::cerr << "Failed to open lobby snapshot for process " << processId << ". It may not be a game server, or may be running an incompatible version." << std::endl;
+        return 1;
+    }
+
+    // Open the game server's egress statistics, if requested.
+    HANDLE hEgressMapping = NULL;
+    EgressStats* egressStats = NULL;
+    if (printEgress)
+    {
+        egressStats = EgressStatsOpen(processId, FALSE, &hEgressMapping);
+        if (egressStats == NULL)
+        {
+            std::cerr << "Failed to open egress statistics for process " << processId << ". It may not have sent any game traffic yet, or may be running an incompatible version." << std::endl;
+            LobbySnapshotClose(snapshot, hMapping);
+            return 1;
+        }
+    }
+
+    // Read and print the snapshot, repeating if we are watching.
+    LobbySnapshotData data;
+    int result = 0;
+    do
+    {
+        if (!LobbySnapshotRead(snapshot, &data))
+        {
+            std::cerr << "Failed to obtain a consistent lobby snapshot." << std::endl;
+            result = 1;
+        }
+        else
+        {
+            PrintSnapshot(snapshot, &data);
+        }
+        if (egressStats != NULL)
+        {
+            printf("\n");
+            PrintEgressStats(egressStats);
+        }
+
+        if (watchInterval != 0)
+        {
+            printf("\n");
+            Sleep(watchInterval);
+        }
+    } while (watchInterval != 0);
+
+    // Release the snapshot and egress statistics.
+    LobbySnapshotClose(snapshot, hMapping);
+    EgressStatsClose(egressStats, hEgressMapping);
+    return result;
+}
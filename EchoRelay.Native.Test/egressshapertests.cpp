@@ -0,0 +1,452 @@
+#include <cinttypes>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <vector>
+#include "test.h"
+#include "egressshaper.h"
+
+/// <summary>
+/// The frequency of the timestamps the tests shape with, in ticks per second (microseconds).
+/// </summary>
+const int64_t FREQUENCY = 1000000;
+
+/// <summary>
+/// A low-priority symbol which is dropped when its peer is congested.
+/// </summary>
+const int64_t SYMBOL_DROP = 0x1001;
+
+/// <summary>
+/// A low-priority symbol which is coalesced when its peer is congested.
+/// </summary>
+const int64_t SYMBOL_COALESCE = 0x1002;
+
+/// <summary>
+/// A symbol without a policy, which is never held back.
+/// </summary>
+const int64_t SYMBOL_CRITICAL = 0x2001;
+
+/// <summary>
+/// Creates a shaper for the tests, with a policy for each low-priority symbol.
+/// </summary>
+/// <param name="bytesPerSecond">The rate each peer's bucket drains at, in bytes per second.</param>
+/// <param name="burstBytes">The size of each peer's bucket, in bytes.</param>
+/// <returns>The shaper.</returns>
+std::unique_ptr<EgressShaper> CreateShaper(uint64_t bytesPerSecond, uint64_t burstBytes)
+{
+	std::unique_ptr<EgressShaper> shaper(new EgressShaper());
+	EgressShaperInitialize(shaper.get(), FREQUENCY, bytesPerSecond, burstBytes, "0x1001:drop,0x1002:coalesce:100");
+	return shaper;
+}
+
+/// <summary>
+/// Holds a coalesced send, tagged with a value identifying it.
+/// </summary>
+/// <param name="shaper">The shaper to hold the send with.</param>
+/// <param name="peer">The peer the send is to.</param>
+/// <param name="bytes">The size of the send.</param>
+/// <param name="tag">The value identifying the send.</param>
+/// <returns>The tag of the send which was superseded, or zero if none were.</returns>
+uint32_t Hold(EgressShaper* shaper, uint64_t peer, uint64_t bytes, uint32_t tag)
+{
+	EgressShaperHeldSend* send = EgressShaperAllocateHeldSend(SYMBOL_COALESCE, peer, bytes, sizeof(tag));
+	memcpy(EgressShaperHeldSendData(send), &tag, sizeof(tag));
+	EgressShaperHeldSend* superseded = EgressShaperHold(shaper, send);
+	uint32_t supersededTag = 0;
+	if (superseded != NULL)
+	{
+		memcpy(&supersededTag, EgressShaperHeldSendData(superseded), sizeof(supersededTag));
+		EgressShaperFreeHeldSend(superseded);
+	}
+	return supersededTag;
+}
+
+/// <summary>
+/// Releases the held sends which are due for a peer.
+/// </summary>
+/// <param name="shaper">The shaper holding the sends.</param>
+/// <param name="peer">The peer to release sends for.</param>
+/// <param name="now">The current timestamp.</param>
+/// <returns>The tags of the sends released.</returns>
+std::vector<uint32_t> Release(EgressShaper* shaper, uint64_t peer, int64_t now)
+{
+	std::vector<uint32_t> tags;
+	EgressShaperHeldSend* released;
+	while ((released = EgressShaperRelease(shaper, peer, now)) != NULL)
+	{
+		uint32_t tag;
+		memcpy(&tag, EgressShaperHeldSendData(released), sizeof(tag));
+		tags.push_back(tag);
+		EgressShaperFreeHeldSend(released);
+	}
+	return tags;
+}
+
+void TestParsesPolicies()
+{
+	std::unique_ptr<EgressShaper> shaper(new EgressShaper());
+	EgressShaperInitialize(shaper.get(), FREQUENCY, 1000, 0, "0x10:drop,bad,32:coalesce,0x30:coalesce:250,0x40:unknown,0x50:drop");
+	CHECK(shaper->bytesPerSecond == 1000);
+	CHECK(shaper->burstBytes == EGRESS_SHAPER_DEFAULT_BURST);
+	CHECK(shaper->policyCount == 4);
+	CHECK(shaper->policies[0].symbol == 0x10 && shaper->policies[0].action == EgressShaperAction::Drop);
+	CHECK(shaper->policies[1].symbol == 32 && shaper->policies[1].action == EgressShaperAction::Coalesce);
+	CHECK(shaper->policies[1].coalesceIntervalMs == EGRESS_SHAPER_DEFAULT_COALESCE_INTERVAL_MS);
+	CHECK(shaper->policies[2].symbol == 0x30 && shaper->policies[2].coalesceIntervalMs == 250);
+	CHECK(shaper->policies[3].symbol == 0x50);
+
+	// Without any policies, nothing is shaped.
+	EgressShaperInitialize(shaper.get(), FREQUENCY, 1000, 0, "");
+	CHECK(shaper->bytesPerSecond == 0);
+	CHECK(EgressShaperShape(shaper.get(), 0x10, 1, 1000000, 0) == EgressShaperDecision::Send);
+}
+
+void TestCriticalTrafficIsNeverHeld()
+{
+	// Critical traffic is charged to the bucket well beyond its burst, but is always sent.
+	std::unique_ptr<EgressShaper> shaper = CreateShaper(10000, 1000);
+	for (int i = 0; i < 1000; i++)
+		CHECK(EgressShaperShape(shaper.get(), SYMBOL_CRITICAL, 1, 500, 0) == EgressShaperDecision::Send);
+
+	// Low-priority traffic to the congested peer is held back, while other peers are unaffected.
+	CHECK(EgressShaperShape(shaper.get(), SYMBOL_DROP, 1, 10, 0) == EgressShaperDecision::Dropped);
+	CHECK(EgressShaperShape(shaper.get(), SYMBOL_COALESCE, 1, 10, 0) == EgressShaperDecision::Coalesced);
+	CHECK(EgressShaperShape(shaper.get(), SYMBOL_DROP, 2, 10, 0) == EgressShaperDecision::Send);
+}
+
+void TestBucketBurstAndRefill()
+{
+	// The bucket allows a burst of ten 100 byte sends, then refills at 100 bytes per 10ms.
+	std::unique_ptr<EgressShaper> shaper = CreateShaper(10000, 1000);
+	for (int i = 0; i < 10; i++)
+		CHECK(EgressShaperShape(shaper.get(), SYMBOL_DROP, 1, 100, 0) == EgressShaperDecision::Send);
+	CHECK(EgressShaperShape(shaper.get(), SYMBOL_DROP, 1, 100, 0) == EgressShaperDecision::Dropped);
+	CHECK(EgressShaperShape(shaper.get(), SYMBOL_DROP, 1, 100, 9999) == EgressShaperDecision::Dropped);
+	CHECK(EgressShaperShape(shaper.get(), SYMBOL_DROP, 1, 100, 10000) == EgressShaperDecision::Send);
+	CHECK(EgressShaperShape(shaper.get(), SYMBOL_DROP, 1, 100, 10000) == EgressShaperDecision::Dropped);
+
+	// Once idle for long enough, the full burst is available again, but no more.
+	int sent = 0;
+	for (int i = 0; i < 20; i++)
+		sent += EgressShaperShape(shaper.get(), SYMBOL_DROP, 1, 100, 10 * FREQUENCY) == EgressShaperDecision::Send;
+	CHECK(sent == 10);
+}
+
+void TestCoalescingKeepsLatest()
+{
+	// Congest the peer with critical traffic, so low-priority sends are coalesced.
+	std::unique_ptr<EgressShaper> shaper = CreateShaper(10000, 1000);
+	CHECK(EgressShaperShape(shaper.get(), SYMBOL_CRITICAL, 1, 1500, 0) == EgressShaperDecision::Send);
+
+	// The first coalesced send is released immediately, as none were sent within the interval. Later sends supersede each
+	// other while held.
+	CHECK(EgressShaperShape(shaper.get(), SYMBOL_COALESCE, 1, 100, 0) == EgressShaperDecision::Coalesced);
+	CHECK(Hold(shaper.get(), 1, 100, 1) == 0);
+	CHECK(Release(shaper.get(), 1, 0) == std::vector<uint32_t>({ 1 }));
+	for (uint32_t tag = 2; tag <= 4; tag++)
+	{
+		CHECK(EgressShaperShape(shaper.get(), SYMBOL_COALESCE, 1, 100, 1000 * tag) == EgressShaperDecision::Coalesced);
+		CHECK(Hold(shaper.get(), 1, 100, tag) == (tag == 2 ? 0 : tag - 1));
+		CHECK(Release(shaper.get(), 1, 1000 * tag).empty());
+	}
+
+	// Once the bucket has room (the critical send, the first release and the held send drain after 170ms, less the 100ms
+	// burst), the latest send is released before its interval elapses, and only once.
+	CHECK(Release(shaper.get(), 1, 69999).empty());
+	CHECK(Release(shaper.get(), 1, 70000) == std::vector<uint32_t>({ 4 }));
+	CHECK(Release(shaper.get(), 1, 70000).empty());
+
+	// The release was charged to the bucket.
+	CHECK(EgressShaperShape(shaper.get(), SYMBOL_DROP, 1, 1000, 169999) == EgressShaperDecision::Dropped);
+	CHECK(EgressShaperShape(shaper.get(), SYMBOL_DROP, 1, 1000, 170000) == EgressShaperDecision::Send);
+}
+
+void TestCoalescingIntervalUnderSustainedCongestion()
+{
+	// Keep the peer congested with critical traffic, holding a coalesced send every 10ms. One is released per interval
+	// (100ms), and each release is the latest held.
+	std::unique_ptr<EgressShaper> shaper = CreateShaper(10000, 1000);
+	std::vector<uint32_t> released;
+	std::vector<int64_t> releaseTimes;
+	for (uint32_t tick = 1; tick <= 100; tick++)
+	{
+		int64_t now = tick * 10000;
+		CHECK(EgressShaperShape(shaper.get(), SYMBOL_CRITICAL, 1, 1000, now) == EgressShaperDecision::Send);
+		CHECK(EgressShaperShape(shaper.get(), SYMBOL_COALESCE, 1, 100, now) == EgressShaperDecision::Coalesced);
+		Hold(shaper.get(), 1, 100, tick);
+		for (uint32_t tag : Release(shaper.get(), 1, now))
+		{
+			released.push_back(tag);
+			releaseTimes.push_back(now);
+		}
+	}
+	CHECK(released.size() == 10);
+	for (size_t i = 0; i < released.size(); i++)
+	{
+		CHECK(released[i] == 1 + i * 10);
+		CHECK(i == 0 || releaseTimes[i] - releaseTimes[i - 1] == 100000);
+	}
+}
+
+void TestIdlePeersAreReclaimed()
+{
+	// Fill every slot, then one more peer cannot be tracked.
+	std::unique_ptr<EgressShaper> shaper = CreateShaper(10000, 1000);
+	for (uint64_t peer = 0; peer < EGRESS_SHAPER_MAX_PEERS; peer++)
+		CHECK(EgressShaperShape(shaper.get(), SYMBOL_CRITICAL, peer, 100, 0) == EgressShaperDecision::Send);
+	uint64_t extraPeer = EGRESS_SHAPER_MAX_PEERS;
+	CHECK(EgressShaperShape(shaper.get(), SYMBOL_CRITICAL, extraPeer, 100, 0) == EgressShaperDecision::Unshaped);
+
+	// Congest and hold a send for one peer, and keep every other peer active.
+	int64_t idleTicks = (int64_t)EGRESS_SHAPER_PEER_IDLE_MS * FREQUENCY / 1000;
+	uint64_t idlePeer = 7;
+	CHECK(EgressShaperShape(shaper.get(), SYMBOL_CRITICAL, idlePeer, 5000, 0) == EgressShaperDecision::Send);
+	CHECK(EgressShaperShape(shaper.get(), SYMBOL_COALESCE, idlePeer, 100, 0) == EgressShaperDecision::Coalesced);
+	CHECK(Hold(shaper.get(), idlePeer, 100, 1) == 0);
+	for (uint64_t peer = 0; peer < EGRESS_SHAPER_MAX_PEERS; peer++)
+	{
+		if (peer != idlePeer)
+			CHECK(EgressShaperShape(shaper.get(), SYMBOL_CRITICAL, peer, 100, idleTicks - 1) == EgressShaperDecision::Send);
+	}
+	CHECK(EgressShaperShape(shaper.get(), SYMBOL_CRITICAL, extraPeer, 100, idleTicks - 1) == EgressShaperDecision::Unshaped);
+
+	// Once the peer is idle, its slot is reclaimed for the new peer, discarding its held send. The new peer starts with a
+	// full bucket.
+	CHECK(EgressShaperShape(shaper.get(), SYMBOL_CRITICAL, extraPeer, 100, idleTicks) == EgressShaperDecision::Send);
+	CHECK(Release(shaper.get(), idlePeer, idleTicks).empty());
+	for (int i = 0; i < 9; i++)
+		CHECK(EgressShaperShape(shaper.get(), SYMBOL_DROP, extraPeer, 100, idleTicks) == EgressShaperDecision::Send);
+	CHECK(EgressShaperShape(shaper.get(), SYMBOL_DROP, extraPeer, 100, idleTicks) == EgressShaperDecision::Dropped);
+
+	// The reclaimed peer cannot be tracked until another slot is idle.
+	CHECK(EgressShaperShape(shaper.get(), SYMBOL_CRITICAL, idlePeer, 100, idleTicks) == EgressShaperDecision::Unshaped);
+}
+
+/// <summary>
+/// A send recorded in a trace.
+/// </summary>
+struct TraceSend
+{
+	int64_t time; // ticks
+	int64_t symbol;
+	uint64_t peer;
+	uint64_t bytes;
+};
+
+/// <summary>
+/// The outcome of replaying a trace through a shaper, per symbol.
+/// </summary>
+struct TraceSymbolResult
+{
+	uint64_t sends;
+	uint64_t sent;
+	uint64_t sentBytes;
+	uint64_t dropped;
+	uint64_t superseded;
+	uint64_t released;
+	uint64_t unshaped;
+};
+
+/// <summary>
+/// Replays a trace through a shaper as the broadcaster hook would, releasing held sends whenever their peer is sent to.
+/// </summary>
+/// <param name="shaper">The shaper to replay the trace through.</param>
+/// <param name="trace">The sends to replay, in time order.</param>
+/// <param name="results">The outcome per symbol.</param>
+/// <param name="sentBytesByPeer">The bytes of low-priority symbols sent to each peer, including releases.</param>
+/// <returns>None</returns>
+void ReplayTrace(EgressShaper* shaper, const std::vector<TraceSend>& trace, std::map<int64_t, TraceSymbolResult>* results, std::map<uint64_t, uint64_t>* sentBytesByPeer)
+{
+	for (const TraceSend& send : trace)
+	{
+		TraceSymbolResult* result = &(*results)[send.symbol];
+		result->sends++;
+		EgressShaperDecision decision = EgressShaperShape(shaper, send.symbol, send.peer, send.bytes, send.time);
+		if (decision == EgressShaperDecision::Dropped)
+		{
+			result->dropped++;
+		}
+		else if (decision == EgressShaperDecision::Coalesced)
+		{
+			EgressShaperHeldSend* superseded = EgressShaperHold(shaper, EgressShaperAllocateHeldSend(send.symbol, send.peer, send.bytes, 0));
+			if (superseded != NULL)
+			{
+				result->superseded++;
+				EgressShaperFreeHeldSend(superseded);
+			}
+		}
+		else
+		{
+			result->sent++;
+			result->sentBytes += send.bytes;
+			result->unshaped += decision == EgressShaperDecision::Unshaped;
+			if (EgressShaperFindPolicy(shaper, send.symbol) >= 0)
+				(*sentBytesByPeer)[send.peer] += send.bytes;
+		}
+
+		EgressShaperHeldSend* released;
+		while ((released = EgressShaperRelease(shaper, send.peer, send.time)) != NULL)
+		{
+			TraceSymbolResult* releasedResult = &(*results)[released->symbol];
+			releasedResult->released++;
+			releasedResult->sentBytes += released->bytes;
+			(*sentBytesByPeer)[released->peer] += released->bytes;
+			EgressShaperFreeHeldSend(released);
+		}
+	}
+}
+
+/// <summary>
+/// Generates a trace resembling a match: at 60 ticks per second, each peer is sent a critical state update, a coalescable
+/// pose update, and (every third tick) a droppable effect. Some peers have larger updates, as if they were spectating.
+/// </summary>
+/// <param name="peers">The amount of peers.</param>
+/// <param name="seconds">The length of the trace, in seconds.</param>
+/// <returns>The trace.</returns>
+std::vector<TraceSend> GenerateMatchTrace(uint32_t peers, uint32_t seconds)
+{
+	std::vector<TraceSend> trace;
+	for (uint32_t tick = 0; tick < seconds * 60; tick++)
+	{
+		int64_t time = (int64_t)tick * FREQUENCY / 60;
+		for (uint64_t peer = 0; peer < peers; peer++)
+		{
+			uint64_t scale = peer % 4 == 0 ? 3 : 1;
+			trace.push_back({ time, SYMBOL_CRITICAL, peer, 200 * scale });
+			trace.push_back({ time, SYMBOL_COALESCE, peer, 150 * scale });
+			if (tick % 3 == 0)
+				trace.push_back({ time, SYMBOL_DROP, peer, 400 });
+		}
+	}
+	return trace;
+}
+
+void TestReplaysMatchTrace()
+{
+	// The peers need about 30KB/s each (90KB/s if spectating), while the shaper allows 40KB/s each.
+	const uint32_t peers = 16, seconds = 30;
+	const uint64_t rate = 40000, burst = 16384;
+	std::unique_ptr<EgressShaper> shaper = CreateShaper(rate, burst);
+	std::vector<TraceSend> trace = GenerateMatchTrace(peers, seconds);
+	std::map<int64_t, TraceSymbolResult> results;
+	std::map<uint64_t, uint64_t> sentBytesByPeer;
+	ReplayTrace(shaper.get(), trace, &results, &sentBytesByPeer);
+
+	// Critical traffic is always sent.
+	CHECK(results[SYMBOL_CRITICAL].sent == results[SYMBOL_CRITICAL].sends);
+
+	// Every low-priority send is accounted for, and is only held back for the congested peers.
+	const TraceSymbolResult& drop = results[SYMBOL_DROP];
+	const TraceSymbolResult& coalesce = results[SYMBOL_COALESCE];
+	CHECK(drop.sent + drop.dropped == drop.sends);
+	CHECK(coalesce.sent + coalesce.superseded + coalesce.released <= coalesce.sends);
+	CHECK(coalesce.sent + coalesce.superseded + coalesce.released + peers >= coalesce.sends);
+	CHECK(drop.dropped > 0 && coalesce.superseded > 0 && coalesce.released > 0);
+	CHECK(drop.unshaped == 0 && coalesce.unshaped == 0);
+
+	// Congested peers still receive a coalesced update at least once per interval.
+	CHECK(coalesce.sent + coalesce.released >= peers * seconds * 1000 / EGRESS_SHAPER_DEFAULT_COALESCE_INTERVAL_MS);
+
+	// Only the congested (spectating) peers have their low-priority traffic held back, and within the rate, less the
+	// releases which the coalescing interval forces.
+	for (uint64_t peer = 0; peer < peers; peer++)
+	{
+		uint64_t offered = 0;
+		for (const TraceSend& send : trace)
+			offered += send.peer == peer && send.symbol != SYMBOL_CRITICAL ? send.bytes : 0;
+		if (peer % 4 != 0)
+		{
+			CHECK(sentBytesByPeer[peer] == offered);
+			continue;
+		}
+		uint64_t forced = (uint64_t)seconds * 1000 / EGRESS_SHAPER_DEFAULT_COALESCE_INTERVAL_MS * 450;
+		CHECK(sentBytesByPeer[peer] < offered);
+		CHECK(sentBytesByPeer[peer] <= rate * seconds + burst + forced);
+	}
+}
+
+/// <summary>
+/// Parses a trace dumped by `EchoRelay.Monitor -replay`, keeping only the broadcaster's sends.
+/// </summary>
+/// <param name="path">The path of the dump.</param>
+/// <param name="trace">The sends parsed.</param>
+/// <returns>True if the dump could be read, false otherwise.</returns>
+bool ReadMonitorTrace(const char* path, std::vector<TraceSend>* trace)
+{
+	FILE* file = fopen(path, "r");
+	if (file == NULL)
+		return false;
+	char line[1 << 16];
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		double seconds;
+		uint64_t symbol;
+		int64_t peer;
+		uint32_t size;
+		if (sscanf(line, " +%lfs broadcast send 0x%" SCNx64 " peer=%" SCNd64 " size=%" SCNu32, &seconds, &symbol, &peer, &size) == 4)
+			trace->push_back({ (int64_t)(seconds * FREQUENCY), (int64_t)symbol, (uint64_t)peer, size });
+	}
+	fclose(file);
+	return true;
+}
+
+/// <summary>
+/// Replays recorded traces through a shaper configured as on a game server, printing the outcome per symbol.
+/// </summary>
+/// <param name="argc">The amount of arguments.</param>
+/// <param name="argv">The arguments: -rate, -burst and -symbols (as the config keys), followed by the trace dumps.</param>
+/// <returns>Zero if every trace was replayed, non-zero otherwise.</returns>
+int ReplayRecordedTraces(int argc, char** argv)
+{
+	uint64_t rate = 0, burst = 0;
+	const char* symbols = "";
+	int result = 0;
+	for (int i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], "-rate") == 0 && i + 1 < argc)
+			rate = strtoull(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "-burst") == 0 && i + 1 < argc)
+			burst = strtoull(argv[++i], NULL, 10);
+		else if (strcmp(argv[i], "-symbols") == 0 && i + 1 < argc)
+			symbols = argv[++i];
+		else
+		{
+			std::vector<TraceSend> trace;
+			if (!ReadMonitorTrace(argv[i], &trace))
+			{
+				fprintf(stderr, "Failed to read trace %s.\n", argv[i]);
+				result = 1;
+				continue;
+			}
+			std::unique_ptr<EgressShaper> shaper(new EgressShaper());
+			EgressShaperInitialize(shaper.get(), FREQUENCY, rate, burst, symbols);
+			std::map<int64_t, TraceSymbolResult> results;
+			std::map<uint64_t, uint64_t> sentBytesByPeer;
+			ReplayTrace(shaper.get(), trace, &results, &sentBytesByPeer);
+			printf("%s: %zu sends, %zu peers\n", argv[i], trace.size(), sentBytesByPeer.size());
+			for (const auto& entry : results)
+			{
+				const TraceSymbolResult& symbol = entry.second;
+				printf("  0x%016" PRIX64 " sends=%" PRIu64 " sent=%" PRIu64 " bytes=%" PRIu64 " dropped=%" PRIu64 " superseded=%" PRIu64 " released=%" PRIu64 " unshaped=%" PRIu64 "\n",
+					(uint64_t)entry.first, symbol.sends, symbol.sent, symbol.sentBytes, symbol.dropped, symbol.superseded, symbol.released, symbol.unshaped);
+			}
+		}
+	}
+	return result;
+}
+
+int main(int argc, char** argv)
+{
+	// Replay recorded traces if any were provided, rather than running the tests.
+	if (argc > 1)
+		return ReplayRecordedTraces(argc, argv);
+
+	RUN_TEST(TestParsesPolicies);
+	RUN_TEST(TestCriticalTrafficIsNeverHeld);
+	RUN_TEST(TestBucketBurstAndRefill);
+	RUN_TEST(TestCoalescingKeepsLatest);
+	RUN_TEST(TestCoalescingIntervalUnderSustainedCongestion);
+	RUN_TEST(TestIdlePeersAreReclaimed);
+	RUN_TEST(TestReplaysMatchTrace);
+	return 0;
+}
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include "test.h"
+#include "foldedstacks.h"
+
+/// <summary>
+/// The base address of the executable module the tests symbolize against.
+/// </summary>
+const uint64_t GAME_BASE = 0x140000000ull;
+
+/// <summary>
+/// The base address of the library module the tests symbolize against, above the executable.
+/// </summary>
+const uint64_t LIBRARY_BASE = 0x7FF800000000ull;
+
+/// <summary>
+/// Creates an empty stack table for the tests. The table is too large to place on the stack.
+/// </summary>
+/// <returns>The stack table.</returns>
+std::unique_ptr<FoldedStacks> CreateStacks()
+{
+	std::unique_ptr<FoldedStacks> stacks(new FoldedStacks());
+	FoldedStacksReset(stacks.get());
+	return stacks;
+}
+
+/// <summary>
+/// Creates the module list the tests symbolize against: the executable and a library, added out of order.
+/// </summary>
+/// <returns>The module list, sorted by base address.</returns>
+std::unique_ptr<FoldedStacksModules> CreateModules()
+{
+	std::unique_ptr<FoldedStacksModules> modules(new FoldedStacksModules());
+	memset(modules.get(), 0, sizeof(*modules));
+	modules->count = 2;
+	modules->modules[0].base = LIBRARY_BASE;
+	modules->modules[0].size = 0x100000;
+	strcpy(modules->modules[0].name, "gameserver.dll");
+	modules->modules[1].base = GAME_BASE;
+	modules->modules[1].size = 0x2000000;
+	strcpy(modules->modules[1].name, "echovr.exe");
+	FoldedStacksSortModules(modules.get());
+	return modules;
+}
+
+/// <summary>
+/// Writes the aggregated stacks as folded stacks, and obtains the lines written in sorted order, as the table's order
+/// depends on the stacks' hashes.
+/// </summary>
+/// <param name="stacks">The stacks to write.</param>
+/// <param name="modules">The modules to symbolize frames against, or NULL.</param>
+/// <returns>The sorted lines written.</returns>
+std::vector<std::string> WriteFolded(const FoldedStacks* stacks, const FoldedStacksModules* modules)
+{
+	FILE* file = tmpfile();
+	CHECK(file != NULL);
+	uint32_t written = FoldedStacksWrite(stacks, modules, file);
+	rewind(file);
+
+	std::vector<std::string> lines;
+	char line[4096];
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		size_t length = strlen(line);
+		CHECK(length > 0 && line[length - 1] == '\n');
+		lines.push_back(std::string(line, length - 1));
+	}
+	fclose(file);
+	CHECK(lines.size() == written);
+	std::sort(lines.begin(), lines.end());
+	return lines;
+}
+
+/// <summary>
+/// Verifies repeated samples of a stack are counted against one line, while the same frames on another thread are not.
+/// </summary>
+void TestFoldsRepeatedStacks()
+{
+	std::unique_ptr<FoldedStacks> stacks = CreateStacks();
+	std::unique_ptr<FoldedStacksModules> modules = CreateModules();
+	const uint64_t tick[] = { GAME_BASE + 0x1D3881, GAME_BASE + 0x10, GAME_BASE + 0x4 };
+	const uint64_t idle[] = { LIBRARY_BASE + 0x20, GAME_BASE + 0x4 };
+	for (int i = 0; i < 3; i++)
+		CHECK(FoldedStacksAdd(stacks.get(), 1, tick, 3, false));
+	CHECK(FoldedStacksAdd(stacks.get(), 1, idle, 2, false));
+	CHECK(FoldedStacksAdd(stacks.get(), 2, tick, 3, false));
+	CHECK(stacks->sampleCount == 5);
+	CHECK(stacks->entryCount == 3);
+	CHECK(stacks->droppedCount == 0);
+
+	// Frames are written from the root to the leaf.
+	std::vector<std::string> lines = WriteFolded(stacks.get(), modules.get());
+	CHECK(lines.size() == 3);
+	CHECK(lines[0] == "thread 1;echovr.exe+0x4;echovr.exe+0x10;echovr.exe+0x1D3881 3");
+	CHECK(lines[1] == "thread 1;echovr.exe+0x4;gameserver.dll+0x20 1");
+	CHECK(lines[2] == "thread 2;echovr.exe+0x4;echovr.exe+0x10;echovr.exe+0x1D3881 1");
+}
+
+/// <summary>
+/// Verifies frames outside every module (below the first, between two, or past the end of one) are written as absolute
+/// addresses, as are all frames when no modules are provided.
+/// </summary>
+void TestSymbolMisses()
+{
+	std::unique_ptr<FoldedStacks> stacks = CreateStacks();
+	std::unique_ptr<FoldedStacksModules> modules = CreateModules();
+	CHECK(modules->modules[0].base == GAME_BASE);
+	const uint64_t frames[] = { 0x1000, GAME_BASE + 0x2000000, LIBRARY_BASE + 0xFFFFF, LIBRARY_BASE + 0x100000, GAME_BASE };
+	CHECK(FoldedStacksAdd(stacks.get(), 7, frames, 5, false));
+
+	CHECK(FoldedStacksFindModule(modules.get(), 0x1000) == NULL);
+	CHECK(FoldedStacksFindModule(modules.get(), GAME_BASE + 0x2000000) == NULL);
+	CHECK(FoldedStacksFindModule(modules.get(), LIBRARY_BASE + 0x100000) == NULL);
+	CHECK(FoldedStacksFindModule(modules.get(), LIBRARY_BASE + 0xFFFFF) == &modules->modules[1]);
+
+	std::vector<std::string> lines = WriteFolded(stacks.get(), modules.get());
+	CHECK(lines.size() == 1);
+	CHECK(lines[0] == "thread 7;echovr.exe+0x0;0x7FF800100000;gameserver.dll+0xFFFFF;0x142000000;0x1000 1");
+
+	lines = WriteFolded(stacks.get(), NULL);
+	CHECK(lines.size() == 1);
+	CHECK(lines[0] == "thread 7;0x140000000;0x7FF800100000;0x7FF8000FFFFF;0x142000000;0x1000 1");
+
+	// A stack symbolized against an empty module list is written as absolute addresses too.
+	FoldedStacksModules empty;
+	empty.count = 0;
+	CHECK(WriteFolded(stacks.get(), &empty) == lines);
+}
+
+/// <summary>
+/// Verifies stacks deeper than the frames retained keep their leaf frames and are marked as truncated at their root, and
+/// that a truncated stack is not folded into an untruncated one with the same frames.
+/// </summary>
+void TestTruncatedStacks()
+{
+	std::unique_ptr<FoldedStacks> stacks = CreateStacks();
+	std::unique_ptr<FoldedStacksModules> modules = CreateModules();
+	uint64_t deep[FOLDED_STACKS_MAX_FRAMES + 6];
+	for (uint32_t i = 0; i < FOLDED_STACKS_MAX_FRAMES + 6; i++)
+		deep[i] = GAME_BASE + 0x100 + i;
+	CHECK(FoldedStacksAdd(stacks.get(), 1, deep, FOLDED_STACKS_MAX_FRAMES + 6, false));
+	CHECK(FoldedStacksAdd(stacks.get(), 1, deep, FOLDED_STACKS_MAX_FRAMES + 1, false));
+	CHECK(stacks->entryCount == 1);
+
+	// A stack already truncated by the sampler is kept apart from the same frames sampled whole.
+	CHECK(FoldedStacksAdd(stacks.get(), 1, deep, 2, true));
+	CHECK(FoldedStacksAdd(stacks.get(), 1, deep, 2, false));
+	CHECK(stacks->entryCount == 3);
+
+	std::string expected = "thread 1;...";
+	for (uint32_t i = FOLDED_STACKS_MAX_FRAMES; i > 0; i--)
+	{
+		char frame[32];
+		snprintf(frame, sizeof(frame), ";echovr.exe+0x%X", 0x100 + i - 1);
+		expected += frame;
+	}
+	expected += " 2";
+	std::vector<std::string> lines = WriteFolded(stacks.get(), modules.get());
+	CHECK(lines.size() == 3);
+	CHECK(lines[0] == "thread 1;...;echovr.exe+0x101;echovr.exe+0x100 1");
+	CHECK(lines[1] == expected);
+	CHECK(lines[2] == "thread 1;echovr.exe+0x101;echovr.exe+0x100 1");
+}
+
+/// <summary>
+/// Verifies new stacks are dropped once the table holds its maximum amount of entries, while stacks already in it are
+/// still counted, and that resetting the table empties it.
+/// </summary>
+void TestDropsNewStacksWhenFull()
+{
+	std::unique_ptr<FoldedStacks> stacks = CreateStacks();
+	for (uint32_t i = 0; i < FOLDED_STACKS_MAX_ENTRIES; i++)
+	{
+		uint64_t frame = GAME_BASE + i;
+		CHECK(FoldedStacksAdd(stacks.get(), 1, &frame, 1, false));
+	}
+	CHECK(stacks->entryCount == FOLDED_STACKS_MAX_ENTRIES);
+
+	uint64_t frame = GAME_BASE + FOLDED_STACKS_MAX_ENTRIES;
+	CHECK(!FoldedStacksAdd(stacks.get(), 1, &frame, 1, false));
+	frame = GAME_BASE;
+	CHECK(FoldedStacksAdd(stacks.get(), 1, &frame, 1, false));
+	CHECK(stacks->sampleCount == FOLDED_STACKS_MAX_ENTRIES + 2);
+	CHECK(stacks->droppedCount == 1);
+	CHECK(WriteFolded(stacks.get(), NULL).size() == FOLDED_STACKS_MAX_ENTRIES);
+
+	FoldedStacksReset(stacks.get());
+	CHECK(stacks->sampleCount == 0 && stacks->entryCount == 0);
+	CHECK(WriteFolded(stacks.get(), NULL).empty());
+}
+
+int main()
+{
+	RUN_TEST(TestFoldsRepeatedStacks);
+	RUN_TEST(TestSymbolMisses);
+	RUN_TEST(TestTruncatedStacks);
+	RUN_TEST(TestDropsNewStacksWhenFull);
+	return 0;
+}
@@ -0,0 +1,260 @@
+#include <vector>
+#include "test.h"
+#include "loadgovernor.h"
+
+/// <summary>
+/// The interval between the simulated game server's ticks, in milliseconds (100 ticks per governor window).
+/// </summary>
+const uint64_t TICK_MS = 10;
+
+/// <summary>
+/// The tick duration the tests configure as the budget, in microseconds.
+/// </summary>
+const uint32_t TICK_BUDGET_US = 20000;
+
+/// <summary>
+/// A change in whether the governor is shedding load, and when it occurred.
+/// </summary>
+struct Transition
+{
+	uint64_t timeMs;
+	LoadGovernorAction action;
+};
+
+/// <summary>
+/// A simulated game server, driving a governor with its ticks as GameServerLib::Update does.
+/// </summary>
+struct Simulation
+{
+	LoadGovernor governor;
+	uint64_t nowMs;
+	uint32_t overrunCredit; // permille of an overrun accumulated, so overruns are spread evenly across ticks
+	std::vector<Transition> transitions;
+};
+
+/// <summary>
+/// Obtains the governor configuration the tests use unless stated otherwise: shedding once 10% of ticks overrun for five
+/// seconds, and recovering once 5% or fewer overrun for thirty seconds.
+/// </summary>
+/// <returns>The configuration.</returns>
+LoadGovernorConfig CreateConfig()
+{
+	LoadGovernorConfig config;
+	config.tickBudgetUs = TICK_BUDGET_US;
+	config.shedOverrunRate = 100;
+	config.recoverOverrunRate = 50;
+	config.shedCpuUsage = 0;
+	config.recoverCpuUsage = 0;
+	config.shedHoldMs = LOAD_GOVERNOR_DEFAULT_SHED_HOLD_MS;
+	config.recoverHoldMs = LOAD_GOVERNOR_DEFAULT_RECOVER_HOLD_MS;
+	return config;
+}
+
+/// <summary>
+/// Initializes a simulation with a governor using the given configuration.
+/// </summary>
+/// <param name="simulation">The simulation to initialize.</param>
+/// <param name="config">The governor's configuration.</param>
+/// <returns>None</returns>
+void SimulationInitialize(Simulation* simulation, const LoadGovernorConfig& config)
+{
+	LoadGovernorInitialize(&simulation->governor, &config);
+	simulation->nowMs = 1000;
+	simulation->overrunCredit = 0;
+	simulation->transitions.clear();
+}
+
+/// <summary>
+/// Runs the simulated game server for a duration, with a portion of its ticks overrunning their budget, evaluating the
+/// governor whenever its window is due and recording the transitions it makes.
+/// </summary>
+/// <param name="simulation">The simulation to run.</param>
+/// <param name="durationMs">The amount of time to run for, in milliseconds.</param>
+/// <param name="overrunRate">The portion of ticks which overrun, in permille.</param>
+/// <param name="cpuUsage">The CPU usage reported for each window, in hundredths of a percent.</param>
+/// <returns>None</returns>
+void SimulationRun(Simulation* simulation, uint64_t durationMs, uint32_t overrunRate, uint32_t cpuUsage)
+{
+	for (uint64_t elapsedMs = 0; elapsedMs < durationMs; elapsedMs += TICK_MS)
+	{
+		simulation->nowMs += TICK_MS;
+		simulation->overrunCredit += overrunRate;
+		bool overrun = simulation->overrunCredit >= 1000;
+		if (overrun)
+			simulation->overrunCredit -= 1000;
+		LoadGovernorRecordTick(&simulation->governor, overrun ? TICK_BUDGET_US * 2 : TICK_BUDGET_US / 2, simulation->nowMs);
+		if (!LoadGovernorWindowDue(&simulation->governor, simulation->nowMs))
+			continue;
+		LoadGovernorAction action = LoadGovernorEvaluate(&simulation->governor, cpuUsage, simulation->nowMs);
+		if (action != LoadGovernorAction::None)
+			simulation->transitions.push_back({ simulation->nowMs, action });
+	}
+}
+
+/// <summary>
+/// Verifies sustained overload sheds once it has lasted the shed hold time, and that the governor recovers only once
+/// load has stayed at or below the recovery threshold for the recovery hold time.
+/// </summary>
+void TestShedsAndRecoversAfterHold()
+{
+	Simulation simulation;
+	SimulationInitialize(&simulation, CreateConfig());
+	SimulationRun(&simulation, 60000, 0, 0);
+	CHECK(simulation.transitions.empty());
+
+	uint64_t overloadStartMs = simulation.nowMs;
+	SimulationRun(&simulation, 20000, 300, 0);
+	CHECK(simulation.transitions.size() == 1);
+	CHECK(simulation.transitions[0].action == LoadGovernorAction::Shed);
+	CHECK(simulation.transitions[0].timeMs >= overloadStartMs + LOAD_GOVERNOR_DEFAULT_SHED_HOLD_MS);
+	CHECK(simulation.transitions[0].timeMs <= overloadStartMs + LOAD_GOVERNOR_DEFAULT_SHED_HOLD_MS + 2 * LOAD_GOVERNOR_WINDOW_MS);
+	CHECK(simulation.governor.shedding);
+
+	uint64_t recoveryStartMs = simulation.nowMs;
+	SimulationRun(&simulation, 60000, 10, 0);
+	CHECK(simulation.transitions.size() == 2);
+	CHECK(simulation.transitions[1].action == LoadGovernorAction::Recover);
+	CHECK(simulation.transitions[1].timeMs >= recoveryStartMs + LOAD_GOVERNOR_DEFAULT_RECOVER_HOLD_MS);
+	CHECK(simulation.transitions[1].timeMs <= recoveryStartMs + LOAD_GOVERNOR_DEFAULT_RECOVER_HOLD_MS + 2 * LOAD_GOVERNOR_WINDOW_MS);
+	CHECK(!simulation.governor.shedding);
+}
+
+/// <summary>
+/// Verifies overload spikes shorter than the shed hold time never shed load, however often they recur.
+/// </summary>
+void TestSpikesDoNotShed()
+{
+	Simulation simulation;
+	SimulationInitialize(&simulation, CreateConfig());
+	for (int i = 0; i < 100; i++)
+	{
+		SimulationRun(&simulation, 4000, 500, 0);
+		SimulationRun(&simulation, 1000, 0, 0);
+	}
+	CHECK(simulation.transitions.empty());
+	CHECK(!simulation.governor.shedding);
+}
+
+/// <summary>
+/// Verifies load between the recovery and shed thresholds holds the governor in whichever state it is in: it neither
+/// sheds while not shedding, nor recovers while shedding, even as load crosses back and forth over the shed threshold.
+/// </summary>
+void TestHoldsStateBetweenThresholds()
+{
+	Simulation simulation;
+	SimulationInitialize(&simulation, CreateConfig());
+	SimulationRun(&simulation, 300000, 80, 0);
+	CHECK(simulation.transitions.empty());
+
+	SimulationRun(&simulation, 10000, 200, 0);
+	CHECK(simulation.transitions.size() == 1);
+	for (int i = 0; i < 60; i++)
+	{
+		SimulationRun(&simulation, 3000, 120, 0);
+		SimulationRun(&simulation, 2000, 60, 0);
+	}
+	CHECK(simulation.transitions.size() == 1);
+	CHECK(simulation.governor.shedding);
+
+	// Recovery windows interrupted by load above the recovery threshold restart the hold.
+	for (int i = 0; i < 10; i++)
+	{
+		SimulationRun(&simulation, 20000, 0, 0);
+		SimulationRun(&simulation, 1000, 60, 0);
+	}
+	CHECK(simulation.transitions.size() == 1);
+	CHECK(simulation.governor.shedding);
+}
+
+/// <summary>
+/// Verifies load which hovers around the shed threshold, varying every window, does not flap: the governor changes
+/// state rarely, and always remains in each state for at least its hold time.
+/// </summary>
+void TestNoisyLoadDoesNotFlap()
+{
+	Simulation simulation;
+	SimulationInitialize(&simulation, CreateConfig());
+
+	// Vary the overrun rate each window, with a fixed seed, for two hours. Stretches of 1 to 60 windows at or above the
+	// shed threshold (10% to 15%) alternate with stretches at or below the recovery threshold (0% to 5%).
+	uint32_t seed = 12345;
+	uint32_t stretch = 0;
+	bool overloaded = false;
+	for (int window = 0; window < 7200; window++)
+	{
+		seed = seed * 1103515245 + 12345;
+		if (stretch == 0)
+		{
+			stretch = 1 + (seed >> 16) % 60;
+			overloaded = !overloaded;
+		}
+		stretch--;
+		uint32_t overrunRate = (overloaded ? 100 : 0) + (seed >> 8) % 51;
+		SimulationRun(&simulation, LOAD_GOVERNOR_WINDOW_MS, overrunRate, 0);
+	}
+
+	// The governor must have changed state in both directions, so the dwell times below are meaningful.
+	CHECK(simulation.transitions.size() >= 4);
+	for (size_t i = 0; i < simulation.transitions.size(); i++)
+	{
+		const Transition& transition = simulation.transitions[i];
+		CHECK(transition.action == (i % 2 == 0 ? LoadGovernorAction::Shed : LoadGovernorAction::Recover));
+		if (i == 0)
+			continue;
+		uint64_t dwellMs = transition.timeMs - simulation.transitions[i - 1].timeMs;
+		CHECK(dwellMs >= (transition.action == LoadGovernorAction::Recover ? LOAD_GOVERNOR_DEFAULT_RECOVER_HOLD_MS : LOAD_GOVERNOR_DEFAULT_SHED_HOLD_MS));
+	}
+}
+
+/// <summary>
+/// Verifies the CPU signal sheds and recovers with its own thresholds, and that recovery requires every enabled signal
+/// to have recovered.
+/// </summary>
+void TestCpuSignal()
+{
+	LoadGovernorConfig config = CreateConfig();
+	config.shedCpuUsage = 9000;
+	config.recoverCpuUsage = 8000;
+	Simulation simulation;
+	SimulationInitialize(&simulation, config);
+	SimulationRun(&simulation, 60000, 0, 8900);
+	CHECK(simulation.transitions.empty());
+
+	SimulationRun(&simulation, 10000, 0, 9500);
+	CHECK(simulation.transitions.size() == 1);
+	SimulationRun(&simulation, 120000, 0, 8500);
+	CHECK(simulation.transitions.size() == 1);
+
+	// CPU has recovered, but ticks still overrun above the recovery threshold.
+	SimulationRun(&simulation, 120000, 80, 5000);
+	CHECK(simulation.transitions.size() == 1);
+	SimulationRun(&simulation, 60000, 0, 5000);
+	CHECK(simulation.transitions.size() == 2);
+	CHECK(simulation.transitions[1].action == LoadGovernorAction::Recover);
+}
+
+/// <summary>
+/// Verifies a governor without shed thresholds is disabled, and never sheds load.
+/// </summary>
+void TestDisabledNeverSheds()
+{
+	LoadGovernorConfig config = CreateConfig();
+	config.shedOverrunRate = 0;
+	config.recoverOverrunRate = 0;
+	Simulation simulation;
+	SimulationInitialize(&simulation, config);
+	CHECK(!LoadGovernorEnabled(&simulation.governor));
+	SimulationRun(&simulation, 60000, 1000, 10000);
+	CHECK(simulation.transitions.empty());
+}
+
+int main()
+{
+	RUN_TEST(TestShedsAndRecoversAfterHold);
+	RUN_TEST(TestSpikesDoNotShed);
+	RUN_TEST(TestHoldsStateBetweenThresholds);
+	RUN_TEST(TestNoisyLoadDoesNotFlap);
+	RUN_TEST(TestCpuSignal);
+	RUN_TEST(TestDisabledNeverSheds);
+	return 0;
+}
@@ -0,0 +1,163 @@
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include "test.h"
+#include "lobbysnapshotlayout.h"
+
+// The layout is shared with readers built separately (monitors, the launcher), so every offset is pinned here, not just the sizes.
+static_assert(offsetof(LobbySnapshot, magic) == 0x00, "LobbySnapshot.magic moved.");
+static_assert(offsetof(LobbySnapshot, version) == 0x04, "LobbySnapshot.version moved.");
+static_assert(offsetof(LobbySnapshot, size) == 0x08, "LobbySnapshot.size moved.");
+static_assert(offsetof(LobbySnapshot, processId) == 0x0C, "LobbySnapshot.processId moved.");
+static_assert(offsetof(LobbySnapshot, sequence) == 0x10, "LobbySnapshot.sequence moved.");
+static_assert(offsetof(LobbySnapshot, netGameState) == 0x18, "LobbySnapshot.netGameState moved.");
+static_assert(offsetof(LobbySnapshot, captureId) == 0x1C, "LobbySnapshot.captureId moved.");
+static_assert(offsetof(LobbySnapshot, data) == 0x20, "LobbySnapshot.data moved.");
+static_assert(sizeof(LobbySnapshot) == 0x20 + sizeof(LobbySnapshotData), "LobbySnapshot has trailing padding.");
+
+static_assert(offsetof(LobbySnapshotData, entrantsLocked) == 0x10, "LobbySnapshotData.entrantsLocked moved.");
+static_assert(offsetof(LobbySnapshotData, entrantCount) == 0x1C, "LobbySnapshotData.entrantCount moved.");
+static_assert(offsetof(LobbySnapshotData, serverId) == 0x20, "LobbySnapshotData.serverId moved.");
+static_assert(offsetof(LobbySnapshotData, regionId) == 0x28, "LobbySnapshotData.regionId moved.");
+static_assert(offsetof(LobbySnapshotData, updateCount) == 0x38, "LobbySnapshotData.updateCount moved.");
+static_assert(offsetof(LobbySnapshotData, publishTime) == 0x50, "LobbySnapshotData.publishTime moved.");
+static_assert(offsetof(LobbySnapshotData, serverDbRtt) == 0x70, "LobbySnapshotData.serverDbRtt moved.");
+static_assert(offsetof(LobbySnapshotData, netStatsFlags) == 0x7C, "LobbySnapshotData.netStatsFlags moved.");
+static_assert(offsetof(LobbySnapshotData, udpReceiveErrors) == 0x80, "LobbySnapshotData.udpReceiveErrors moved.");
+static_assert(offsetof(LobbySnapshotData, workerQueueDepth) == 0x98, "LobbySnapshotData.workerQueueDepth moved.");
+static_assert(offsetof(LobbySnapshotData, workerTurnaroundMax) == 0xA4, "LobbySnapshotData.workerTurnaroundMax moved.");
+static_assert(offsetof(LobbySnapshotData, entrants) == 0xA8, "LobbySnapshotData.entrants moved.");
+
+static_assert(offsetof(LobbySnapshotEntrant, platformId) == 0x10, "LobbySnapshotEntrant.platformId moved.");
+static_assert(offsetof(LobbySnapshotEntrant, displayName) == 0x18, "LobbySnapshotEntrant.displayName moved.");
+static_assert(offsetof(LobbySnapshotEntrant, ping) == 0x3C, "LobbySnapshotEntrant.ping moved.");
+static_assert(offsetof(LobbySnapshotEntrant, teamIndex) == 0x3E, "LobbySnapshotEntrant.teamIndex moved.");
+static_assert(offsetof(LobbySnapshotEntrant, genIndex) == 0x40, "LobbySnapshotEntrant.genIndex moved.");
+
+/// <summary>
+/// Fills the snapshot data with values all derived from a single generation, so a copy mixing two writes can be detected.
+/// </summary>
+static void WriteGeneration(LobbySnapshotData* data, uint64_t generation)
+{
+	data->updateCount = generation;
+	data->messagesSent = generation * 3;
+	data->serverDbRtt = (uint32_t)generation;
+	data->entrantCount = (uint32_t)(generation % LOBBY_SNAPSHOT_MAX_ENTRANTS);
+	for (uint32_t i = 0; i < LOBBY_SNAPSHOT_MAX_ENTRANTS; i++)
+	{
+		data->entrants[i].userId.accountId = generation + i;
+		memset(data->entrants[i].displayName, (int)(generation & 0x7F), sizeof(data->entrants[i].displayName));
+		data->entrants[i].ping = (uint16_t)generation;
+	}
+}
+
+/// <summary>
+/// Checks that a copy of the snapshot data was taken from a single generation.
+/// </summary>
+static bool IsConsistent(const LobbySnapshotData* data)
+{
+	uint64_t generation = data->updateCount;
+	if (data->messagesSent != generation * 3 || data->serverDbRtt != (uint32_t)generation || data->entrantCount != (uint32_t)(generation % LOBBY_SNAPSHOT_MAX_ENTRANTS))
+		return false;
+	for (uint32_t i = 0; i < LOBBY_SNAPSHOT_MAX_ENTRANTS; i++)
+	{
+		const LobbySnapshotEntrant* entrant = &data->entrants[i];
+		if (entrant->userId.accountId != generation + i || entrant->ping != (uint16_t)generation)
+			return false;
+		for (size_t j = 0; j < sizeof(entrant->displayName); j++)
+		{
+			if (entrant->displayName[j] != (char)(generation & 0x7F))
+				return false;
+		}
+	}
+	return true;
+}
+
+static void TestReadSucceedsWhenIdle()
+{
+	static LobbySnapshot snapshot;
+	memset((void*)&snapshot, 0, sizeof(snapshot));
+	LobbySnapshotBeginWrite(&snapshot);
+	WriteGeneration(&snapshot.data, 42);
+	LobbySnapshotEndWrite(&snapshot);
+	CHECK(snapshot.sequence.load() == 2);
+
+	LobbySnapshotData data;
+	CHECK(LobbySnapshotRead(&snapshot, &data));
+	CHECK(data.updateCount == 42);
+	CHECK(IsConsistent(&data));
+}
+
+static void TestReadFailsDuringWrite()
+{
+	// A reader must give up, rather than return data, while a write is left in progress.
+	static LobbySnapshot snapshot;
+	memset((void*)&snapshot, 0, sizeof(snapshot));
+	LobbySnapshotBeginWrite(&snapshot);
+	CHECK(snapshot.sequence.load() & 1);
+
+	LobbySnapshotData data;
+	CHECK(!LobbySnapshotRead(&snapshot, &data));
+	LobbySnapshotEndWrite(&snapshot);
+	CHECK(LobbySnapshotRead(&snapshot, &data));
+}
+
+static void TestConcurrentReadsAreNeverTorn()
+{
+	// A writer publishes generations continuously, while a reader verifies every copy it obtains came from a single one.
+	static LobbySnapshot snapshot;
+	memset((void*)&snapshot, 0, sizeof(snapshot));
+	WriteGeneration(&snapshot.data, 0);
+	std::atomic<bool> stop(false);
+	std::atomic<uint64_t> generations(0);
+	std::atomic<uint32_t> spin(0);
+	std::thread writer([&]()
+	{
+		uint64_t generation = 0;
+		while (!stop.load(std::memory_order_relaxed))
+		{
+			LobbySnapshotBeginWrite(&snapshot);
+			WriteGeneration(&snapshot.data, ++generation);
+			LobbySnapshotEndWrite(&snapshot);
+
+			// Leave the snapshot consistent for a short while, as the game server does between publishes (though far shorter).
+			for (uint32_t i = 0; i < 256; i++)
+				spin.fetch_add(1, std::memory_order_relaxed);
+		}
+		generations.store(generation);
+	});
+
+	const uint64_t attempts = 200000;
+	uint64_t reads = 0;
+	uint64_t torn = 0;
+	uint64_t lastGeneration = 0;
+	bool regressed = false;
+	LobbySnapshotData data;
+	for (uint64_t attempt = 0; attempt < attempts; attempt++)
+	{
+		if (!LobbySnapshotRead(&snapshot, &data))
+			continue;
+		reads++;
+		if (!IsConsistent(&data))
+			torn++;
+		if (data.updateCount < lastGeneration)
+			regressed = true;
+		lastGeneration = data.updateCount;
+	}
+	stop.store(true);
+	writer.join();
+
+	printf("  %llu of %llu reads consistent over %llu generations\n", (unsigned long long)(reads - torn), (unsigned long long)attempts, (unsigned long long)generations.load());
+	CHECK(reads > 0);
+	CHECK(torn == 0);
+	CHECK(!regressed);
+	CHECK(snapshot.sequence.load() == generations.load() * 2);
+}
+
+int main()
+{
+	RUN_TEST(TestReadSucceedsWhenIdle);
+	RUN_TEST(TestReadFailsDuringWrite);
+	RUN_TEST(TestConcurrentReadsAreNeverTorn);
+	return 0;
+}
@@ -0,0 +1,225 @@
+#include <vector>
+#include "test.h"
+#include "supervisor.h"
+#include "fakebackend.h"
+
+/// <summary>
+/// The interval at which the tests tick the supervisor, in milliseconds. This matches the launcher.
+/// </summary>
+const uint64_t TICK_INTERVAL_MS = 1000;
+
+/// <summary>
+/// A supervisor driven by a fake backend on a simulated clock, which records every state change it reports.
+/// </summary>
+struct SimulatedFleet
+{
+	struct Transition
+	{
+		uint64_t time;
+		uint64_t id;
+		InstanceState previousState;
+		InstanceState state;
+	};
+
+	uint64_t now;
+	FakeInstanceBackend backend;
+	FleetSupervisor supervisor;
+	std::vector<Transition> transitions;
+
+	SimulatedFleet(const FleetSupervisorConfig& config, uint64_t bootDurationMs)
+		: now(0), backend(&now, bootDurationMs), supervisor(&backend, config)
+	{
+		supervisor.OnInstanceStateChanged = [this](const SupervisedInstance& instance, InstanceState previousState)
+		{
+			transitions.push_back({ now, instance.id, previousState, instance.state });
+		};
+	}
+
+	/// <summary>
+	/// Ticks the supervisor at the tick interval until the given simulated time.
+	/// </summary>
+	void RunUntil(uint64_t time)
+	{
+		for (; now <= time; now += TICK_INTERVAL_MS)
+			supervisor.Tick(now);
+	}
+
+	/// <summary>
+	/// Obtains the times at which instances were launched.
+	/// </summary>
+	std::vector<uint64_t> LaunchTimes() const
+	{
+		std::vector<uint64_t> times;
+		for (const Transition& transition : transitions)
+		{
+			if (transition.previousState == InstanceState::Exited && transition.state == InstanceState::Booting)
+				times.push_back(transition.time);
+		}
+		return times;
+	}
+
+	/// <summary>
+	/// Obtains the identifier of the first instance in a given state.
+	/// </summary>
+	uint64_t FirstInstance(InstanceState state) const
+	{
+		for (const SupervisedInstance& instance : supervisor.GetInstances())
+		{
+			if (instance.state == state)
+				return instance.id;
+		}
+		return 0;
+	}
+};
+
+static FleetSupervisorConfig CreateConfig()
+{
+	FleetSupervisorConfig config;
+	config.standbyCount = 2;
+	config.maxInstances = 4;
+	config.maxConcurrentBoots = 1;
+	config.launchStaggerMs = 10000;
+	config.bootTimeoutMs = 60000;
+	return config;
+}
+
+static void TestSpawnsStandbyPoolStaggered()
+{
+	// Boots are limited to one at a time, so the second standby launches once the first registers (after its stagger).
+	SimulatedFleet fleet(CreateConfig(), 5000);
+	fleet.RunUntil(30000);
+	std::vector<uint64_t> launches = fleet.LaunchTimes();
+	CHECK(launches.size() == 2);
+	CHECK(launches[0] == 0);
+	CHECK(launches[1] == 10000);
+	CHECK(fleet.supervisor.CountInstances(InstanceState::Idle) == 2);
+	CHECK(fleet.supervisor.CountInstances(InstanceState::Booting) == 0);
+
+	const FleetStatistics& statistics = fleet.supervisor.GetStatistics();
+	CHECK(statistics.launches == 2);
+	CHECK(statistics.registrations == 2);
+	CHECK(statistics.bootToRegisteredMinMs == 5000);
+	CHECK(statistics.bootToRegisteredMaxMs == 5000);
+
+	// Once the pool is satisfied, nothing further is launched.
+	fleet.RunUntil(120000);
+	CHECK(fleet.LaunchTimes().size() == 2);
+}
+
+static void TestPromotedStandbyIsReplaced()
+{
+	// When a standby is given a session, the pool is short by one, so another instance is launched to replace it.
+	SimulatedFleet fleet(CreateConfig(), 5000);
+	fleet.RunUntil(30000);
+	uint64_t promoted = fleet.FirstInstance(InstanceState::Idle);
+	CHECK(promoted != 0);
+	fleet.backend.SetState(promoted, InstanceState::Busy);
+	fleet.RunUntil(31000);
+	CHECK(fleet.supervisor.CountInstances(InstanceState::Busy) == 1);
+	CHECK(fleet.supervisor.CountInstances(InstanceState::Booting) == 1);
+	CHECK(fleet.LaunchTimes().size() == 3);
+
+	fleet.RunUntil(40000);
+	CHECK(fleet.supervisor.CountInstances(InstanceState::Idle) == 2);
+	CHECK(fleet.supervisor.CountInstances(InstanceState::Busy) == 1);
+
+	// A session ending returns the instance to the pool, leaving it with a surplus rather than terminating anything.
+	fleet.backend.SetState(promoted, InstanceState::Idle);
+	fleet.RunUntil(60000);
+	CHECK(fleet.supervisor.CountInstances(InstanceState::Idle) == 3);
+	CHECK(fleet.LaunchTimes().size() == 3);
+}
+
+static void TestBusyInstancesRespectLimit()
+{
+	// With every instance hosting a session, the pool stops growing at the instance limit.
+	SimulatedFleet fleet(CreateConfig(), 5000);
+	for (uint64_t time = 0; time <= 300000; time += 5000)
+	{
+		fleet.RunUntil(time);
+		uint64_t idle;
+		while ((idle = fleet.FirstInstance(InstanceState::Idle)) != 0)
+		{
+			fleet.backend.SetState(idle, InstanceState::Busy);
+			fleet.RunUntil(fleet.now);
+		}
+	}
+	CHECK(fleet.supervisor.GetInstances().size() == 4);
+	CHECK(fleet.supervisor.CountInstances(InstanceState::Busy) == 4);
+	CHECK(fleet.LaunchTimes().size() == 4);
+}
+
+static void TestExitedInstanceReplacedImmediately()
+{
+	// Replacements for exited instances are not subject to the launch stagger.
+	SimulatedFleet fleet(CreateConfig(), 5000);
+	fleet.RunUntil(30000);
+	uint64_t exited = fleet.FirstInstance(InstanceState::Idle);
+	fleet.backend.SetState(exited, InstanceState::Exited);
+	fleet.RunUntil(31000);
+	std::vector<uint64_t> launches = fleet.LaunchTimes();
+	CHECK(launches.size() == 3);
+	CHECK(launches[2] == 31000);
+	CHECK(fleet.supervisor.GetStatistics().exits == 1);
+	for (const SupervisedInstance& instance : fleet.supervisor.GetInstances())
+		CHECK(instance.id != exited);
+}
+
+static void TestLaunchFailuresBackOff()
+{
+	// A failed launch drops pending replacements, so retries wait out the stagger instead of failing every tick.
+	SimulatedFleet fleet(CreateConfig(), 5000);
+	fleet.RunUntil(30000);
+	fleet.backend.FailLaunches(3);
+	fleet.backend.SetState(fleet.FirstInstance(InstanceState::Idle), InstanceState::Exited);
+	fleet.RunUntil(31000);
+	CHECK(fleet.supervisor.GetStatistics().launchFailures == 1);
+
+	// The remaining failures are each separated by the stagger, after which the launch succeeds.
+	fleet.RunUntil(40000);
+	CHECK(fleet.supervisor.GetStatistics().launchFailures == 1);
+	fleet.RunUntil(41000);
+	CHECK(fleet.supervisor.GetStatistics().launchFailures == 2);
+	fleet.RunUntil(51000);
+	CHECK(fleet.supervisor.GetStatistics().launchFailures == 3);
+	CHECK(fleet.LaunchTimes().size() == 2);
+	fleet.RunUntil(61000);
+	std::vector<uint64_t> launches = fleet.LaunchTimes();
+	CHECK(launches.size() == 3);
+	CHECK(launches[2] == 61000);
+	CHECK(fleet.supervisor.GetStatistics().launchFailures == 3);
+}
+
+static void TestBootTimeoutReplacesInstance()
+{
+	// Instances which never register are terminated at the boot timeout, and replaced.
+	SimulatedFleet fleet(CreateConfig(), 10 * 60 * 1000);
+	fleet.RunUntil(60000);
+	CHECK(fleet.supervisor.GetStatistics().bootTimeouts == 1);
+	CHECK(fleet.supervisor.GetStatistics().exits == 1);
+	std::vector<uint64_t> launches = fleet.LaunchTimes();
+	CHECK(launches.size() == 2);
+	CHECK(launches[1] == 60000);
+	CHECK(fleet.supervisor.CountInstances(InstanceState::Booting) == 1);
+	CHECK(fleet.supervisor.GetStatistics().registrations == 0);
+}
+
+static void TestShutdownTerminatesAll()
+{
+	SimulatedFleet fleet(CreateConfig(), 5000);
+	fleet.RunUntil(30000);
+	fleet.supervisor.Shutdown();
+	CHECK(fleet.supervisor.GetInstances().empty());
+}
+
+int main()
+{
+	RUN_TEST(TestSpawnsStandbyPoolStaggered);
+	RUN_TEST(TestPromotedStandbyIsReplaced);
+	RUN_TEST(TestBusyInstancesRespectLimit);
+	RUN_TEST(TestExitedInstanceReplacedImmediately);
+	RUN_TEST(TestLaunchFailuresBackOff);
+	RUN_TEST(TestBootTimeoutReplacesInstance);
+	RUN_TEST(TestShutdownTerminatesAll);
+	return 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdio>
+#include <cstdlib>
+
+// Minimal helpers for the native tests. Each test file builds into its own executable, which exits with a non-zero code
+// on the first failed check.
+
+/// <summary>
+/// Fails the running test if a condition does not hold.
+/// </summary>
+#define CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			exit(1); \
+		} \
+	} while (0)
+
+/// <summary>
+/// Runs a test function, printing its name once it passes.
+/// </summary>
+/// <param name="name">The name of the test.</param>
+/// <param name="test">The test function.</param>
+/// <returns>None</returns>
+inline void RunTest(const char* name, void (*test)())
+{
+	test();
+	printf("PASS %s\n", name);
+}
+
+#define RUN_TEST(test) RunTest(#test, test)
@@ -1,4 +1,15 @@
+#include <atomic>
+#include <vector>
+#include <algorithm>
 #include "echovrunexported.h"
+#include "lobbysnapshot.h"
+#include "flightrecorder.h"
+#include "startuptrace.h"
+#include "egressstats.h"
+#include "egressshaper.h"
+#include "capture.h"
+#include "profiler.h"
+#include "logsegments.h"
 #include "patches.h"
 #include "processmem.h"
 #include <detours.h>
@@ -40,6 +51,86 @@ HWND hWindow = NULL;
 /// </summary>
 EchoVR::Json* localConfig = NULL;
 
+/// <summary>
+/// The shared memory lobby snapshot for this process, used to publish the net game state to external monitors (dedicated servers only).
+/// </summary>
+LobbySnapshot* lobbySnapshot = NULL;
+/// <summary>
+/// The file mapping handle for the lobby snapshot.
+/// </summary>
+HANDLE lobbySnapshotMapping = NULL;
+
+/// <summary>
+/// The flight recorder holding recent patch events (net game state transitions, lifecycle events), dumped to disk when the process exits or crashes.
+/// </summary>
+FlightRecorder flightRecorder;
+/// <summary>
+/// The unhandled exception filter which was installed before ours, to be chained to.
+/// </summary>
+LPTOP_LEVEL_EXCEPTION_FILTER previousExceptionFilter = NULL;
+
+/// <summary>
+/// The startup trace shared with the game server library, used to time each phase of booting until the first registration.
+/// </summary>
+StartupTrace* startupTrace = NULL;
+/// <summary>
+/// The file mapping handle for the startup trace.
+/// </summary>
+HANDLE startupTraceMapping = NULL;
+/// <summary>
+/// The startup trace phase for the current net game state.
+/// </summary>
+UINT32 netGameStatePhase = STARTUP_TRACE_INVALID_EVENT;
+
+/// <summary>
+/// The shared memory egress statistics for this process, counting messages sent by the UDP broadcaster per message type and peer (dedicated servers only).
+/// </summary>
+EgressStats* egressStats = NULL;
+/// <summary>
+/// The file mapping handle for the egress statistics.
+/// </summary>
+HANDLE egressStatsMapping = NULL;
+/// <summary>
+/// The egress statistics table owned by the current thread, claimed on its first send.
+/// </summary>
+thread_local EgressStatsThreadTable* egressStatsThreadTable = NULL;
+/// <summary>
+/// Indicates whether the current thread has attempted to claim an egress statistics table.
+/// </summary>
+thread_local BOOL egressStatsThreadTableClaimed = FALSE;
+/// <summary>
+/// The amount of sends recorded by the current thread, used to sample the overhead of recording.
+/// </summary>
+thread_local UINT32 egressStatsThreadSends = 0;
+/// <summary>
+/// The per-peer egress shaper, which drops or coalesces configured low-priority symbols when a peer is congested (disabled unless configured).
+/// </summary>
+EgressShaper egressShaper;
+/// <summary>
+/// The capture writer for broadcaster sends, which follows the session capture started by the game server library (dedicated servers only).
+/// </summary>
+CaptureWriter capture;
+/// <summary>
+/// The capture identifier the capture writer was last synchronized to, claimed by the thread which opens or closes the capture.
+/// </summary>
+std::atomic<UINT32> captureTargetId(0);
+/// <summary>
+/// The maximum size of a capture file, in bytes.
+/// </summary>
+UINT64 captureCapacity = CAPTURE_DEFAULT_CAPACITY;
+/// <summary>
+/// The sampling profiler, which profiles each session when enabled (dedicated servers only).
+/// </summary>
+Profiler profiler;
+/// <summary>
+/// The log sink, which writes log lines to compressed, rotated segments when enabled (dedicated servers only).
+/// </summary>
+LogSink logSink;
+/// <summary>
+/// The net game state most recently transitioned to.
+/// </summary>
+EchoVR::NetGameState netGameState = EchoVR::NetGameState::LoggedOut;
+
 /// <summary>
 /// A timestep value in ticks/updates per second, to be used for headless mode (due to lack of GPU/refresh rate throttling).
 /// If non-zero, sets the timestep override by the given tick rate per second.
@@ -61,6 +152,9 @@ VOID FatalError(const CHAR* msg, const CHAR* title)
     if (msg == NULL)
         msg = "An unknown error occurred.";
 
+    // Record the error, so it is visible in the flight recorder dump on exit.
+    FlightRecorderRecord(&flightRecorder, FlightRecorderEventType::Lifecycle, (UINT64)FlightRecorderLifecycleEvent::FatalError, msg, strlen(msg));
+
     // Show a message box.
     MessageBoxA(NULL, msg, title, MB_OK);
 
@@ -107,6 +201,17 @@ VOID WriteLogHook(EchoVR::LogLevel logLevel, UINT64 unk, const CHAR* format, va_
     else if (!strcmp(format, "[NETGAME] No screen stats info for game mode %s")) // noisy in social lobby
         return;
 
+    // Stage the line for our log segments, if enabled.
+    LogSinkWrite(&logSink, logLevel, format, vl);
+
+    // This hook is also installed for log segments outside of headless mode, where there is no console to print to.
+    if (!isHeadless)
+    {
+        if (logSink.thread == NULL || logSink.passthrough)
+            EchoVR::WriteLog(logLevel, unk, format, vl);
+        return;
+    }
+
     // Print the ANSI color code prefix for the given log level.
     switch (logLevel)
     {
@@ -135,8 +240,9 @@ VOID WriteLogHook(EchoVR::LogLevel logLevel, UINT64 unk, const CHAR* format, va_
     // Print the ANSI color code for restoring the default text style.
     printf("\u001B[0m");
 
-    // Call the original method
-    EchoVR::WriteLog(logLevel, unk, format, vl);
+    // Call the original method, unless our log segments replace the game's own log.
+    if (logSink.thread == NULL || logSink.passthrough)
+        EchoVR::WriteLog(logLevel, unk, format, vl);
 }
 
 /// <summary>
@@ -337,6 +443,32 @@ VOID PatchDeadlockMonitor()
 /// <returns>None</returns>
 VOID NetGameSwitchStateHook(PVOID pGame, EchoVR::NetGameState state)
 {
+    // Record the transition in the flight recorder.
+    FlightRecorderRecord(&flightRecorder, FlightRecorderEventType::NetGameStateChange, (UINT64)state, NULL, 0);
+
+    // Profile each session on its own: discard samples taken between sessions once a level begins loading, and write the
+    // session's profile once it returns to the lobby.
+    if (state == EchoVR::NetGameState::LoadingLevel)
+        ProfilerRequest(&profiler, PROFILER_REQUEST_RESET);
+    else if (state == EchoVR::NetGameState::Lobby && netGameState > EchoVR::NetGameState::Lobby)
+        ProfilerRequest(&profiler, PROFILER_REQUEST_DUMP_SESSION);
+    netGameState = state;
+
+    // Time each net game state as a startup phase (e.g. the lobby load), until startup tracing ends.
+    CHAR phaseName[48];
+    sprintf_s(phaseName, "NetGame: %s", EchoVR::GetNetGameStateName(state));
+    StartupTraceEnd(startupTrace, netGameStatePhase);
+    netGameStatePhase = StartupTraceBegin(startupTrace, "netgame", phaseName);
+
+    // Publish the state to the lobby snapshot for external monitors, opening it the first time we need it.
+    if (isServer)
+    {
+        if (lobbySnapshot == NULL)
+            lobbySnapshot = LobbySnapshotOpen(GetCurrentProcessId(), TRUE, &lobbySnapshotMapping);
+        if (lobbySnapshot != NULL)
+            lobbySnapshot->netGameState.store((INT32)state, std::memory_order_relaxed);
+    }
+
     // Hook the net game switch state function, so we can redirect "load level failed" to a ready state again.
     // This way if a client requests a non-existent level, the game server library isn't unloaded due to a state
     // transition to "load failed" (because the level failed to load)
@@ -347,6 +479,7 @@ VOID NetGameSwitchStateHook(PVOID pGame, EchoVR::NetGameState state)
         // Note: This is an ugly hack, as the client will get an irrelevant connection failure message (server is full, 
         // failed to connect, etc). But at least it doesn't cause the server to get stuck in a "not ready" state in some menu.
         Log(EchoVR::LogLevel::Debug, "[ECHORELAY.PATCH] Dedicated server failed to load level. Resetting session to keep game server available.");
+        FlightRecorderRecord(&flightRecorder, FlightRecorderEventType::Lifecycle, (UINT64)FlightRecorderLifecycleEvent::LoadFailedReset, NULL, 0);
         EchoVR::NetGameScheduleReturnToLobby(pGame);
         return;
     }
@@ -355,6 +488,173 @@ VOID NetGameSwitchStateHook(PVOID pGame, EchoVR::NetGameState state)
     EchoVR::NetGameSwitchState(pGame, state);
 }
 
+/// <summary>
+/// The arguments of a broadcaster send held by the egress shaper, so it can be replayed once released. The message item
+/// follows, then the additional buffer.
+/// </summary>
+struct HeldBroadcasterSend
+{
+    EchoVR::Broadcaster* broadcaster;
+    INT32 mbThreadPriority;
+    UINT64 size;
+    UINT64 bufferLen;
+    UINT64 dest;
+    FLOAT priority;
+    EchoVR::SymbolId unk;
+};
+
+static_assert(EGRESS_SHAPER_INVALID_PEER == EchoVR::Peer_InvalidPeer, "The egress shaper's invalid peer must match the game's.");
+
+/// <summary>
+/// Sends a message with the game's UDP broadcaster, recording it in the session capture and egress statistics.
+/// </summary>
+/// <param name="broadcaster">The broadcaster to send with.</param>
+/// <param name="messageId">The message type symbol to send.</param>
+/// <param name="mbThreadPriority">TODO: Unknown</param>
+/// <param name="item">The message item to send.</param>
+/// <param name="size">The size of the message item.</param>
+/// <param name="buffer">An additional buffer to send with the message.</param>
+/// <param name="bufferLen">The size of the additional buffer.</param>
+/// <param name="peer">The peer to send the message to.</param>
+/// <param name="dest">TODO: Unknown</param>
+/// <param name="priority">The priority of the message.</param>
+/// <param name="unk">TODO: Unknown</param>
+/// <returns>The result of the original send function.</returns>
+INT32 BroadcasterSendRecorded(EchoVR::Broadcaster* broadcaster, EchoVR::SymbolId messageId, INT32 mbThreadPriority, VOID* item, UINT64 size, VOID* buffer, UINT64 bufferLen, EchoVR::Peer peer, UINT64 dest, FLOAT priority, EchoVR::SymbolId unk)
+{
+    // Follow the game server library's session capture, opening or closing ours when it changes.
+    if (lobbySnapshot != NULL)
+    {
+        UINT32 captureId = lobbySnapshot->captureId.load(std::memory_order_relaxed);
+        UINT32 currentCaptureId = captureTargetId.load(std::memory_order_relaxed);
+        if (captureId != currentCaptureId && captureTargetId.compare_exchange_strong(currentCaptureId, captureId))
+        {
+            if (captureId == 0)
+                CaptureWriterClose(&capture);
+            else
+                CaptureWriterOpen(&capture, "EchoRelay.Patch", captureId, captureCapacity);
+        }
+        CaptureWriterRecord(&capture, CaptureStream::BroadcasterSend, messageId, peer, item, size, buffer, bufferLen);
+    }
+
+    // Claim a table for this thread on its first send. If none remain, we only count the send in the totals.
+    if (!egressStatsThreadTableClaimed)
+    {
+        egressStatsThreadTable = EgressStatsClaimThreadTable(egressStats);
+        egressStatsThreadTableClaimed = TRUE;
+    }
+
+    // Record the send, periodically measuring how long recording takes.
+    EgressStatsThreadTable* table = egressStatsThreadTable;
+    if (table == NULL)
+    {
+        egressStats->untrackedMessages.fetch_add(1, std::memory_order_relaxed);
+        egressStats->untrackedBytes.fetch_add(size + bufferLen, std::memory_order_relaxed);
+    }
+    else if ((++egressStatsThreadSends & (EGRESS_STATS_OVERHEAD_SAMPLE_INTERVAL - 1)) == 0)
+    {
+        LARGE_INTEGER begin, end;
+        QueryPerformanceCounter(&begin);
+        EgressStatsRecord(table, messageId, peer, size + bufferLen);
+        QueryPerformanceCounter(&end);
+        table->overheadTicks.store(table->overheadTicks.load(std::memory_order_relaxed) + (end.QuadPart - begin.QuadPart), std::memory_order_relaxed);
+        table->overheadSamples.store(table->overheadSamples.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    else
+    {
+        EgressStatsRecord(table, messageId, peer, size + bufferLen);
+    }
+
+    // Call the original function
+    return EchoVR::BroadcasterSend(broadcaster, messageId, mbThreadPriority, item, size, buffer, bufferLen, peer, dest, priority, unk);
+}
+
+/// <summary>
+/// Sends the messages the egress shaper has released for a peer.
+/// </summary>
+/// <param name="peer">The peer to send released messages to.</param>
+/// <param name="now">The current timestamp, in ticks.</param>
+/// <returns>None</returns>
+VOID BroadcasterSendReleased(EchoVR::Peer peer, INT64 now)
+{
+    EgressShaperHeldSend* released;
+    while ((released = EgressShaperRelease(&egressShaper, peer, now)) != NULL)
+    {
+        HeldBroadcasterSend* send = (HeldBroadcasterSend*)EgressShaperHeldSendData(released);
+        BYTE* item = (BYTE*)(send + 1);
+        BroadcasterSendRecorded(send->broadcaster, released->symbol, send->mbThreadPriority, item, send->size, send->bufferLen != 0 ? item + send->size : NULL,
+            send->bufferLen, released->peer, send->dest, send->priority, send->unk);
+        EgressShaperFreeHeldSend(released);
+    }
+}
+
+/// <summary>
+/// A detour hook for the game's UDP broadcaster send function, which shapes low-priority sends to congested peers, then counts
+/// the messages and bytes sent per message type and destination peer into the egress statistics, before sending the message.
+/// </summary>
+/// <param name="broadcaster">The broadcaster to send with.</param>
+/// <param name="messageId">The message type symbol to send.</param>
+/// <param name="mbThreadPriority">TODO: Unknown</param>
+/// <param name="item">The message item to send.</param>
+/// <param name="size">The size of the message item.</param>
+/// <param name="buffer">An additional buffer to send with the message.</param>
+/// <param name="bufferLen">The size of the additional buffer.</param>
+/// <param name="peer">The peer to send the message to.</param>
+/// <param name="dest">TODO: Unknown</param>
+/// <param name="priority">The priority of the message.</param>
+/// <param name="unk">TODO: Unknown</param>
+/// <returns>The result of the original send function.</returns>
+INT32 BroadcasterSendHook(EchoVR::Broadcaster* broadcaster, EchoVR::SymbolId messageId, INT32 mbThreadPriority, VOID* item, UINT64 size, VOID* buffer, UINT64 bufferLen, EchoVR::Peer peer, UINT64 dest, FLOAT priority, EchoVR::SymbolId unk)
+{
+    // If shaping is disabled, send the message as is.
+    if (egressShaper.bytesPerSecond == 0)
+        return BroadcasterSendRecorded(broadcaster, messageId, mbThreadPriority, item, size, buffer, bufferLen, peer, dest, priority, unk);
+
+    // Hold back low-priority sends to congested peers. The meaning of the send function's result has not been mapped out,
+    // so held back sends report zero.
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    EgressShaperDecision decision = EgressShaperShape(&egressShaper, messageId, peer, size + bufferLen, now.QuadPart);
+    if (decision == EgressShaperDecision::Dropped)
+    {
+        if (egressStats != NULL)
+            egressStats->droppedMessages.fetch_add(1, std::memory_order_relaxed);
+        BroadcasterSendReleased(peer, now.QuadPart);
+        return 0;
+    }
+    else if (decision == EgressShaperDecision::Coalesced)
+    {
+        // Copy the send so it can be replayed once released, superseding any send of the same symbol already held.
+        EgressShaperHeldSend* held = EgressShaperAllocateHeldSend(messageId, peer, size + bufferLen, sizeof(HeldBroadcasterSend) + size + bufferLen);
+        if (held != NULL)
+        {
+            HeldBroadcasterSend* send = (HeldBroadcasterSend*)EgressShaperHeldSendData(held);
+            *send = { broadcaster, mbThreadPriority, size, bufferLen, dest, priority, unk };
+            memcpy(send + 1, item, size);
+            if (bufferLen != 0)
+                memcpy((BYTE*)(send + 1) + size, buffer, bufferLen);
+            held = EgressShaperHold(&egressShaper, held);
+        }
+        if (held != NULL)
+        {
+            if (egressStats != NULL)
+                egressStats->coalescedMessages.fetch_add(1, std::memory_order_relaxed);
+            EgressShaperFreeHeldSend(held);
+        }
+        BroadcasterSendReleased(peer, now.QuadPart);
+        return 0;
+    }
+    else if (decision == EgressShaperDecision::Unshaped)
+    {
+        if (egressStats != NULL)
+            egressStats->unshapedMessages.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Send any held messages the peer now has room for, before this one.
+    BroadcasterSendReleased(peer, now.QuadPart);
+    return BroadcasterSendRecorded(broadcaster, messageId, mbThreadPriority, item, size, buffer, bufferLen, peer, dest, priority, unk);
+}
+
 /// <summary>
 /// A detour hook for the game's method it uses to build CLI argument definitions. 
 /// Adds additional definitions to the structure, so that they may be parsed successfully without error.
@@ -363,6 +663,8 @@ VOID NetGameSwitchStateHook(PVOID pGame, EchoVR::NetGameState state)
 /// <param name="pArgSyntax">A pointer to the CLI argument structure tracking all CLI arguments.</param>
 UINT64 BuildCmdLineSyntaxDefinitionsHook(PVOID pGame, PVOID pArgSyntax)
 {
+    UINT32 phase = StartupTraceBegin(startupTrace, "patch", "BuildCmdLineSyntaxDefinitions");
+
     // Add all original CLI argument options.
     UINT64 result = EchoVR::BuildCmdLineSyntaxDefinitions(pGame, pArgSyntax);
 
@@ -379,6 +681,7 @@ UINT64 BuildCmdLineSyntaxDefinitionsHook(PVOID pGame, PVOID pArgSyntax)
     EchoVR::AddArgSyntax(pArgSyntax, "-timestep", 1, 1, FALSE);
     EchoVR::AddArgHelpString(pArgSyntax, "-timestep", "[EchoRelay] Sets the fixed update interval when using -headless (in ticks/updates per second). 0 = no fixed time step, 120 = default");
 
+    StartupTraceEnd(startupTrace, phase);
     return result;
 }
 
@@ -388,6 +691,8 @@ UINT64 BuildCmdLineSyntaxDefinitionsHook(PVOID pGame, PVOID pArgSyntax)
 /// <param name="pGame">A pointer to the game instance.</param>
 UINT64 PreprocessCommandLineHook(PVOID pGame)
 {
+    UINT32 phase = StartupTraceBegin(startupTrace, "patch", "PreprocessCommandLine");
+
     // Check which were set with command line arguments.
     int argc;
     LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
@@ -437,12 +742,22 @@ UINT64 PreprocessCommandLineHook(PVOID pGame)
     if (isServer)
         PatchEnableServer();
 
+    // Count the game server's outgoing messages for external monitors. The hook (including egress shaping, which counts the
+    // sends it holds back) relies on the region, so it is only installed once the region is available.
+    if (isServer && egressStats == NULL)
+    {
+        egressStats = EgressStatsOpen(GetCurrentProcessId(), TRUE, &egressStatsMapping);
+        if (egressStats != NULL)
+            PatchDetour(&(PVOID&)EchoVR::BroadcasterSend, BroadcasterSendHook);
+    }
+
     // Update the window title
     if (hWindow != NULL && isNoOVR)
         EchoVR::SetWindowTextA_(hWindow, "Echo VR - [DEMO]");
 
     // Run the original method
     UINT64 result = EchoVR::PreprocessCommandLine(pGame);
+    StartupTraceEnd(startupTrace, phase);
     return result;
 }
 
@@ -464,7 +779,62 @@ UINT64 LoadLocalConfigHook(PVOID pGame)
 
     // Store a reference to the local config.
     localConfig = (EchoVR::Json*)((CHAR*)pGame + 0x63240);
-    return EchoVR::LoadLocalConfig(pGame);
+
+    // Load the config, timing it as a startup phase.
+    UINT32 phase = StartupTraceBegin(startupTrace, "patch", "LoadLocalConfig");
+    UINT64 result = EchoVR::LoadLocalConfig(pGame);
+
+    // Configure egress shaping from the config (or fallback to disabled). This only takes effect on dedicated servers.
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    CHAR* shapingRate = EchoVR::JsonValueAsString(localConfig, (CHAR*)"egress_shaping_rate", (CHAR*)"0", false);
+    CHAR* shapingBurst = EchoVR::JsonValueAsString(localConfig, (CHAR*)"egress_shaping_burst", (CHAR*)"0", false);
+    CHAR* shapingSymbols = EchoVR::JsonValueAsString(localConfig, (CHAR*)"egress_shaping_symbols", (CHAR*)"", false);
+    EgressShaperInitialize(&egressShaper, frequency.QuadPart, strtoull(shapingRate, NULL, 10), strtoull(shapingBurst, NULL, 10), shapingSymbols);
+
+    // Obtain the maximum size of session captures from the config (or fallback to the default).
+    CHAR* captureMaxMb = EchoVR::JsonValueAsString(localConfig, (CHAR*)"capture_max_mb", (CHAR*)"0", false);
+    if (strtoull(captureMaxMb, NULL, 10) != 0)
+        captureCapacity = strtoull(captureMaxMb, NULL, 10) * 1024 * 1024;
+
+    // Start the sampling profiler if a sampling rate is configured (or fallback to disabled). This only takes effect on dedicated servers.
+    CHAR* profilerRate = EchoVR::JsonValueAsString(localConfig, (CHAR*)"profiler_rate_hz", (CHAR*)"0", false);
+    if (isServer && profiler.thread == NULL && strtoul(profilerRate, NULL, 10) != 0 && !ProfilerStart(&profiler, strtoul(profilerRate, NULL, 10)))
+        Log(EchoVR::LogLevel::Warning, "[ECHORELAY.PATCH] Failed to start the sampling profiler.");
+
+    // Start writing log segments if enabled (or fallback to disabled), with their rotation and compression from the config. This only takes effect on dedicated servers.
+    CHAR* logSegments = EchoVR::JsonValueAsString(localConfig, (CHAR*)"log_segments", (CHAR*)"0", false);
+    if (isServer && logSink.thread == NULL && strtoul(logSegments, NULL, 10) != 0)
+    {
+        CHAR* logSegmentMaxMb = EchoVR::JsonValueAsString(localConfig, (CHAR*)"log_segment_max_mb", (CHAR*)"0", false);
+        CHAR* logSegmentMaxMinutes = EchoVR::JsonValueAsString(localConfig, (CHAR*)"log_segment_max_minutes", (CHAR*)"0", false);
+        CHAR* logCompression = EchoVR::JsonValueAsString(localConfig, (CHAR*)"log_compression", (CHAR*)"xpress_huff", false);
+        CHAR* logSegmentsOnly = EchoVR::JsonValueAsString(localConfig, (CHAR*)"log_segments_only", (CHAR*)"0", false);
+        UINT64 maxSegmentSize = strtoull(logSegmentMaxMb, NULL, 10) != 0 ? strtoull(logSegmentMaxMb, NULL, 10) * 1024 * 1024 : LOG_SINK_DEFAULT_SEGMENT_SIZE;
+        ULONGLONG maxSegmentAgeMs = strtoull(logSegmentMaxMinutes, NULL, 10) != 0 ? strtoull(logSegmentMaxMinutes, NULL, 10) * 60 * 1000 : LOG_SINK_DEFAULT_SEGMENT_AGE_MS;
+        DWORD compressionAlgorithm = LOG_SINK_DEFAULT_COMPRESSION_ALGORITHM;
+        if (!strcmp(logCompression, "xpress"))
+            compressionAlgorithm = COMPRESS_ALGORITHM_XPRESS | COMPRESS_RAW;
+        else if (!strcmp(logCompression, "mszip"))
+            compressionAlgorithm = COMPRESS_ALGORITHM_MSZIP | COMPRESS_RAW;
+        else if (!strcmp(logCompression, "lzms"))
+            compressionAlgorithm = COMPRESS_ALGORITHM_LZMS | COMPRESS_RAW;
+        else if (!strcmp(logCompression, "none"))
+            compressionAlgorithm = 0;
+
+        // Outside of headless mode, our write log hook is not installed yet.
+        if (LogSinkStart(&logSink, compressionAlgorithm, maxSegmentSize, maxSegmentAgeMs, strtoul(logSegmentsOnly, NULL, 10) == 0))
+        {
+            if (!isHeadless)
+                PatchDetour(&(PVOID&)EchoVR::WriteLog, WriteLogHook);
+        }
+        else
+        {
+            Log(EchoVR::LogLevel::Warning, "[ECHORELAY.PATCH] Failed to start writing log segments.");
+        }
+    }
+    StartupTraceEnd(startupTrace, phase);
+    return result;
 }
 
 /// <summary>
@@ -516,8 +886,12 @@ FARPROC GetProcAddressHook(HMODULE hModule, LPCSTR lpProcName)
     if (isServer && strcmp(lpProcName, "RadPluginShutdown") == 0)
     {
         // If this is a user platform dll, exit the whole process with a success code instead of continuing to gracefully unload.
+        // The flight recorder is dumped as the process detaches this library.
         if (EchoVR::GetProcAddress(hModule, "Users") != NULL)
+        {
+            FlightRecorderRecord(&flightRecorder, FlightRecorderEventType::Lifecycle, (UINT64)FlightRecorderLifecycleEvent::PluginShutdownExit, NULL, 0);
             exit(0);
+        }
     }
 
     // Call the original function.
@@ -560,6 +934,17 @@ BOOL VerifyGameVersion()
     return coffFileHeader->TimeDateStamp == 0x6452dff6;
 }
 
+/// <summary>
+/// An unhandled exception filter which dumps the flight recorder before passing the exception on.
+/// </summary>
+/// <param name="exceptionInfo">Information about the unhandled exception.</param>
+/// <returns>The result of the previous exception filter, or EXCEPTION_CONTINUE_SEARCH if there was none.</returns>
+LONG WINAPI FlightRecorderExceptionFilter(EXCEPTION_POINTERS* exceptionInfo)
+{
+    FlightRecorderDump(&flightRecorder, FlightRecorderDumpReason::Crash, exceptionInfo->ExceptionRecord);
+    return previousExceptionFilter != NULL ? previousExceptionFilter(exceptionInfo) : EXCEPTION_CONTINUE_SEARCH;
+}
+
 /// <summary>
 /// Initializes the patcher, executing startup patchs on the game and installing detours/hooks on various game functions.
 /// </summary>
@@ -571,6 +956,19 @@ VOID Initialize()
         return;
     initialized = true;
 
+    // Start recording events, and dump them if the process crashes.
+    FlightRecorderInitialize(&flightRecorder, "EchoRelay.Patch");
+    CaptureWriterInitialize(&capture);
+    FlightRecorderRecord(&flightRecorder, FlightRecorderEventType::Lifecycle, (UINT64)FlightRecorderLifecycleEvent::PatchInitialize, NULL, 0);
+    previousExceptionFilter = SetUnhandledExceptionFilter(FlightRecorderExceptionFilter);
+
+    // Start tracing startup phases, including the time from process creation until we were attached.
+    startupTrace = StartupTraceOpen(&startupTraceMapping);
+    INT64 attachTime = StartupTraceNow();
+    if (startupTrace != NULL)
+        StartupTraceRecord(startupTrace, "patch", "Process creation to patch attach", startupTrace->processStartTimestamp, attachTime, FALSE);
+    UINT32 phase = StartupTraceRecord(startupTrace, "patch", "Patch Initialize", attachTime, 0, FALSE);
+
     // Verify the game version before patching
     if (!VerifyGameVersion())
         MessageBox(NULL, L"EchoRelay version check failed. Patches may fail to be applied. Verify you're running the correct version of Echo VR.", L"Echo Relay: Warning", MB_OK);
@@ -591,4 +989,37 @@ VOID Initialize()
 #if _DEBUG
     PatchDeadlockMonitor();
 #endif
+
+    StartupTraceEnd(startupTrace, phase);
+}
+
+/// <summary>
+/// Terminates the patcher, dumping the flight recorder. This is called when the process is exiting or the library is being unloaded.
+/// </summary>
+/// <param name="processExiting">Indicates whether the process is exiting, rather than the library being unloaded.</param>
+/// <returns>None</returns>
+VOID Terminate(BOOL processExiting)
+{
+    // If we never initialized, there is nothing to do.
+    if (!initialized)
+        return;
+
+    // Dump our recorded events.
+    FlightRecorderDump(&flightRecorder, FlightRecorderDumpReason::Exit, NULL);
+
+    // Finalize any capture in progress, and our current log segment.
+    CaptureWriterCloseOnExit(&capture);
+    LogSinkCloseOnExit(&logSink);
+
+    // The profiler thread is not stopped, as waiting on a thread here would deadlock on the loader lock. This library
+    // is only unloaded as the process exits, which ends the thread.
+
+    // If we're being unloaded rather than exiting, our exception filter must not outlive us.
+    if (!processExiting)
+        SetUnhandledExceptionFilter(previousExceptionFilter);
+
+    // Release the startup trace.
+    StartupTraceClose(startupTrace, startupTraceMapping);
+    startupTrace = NULL;
+    startupTraceMapping = NULL;
 }
\ No newline at end of file
@@ -2,3 +2,4 @@
 #include "pch.h"
 
 VOID Initialize();
+VOID Terminate(BOOL processExiting);
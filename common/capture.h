@@ -0,0 +1,472 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include "pch.h"
+#include <compressapi.h>
+#include "echovr.h"
+
+#pragma comment(lib, "Cabinet.lib")
+
+/// <summary>
+/// The directory (relative to the game's working directory) capture files are written to.
+/// </summary>
+#define CAPTURE_DIRECTORY "_local\\captures"
+
+/// <summary>
+/// A magic value identifying a capture file ("ERCP").
+/// </summary>
+const UINT32 CAPTURE_MAGIC = 0x50435245;
+
+/// <summary>
+/// A magic value identifying a chunk within a capture file ("ERCC").
+/// </summary>
+const UINT32 CAPTURE_CHUNK_MAGIC = 0x43435245;
+
+/// <summary>
+/// The version of the capture file layout. This must be incremented whenever the layout changes.
+/// </summary>
+const UINT32 CAPTURE_VERSION = 1;
+
+/// <summary>
+/// The size of the buffer records are collected in before being compressed and appended as a chunk.
+/// Records larger than this are not captured.
+/// </summary>
+const UINT32 CAPTURE_CHUNK_SIZE = 256 * 1024;
+
+/// <summary>
+/// The compression algorithm used for chunks (the Windows Compression API's XPRESS with Huffman encoding, without framing).
+/// </summary>
+const DWORD CAPTURE_COMPRESSION_ALGORITHM = COMPRESS_ALGORITHM_XPRESS_HUFF | COMPRESS_RAW;
+
+/// <summary>
+/// The default maximum size of a capture file, in bytes. The file is mapped at this size, and truncated when closed.
+/// </summary>
+const UINT64 CAPTURE_DEFAULT_CAPACITY = 256ULL * 1024 * 1024;
+
+/// <summary>
+/// The stream a captured record was observed on.
+/// </summary>
+enum class CaptureStream : UINT16
+{
+	ServerDbSend = 1, // game server to ServerDB
+	ServerDbReceive = 2, // ServerDB to game server
+	BroadcasterSend = 3, // game server to peers (UDP)
+	BroadcasterLocalEvent = 4, // events raised on the game server's own broadcaster
+};
+
+/// <summary>
+/// The header of a capture file.
+/// </summary>
+struct CaptureFileHeader
+{
+	UINT32 magic; // 0x00
+	UINT32 version; // 0x04
+	UINT32 processId; // 0x08
+	UINT32 captureId; // 0x0C (shared by the captures of each library loaded into the process)
+	INT64 frequency; // 0x10 (QueryPerformanceFrequency)
+	INT64 startTimestamp; // 0x18 (QueryPerformanceCounter)
+	FILETIME startTime; // 0x20 (UTC)
+	UINT32 compressionAlgorithm; // 0x28
+	UINT32 chunkSize; // 0x2C (the maximum uncompressed size of a chunk)
+	UINT64 recordCount; // 0x30 (written when the capture is closed)
+	UINT64 droppedRecords; // 0x38 (records which were too large, or did not fit in the file)
+	CHAR module[32]; // 0x40
+};
+static_assert(sizeof(CaptureFileHeader) == 0x60, "CaptureFileHeader layout changed, update CAPTURE_VERSION.");
+
+/// <summary>
+/// The header of a chunk of records within a capture file. Chunks follow the file header back to back.
+/// </summary>
+struct CaptureChunkHeader
+{
+	UINT32 magic; // 0x00
+	UINT32 compressedSize; // 0x04 (equal to uncompressedSize if the chunk is stored uncompressed)
+	UINT32 uncompressedSize; // 0x08
+	UINT32 recordCount; // 0x0C
+	INT64 firstTimestamp; // 0x10
+	INT64 lastTimestamp; // 0x18
+};
+static_assert(sizeof(CaptureChunkHeader) == 0x20, "CaptureChunkHeader layout changed, update CAPTURE_VERSION.");
+
+/// <summary>
+/// The header of a single record within a chunk, followed by its payload.
+/// </summary>
+struct CaptureRecordHeader
+{
+	INT64 timestamp; // 0x00 (QueryPerformanceCounter)
+	EchoVR::SymbolId symbol; // 0x08
+	EchoVR::Peer peer; // 0x10 (broadcaster streams only)
+	UINT32 size; // 0x18
+	CaptureStream stream; // 0x1C
+	BYTE padding[2]; // 0x1E
+};
+static_assert(sizeof(CaptureRecordHeader) == 0x20, "CaptureRecordHeader layout changed, update CAPTURE_VERSION.");
+
+/// <summary>
+/// A capture writer, which appends records to a memory-mapped capture file. Records are collected in an in-memory chunk,
+/// which is compressed and copied into the mapped view when full, so capturing never waits on file IO. As the view is
+/// backed by the file, chunks which were appended survive the process crashing.
+/// </summary>
+struct CaptureWriter
+{
+	SRWLOCK lock;
+	std::atomic<UINT32> captureId; // zero while not capturing
+	HANDLE file;
+	HANDLE mapping;
+	BYTE* view;
+	UINT64 capacity;
+	UINT64 offset;
+	COMPRESSOR_HANDLE compressor;
+	UINT64 recordCount;
+	UINT64 droppedRecords;
+	CaptureChunkHeader chunkHeader;
+	BYTE* chunk; // CAPTURE_CHUNK_SIZE bytes
+	BYTE* compressedChunk; // CAPTURE_CHUNK_SIZE bytes
+};
+
+/// <summary>
+/// Initializes a capture writer, which remains idle until <see cref="CaptureWriterOpen"/> is called.
+/// </summary>
+/// <param name="writer">The writer to initialize.</param>
+/// <returns>None</returns>
+inline VOID CaptureWriterInitialize(CaptureWriter* writer)
+{
+	memset(writer, 0, sizeof(*writer));
+	InitializeSRWLock(&writer->lock);
+}
+
+/// <summary>
+/// Compresses the current chunk and appends it to the capture file. The writer's lock must be held.
+/// </summary>
+/// <param name="writer">The writer to flush.</param>
+/// <returns>None</returns>
+inline VOID CaptureWriterFlushChunk(CaptureWriter* writer)
+{
+	CaptureChunkHeader* header = &writer->chunkHeader;
+	if (header->recordCount == 0)
+		return;
+
+	// Compress the chunk, storing it as-is if it does not compress.
+	SIZE_T compressedSize = 0;
+	const BYTE* data = writer->chunk;
+	header->compressedSize = header->uncompressedSize;
+	if (writer->compressor != NULL && Compress(writer->compressor, writer->chunk, header->uncompressedSize, writer->compressedChunk, CAPTURE_CHUNK_SIZE, &compressedSize) &&
+		compressedSize < header->uncompressedSize)
+	{
+		header->compressedSize = (UINT32)compressedSize;
+		data = writer->compressedChunk;
+	}
+
+	// Append the chunk if it fits. The payload is copied before the header, so a partially appended chunk is never valid.
+	if (writer->offset + sizeof(CaptureChunkHeader) + header->compressedSize <= writer->capacity)
+	{
+		header->magic = CAPTURE_CHUNK_MAGIC;
+		memcpy(writer->view + writer->offset + sizeof(CaptureChunkHeader), data, header->compressedSize);
+		memcpy(writer->view + writer->offset, header, sizeof(CaptureChunkHeader));
+		writer->offset += sizeof(CaptureChunkHeader) + header->compressedSize;
+		writer->recordCount += header->recordCount;
+	}
+	else
+	{
+		writer->droppedRecords += header->recordCount;
+	}
+	memset(header, 0, sizeof(*header));
+}
+
+/// <summary>
+/// Closes the current capture file, if any, flushing buffered records and truncating the file to its written size. The
+/// writer's lock must be held.
+/// </summary>
+/// <param name="writer">The writer to close the capture for.</param>
+/// <returns>None</returns>
+inline VOID CaptureWriterCloseLocked(CaptureWriter* writer)
+{
+	if (writer->view != NULL)
+	{
+		// Flush the remaining records, and finalize the header.
+		CaptureWriterFlushChunk(writer);
+		CaptureFileHeader* header = (CaptureFileHeader*)writer->view;
+		header->recordCount = writer->recordCount;
+		header->droppedRecords = writer->droppedRecords;
+		UnmapViewOfFile(writer->view);
+		CloseHandle(writer->mapping);
+
+		// The file was extended to its capacity when mapped, so truncate it to what we wrote.
+		LARGE_INTEGER size;
+		size.QuadPart = (LONGLONG)writer->offset;
+		SetFilePointerEx(writer->file, size, NULL, FILE_BEGIN);
+		SetEndOfFile(writer->file);
+		CloseHandle(writer->file);
+	}
+	if (writer->compressor != NULL)
+		CloseCompressor(writer->compressor);
+	free(writer->chunk);
+	free(writer->compressedChunk);
+
+	// Reset the writer, retaining its lock.
+	writer->captureId.store(0, std::memory_order_relaxed);
+	writer->file = NULL;
+	writer->mapping = NULL;
+	writer->view = NULL;
+	writer->compressor = NULL;
+	writer->chunk = NULL;
+	writer->compressedChunk = NULL;
+}
+
+/// <summary>
+/// Closes the current capture file, if any, flushing buffered records and truncating the file to its written size.
+/// </summary>
+/// <param name="writer">The writer to close the capture for.</param>
+/// <returns>None</returns>
+inline VOID CaptureWriterClose(CaptureWriter* writer)
+{
+	AcquireSRWLockExclusive(&writer->lock);
+	CaptureWriterCloseLocked(writer);
+	ReleaseSRWLockExclusive(&writer->lock);
+}
+
+/// <summary>
+/// Closes the current capture file as the process exits. A thread terminated while recording never releases the writer's
+/// lock, so if it is held, the capture is left as it is rather than waited on. Its header then lacks the final record
+/// counts, and the file is not truncated, but every chunk appended can still be read.
+/// </summary>
+/// <param name="writer">The writer to close the capture for.</param>
+/// <returns>None</returns>
+inline VOID CaptureWriterCloseOnExit(CaptureWriter* writer)
+{
+	if (!TryAcquireSRWLockExclusive(&writer->lock))
+		return;
+	CaptureWriterCloseLocked(writer);
+	ReleaseSRWLockExclusive(&writer->lock);
+}
+
+/// <summary>
+/// Opens a new capture file, closing any capture which is already open. The file is written to
+/// <see cref="CAPTURE_DIRECTORY"/> as "&lt;module&gt;.&lt;process id&gt;.&lt;capture id&gt;.erc".
+/// </summary>
+/// <param name="writer">The writer to open the capture with.</param>
+/// <param name="module">The name of the library capturing.</param>
+/// <param name="captureId">A non-zero identifier for the capture, shared by the libraries capturing the same session.</param>
+/// <param name="capacity">The maximum size of the capture file, in bytes.</param>
+/// <returns>TRUE if the capture was opened, FALSE otherwise.</returns>
+inline BOOL CaptureWriterOpen(CaptureWriter* writer, const CHAR* module, UINT32 captureId, UINT64 capacity)
+{
+	CaptureWriterClose(writer);
+	AcquireSRWLockExclusive(&writer->lock);
+
+	// Create the capture file, and map it at its full capacity.
+	CHAR path[MAX_PATH];
+	CreateDirectoryA("_local", NULL);
+	CreateDirectoryA(CAPTURE_DIRECTORY, NULL);
+	sprintf_s(path, CAPTURE_DIRECTORY "\\%s.%u.%u.erc", module, GetCurrentProcessId(), captureId);
+	writer->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (writer->file == INVALID_HANDLE_VALUE)
+	{
+		writer->file = NULL;
+		ReleaseSRWLockExclusive(&writer->lock);
+		return FALSE;
+	}
+	writer->mapping = CreateFileMappingA(writer->file, NULL, PAGE_READWRITE, (DWORD)(capacity >> 32), (DWORD)capacity, NULL);
+	writer->view = writer->mapping != NULL ? (BYTE*)MapViewOfFile(writer->mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0) : NULL;
+	writer->chunk = (BYTE*)malloc(CAPTURE_CHUNK_SIZE);
+	writer->compressedChunk = (BYTE*)malloc(CAPTURE_CHUNK_SIZE);
+	if (writer->view == NULL || writer->chunk == NULL || writer->compressedChunk == NULL)
+	{
+		if (writer->view != NULL)
+			UnmapViewOfFile(writer->view);
+		if (writer->mapping != NULL)
+			CloseHandle(writer->mapping);
+		CloseHandle(writer->file);
+		DeleteFileA(path);
+		free(writer->chunk);
+		free(writer->compressedChunk);
+		writer->file = NULL;
+		writer->mapping = NULL;
+		writer->view = NULL;
+		writer->chunk = NULL;
+		writer->compressedChunk = NULL;
+		ReleaseSRWLockExclusive(&writer->lock);
+		return FALSE;
+	}
+
+	// Chunks are stored uncompressed if a compressor is unavailable.
+	if (!CreateCompressor(CAPTURE_COMPRESSION_ALGORITHM, NULL, &writer->compressor))
+		writer->compressor = NULL;
+
+	// Write the file header.
+	LARGE_INTEGER frequency, now;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&now);
+	CaptureFileHeader* header = (CaptureFileHeader*)writer->view;
+	header->version = CAPTURE_VERSION;
+	header->processId = GetCurrentProcessId();
+	header->captureId = captureId;
+	header->frequency = frequency.QuadPart;
+	header->startTimestamp = now.QuadPart;
+	GetSystemTimePreciseAsFileTime(&header->startTime);
+	header->compressionAlgorithm = writer->compressor != NULL ? CAPTURE_COMPRESSION_ALGORITHM : 0;
+	header->chunkSize = CAPTURE_CHUNK_SIZE;
+	strncpy_s(header->module, module, _TRUNCATE);
+	header->magic = CAPTURE_MAGIC;
+
+	writer->capacity = capacity;
+	writer->offset = sizeof(CaptureFileHeader);
+	writer->recordCount = 0;
+	writer->droppedRecords = 0;
+	memset(&writer->chunkHeader, 0, sizeof(writer->chunkHeader));
+	writer->captureId.store(captureId, std::memory_order_relaxed);
+	ReleaseSRWLockExclusive(&writer->lock);
+	return TRUE;
+}
+
+/// <summary>
+/// Records a message in the capture, if one is open. The payload may be provided in two parts, which are captured back to back.
+/// </summary>
+/// <param name="writer">The writer to record with.</param>
+/// <param name="stream">The stream the message was observed on.</param>
+/// <param name="symbol">The message type symbol.</param>
+/// <param name="peer">The peer the message was sent to, for broadcaster streams.</param>
+/// <param name="payload">The first part of the payload.</param>
+/// <param name="payloadSize">The size of the first part of the payload, in bytes.</param>
+/// <param name="extra">The second part of the payload, or NULL if there is none.</param>
+/// <param name="extraSize">The size of the second part of the payload, in bytes.</param>
+/// <returns>None</returns>
+inline VOID CaptureWriterRecord(CaptureWriter* writer, CaptureStream stream, EchoVR::SymbolId symbol, EchoVR::Peer peer, const VOID* payload, UINT64 payloadSize, const VOID* extra, UINT64 extraSize)
+{
+	// Avoid taking the lock while we are not capturing.
+	if (writer->captureId.load(std::memory_order_relaxed) == 0)
+		return;
+
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	UINT64 recordSize = sizeof(CaptureRecordHeader) + payloadSize + extraSize;
+	AcquireSRWLockExclusive(&writer->lock);
+	if (writer->view == NULL)
+	{
+		ReleaseSRWLockExclusive(&writer->lock);
+		return;
+	}
+	if (recordSize > CAPTURE_CHUNK_SIZE)
+	{
+		writer->droppedRecords++;
+		ReleaseSRWLockExclusive(&writer->lock);
+		return;
+	}
+
+	// Start a new chunk if the record does not fit in this one.
+	CaptureChunkHeader* chunkHeader = &writer->chunkHeader;
+	if (chunkHeader->uncompressedSize + recordSize > CAPTURE_CHUNK_SIZE)
+		CaptureWriterFlushChunk(writer);
+	if (chunkHeader->recordCount == 0)
+		chunkHeader->firstTimestamp = now.QuadPart;
+	chunkHeader->lastTimestamp = now.QuadPart;
+
+	// Append the record to the chunk.
+	BYTE* record = writer->chunk + chunkHeader->uncompressedSize;
+	CaptureRecordHeader* recordHeader = (CaptureRecordHeader*)record;
+	recordHeader->timestamp = now.QuadPart;
+	recordHeader->symbol = symbol;
+	recordHeader->peer = peer;
+	recordHeader->size = (UINT32)(payloadSize + extraSize);
+	recordHeader->stream = stream;
+	recordHeader->padding[0] = recordHeader->padding[1] = 0;
+	if (payloadSize != 0)
+		memcpy(record + sizeof(CaptureRecordHeader), payload, payloadSize);
+	if (extraSize != 0)
+		memcpy(record + sizeof(CaptureRecordHeader) + payloadSize, extra, extraSize);
+	chunkHeader->uncompressedSize += (UINT32)recordSize;
+	chunkHeader->recordCount++;
+	ReleaseSRWLockExclusive(&writer->lock);
+}
+
+/// <summary>
+/// A capture reader, which reads a capture file one chunk at a time.
+/// </summary>
+struct CaptureReader
+{
+	std::ifstream file;
+	CaptureFileHeader header;
+	DECOMPRESSOR_HANDLE decompressor;
+	std::vector<BYTE> compressedChunk;
+	std::vector<BYTE> chunk;
+	UINT32 chunkOffset;
+};
+
+/// <summary>
+/// Opens a capture file for reading.
+/// </summary>
+/// <param name="reader">The reader to open the file with.</param>
+/// <param name="path">The path of the capture file.</param>
+/// <returns>TRUE if the file was opened and is a compatible capture, FALSE otherwise.</returns>
+inline BOOL CaptureReaderOpen(CaptureReader* reader, const CHAR* path)
+{
+	reader->file.open(path, std::ios::binary);
+	reader->decompressor = NULL;
+	reader->chunkOffset = 0;
+	if (!reader->file.read((CHAR*)&reader->header, sizeof(reader->header)) || reader->header.magic != CAPTURE_MAGIC || reader->header.version != CAPTURE_VERSION ||
+		reader->header.frequency == 0 || reader->header.chunkSize == 0 || reader->header.chunkSize > CAPTURE_CHUNK_SIZE)
+		return FALSE;
+	if (reader->header.compressionAlgorithm != 0 && !CreateDecompressor(reader->header.compressionAlgorithm, NULL, &reader->decompressor))
+		return FALSE;
+	return TRUE;
+}
+
+/// <summary>
+/// Reads the next record from a capture file.
+/// </summary>
+/// <param name="reader">The reader to read with.</param>
+/// <param name="header">The header of the record which was read.</param>
+/// <param name="payload">The payload of the record which was read. This remains valid until the next read.</param>
+/// <returns>TRUE if a record was read, FALSE if the end of the capture was reached (or it was truncated or corrupt).</returns>
+inline BOOL CaptureReaderNext(CaptureReader* reader, CaptureRecordHeader* header, const BYTE** payload)
+{
+	// If we have consumed the current chunk, read and decompress the next. A chunk which was never written (e.g. the tail
+	// of a capture from a process which crashed) has no magic.
+	if (reader->chunkOffset >= reader->chunk.size())
+	{
+		CaptureChunkHeader chunkHeader;
+		if (!reader->file.read((CHAR*)&chunkHeader, sizeof(chunkHeader)) || chunkHeader.magic != CAPTURE_CHUNK_MAGIC ||
+			chunkHeader.uncompressedSize > reader->header.chunkSize || chunkHeader.compressedSize > chunkHeader.uncompressedSize)
+			return FALSE;
+		reader->chunk.resize(chunkHeader.uncompressedSize);
+		reader->chunkOffset = 0;
+		if (chunkHeader.compressedSize == chunkHeader.uncompressedSize)
+		{
+			if (!reader->file.read((CHAR*)reader->chunk.data(), chunkHeader.uncompressedSize))
+				return FALSE;
+		}
+		else
+		{
+			SIZE_T decompressedSize = 0;
+			reader->compressedChunk.resize(chunkHeader.compressedSize);
+			if (reader->decompressor == NULL || !reader->file.read((CHAR*)reader->compressedChunk.data(), chunkHeader.compressedSize) ||
+				!Decompress(reader->decompressor, reader->compressedChunk.data(), chunkHeader.compressedSize, reader->chunk.data(), chunkHeader.uncompressedSize, &decompressedSize) ||
+				decompressedSize != chunkHeader.uncompressedSize)
+				return FALSE;
+		}
+	}
+
+	// Read the next record from the chunk.
+	if (reader->chunkOffset + sizeof(CaptureRecordHeader) > reader->chunk.size())
+		return FALSE;
+	memcpy(header, reader->chunk.data() + reader->chunkOffset, sizeof(CaptureRecordHeader));
+	if (reader->chunkOffset + sizeof(CaptureRecordHeader) + header->size > reader->chunk.size())
+		return FALSE;
+	*payload = reader->chunk.data() + reader->chunkOffset + sizeof(CaptureRecordHeader);
+	reader->chunkOffset += sizeof(CaptureRecordHeader) + header->size;
+	return TRUE;
+}
+
+/// <summary>
+/// Closes a capture file opened for reading.
+/// </summary>
+/// <param name="reader">The reader to close.</param>
+/// <returns>None</returns>
+inline VOID CaptureReaderClose(CaptureReader* reader)
+{
+	if (reader->decompressor != NULL)
+		CloseDecompressor(reader->decompressor);
+	reader->decompressor = NULL;
+	reader->file.close();
+}
@@ -188,7 +188,7 @@ namespace EchoVR
 	const TcpPeer TcpPeer_InvalidPeer = { 0xFFFFFFFF, 0 };
 
 	/// <summary>
-	/// TODO: Map this out
+	/// TODO: Map this out. Until then, ServerDB link statistics are obtained from the OS instead (see netstats.h).
 	/// </summary>
 	struct TcpPeerConnectionStats{};
 
@@ -282,6 +282,39 @@ namespace EchoVR
 		InGame = 9
 	};
 
+	/// <summary>
+	/// Obtains a display name for a given net game state.
+	/// </summary>
+	/// <param name="state">The net game state to obtain the name for.</param>
+	/// <returns>The name of the net game state.</returns>
+	inline const CHAR* GetNetGameStateName(NetGameState state)
+	{
+		switch (state)
+		{
+		case NetGameState::OSNeedsUpdate: return "OSNeedsUpdate";
+		case NetGameState::OBBMissing: return "OBBMissing";
+		case NetGameState::NoNetwork: return "NoNetwork";
+		case NetGameState::BroadcasterError: return "BroadcasterError";
+		case NetGameState::CertificateError: return "CertificateError";
+		case NetGameState::ServiceUnavailable: return "ServiceUnavailable";
+		case NetGameState::LoginFailed: return "LoginFailed";
+		case NetGameState::LoginReplaced: return "LoginReplaced";
+		case NetGameState::LobbyBooted: return "LobbyBooted";
+		case NetGameState::LoadFailed: return "LoadFailed";
+		case NetGameState::LoggedOut: return "LoggedOut";
+		case NetGameState::LoadingRoot: return "LoadingRoot";
+		case NetGameState::LoggingIn: return "LoggingIn";
+		case NetGameState::LoggedIn: return "LoggedIn";
+		case NetGameState::LoadingGlobal: return "LoadingGlobal";
+		case NetGameState::Lobby: return "Lobby";
+		case NetGameState::ServerLoading: return "ServerLoading";
+		case NetGameState::LoadingLevel: return "LoadingLevel";
+		case NetGameState::ReadyForGame: return "ReadyForGame";
+		case NetGameState::InGame: return "InGame";
+		default: return "Unknown";
+		}
+	}
+
 	/// <summary>
 	/// The main structure used to track lobby/game session information for the current game.
 	/// Lobby objects can be local, dedicated, etc. As a game server, this is a dedicated lobby object.
@@ -0,0 +1,450 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// This header has no platform dependencies, so the shaper can be driven by recorded send traces (and tested) anywhere.
+// Hooking the broadcaster, and replaying the sends the shaper holds, is left to EchoRelay.Patch.
+
+/// <summary>
+/// The maximum amount of symbols which can be given a shaping policy. Policies beyond this are ignored.
+/// </summary>
+const uint32_t EGRESS_SHAPER_MAX_SYMBOLS = 16;
+
+/// <summary>
+/// The amount of peers which can be tracked by the shaper. This must be a power of two. Once every slot is in use, the slots
+/// of idle peers are reclaimed, and sends to peers which still cannot be tracked are not shaped.
+/// </summary>
+const uint32_t EGRESS_SHAPER_MAX_PEERS = 256;
+
+/// <summary>
+/// The identifier of an invalid peer, which marks an unused slot. This matches EchoVR::Peer_InvalidPeer.
+/// </summary>
+const uint64_t EGRESS_SHAPER_INVALID_PEER = UINT64_MAX;
+
+/// <summary>
+/// The default burst size of each peer's bucket, in bytes.
+/// </summary>
+const uint64_t EGRESS_SHAPER_DEFAULT_BURST = 16384;
+
+/// <summary>
+/// The default interval at which a coalesced symbol is still sent to a congested peer, in milliseconds.
+/// </summary>
+const uint32_t EGRESS_SHAPER_DEFAULT_COALESCE_INTERVAL_MS = 100;
+
+/// <summary>
+/// The time after which a peer's slot may be reclaimed for another peer, if nothing was sent to it, in milliseconds.
+/// </summary>
+const uint32_t EGRESS_SHAPER_PEER_IDLE_MS = 30000;
+
+/// <summary>
+/// The action taken for a low-priority symbol when its peer is congested.
+/// </summary>
+enum class EgressShaperAction : uint32_t
+{
+	Drop, // the message is not sent
+	Coalesce, // the latest message is held until the peer has room for it (or for at most an interval), as each message supersedes the last
+};
+
+/// <summary>
+/// The outcome of shaping a send.
+/// </summary>
+enum class EgressShaperDecision : uint32_t
+{
+	Send,
+	Unshaped, // the peer could not be tracked as every slot is in use, so the message is sent without being shaped
+	Dropped,
+	Coalesced, // the message should be held with EgressShaperHold, superseding any message held for its symbol
+};
+
+/// <summary>
+/// The shaping policy for a low-priority symbol.
+/// </summary>
+struct EgressShaperPolicy
+{
+	int64_t symbol;
+	EgressShaperAction action;
+	uint32_t coalesceIntervalMs;
+};
+
+/// <summary>
+/// A coalesced send held by the shaper until its peer has room for it, or until it is superseded. The data the caller
+/// needs to replay the send follows the header (see <see cref="EgressShaperHeldSendData"/>).
+/// </summary>
+struct EgressShaperHeldSend
+{
+	int64_t symbol;
+	uint64_t peer;
+	uint64_t bytes; // the size charged to the peer's bucket once the send is released
+};
+
+/// <summary>
+/// The shaping state of a single peer. The bucket is tracked as a theoretical arrival time (the time at which the bytes sent
+/// so far would have drained at the configured rate), so it can be updated with a single compare-exchange.
+/// </summary>
+struct EgressShaperPeer
+{
+	std::atomic<uint64_t> peer; // EGRESS_SHAPER_INVALID_PEER while the slot is unused
+	std::atomic<int64_t> theoreticalArrival; // ticks
+	std::atomic<int64_t> lastSeen; // ticks, of the last send to the peer
+	std::atomic<int64_t> lastRelease[EGRESS_SHAPER_MAX_SYMBOLS]; // ticks, per policy, of the last held send released
+	std::atomic<uint64_t> heldBytes[EGRESS_SHAPER_MAX_SYMBOLS]; // per policy, the size of the latest held send
+	std::atomic<EgressShaperHeldSend*> held[EGRESS_SHAPER_MAX_SYMBOLS]; // per policy, the latest held send (if any)
+};
+
+/// <summary>
+/// A per-peer egress shaper. All traffic is charged to its peer's bucket, but only sends of symbols with a configured policy
+/// are ever held back, and only when the bucket is exhausted. Reliable and gameplay-critical traffic is never delayed or dropped.
+/// Timestamps are provided by the caller, so the shaper may be driven by recorded traffic as well as live traffic.
+/// </summary>
+struct EgressShaper
+{
+	// Configuration
+	uint64_t bytesPerSecond; // per peer, zero if shaping is disabled
+	uint64_t burstBytes;
+	int64_t frequency; // ticks per second
+	uint32_t policyCount;
+	EgressShaperPolicy policies[EGRESS_SHAPER_MAX_SYMBOLS];
+
+	// State
+	EgressShaperPeer peers[EGRESS_SHAPER_MAX_PEERS];
+};
+
+/// <summary>
+/// Allocates a send to be held by the shaper, with room for the data the caller needs to replay it.
+/// </summary>
+/// <param name="symbol">The message type symbol being sent.</param>
+/// <param name="peer">The peer the message is being sent to.</param>
+/// <param name="bytes">The size of the message, in bytes.</param>
+/// <param name="dataSize">The size of the caller's data, in bytes.</param>
+/// <returns>The allocated send, or NULL if it could not be allocated.</returns>
+inline EgressShaperHeldSend* EgressShaperAllocateHeldSend(int64_t symbol, uint64_t peer, uint64_t bytes, size_t dataSize)
+{
+	EgressShaperHeldSend* send = (EgressShaperHeldSend*)malloc(sizeof(EgressShaperHeldSend) + dataSize);
+	if (send == NULL)
+		return NULL;
+	send->symbol = symbol;
+	send->peer = peer;
+	send->bytes = bytes;
+	return send;
+}
+
+/// <summary>
+/// Obtains the caller's data for a held send.
+/// </summary>
+/// <param name="send">The held send.</param>
+/// <returns>The data following the send's header.</returns>
+inline void* EgressShaperHeldSendData(EgressShaperHeldSend* send)
+{
+	return send + 1;
+}
+
+/// <summary>
+/// Frees a held send, once it has been released or superseded.
+/// </summary>
+/// <param name="send">The held send to free.</param>
+/// <returns>None</returns>
+inline void EgressShaperFreeHeldSend(EgressShaperHeldSend* send)
+{
+	free(send);
+}
+
+/// <summary>
+/// Parses a shaping policy list into the shaper. Each entry is separated by a comma, and takes the form
+/// `&lt;symbol&gt;:drop` or `&lt;symbol&gt;:coalesce[:&lt;interval ms&gt;]`, where the symbol is a decimal or 0x-prefixed hex value.
+/// Malformed entries are skipped.
+/// </summary>
+/// <param name="shaper">The shaper to add policies to.</param>
+/// <param name="policies">The policy list to parse.</param>
+/// <returns>None</returns>
+inline void EgressShaperParsePolicies(EgressShaper* shaper, const char* policies)
+{
+	const char* cursor = policies;
+	while (*cursor != '\0' && shaper->policyCount < EGRESS_SHAPER_MAX_SYMBOLS)
+	{
+		// Parse the symbol, followed by the action.
+		char* end = NULL;
+		EgressShaperPolicy policy;
+		policy.symbol = (int64_t)strtoull(cursor, &end, 0);
+		policy.action = EgressShaperAction::Drop;
+		policy.coalesceIntervalMs = EGRESS_SHAPER_DEFAULT_COALESCE_INTERVAL_MS;
+		bool valid = end != cursor && *end == ':';
+		if (valid)
+		{
+			cursor = end + 1;
+			if (strncmp(cursor, "drop", 4) == 0)
+			{
+				policy.action = EgressShaperAction::Drop;
+				cursor += 4;
+			}
+			else if (strncmp(cursor, "coalesce", 8) == 0)
+			{
+				policy.action = EgressShaperAction::Coalesce;
+				cursor += 8;
+				if (*cursor == ':')
+				{
+					policy.coalesceIntervalMs = (uint32_t)strtoul(cursor + 1, &end, 10);
+					cursor = end;
+				}
+			}
+			else
+			{
+				valid = false;
+			}
+		}
+		if (valid && (*cursor == ',' || *cursor == '\0'))
+			shaper->policies[shaper->policyCount++] = policy;
+
+		// Skip to the next entry.
+		cursor = strchr(cursor, ',');
+		if (cursor == NULL)
+			break;
+		cursor++;
+	}
+}
+
+/// <summary>
+/// Resets the shaping state of a peer's slot, freeing any sends held for its previous peer.
+/// </summary>
+/// <param name="state">The slot to reset.</param>
+/// <param name="now">The current timestamp, in ticks.</param>
+/// <returns>None</returns>
+inline void EgressShaperResetPeer(EgressShaperPeer* state, int64_t now)
+{
+	state->theoreticalArrival.store(0, std::memory_order_relaxed);
+	state->lastSeen.store(now, std::memory_order_relaxed);
+	for (uint32_t i = 0; i < EGRESS_SHAPER_MAX_SYMBOLS; i++)
+	{
+		state->lastRelease[i].store(INT64_MIN / 2, std::memory_order_relaxed);
+		state->heldBytes[i].store(0, std::memory_order_relaxed);
+		EgressShaperHeldSend* held = state->held[i].exchange(NULL, std::memory_order_acquire);
+		if (held != NULL)
+			EgressShaperFreeHeldSend(held);
+	}
+}
+
+/// <summary>
+/// Initializes an egress shaper.
+/// </summary>
+/// <param name="shaper">The shaper to initialize.</param>
+/// <param name="frequency">The frequency of the timestamps which will be provided to the shaper, in ticks per second.</param>
+/// <param name="bytesPerSecond">The rate each peer's bucket drains at, in bytes per second, or zero to disable shaping.</param>
+/// <param name="burstBytes">The size of each peer's bucket, in bytes.</param>
+/// <param name="policies">The shaping policies for low-priority symbols (see <see cref="EgressShaperParsePolicies"/>).</param>
+/// <returns>None</returns>
+inline void EgressShaperInitialize(EgressShaper* shaper, int64_t frequency, uint64_t bytesPerSecond, uint64_t burstBytes, const char* policies)
+{
+	shaper->bytesPerSecond = 0;
+	shaper->burstBytes = burstBytes != 0 ? burstBytes : EGRESS_SHAPER_DEFAULT_BURST;
+	shaper->frequency = frequency;
+	shaper->policyCount = 0;
+	for (EgressShaperPeer& peer : shaper->peers)
+	{
+		peer.peer.store(EGRESS_SHAPER_INVALID_PEER, std::memory_order_relaxed);
+		for (std::atomic<EgressShaperHeldSend*>& held : peer.held)
+			held.store(NULL, std::memory_order_relaxed);
+		EgressShaperResetPeer(&peer, 0);
+	}
+	if (policies != NULL)
+		EgressShaperParsePolicies(shaper, policies);
+
+	// Only enable shaping if there is something to shape.
+	if (shaper->policyCount != 0)
+		shaper->bytesPerSecond = bytesPerSecond;
+}
+
+/// <summary>
+/// Finds the shaping state for a peer, optionally claiming a slot for it if it has none. Slots are never emptied, as that would
+/// break the probe sequences passing through them. Instead, once every slot is in use, the slot of a peer which has been idle
+/// for <see cref="EGRESS_SHAPER_PEER_IDLE_MS"/> is reclaimed in place, discarding any sends held for it.
+/// </summary>
+/// <param name="shaper">The shaper to find the peer in.</param>
+/// <param name="peer">The peer to find.</param>
+/// <param name="now">The current timestamp, in ticks.</param>
+/// <param name="claim">Indicates whether a slot should be claimed for the peer if it has none.</param>
+/// <returns>The shaping state for the peer, or NULL if it is not tracked (or could not be, as every slot is in use).</returns>
+inline EgressShaperPeer* EgressShaperFindPeer(EgressShaper* shaper, uint64_t peer, int64_t now, bool claim)
+{
+	if (peer == EGRESS_SHAPER_INVALID_PEER)
+		return NULL;
+	uint32_t index = (uint32_t)((peer * 0x9E3779B97F4A7C15) >> 32) & (EGRESS_SHAPER_MAX_PEERS - 1);
+	int64_t idleTicks = (int64_t)EGRESS_SHAPER_PEER_IDLE_MS * shaper->frequency / 1000;
+	EgressShaperPeer* idle = NULL;
+	for (uint32_t probe = 0; probe < EGRESS_SHAPER_MAX_PEERS; probe++)
+	{
+		EgressShaperPeer* state = &shaper->peers[(index + probe) & (EGRESS_SHAPER_MAX_PEERS - 1)];
+		uint64_t current = state->peer.load(std::memory_order_acquire);
+		if (current == peer)
+			return state;
+		if (current == EGRESS_SHAPER_INVALID_PEER)
+		{
+			// Claim the slot. If another thread claimed it first, it may have been for the same peer.
+			if (!claim)
+				return NULL;
+			if (state->peer.compare_exchange_strong(current, peer, std::memory_order_acq_rel) || current == peer)
+				return state;
+		}
+		else if (idle == NULL && now - state->lastSeen.load(std::memory_order_relaxed) >= idleTicks)
+		{
+			idle = state;
+		}
+	}
+
+	// Every slot is in use, so reclaim the first idle slot probed, if any.
+	if (!claim || idle == NULL)
+		return NULL;
+	uint64_t current = idle->peer.load(std::memory_order_relaxed);
+	if (!idle->peer.compare_exchange_strong(current, peer, std::memory_order_acq_rel))
+		return current == peer ? idle : NULL;
+	EgressShaperResetPeer(idle, now);
+	return idle;
+}
+
+/// <summary>
+/// Finds the policy for a symbol.
+/// </summary>
+/// <param name="shaper">The shaper holding the policies.</param>
+/// <param name="symbol">The message type symbol to find the policy for.</param>
+/// <returns>The index of the policy, or -1 if the symbol has none.</returns>
+inline int32_t EgressShaperFindPolicy(const EgressShaper* shaper, int64_t symbol)
+{
+	for (uint32_t i = 0; i < shaper->policyCount; i++)
+	{
+		if (shaper->policies[i].symbol == symbol)
+			return (int32_t)i;
+	}
+	return -1;
+}
+
+/// <summary>
+/// Obtains the cost of sending an amount of bytes, in ticks.
+/// </summary>
+/// <param name="shaper">The shaper to obtain the cost with.</param>
+/// <param name="bytes">The amount of bytes.</param>
+/// <returns>The time the peer's bucket takes to drain the bytes, in ticks.</returns>
+inline int64_t EgressShaperCost(const EgressShaper* shaper, uint64_t bytes)
+{
+	return (int64_t)(bytes * shaper->frequency / shaper->bytesPerSecond);
+}
+
+/// <summary>
+/// Obtains the time at which a send made now would begin draining from a peer's bucket.
+/// </summary>
+/// <param name="theoreticalArrival">The theoretical arrival time of the peer's bucket, in ticks.</param>
+/// <param name="now">The current timestamp, in ticks.</param>
+/// <returns>The later of the two times.</returns>
+inline int64_t EgressShaperStart(int64_t theoreticalArrival, int64_t now)
+{
+	return theoreticalArrival > now ? theoreticalArrival : now;
+}
+
+/// <summary>
+/// Charges a send to a peer's bucket.
+/// </summary>
+/// <param name="state">The shaping state of the peer.</param>
+/// <param name="cost">The cost of the send, in ticks.</param>
+/// <param name="now">The current timestamp, in ticks.</param>
+/// <returns>None</returns>
+inline void EgressShaperCharge(EgressShaperPeer* state, int64_t cost, int64_t now)
+{
+	int64_t theoreticalArrival = state->theoreticalArrival.load(std::memory_order_relaxed);
+	while (!state->theoreticalArrival.compare_exchange_weak(theoreticalArrival, EgressShaperStart(theoreticalArrival, now) + cost, std::memory_order_relaxed))
+	{
+	}
+}
+
+/// <summary>
+/// Decides whether a send should proceed, charging it to its peer's bucket if so.
+/// </summary>
+/// <param name="shaper">The shaper to shape with.</param>
+/// <param name="symbol">The message type symbol being sent.</param>
+/// <param name="peer">The peer the message is being sent to.</param>
+/// <param name="bytes">The size of the message, in bytes.</param>
+/// <param name="now">The current timestamp, in ticks.</param>
+/// <returns>The decision for the send.</returns>
+inline EgressShaperDecision EgressShaperShape(EgressShaper* shaper, int64_t symbol, uint64_t peer, uint64_t bytes, int64_t now)
+{
+	// If shaping is disabled, or the peer cannot be tracked, every send proceeds.
+	if (shaper->bytesPerSecond == 0 || peer == EGRESS_SHAPER_INVALID_PEER)
+		return EgressShaperDecision::Send;
+	EgressShaperPeer* state = EgressShaperFindPeer(shaper, peer, now, true);
+	if (state == NULL)
+		return EgressShaperDecision::Unshaped;
+	state->lastSeen.store(now, std::memory_order_relaxed);
+
+	// Charge the send to the bucket. The peer is congested if a low-priority send would take the bucket beyond its burst size.
+	int32_t policyIndex = EgressShaperFindPolicy(shaper, symbol);
+	int64_t cost = EgressShaperCost(shaper, bytes);
+	int64_t burst = EgressShaperCost(shaper, shaper->burstBytes);
+	int64_t theoreticalArrival = state->theoreticalArrival.load(std::memory_order_relaxed);
+	while (true)
+	{
+		int64_t start = EgressShaperStart(theoreticalArrival, now);
+		if (policyIndex >= 0 && start + cost - now > burst)
+		{
+			// The peer is congested. Low-priority sends are dropped, or held to be coalesced with later sends.
+			return shaper->policies[policyIndex].action == EgressShaperAction::Drop ? EgressShaperDecision::Dropped : EgressShaperDecision::Coalesced;
+		}
+		if (state->theoreticalArrival.compare_exchange_weak(theoreticalArrival, start + cost, std::memory_order_relaxed))
+			return EgressShaperDecision::Send;
+	}
+}
+
+/// <summary>
+/// Holds a coalesced send until its peer has room for it, superseding any send already held for its symbol. Held sends are
+/// only released by <see cref="EgressShaperRelease"/>, which the caller should check whenever it sends to the peer.
+/// </summary>
+/// <param name="shaper">The shaper to hold the send with.</param>
+/// <param name="send">The send to hold, allocated with <see cref="EgressShaperAllocateHeldSend"/>.</param>
+/// <returns>The superseded send, or the send itself if it could not be held, for the caller to free. NULL if nothing was superseded.</returns>
+inline EgressShaperHeldSend* EgressShaperHold(EgressShaper* shaper, EgressShaperHeldSend* send)
+{
+	// The peer's slot was claimed when the send was shaped. It can only be missing if it was reclaimed in the meantime.
+	int32_t policyIndex = EgressShaperFindPolicy(shaper, send->symbol);
+	EgressShaperPeer* state = EgressShaperFindPeer(shaper, send->peer, 0, false);
+	if (policyIndex < 0 || state == NULL)
+		return send;
+	state->heldBytes[policyIndex].store(send->bytes, std::memory_order_relaxed);
+	return state->held[policyIndex].exchange(send, std::memory_order_acq_rel);
+}
+
+/// <summary>
+/// Releases a send held for a peer, if it is due: the peer's bucket has room for it, or its symbol's coalescing interval has
+/// elapsed since the last send released for it (so a peer which remains congested is still updated once per interval). The
+/// released send is charged to the peer's bucket. This should be called until it returns NULL.
+/// </summary>
+/// <param name="shaper">The shaper holding the sends.</param>
+/// <param name="peer">The peer to release a held send for.</param>
+/// <param name="now">The current timestamp, in ticks.</param>
+/// <returns>The released send, which the caller sends and then frees, or NULL if none are due.</returns>
+inline EgressShaperHeldSend* EgressShaperRelease(EgressShaper* shaper, uint64_t peer, int64_t now)
+{
+	if (shaper->bytesPerSecond == 0)
+		return NULL;
+	EgressShaperPeer* state = EgressShaperFindPeer(shaper, peer, now, false);
+	if (state == NULL)
+		return NULL;
+	int64_t burst = EgressShaperCost(shaper, shaper->burstBytes);
+	for (uint32_t i = 0; i < shaper->policyCount; i++)
+	{
+		if (state->held[i].load(std::memory_order_relaxed) == NULL)
+			continue;
+
+		// The held send is only owned once it is exchanged out, so its size is checked from its slot instead.
+		int64_t start = EgressShaperStart(state->theoreticalArrival.load(std::memory_order_relaxed), now);
+		int64_t intervalTicks = (int64_t)shaper->policies[i].coalesceIntervalMs * shaper->frequency / 1000;
+		if (start + EgressShaperCost(shaper, state->heldBytes[i].load(std::memory_order_relaxed)) - now > burst &&
+			now - state->lastRelease[i].load(std::memory_order_relaxed) < intervalTicks)
+			continue;
+		EgressShaperHeldSend* held = state->held[i].exchange(NULL, std::memory_order_acq_rel);
+		if (held == NULL)
+			continue;
+		state->lastRelease[i].store(now, std::memory_order_relaxed);
+		EgressShaperCharge(state, EgressShaperCost(shaper, held->bytes), now);
+		return held;
+	}
+	return NULL;
+}
@@ -0,0 +1,286 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include "pch.h"
+#include "echovr.h"
+
+/// <summary>
+/// The format of the name of the shared memory region holding a game server's egress statistics, keyed by process identifier.
+/// </summary>
+#define EGRESS_STATS_NAME_FORMAT "Local\\EchoRelay.EgressStats.%u"
+
+/// <summary>
+/// A magic value identifying an egress statistics region ("EREG").
+/// </summary>
+const UINT32 EGRESS_STATS_MAGIC = 0x47455245;
+
+/// <summary>
+/// The version of the egress statistics layout. This must be incremented whenever the layout changes.
+/// </summary>
+const UINT32 EGRESS_STATS_VERSION = 3;
+
+/// <summary>
+/// The maximum amount of threads which can record egress statistics. Sends from any further threads are only counted in totals.
+/// </summary>
+const UINT32 EGRESS_STATS_MAX_THREADS = 8;
+
+/// <summary>
+/// The amount of (symbol, peer) entries in each thread's table. This must be a power of two.
+/// </summary>
+const UINT32 EGRESS_STATS_TABLE_CAPACITY = 1024;
+
+/// <summary>
+/// The maximum amount of entries probed when recording a send, before it is counted as an overflow instead.
+/// </summary>
+const UINT32 EGRESS_STATS_MAX_PROBES = 16;
+
+/// <summary>
+/// The interval (in sends, per thread) at which the overhead of recording a send is measured. This must be a power of two.
+/// </summary>
+const UINT32 EGRESS_STATS_OVERHEAD_SAMPLE_INTERVAL = 256;
+
+/// <summary>
+/// Message and byte counters for a single message type sent to a single peer.
+/// </summary>
+struct EgressStatsEntry
+{
+	std::atomic<UINT64> symbol; // 0x00
+	std::atomic<UINT64> peer; // 0x08
+	std::atomic<UINT64> messages; // 0x10 (zero while the entry is unused, published last)
+	std::atomic<UINT64> bytes; // 0x18
+};
+static_assert(sizeof(EgressStatsEntry) == 0x20, "EgressStatsEntry layout changed, update EGRESS_STATS_VERSION.");
+
+/// <summary>
+/// The egress statistics recorded by a single thread. Only the owning thread writes to its table, so counters are updated
+/// without atomic read-modify-write operations, and readers never block the game.
+/// </summary>
+struct EgressStatsThreadTable
+{
+	std::atomic<UINT32> threadId; // 0x00 (zero while the table is unclaimed)
+	BYTE padding[4]; // 0x04
+	std::atomic<UINT64> overflowMessages; // 0x08 (sends which could not be placed in the table)
+	std::atomic<UINT64> overflowBytes; // 0x10
+	std::atomic<UINT64> overheadTicks; // 0x18 (QueryPerformanceCounter ticks spent recording sampled sends)
+	std::atomic<UINT64> overheadSamples; // 0x20
+	BYTE padding2[0x18]; // 0x28 (keeps entries off the header's cache line)
+	EgressStatsEntry entries[EGRESS_STATS_TABLE_CAPACITY]; // 0x40
+};
+static_assert(offsetof(EgressStatsThreadTable, entries) == 0x40, "EgressStatsThreadTable layout changed, update EGRESS_STATS_VERSION.");
+
+/// <summary>
+/// An egress statistics region, which counts the messages and bytes the game server's UDP broadcaster sends, per message type
+/// and destination peer.
+/// </summary>
+struct EgressStats
+{
+	UINT32 magic; // 0x00
+	UINT32 version; // 0x04
+	UINT32 processId; // 0x08
+	std::atomic<UINT32> threadCount; // 0x0C (amount of tables claimed, may exceed EGRESS_STATS_MAX_THREADS)
+	INT64 frequency; // 0x10 (QueryPerformanceFrequency)
+	std::atomic<UINT64> untrackedMessages; // 0x18 (sends from threads without a table)
+	std::atomic<UINT64> untrackedBytes; // 0x20
+	std::atomic<UINT64> droppedMessages; // 0x28 (low-priority sends dropped by egress shaping)
+	std::atomic<UINT64> coalescedMessages; // 0x30 (low-priority sends superseded by egress shaping)
+	std::atomic<UINT64> unshapedMessages; // 0x38 (sends not shaped, as the shaper's peer table was full)
+	EgressStatsThreadTable threads[EGRESS_STATS_MAX_THREADS]; // 0x40
+};
+static_assert(offsetof(EgressStats, threads) == 0x40, "EgressStats layout changed, update EGRESS_STATS_VERSION.");
+
+/// <summary>
+/// The key by which egress statistics are grouped when ranking talkers.
+/// </summary>
+enum class EgressStatsGroupBy
+{
+	Symbol,
+	Peer,
+	SymbolAndPeer,
+};
+
+/// <summary>
+/// Aggregated egress statistics for a message type, peer, or both, as ranked by <see cref="EgressStatsTopTalkers"/>.
+/// </summary>
+struct EgressStatsTalker
+{
+	EchoVR::SymbolId symbol; // zero when grouping by peer
+	EchoVR::Peer peer; // zero when grouping by symbol
+	UINT64 messages;
+	UINT64 bytes;
+};
+
+/// <summary>
+/// Opens the egress statistics region for a game server process, creating it if requested.
+/// </summary>
+/// <param name="processId">The identifier of the game server process.</param>
+/// <param name="create">Indicates whether the region should be created (by the game server) rather than opened (by a reader).</param>
+/// <param name="hMapping">The handle to the file mapping, to be provided when closing the region.</param>
+/// <returns>The mapped egress statistics, or NULL if they could not be opened.</returns>
+inline EgressStats* EgressStatsOpen(DWORD processId, BOOL create, HANDLE* hMapping)
+{
+	// Open or create the file mapping for the process.
+	CHAR name[64];
+	sprintf_s(name, EGRESS_STATS_NAME_FORMAT, processId);
+	if (create)
+		*hMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(EgressStats), name);
+	else
+		*hMapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+	if (*hMapping == NULL)
+		return NULL;
+	EgressStats* stats = (EgressStats*)MapViewOfFile(*hMapping, create ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, sizeof(EgressStats));
+	if (stats == NULL)
+	{
+		CloseHandle(*hMapping);
+		*hMapping = NULL;
+		return NULL;
+	}
+
+	// Initialize the header if we created the region, otherwise verify it is a layout we understand.
+	if (create)
+	{
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		stats->version = EGRESS_STATS_VERSION;
+		stats->processId = processId;
+		stats->frequency = frequency.QuadPart;
+		stats->magic = EGRESS_STATS_MAGIC;
+	}
+	else if (stats->magic != EGRESS_STATS_MAGIC || stats->version != EGRESS_STATS_VERSION)
+	{
+		UnmapViewOfFile(stats);
+		CloseHandle(*hMapping);
+		*hMapping = NULL;
+		return NULL;
+	}
+	return stats;
+}
+
+/// <summary>
+/// Unmaps an egress statistics region and closes its file mapping.
+/// </summary>
+/// <param name="stats">The egress statistics to unmap.</param>
+/// <param name="hMapping">The handle to the file mapping obtained when opening the region.</param>
+/// <returns>None</returns>
+inline VOID EgressStatsClose(EgressStats* stats, HANDLE hMapping)
+{
+	if (stats != NULL)
+		UnmapViewOfFile(stats);
+	if (hMapping != NULL)
+		CloseHandle(hMapping);
+}
+
+/// <summary>
+/// Claims a table for the calling thread to record egress statistics into.
+/// </summary>
+/// <param name="stats">The egress statistics to claim a table from.</param>
+/// <returns>The claimed table, or NULL if all tables have been claimed.</returns>
+inline EgressStatsThreadTable* EgressStatsClaimThreadTable(EgressStats* stats)
+{
+	UINT32 index = stats->threadCount.fetch_add(1, std::memory_order_relaxed);
+	if (index >= EGRESS_STATS_MAX_THREADS)
+		return NULL;
+	EgressStatsThreadTable* table = &stats->threads[index];
+	table->threadId.store(GetCurrentThreadId(), std::memory_order_release);
+	return table;
+}
+
+/// <summary>
+/// Obtains the table index for a (symbol, peer) key.
+/// </summary>
+/// <param name="symbol">The message type symbol.</param>
+/// <param name="peer">The destination peer.</param>
+/// <returns>The index of the first entry to probe.</returns>
+inline UINT32 EgressStatsHash(UINT64 symbol, UINT64 peer)
+{
+	UINT64 hash = (symbol ^ (peer * 0x9E3779B97F4A7C15)) * 0xBF58476D1CE4E5B9;
+	return (UINT32)(hash >> 32) & (EGRESS_STATS_TABLE_CAPACITY - 1);
+}
+
+/// <summary>
+/// Records a send in the calling thread's table. This must only be called by the thread which claimed the table.
+/// </summary>
+/// <param name="table">The calling thread's table.</param>
+/// <param name="symbol">The message type symbol which was sent.</param>
+/// <param name="peer">The peer the message was sent to.</param>
+/// <param name="bytes">The size of the message, in bytes.</param>
+/// <returns>None</returns>
+inline VOID EgressStatsRecord(EgressStatsThreadTable* table, UINT64 symbol, UINT64 peer, UINT64 bytes)
+{
+	// As we are the only writer, counters are updated with plain loads and stores. The message count is stored last with
+	// release semantics, so a reader which observes a non-zero count also observes the entry's key.
+	UINT32 index = EgressStatsHash(symbol, peer);
+	for (UINT32 probe = 0; probe < EGRESS_STATS_MAX_PROBES; probe++)
+	{
+		EgressStatsEntry* entry = &table->entries[(index + probe) & (EGRESS_STATS_TABLE_CAPACITY - 1)];
+		UINT64 messages = entry->messages.load(std::memory_order_relaxed);
+		if (messages == 0)
+		{
+			entry->symbol.store(symbol, std::memory_order_relaxed);
+			entry->peer.store(peer, std::memory_order_relaxed);
+			entry->bytes.store(bytes, std::memory_order_relaxed);
+			entry->messages.store(1, std::memory_order_release);
+			return;
+		}
+		if (entry->symbol.load(std::memory_order_relaxed) == symbol && entry->peer.load(std::memory_order_relaxed) == peer)
+		{
+			entry->bytes.store(entry->bytes.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+			entry->messages.store(messages + 1, std::memory_order_release);
+			return;
+		}
+	}
+
+	// The key's neighbourhood is full, so we only count it in the table's totals.
+	table->overflowMessages.store(table->overflowMessages.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	table->overflowBytes.store(table->overflowBytes.load(std::memory_order_relaxed) + bytes, std::memory_order_relaxed);
+}
+
+/// <summary>
+/// Aggregates the egress statistics across all threads and ranks the largest talkers by bytes sent.
+/// </summary>
+/// <param name="stats">The egress statistics to aggregate.</param>
+/// <param name="groupBy">The key to group statistics by.</param>
+/// <param name="count">The maximum amount of talkers to obtain.</param>
+/// <param name="talkers">The ranked talkers, largest first.</param>
+/// <returns>None</returns>
+inline VOID EgressStatsTopTalkers(const EgressStats* stats, EgressStatsGroupBy groupBy, size_t count, std::vector<EgressStatsTalker>* talkers)
+{
+	// Gather every used entry across all claimed tables, keyed as requested.
+	std::vector<EgressStatsTalker> entries;
+	UINT32 threadCount = min(stats->threadCount.load(std::memory_order_relaxed), EGRESS_STATS_MAX_THREADS);
+	for (UINT32 i = 0; i < threadCount; i++)
+	{
+		for (const EgressStatsEntry& entry : stats->threads[i].entries)
+		{
+			UINT64 messages = entry.messages.load(std::memory_order_acquire);
+			if (messages == 0)
+				continue;
+			EgressStatsTalker talker;
+			talker.symbol = groupBy != EgressStatsGroupBy::Peer ? entry.symbol.load(std::memory_order_relaxed) : 0;
+			talker.peer = groupBy != EgressStatsGroupBy::Symbol ? entry.peer.load(std::memory_order_relaxed) : 0;
+			talker.messages = messages;
+			talker.bytes = entry.bytes.load(std::memory_order_relaxed);
+			entries.push_back(talker);
+		}
+	}
+
+	// Merge entries with equal keys (from different threads, or grouped together), then rank them.
+	std::sort(entries.begin(), entries.end(), [](const EgressStatsTalker& a, const EgressStatsTalker& b) { return a.symbol != b.symbol ? a.symbol < b.symbol : a.peer < b.peer; });
+	talkers->clear();
+	for (const EgressStatsTalker& entry : entries)
+	{
+		if (!talkers->empty() && talkers->back().symbol == entry.symbol && talkers->back().peer == entry.peer)
+		{
+			talkers->back().messages += entry.messages;
+			talkers->back().bytes += entry.bytes;
+		}
+		else
+		{
+			talkers->push_back(entry);
+		}
+	}
+	std::sort(talkers->begin(), talkers->end(), [](const EgressStatsTalker& a, const EgressStatsTalker& b) { return a.bytes > b.bytes; });
+	if (talkers->size() > count)
+		talkers->resize(count);
+}
@@ -0,0 +1,249 @@
+#pragma once
+
+#include <atomic>
+#include "pch.h"
+#include "echovr.h"
+
+/// <summary>
+/// The directory (relative to the game's working directory) flight recorder dumps are written to.
+/// </summary>
+#define FLIGHT_RECORDER_DUMP_DIRECTORY "_local\\flightrecorder"
+
+/// <summary>
+/// A magic value identifying a flight recorder dump ("ERFR").
+/// </summary>
+const UINT32 FLIGHT_RECORDER_MAGIC = 0x52465245;
+
+/// <summary>
+/// The version of the flight recorder dump layout. This must be incremented whenever the layout changes.
+/// </summary>
+const UINT32 FLIGHT_RECORDER_VERSION = 1;
+
+/// <summary>
+/// The amount of events retained by a flight recorder. This must be a power of two.
+/// </summary>
+const UINT32 FLIGHT_RECORDER_CAPACITY = 4096;
+
+/// <summary>
+/// The maximum amount of payload bytes retained for each event. Larger payloads are truncated.
+/// </summary>
+const UINT32 FLIGHT_RECORDER_PAYLOAD_SIZE = 24;
+
+/// <summary>
+/// The type of an event recorded by a flight recorder.
+/// </summary>
+enum class FlightRecorderEventType : UINT16
+{
+	None = 0,
+	Lifecycle = 1, // symbol: FlightRecorderLifecycleEvent
+	ServerDbSend = 2, // symbol: message type symbol
+	ServerDbReceive = 3, // symbol: message type symbol
+	NetGameStateChange = 4, // symbol: EchoVR::NetGameState
+};
+
+/// <summary>
+/// A lifecycle event recorded by a flight recorder, stored in the symbol field of a <see cref="FlightRecorderEventType::Lifecycle"/> event.
+/// </summary>
+enum class FlightRecorderLifecycleEvent : UINT64
+{
+	// Game server library
+	Initialize = 1,
+	Terminate = 2,
+	RequestRegistration = 3,
+	Unregister = 4,
+	EndSession = 5,
+	LockPlayerSessions = 6,
+	UnlockPlayerSessions = 7,
+	AcceptPlayerSessions = 8,
+	RemovePlayerSession = 9,
+	SessionStarting = 10,
+	SessionError = 11,
+	ServerDbFailover = 12,
+	GameThreadStall = 13,
+	LoadShedStart = 14,
+	LoadShedEnd = 15,
+
+	// Patch library
+	PatchInitialize = 100,
+	FatalError = 101,
+	LoadFailedReset = 102,
+	PluginShutdownExit = 103,
+};
+
+/// <summary>
+/// The reason a flight recorder was dumped.
+/// </summary>
+enum class FlightRecorderDumpReason : UINT32
+{
+	Exit = 1,
+	Crash = 2,
+};
+
+/// <summary>
+/// A single event recorded by a flight recorder.
+/// </summary>
+struct FlightRecorderEvent
+{
+	std::atomic<UINT64> sequence; // 0x00 (event index + 1 once the event is fully written, zero while it is being written or never written)
+	INT64 timestamp; // 0x08 (QueryPerformanceCounter)
+	UINT64 symbol; // 0x10
+	UINT32 threadId; // 0x18
+	FlightRecorderEventType type; // 0x1C
+	UINT16 payloadSize; // 0x1E (bytes retained in payload)
+	UINT32 originalSize; // 0x20 (bytes provided before truncation)
+	BYTE padding[4]; // 0x24
+	BYTE payload[FLIGHT_RECORDER_PAYLOAD_SIZE]; // 0x28
+};
+static_assert(sizeof(FlightRecorderEvent) == 0x40, "FlightRecorderEvent layout changed, update FLIGHT_RECORDER_VERSION.");
+
+/// <summary>
+/// The header of a flight recorder, which is written as-is at the start of a dump, followed by the events.
+/// </summary>
+struct FlightRecorderHeader
+{
+	UINT32 magic; // 0x00
+	UINT32 version; // 0x04
+	UINT32 eventSize; // 0x08
+	UINT32 capacity; // 0x0C
+	UINT32 processId; // 0x10
+	FlightRecorderDumpReason dumpReason; // 0x14
+	UINT32 exceptionCode; // 0x18
+	UINT32 droppedCount; // 0x1C (events dropped because their slot was still held by an earlier writer, or already by a later one)
+	UINT64 exceptionAddress; // 0x20
+	INT64 frequency; // 0x28 (QueryPerformanceFrequency)
+	INT64 startTimestamp; // 0x30 (QueryPerformanceCounter at initialization)
+	FILETIME startTime; // 0x38 (system time at initialization)
+	INT64 dumpTimestamp; // 0x40 (QueryPerformanceCounter at time of dumping)
+	UINT64 eventCount; // 0x48 (total events recorded, including those overwritten)
+	CHAR module[32]; // 0x50
+};
+static_assert(sizeof(FlightRecorderHeader) == 0x70, "FlightRecorderHeader layout changed, update FLIGHT_RECORDER_VERSION.");
+
+/// <summary>
+/// A fixed-size, lock-free ring buffer of recent events, kept in memory at all times and dumped to disk when the
+/// process exits or crashes. Recording an event costs one atomic increment, a timestamp and a small copy.
+/// </summary>
+struct FlightRecorder
+{
+	FlightRecorderHeader header;
+	std::atomic<UINT64> head;
+	std::atomic<UINT32> dropped;
+	std::atomic<BOOL> dumped;
+	FlightRecorderEvent events[FLIGHT_RECORDER_CAPACITY];
+};
+static_assert((FLIGHT_RECORDER_CAPACITY & (FLIGHT_RECORDER_CAPACITY - 1)) == 0, "FLIGHT_RECORDER_CAPACITY must be a power of two.");
+
+/// <summary>
+/// Initializes a flight recorder. This must be called before any events are recorded.
+/// </summary>
+/// <param name="recorder">The recorder to initialize.</param>
+/// <param name="module">The name of the module which owns the recorder, used to name its dumps.</param>
+/// <returns>None</returns>
+inline VOID FlightRecorderInitialize(FlightRecorder* recorder, const CHAR* module)
+{
+	LARGE_INTEGER value;
+	recorder->header.magic = FLIGHT_RECORDER_MAGIC;
+	recorder->header.version = FLIGHT_RECORDER_VERSION;
+	recorder->header.eventSize = sizeof(FlightRecorderEvent);
+	recorder->header.capacity = FLIGHT_RECORDER_CAPACITY;
+	recorder->header.processId = GetCurrentProcessId();
+	QueryPerformanceFrequency(&value);
+	recorder->header.frequency = value.QuadPart;
+	QueryPerformanceCounter(&value);
+	recorder->header.startTimestamp = value.QuadPart;
+	GetSystemTimeAsFileTime(&recorder->header.startTime);
+	strncpy_s(recorder->header.module, module, _TRUNCATE);
+}
+
+/// <summary>
+/// Records an event in the flight recorder, overwriting the oldest event if the recorder is full.
+/// This is safe to call from any thread.
+/// </summary>
+/// <param name="recorder">The recorder to record the event in.</param>
+/// <param name="type">The type of event.</param>
+/// <param name="symbol">The symbol describing the event, specific to the event type.</param>
+/// <param name="payload">The payload for the event, or NULL if there is none.</param>
+/// <param name="payloadSize">The size of the payload, in bytes. Only the first FLIGHT_RECORDER_PAYLOAD_SIZE bytes are retained.</param>
+/// <returns>None</returns>
+inline VOID FlightRecorderRecord(FlightRecorder* recorder, FlightRecorderEventType type, UINT64 symbol, const VOID* payload, UINT64 payloadSize)
+{
+	// Obtain the next index, then claim its slot by marking it as being written. If the ring wrapped while another writer
+	// holds the slot (or a writer a lap ahead already published to it), drop this event rather than interleave with it.
+	// On the first lap, a zero sequence means the slot was never written, so it can be claimed.
+	UINT64 index = recorder->head.fetch_add(1, std::memory_order_relaxed);
+	FlightRecorderEvent* evt = &recorder->events[index & (FLIGHT_RECORDER_CAPACITY - 1)];
+	UINT64 current = evt->sequence.load(std::memory_order_relaxed);
+	do
+	{
+		if ((current == 0 && index >= FLIGHT_RECORDER_CAPACITY) || current > index)
+		{
+			recorder->dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+	} while (!evt->sequence.compare_exchange_weak(current, 0, std::memory_order_acquire, std::memory_order_relaxed));
+	std::atomic_thread_fence(std::memory_order_release);
+
+	// Fill out the event.
+	LARGE_INTEGER timestamp;
+	QueryPerformanceCounter(&timestamp);
+	UINT16 retainedSize = payload == NULL ? 0 : (UINT16)min(payloadSize, (UINT64)FLIGHT_RECORDER_PAYLOAD_SIZE);
+	evt->timestamp = timestamp.QuadPart;
+	evt->symbol = symbol;
+	evt->threadId = GetCurrentThreadId();
+	evt->type = type;
+	evt->payloadSize = retainedSize;
+	evt->originalSize = payload == NULL ? 0 : (UINT32)min(payloadSize, (UINT64)MAXUINT32);
+	if (retainedSize != 0)
+		memcpy(evt->payload, payload, retainedSize);
+
+	// Publish the event.
+	evt->sequence.store(index + 1, std::memory_order_release);
+}
+
+/// <summary>
+/// Dumps the flight recorder to a file in <see cref="FLIGHT_RECORDER_DUMP_DIRECTORY"/>. Only the first dump for a recorder
+/// is written, so a crash dump is not overwritten by the exit which follows it. This only uses kernel32 file functions,
+/// so it is safe to call from an unhandled exception filter or DLL detach.
+/// </summary>
+/// <param name="recorder">The recorder to dump.</param>
+/// <param name="reason">The reason for the dump.</param>
+/// <param name="exceptionRecord">The exception which caused a crash, or NULL if there is none.</param>
+/// <returns>TRUE if the dump was written, FALSE otherwise.</returns>
+inline BOOL FlightRecorderDump(FlightRecorder* recorder, FlightRecorderDumpReason reason, const EXCEPTION_RECORD* exceptionRecord)
+{
+	// If the recorder was never initialized or was already dumped, stop.
+	if (recorder->header.magic != FLIGHT_RECORDER_MAGIC || recorder->dumped.exchange(TRUE))
+		return FALSE;
+
+	// Fill out the dump information in the header.
+	LARGE_INTEGER timestamp;
+	QueryPerformanceCounter(&timestamp);
+	recorder->header.dumpReason = reason;
+	recorder->header.dumpTimestamp = timestamp.QuadPart;
+	recorder->header.eventCount = recorder->head.load(std::memory_order_acquire);
+	recorder->header.droppedCount = recorder->dropped.load(std::memory_order_relaxed);
+	if (exceptionRecord != NULL)
+	{
+		recorder->header.exceptionCode = exceptionRecord->ExceptionCode;
+		recorder->header.exceptionAddress = (UINT64)exceptionRecord->ExceptionAddress;
+	}
+
+	// Create the output file, named by module and process.
+	CHAR path[MAX_PATH];
+	CreateDirectoryA("_local", NULL);
+	CreateDirectoryA(FLIGHT_RECORDER_DUMP_DIRECTORY, NULL);
+	sprintf_s(path, FLIGHT_RECORDER_DUMP_DIRECTORY "\\%s.%u.bin", recorder->header.module, recorder->header.processId);
+	HANDLE hFile = CreateFileA(path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return FALSE;
+
+	// Write the header followed by the raw ring. Events being written at the time of the dump carry a zero sequence,
+	// and are discarded by the decoder. Events are otherwise written in place while the ring is copied, so a slot claimed by
+	// a later writer during the copy may be torn. Its sequence will not match its position (or will be zero), so the decoder
+	// discards it too.
+	DWORD written = 0;
+	BOOL success = WriteFile(hFile, &recorder->header, sizeof(recorder->header), &written, NULL)
+		&& WriteFile(hFile, recorder->events, sizeof(recorder->events), &written, NULL);
+	CloseHandle(hFile);
+	return success;
+}
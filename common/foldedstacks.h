@@ -0,0 +1,250 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+// This header has no platform dependencies, so sampled stacks can be aggregated, symbolized and written (and tested) anywhere.
+
+/// <summary>
+/// The maximum amount of frames retained for each sampled stack. Deeper stacks are truncated at their root.
+/// </summary>
+const uint32_t FOLDED_STACKS_MAX_FRAMES = 24;
+
+/// <summary>
+/// The amount of distinct stacks which can be aggregated. This must be a power of two.
+/// </summary>
+const uint32_t FOLDED_STACKS_CAPACITY = 4096;
+
+/// <summary>
+/// The maximum amount of distinct stacks aggregated, before further new stacks are counted as dropped. This keeps probe sequences short.
+/// </summary>
+const uint32_t FOLDED_STACKS_MAX_ENTRIES = FOLDED_STACKS_CAPACITY * 3 / 4;
+
+/// <summary>
+/// The maximum amount of modules which stacks can be symbolized against.
+/// </summary>
+const uint32_t FOLDED_STACKS_MAX_MODULES = 256;
+
+/// <summary>
+/// The maximum length of a module name, including the null terminator. Longer names are truncated.
+/// </summary>
+const uint32_t FOLDED_STACKS_MAX_MODULE_NAME = 64;
+
+static_assert((FOLDED_STACKS_CAPACITY & (FOLDED_STACKS_CAPACITY - 1)) == 0, "FOLDED_STACKS_CAPACITY must be a power of two.");
+
+/// <summary>
+/// A module loaded in the sampled process, which frames within are symbolized as offsets of.
+/// </summary>
+struct FoldedStacksModule
+{
+	uint64_t base;
+	uint64_t size;
+	char name[FOLDED_STACKS_MAX_MODULE_NAME];
+};
+
+/// <summary>
+/// The modules loaded in the sampled process, sorted by base address.
+/// </summary>
+struct FoldedStacksModules
+{
+	uint32_t count;
+	FoldedStacksModule modules[FOLDED_STACKS_MAX_MODULES];
+};
+
+/// <summary>
+/// A distinct stack (per thread), and the amount of times it was sampled.
+/// </summary>
+struct FoldedStacksEntry
+{
+	uint64_t hash; // zero while the entry is unused
+	uint64_t count;
+	uint32_t threadId;
+	uint32_t frameCount; // the first frame is the leaf
+	bool truncated; // indicates the stack had more frames than were retained
+	uint64_t frames[FOLDED_STACKS_MAX_FRAMES];
+};
+
+/// <summary>
+/// An open-addressed table of sampled stacks and their counts, which is written out as folded stacks: one line per stack,
+/// with its frames from the root to the leaf separated by semicolons, followed by its count. This is the input format of
+/// flame graph tools (flamegraph.pl, speedscope, Perfetto).
+/// </summary>
+struct FoldedStacks
+{
+	uint64_t sampleCount;
+	uint64_t droppedCount; // samples of new stacks which could not be added as the table was full
+	uint32_t entryCount;
+	FoldedStacksEntry entries[FOLDED_STACKS_CAPACITY];
+};
+
+/// <summary>
+/// Clears all aggregated stacks.
+/// </summary>
+/// <param name="stacks">The stacks to clear.</param>
+/// <returns>None</returns>
+inline void FoldedStacksReset(FoldedStacks* stacks)
+{
+	stacks->sampleCount = 0;
+	stacks->droppedCount = 0;
+	stacks->entryCount = 0;
+	for (uint32_t i = 0; i < FOLDED_STACKS_CAPACITY; i++)
+		stacks->entries[i].hash = 0;
+}
+
+/// <summary>
+/// Obtains the hash identifying a stack, which is never zero.
+/// </summary>
+/// <param name="threadId">The thread the stack was sampled from.</param>
+/// <param name="frames">The frames of the stack, leaf first.</param>
+/// <param name="frameCount">The amount of frames.</param>
+/// <param name="truncated">Indicates the stack had more frames than were provided.</param>
+/// <returns>The hash of the stack.</returns>
+inline uint64_t FoldedStacksHash(uint32_t threadId, const uint64_t* frames, uint32_t frameCount, bool truncated)
+{
+	// FNV-1a over each value, rather than each byte, is enough to spread addresses.
+	uint64_t hash = 0xCBF29CE484222325ull;
+	hash = (hash ^ threadId) * 0x100000001B3ull;
+	hash = (hash ^ (truncated ? 1 : 0)) * 0x100000001B3ull;
+	for (uint32_t i = 0; i < frameCount; i++)
+		hash = (hash ^ frames[i]) * 0x100000001B3ull;
+	hash ^= hash >> 32;
+	return hash != 0 ? hash : 1;
+}
+
+/// <summary>
+/// Counts a sampled stack, adding it to the table if it has not been sampled before.
+/// </summary>
+/// <param name="stacks">The stacks to add the sample to.</param>
+/// <param name="threadId">The thread the stack was sampled from.</param>
+/// <param name="frames">The frames of the stack, leaf first.</param>
+/// <param name="frameCount">The amount of frames. Frames beyond FOLDED_STACKS_MAX_FRAMES are truncated.</param>
+/// <param name="truncated">Indicates the stack had more frames than were provided.</param>
+/// <returns>true if the sample was counted, false if it was dropped as the table was full.</returns>
+inline bool FoldedStacksAdd(FoldedStacks* stacks, uint32_t threadId, const uint64_t* frames, uint32_t frameCount, bool truncated)
+{
+	if (frameCount > FOLDED_STACKS_MAX_FRAMES)
+	{
+		frameCount = FOLDED_STACKS_MAX_FRAMES;
+		truncated = true;
+	}
+	stacks->sampleCount++;
+
+	// Probe from the stack's hash until we find it, or an unused entry to add it to.
+	uint64_t hash = FoldedStacksHash(threadId, frames, frameCount, truncated);
+	for (uint32_t probe = 0; probe < FOLDED_STACKS_CAPACITY; probe++)
+	{
+		FoldedStacksEntry* entry = &stacks->entries[(hash + probe) & (FOLDED_STACKS_CAPACITY - 1)];
+		if (entry->hash == hash && entry->threadId == threadId && entry->frameCount == frameCount && entry->truncated == truncated &&
+			memcmp(entry->frames, frames, frameCount * sizeof(uint64_t)) == 0)
+		{
+			entry->count++;
+			return true;
+		}
+		if (entry->hash != 0)
+			continue;
+		if (stacks->entryCount >= FOLDED_STACKS_MAX_ENTRIES)
+			break;
+		entry->hash = hash;
+		entry->count = 1;
+		entry->threadId = threadId;
+		entry->frameCount = frameCount;
+		entry->truncated = truncated;
+		memcpy(entry->frames, frames, frameCount * sizeof(uint64_t));
+		stacks->entryCount++;
+		return true;
+	}
+	stacks->droppedCount++;
+	return false;
+}
+
+/// <summary>
+/// Sorts a module list by base address, so frames can be symbolized against it.
+/// </summary>
+/// <param name="modules">The modules to sort.</param>
+/// <returns>None</returns>
+inline void FoldedStacksSortModules(FoldedStacksModules* modules)
+{
+	// Module lists are short, and sorted once per write.
+	for (uint32_t i = 1; i < modules->count; i++)
+	{
+		FoldedStacksModule module = modules->modules[i];
+		uint32_t j = i;
+		for (; j > 0 && modules->modules[j - 1].base > module.base; j--)
+			modules->modules[j] = modules->modules[j - 1];
+		modules->modules[j] = module;
+	}
+}
+
+/// <summary>
+/// Finds the module containing an address.
+/// </summary>
+/// <param name="modules">The modules, sorted by base address.</param>
+/// <param name="address">The address to find the module for.</param>
+/// <returns>The module containing the address, or NULL if there is none.</returns>
+inline const FoldedStacksModule* FoldedStacksFindModule(const FoldedStacksModules* modules, uint64_t address)
+{
+	// Find the last module based at or below the address.
+	uint32_t low = 0;
+	uint32_t high = modules->count;
+	while (low < high)
+	{
+		uint32_t middle = (low + high) / 2;
+		if (modules->modules[middle].base <= address)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+	if (low == 0)
+		return NULL;
+	const FoldedStacksModule* module = &modules->modules[low - 1];
+	return address - module->base < module->size ? module : NULL;
+}
+
+/// <summary>
+/// Formats a frame as an offset within the module containing it (e.g. "echovr.exe+0x1D3881"), or as an absolute address if it is in no known module.
+/// </summary>
+/// <param name="modules">The modules, sorted by base address.</param>
+/// <param name="address">The address of the frame.</param>
+/// <param name="buffer">The buffer to format the frame into.</param>
+/// <param name="bufferSize">The size of the buffer.</param>
+/// <returns>None</returns>
+inline void FoldedStacksFormatFrame(const FoldedStacksModules* modules, uint64_t address, char* buffer, size_t bufferSize)
+{
+	const FoldedStacksModule* module = modules != NULL ? FoldedStacksFindModule(modules, address) : NULL;
+	if (module != NULL)
+		snprintf(buffer, bufferSize, "%s+0x%llX", module->name, (unsigned long long)(address - module->base));
+	else
+		snprintf(buffer, bufferSize, "0x%llX", (unsigned long long)address);
+}
+
+/// <summary>
+/// Writes the aggregated stacks as folded stacks, one line per stack: "thread &lt;id&gt;;&lt;root frame&gt;;...;&lt;leaf frame&gt; &lt;count&gt;".
+/// Stacks truncated at their root begin with a "..." frame after the thread.
+/// </summary>
+/// <param name="stacks">The stacks to write.</param>
+/// <param name="modules">The modules to symbolize frames against, sorted by base address, or NULL to write absolute addresses.</param>
+/// <param name="file">The file to write to.</param>
+/// <returns>The amount of stacks written.</returns>
+inline uint32_t FoldedStacksWrite(const FoldedStacks* stacks, const FoldedStacksModules* modules, FILE* file)
+{
+	uint32_t written = 0;
+	char frame[FOLDED_STACKS_MAX_MODULE_NAME + 32];
+	for (uint32_t i = 0; i < FOLDED_STACKS_CAPACITY; i++)
+	{
+		const FoldedStacksEntry* entry = &stacks->entries[i];
+		if (entry->hash == 0)
+			continue;
+		fprintf(file, "thread %u", entry->threadId);
+		if (entry->truncated)
+			fputs(";...", file);
+		for (uint32_t j = entry->frameCount; j > 0; j--)
+		{
+			FoldedStacksFormatFrame(modules, entry->frames[j - 1], frame, sizeof(frame));
+			fprintf(file, ";%s", frame);
+		}
+		fprintf(file, " %llu\n", (unsigned long long)entry->count);
+		written++;
+	}
+	return written;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "pch.h"
+#include "lobbysnapshotlayout.h"
+
+/// <summary>
+/// The format of the name of the shared memory region holding a game server's lobby snapshot, keyed by process identifier.
+/// </summary>
+#define LOBBY_SNAPSHOT_NAME_FORMAT "Local\\EchoRelay.LobbySnapshot.%u"
+
+/// <summary>
+/// Opens the lobby snapshot region for a given process, mapping it into the current process.
+/// </summary>
+/// <param name="processId">The identifier of the game server process which publishes the snapshot.</param>
+/// <param name="create">Indicates whether the region should be created (and initialized) if it does not exist.</param>
+/// <param name="hMapping">The handle to the file mapping, to be provided when closing the snapshot.</param>
+/// <returns>The mapped lobby snapshot, or NULL if it could not be opened.</returns>
+inline LobbySnapshot* LobbySnapshotOpen(DWORD processId, BOOL create, HANDLE* hMapping)
+{
+	// Obtain the name of the region for this process.
+	CHAR name[64];
+	sprintf_s(name, LOBBY_SNAPSHOT_NAME_FORMAT, processId);
+
+	// Open (or create) the file mapping.
+	if (create)
+		*hMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(LobbySnapshot), name);
+	else
+		*hMapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+	if (*hMapping == NULL)
+		return NULL;
+
+	// Map the region into our process.
+	LobbySnapshot* snapshot = (LobbySnapshot*)MapViewOfFile(*hMapping, create ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, sizeof(LobbySnapshot));
+	if (snapshot == NULL)
+	{
+		CloseHandle(*hMapping);
+		*hMapping = NULL;
+		return NULL;
+	}
+
+	// If we are the publishing side, initialize the header. New mappings are zero-filled, and both libraries
+	// within the game process write the same values, so this is safe to repeat.
+	if (create)
+	{
+		snapshot->magic = LOBBY_SNAPSHOT_MAGIC;
+		snapshot->version = LOBBY_SNAPSHOT_VERSION;
+		snapshot->size = sizeof(LobbySnapshot);
+		snapshot->processId = processId;
+	}
+	else if (snapshot->magic != LOBBY_SNAPSHOT_MAGIC || snapshot->version != LOBBY_SNAPSHOT_VERSION || snapshot->size != sizeof(LobbySnapshot))
+	{
+		// The region was created by an incompatible version.
+		UnmapViewOfFile(snapshot);
+		CloseHandle(*hMapping);
+		*hMapping = NULL;
+		return NULL;
+	}
+	return snapshot;
+}
+
+/// <summary>
+/// Unmaps a lobby snapshot region and closes its file mapping.
+/// </summary>
+/// <param name="snapshot">The snapshot to unmap.</param>
+/// <param name="hMapping">The handle to the file mapping obtained when opening the snapshot.</param>
+/// <returns>None</returns>
+inline VOID LobbySnapshotClose(LobbySnapshot* snapshot, HANDLE hMapping)
+{
+	if (snapshot != NULL)
+		UnmapViewOfFile(snapshot);
+	if (hMapping != NULL)
+		CloseHandle(hMapping);
+}
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// This header has no platform dependencies, so the snapshot layout and its sequence lock can be tested anywhere. Mapping
+// the shared memory region is left to lobbysnapshot.h.
+
+/// <summary>
+/// A magic value identifying a lobby snapshot region ("ERLS").
+/// </summary>
+const uint32_t LOBBY_SNAPSHOT_MAGIC = 0x534C5245;
+
+/// <summary>
+/// The version of the lobby snapshot layout. This must be incremented whenever the layout changes.
+/// </summary>
+const uint32_t LOBBY_SNAPSHOT_VERSION = 4;
+
+/// <summary>
+/// The maximum amount of entrants recorded in a lobby snapshot.
+/// </summary>
+const uint32_t LOBBY_SNAPSHOT_MAX_ENTRANTS = 32;
+
+/// <summary>
+/// The amount of attempts a reader makes to obtain a consistent snapshot before giving up.
+/// </summary>
+const uint32_t LOBBY_SNAPSHOT_READ_ATTEMPTS = 64;
+
+/// <summary>
+/// The identifier of an entrant in a lobby snapshot. This matches the layout of EchoVR::XPlatformId.
+/// </summary>
+struct LobbySnapshotUserId
+{
+	uint64_t platformCode;
+	uint64_t accountId;
+};
+
+/// <summary>
+/// Information about a single entrant in a lobby snapshot.
+/// </summary>
+struct LobbySnapshotEntrant
+{
+	LobbySnapshotUserId userId; // 0x00
+	int64_t platformId; // 0x10 (EchoVR::SymbolId)
+	char displayName[36]; // 0x18
+	uint16_t ping; // 0x3C
+	uint16_t teamIndex; // 0x3E
+	uint16_t genIndex; // 0x40
+	uint8_t padding[6]; // 0x42
+};
+static_assert(sizeof(LobbySnapshotEntrant) == 0x48, "LobbySnapshotEntrant layout changed, update LOBBY_SNAPSHOT_VERSION.");
+
+/// <summary>
+/// The lobby state published by the game server. This is protected by the sequence counter in <see cref="LobbySnapshot"/>.
+/// </summary>
+struct LobbySnapshotData
+{
+	uint8_t gameSessionId[16]; // 0x00 (GUID)
+	uint32_t entrantsLocked; // 0x10
+	uint32_t registered; // 0x14
+	uint32_t sessionActive; // 0x18
+	uint32_t entrantCount; // 0x1C
+	uint64_t serverId; // 0x20
+	int64_t regionId; // 0x28 (EchoVR::SymbolId)
+	int64_t versionLock; // 0x30 (EchoVR::SymbolId)
+	uint64_t updateCount; // 0x38
+	uint64_t messagesSent; // 0x40
+	uint64_t messagesReceived; // 0x48
+	uint64_t publishTime; // 0x50 (GetTickCount64 at time of publishing)
+	uint64_t serverDbBytesSent; // 0x58
+	uint64_t serverDbBytesReceived; // 0x60
+	uint64_t serverDbRetransmits; // 0x68 (cumulative)
+	uint32_t serverDbRtt; // 0x70 (milliseconds)
+	uint32_t serverDbQueueBytes; // 0x74
+	uint32_t udpReceiveQueueBytes; // 0x78
+	uint32_t netStatsFlags; // 0x7C (NET_STATS_FLAG_*)
+	uint64_t udpReceiveErrors; // 0x80 (system-wide, cumulative)
+	uint64_t workerJobsSubmitted; // 0x88
+	uint64_t workerJobsCompleted; // 0x90
+	uint32_t workerQueueDepth; // 0x98
+	uint32_t workerQueueLatencyMean; // 0x9C (microseconds)
+	uint32_t workerQueueLatencyMax; // 0xA0 (microseconds, over the last worker stats interval)
+	uint32_t workerTurnaroundMax; // 0xA4 (microseconds, over the last worker stats interval)
+	LobbySnapshotEntrant entrants[LOBBY_SNAPSHOT_MAX_ENTRANTS]; // 0xA8
+};
+static_assert(sizeof(LobbySnapshotData) == 0xA8 + (0x48 * LOBBY_SNAPSHOT_MAX_ENTRANTS), "LobbySnapshotData layout changed, update LOBBY_SNAPSHOT_VERSION.");
+
+/// <summary>
+/// A lobby snapshot region, shared between the game server process and external monitors.
+/// The game server library is the sole writer of <see cref="data"/>, using a sequence lock: the sequence is odd while
+/// a write is in progress. Readers copy the data and retry if the sequence changed, so they never block the game thread.
+/// </summary>
+struct LobbySnapshot
+{
+	uint32_t magic; // 0x00
+	uint32_t version; // 0x04
+	uint32_t size; // 0x08
+	uint32_t processId; // 0x0C
+	std::atomic<uint64_t> sequence; // 0x10
+
+	// The net game state is written by the patch library on state transitions, and the capture identifier by the game
+	// server library when a session capture starts or stops (zero while not capturing). They are single atomic values and
+	// are therefore not protected by the sequence lock.
+	std::atomic<int32_t> netGameState; // 0x18
+	std::atomic<uint32_t> captureId; // 0x1C
+
+	LobbySnapshotData data; // 0x20
+};
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t) && ATOMIC_LLONG_LOCK_FREE == 2, "Lobby snapshot atomics must be lock free to be shared between processes.");
+static_assert(offsetof(LobbySnapshot, data) == 0x20, "LobbySnapshot layout changed, update LOBBY_SNAPSHOT_VERSION.");
+
+/// <summary>
+/// Marks the beginning of a write to the snapshot data. The sequence becomes odd, signaling readers to retry.
+/// </summary>
+/// <param name="snapshot">The snapshot being written to.</param>
+/// <returns>None</returns>
+inline void LobbySnapshotBeginWrite(LobbySnapshot* snapshot)
+{
+	snapshot->sequence.store(snapshot->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+}
+
+/// <summary>
+/// Marks the end of a write to the snapshot data. The sequence becomes even, publishing the data to readers.
+/// </summary>
+/// <param name="snapshot">The snapshot being written to.</param>
+/// <returns>None</returns>
+inline void LobbySnapshotEndWrite(LobbySnapshot* snapshot)
+{
+	snapshot->sequence.store(snapshot->sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+/// <summary>
+/// Reads a consistent copy of the snapshot data, retrying if the writer updated it during the copy.
+/// </summary>
+/// <param name="snapshot">The snapshot to read from.</param>
+/// <param name="result">The buffer to copy the snapshot data into.</param>
+/// <returns>true if a consistent copy was obtained, false if the writer was too busy.</returns>
+inline bool LobbySnapshotRead(const LobbySnapshot* snapshot, LobbySnapshotData* result)
+{
+	for (uint32_t attempt = 0; attempt < LOBBY_SNAPSHOT_READ_ATTEMPTS; attempt++)
+	{
+		// If a write is in progress, try again.
+		uint64_t sequenceBefore = snapshot->sequence.load(std::memory_order_acquire);
+		if (sequenceBefore & 1)
+			continue;
+
+		// Copy the data, then verify the sequence did not change while we were copying.
+		memcpy(result, (const void*)&snapshot->data, sizeof(LobbySnapshotData));
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (snapshot->sequence.load(std::memory_order_relaxed) == sequenceBefore)
+			return true;
+	}
+	return false;
+}
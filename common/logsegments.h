@@ -0,0 +1,670 @@
+#pragma once
+
+#include <atomic>
+#include <fstream>
+#include <vector>
+#include "pch.h"
+#include <compressapi.h>
+#include "echovr.h"
+
+#pragma comment(lib, "Cabinet.lib")
+
+/// <summary>
+/// The directory (relative to the game's working directory) log segments are written to.
+/// </summary>
+#define LOG_SEGMENTS_DIRECTORY "_local\\logs"
+
+/// <summary>
+/// A magic value identifying a log segment file ("ERLS").
+/// </summary>
+const UINT32 LOG_SEGMENT_MAGIC = 0x534C5245;
+
+/// <summary>
+/// A magic value identifying a block of records within a log segment ("ERLB").
+/// </summary>
+const UINT32 LOG_SEGMENT_BLOCK_MAGIC = 0x424C5245;
+
+/// <summary>
+/// A magic value identifying the index at the end of a log segment ("ERLI").
+/// </summary>
+const UINT32 LOG_SEGMENT_INDEX_MAGIC = 0x494C5245;
+
+/// <summary>
+/// The version of the log segment layout. This must be incremented whenever the layout changes.
+/// </summary>
+const UINT32 LOG_SEGMENT_VERSION = 1;
+
+/// <summary>
+/// The maximum uncompressed size of a block of records. Each block is compressed independently, so it can be decompressed
+/// without those before it.
+/// </summary>
+const UINT32 LOG_SEGMENT_BLOCK_SIZE = 256 * 1024;
+
+/// <summary>
+/// The size of each of the two buffers log lines are staged in before the sink's thread picks them up, in bytes. Lines
+/// logged while both are full are dropped.
+/// </summary>
+const UINT32 LOG_SINK_STAGING_SIZE = 1024 * 1024;
+
+/// <summary>
+/// The size of the buffer compressed blocks are collected in before being written to the segment, in bytes.
+/// </summary>
+const UINT32 LOG_SINK_WRITE_SIZE = 1024 * 1024;
+
+/// <summary>
+/// The maximum length of a log line, in bytes. Longer lines are truncated.
+/// </summary>
+const UINT32 LOG_SINK_MAX_LINE = 0x1000;
+
+/// <summary>
+/// The interval at which the sink's thread picks up staged lines, in milliseconds.
+/// </summary>
+const DWORD LOG_SINK_DRAIN_INTERVAL_MS = 1000;
+
+/// <summary>
+/// The maximum time a line is held in memory before it is compressed and written, even if its block is not full, in milliseconds.
+/// </summary>
+const ULONGLONG LOG_SINK_FLUSH_INTERVAL_MS = 5000;
+
+/// <summary>
+/// The default size at which a segment is rotated, in bytes (compressed, as written).
+/// </summary>
+const UINT64 LOG_SINK_DEFAULT_SEGMENT_SIZE = 64ULL * 1024 * 1024;
+
+/// <summary>
+/// The default age at which a segment is rotated, in milliseconds.
+/// </summary>
+const ULONGLONG LOG_SINK_DEFAULT_SEGMENT_AGE_MS = 60 * 60 * 1000;
+
+/// <summary>
+/// The default compression algorithm for blocks (the Windows Compression API's XPRESS with Huffman encoding, without framing).
+/// </summary>
+const DWORD LOG_SINK_DEFAULT_COMPRESSION_ALGORITHM = COMPRESS_ALGORITHM_XPRESS_HUFF | COMPRESS_RAW;
+
+/// <summary>
+/// The header of a log segment file.
+/// </summary>
+struct LogSegmentHeader
+{
+	UINT32 magic; // 0x00
+	UINT32 version; // 0x04
+	UINT32 processId; // 0x08
+	UINT32 segmentId; // 0x0C (the segment's position in its process' sequence, from zero)
+	UINT32 compressionAlgorithm; // 0x10 (zero if blocks are stored uncompressed)
+	UINT32 blockSize; // 0x14 (the maximum uncompressed size of a block)
+	FILETIME startTime; // 0x18 (UTC)
+};
+static_assert(sizeof(LogSegmentHeader) == 0x20, "LogSegmentHeader layout changed, update LOG_SEGMENT_VERSION.");
+
+/// <summary>
+/// The header of a block of records within a log segment. Blocks follow the file header back to back.
+/// </summary>
+struct LogSegmentBlockHeader
+{
+	UINT32 magic; // 0x00
+	UINT32 compressedSize; // 0x04 (equal to uncompressedSize if the block is stored uncompressed)
+	UINT32 uncompressedSize; // 0x08
+	UINT32 recordCount; // 0x0C
+	UINT64 firstTime; // 0x10 (FILETIME, UTC)
+	UINT64 lastTime; // 0x18 (FILETIME, UTC)
+};
+static_assert(sizeof(LogSegmentBlockHeader) == 0x20, "LogSegmentBlockHeader layout changed, update LOG_SEGMENT_VERSION.");
+
+/// <summary>
+/// The header of a single log line within a block, followed by its text (without a terminator).
+/// </summary>
+struct LogRecordHeader
+{
+	UINT64 time; // 0x00 (FILETIME, UTC)
+	EchoVR::LogLevel level; // 0x08
+	UINT32 size; // 0x0C
+};
+static_assert(sizeof(LogRecordHeader) == 0x10, "LogRecordHeader layout changed, update LOG_SEGMENT_VERSION.");
+
+/// <summary>
+/// An entry in a log segment's index, describing one block.
+/// </summary>
+struct LogSegmentIndexEntry
+{
+	UINT64 offset; // 0x00 (of the block header, from the start of the file)
+	UINT64 firstTime; // 0x08
+	UINT64 lastTime; // 0x10
+	UINT32 recordCount; // 0x18
+	UINT32 padding; // 0x1C
+};
+static_assert(sizeof(LogSegmentIndexEntry) == 0x20, "LogSegmentIndexEntry layout changed, update LOG_SEGMENT_VERSION.");
+
+/// <summary>
+/// The footer at the end of a log segment which was closed, following its index. A segment from a process which crashed has
+/// no footer, and its blocks must be found by walking their headers.
+/// </summary>
+struct LogSegmentFooter
+{
+	UINT32 magic; // 0x00
+	UINT32 entryCount; // 0x04
+	UINT64 indexOffset; // 0x08
+};
+static_assert(sizeof(LogSegmentFooter) == 0x10, "LogSegmentFooter layout changed, update LOG_SEGMENT_VERSION.");
+
+/// <summary>
+/// A log sink, which writes log lines to compressed, rotated segment files in <see cref="LOG_SEGMENTS_DIRECTORY"/>. Logging
+/// threads only copy each line into a staging buffer. A background thread picks staged lines up, packs them into blocks which
+/// are compressed independently, and writes the compressed blocks in large sequential writes. Each segment ends with an index
+/// of its blocks' times and offsets, so tools can seek by time without decompressing the blocks before it.
+/// </summary>
+struct LogSink
+{
+	// Staging (any thread, guarded by the staging lock).
+	SRWLOCK stagingLock;
+	BYTE* staging[2]; // LOG_SINK_STAGING_SIZE bytes each
+	UINT32 stagingSize[2];
+	UINT32 stagingActive; // the buffer lines are staged in, while the other is drained
+	UINT64 droppedRecords;
+	BOOL passthrough; // indicates lines should still be passed to the game's own log
+
+	// Writing (the sink's thread, or whoever holds the write lock).
+	SRWLOCK writeLock;
+	HANDLE thread;
+	HANDLE wakeEvent;
+	std::atomic<BOOL> closed;
+	DWORD compressionAlgorithm;
+	COMPRESSOR_HANDLE compressor;
+	LogSegmentBlockHeader blockHeader;
+	BYTE* block; // LOG_SEGMENT_BLOCK_SIZE bytes
+	BYTE* compressedBlock; // LOG_SEGMENT_BLOCK_SIZE bytes
+	BYTE* writeBuffer; // LOG_SINK_WRITE_SIZE bytes
+	UINT32 writeBufferSize;
+	ULONGLONG lastFlushTime;
+
+	// The segment being written.
+	HANDLE file; // NULL until a block is written
+	UINT32 segmentId;
+	UINT64 segmentSize; // including blocks in the write buffer
+	ULONGLONG segmentStartTime;
+	UINT64 maxSegmentSize;
+	ULONGLONG maxSegmentAgeMs;
+	std::vector<LogSegmentIndexEntry> index;
+};
+
+/// <summary>
+/// Writes the contents of the sink's write buffer to the current segment. The write lock must be held.
+/// </summary>
+/// <param name="sink">The sink to write.</param>
+/// <returns>None</returns>
+inline VOID LogSinkWriteBuffer(LogSink* sink)
+{
+	if (sink->writeBufferSize == 0)
+		return;
+	DWORD written = 0;
+	if (sink->file != NULL)
+		WriteFile(sink->file, sink->writeBuffer, sink->writeBufferSize, &written, NULL);
+	sink->writeBufferSize = 0;
+}
+
+/// <summary>
+/// Finalizes the current segment, if any, writing its buffered blocks followed by its index. The write lock must be held.
+/// </summary>
+/// <param name="sink">The sink to finalize the segment of.</param>
+/// <returns>None</returns>
+inline VOID LogSinkCloseSegment(LogSink* sink)
+{
+	if (sink->file == NULL)
+		return;
+	LogSinkWriteBuffer(sink);
+
+	// Write the index and footer together, so a segment never has a footer without its index.
+	LogSegmentFooter footer;
+	footer.magic = LOG_SEGMENT_INDEX_MAGIC;
+	footer.entryCount = (UINT32)sink->index.size();
+	footer.indexOffset = sink->segmentSize;
+	std::vector<BYTE> tail(sink->index.size() * sizeof(LogSegmentIndexEntry) + sizeof(footer));
+	if (!sink->index.empty())
+		memcpy(tail.data(), sink->index.data(), sink->index.size() * sizeof(LogSegmentIndexEntry));
+	memcpy(tail.data() + tail.size() - sizeof(footer), &footer, sizeof(footer));
+	DWORD written = 0;
+	WriteFile(sink->file, tail.data(), (DWORD)tail.size(), &written, NULL);
+	CloseHandle(sink->file);
+
+	sink->file = NULL;
+	sink->segmentId++;
+	sink->index.clear();
+}
+
+/// <summary>
+/// Opens the next segment, as "log.&lt;process id&gt;.&lt;segment id&gt;.erl". The write lock must be held.
+/// </summary>
+/// <param name="sink">The sink to open the segment for.</param>
+/// <returns>TRUE if the segment was opened, FALSE otherwise.</returns>
+inline BOOL LogSinkOpenSegment(LogSink* sink)
+{
+	CHAR path[MAX_PATH];
+	CreateDirectoryA("_local", NULL);
+	CreateDirectoryA(LOG_SEGMENTS_DIRECTORY, NULL);
+	sprintf_s(path, LOG_SEGMENTS_DIRECTORY "\\log.%u.%u.erl", GetCurrentProcessId(), sink->segmentId);
+	sink->file = CreateFileA(path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (sink->file == INVALID_HANDLE_VALUE)
+	{
+		sink->file = NULL;
+		return FALSE;
+	}
+
+	// The header leads the first write.
+	LogSegmentHeader* header = (LogSegmentHeader*)sink->writeBuffer;
+	header->magic = LOG_SEGMENT_MAGIC;
+	header->version = LOG_SEGMENT_VERSION;
+	header->processId = GetCurrentProcessId();
+	header->segmentId = sink->segmentId;
+	header->compressionAlgorithm = sink->compressor != NULL ? sink->compressionAlgorithm : 0;
+	header->blockSize = LOG_SEGMENT_BLOCK_SIZE;
+	GetSystemTimeAsFileTime(&header->startTime);
+	sink->writeBufferSize = sizeof(LogSegmentHeader);
+	sink->segmentSize = sizeof(LogSegmentHeader);
+	sink->segmentStartTime = GetTickCount64();
+	return TRUE;
+}
+
+/// <summary>
+/// Compresses the current block and appends it to the write buffer, rotating the segment first if it is full or too old.
+/// The write lock must be held.
+/// </summary>
+/// <param name="sink">The sink to flush the block of.</param>
+/// <returns>None</returns>
+inline VOID LogSinkFlushBlock(LogSink* sink)
+{
+	LogSegmentBlockHeader* header = &sink->blockHeader;
+	if (header->recordCount == 0)
+		return;
+
+	// Compress the block, storing it as-is if it does not compress.
+	SIZE_T compressedSize = 0;
+	const BYTE* data = sink->block;
+	header->compressedSize = header->uncompressedSize;
+	if (sink->compressor != NULL && Compress(sink->compressor, sink->block, header->uncompressedSize, sink->compressedBlock, LOG_SEGMENT_BLOCK_SIZE, &compressedSize) &&
+		compressedSize < header->uncompressedSize)
+	{
+		header->compressedSize = (UINT32)compressedSize;
+		data = sink->compressedBlock;
+	}
+
+	// Rotate the segment if the block would take it past its maximum size, or it has reached its maximum age.
+	UINT32 blockSize = sizeof(LogSegmentBlockHeader) + header->compressedSize;
+	if (sink->file != NULL && sink->index.size() != 0 && (sink->segmentSize + blockSize > sink->maxSegmentSize ||
+		GetTickCount64() - sink->segmentStartTime >= sink->maxSegmentAgeMs))
+		LogSinkCloseSegment(sink);
+	if (sink->file == NULL && !LogSinkOpenSegment(sink))
+	{
+		memset(header, 0, sizeof(*header));
+		return;
+	}
+
+	// Append the block to the write buffer, writing the buffer out first if it would not fit.
+	if (sink->writeBufferSize + blockSize > LOG_SINK_WRITE_SIZE)
+		LogSinkWriteBuffer(sink);
+	LogSegmentIndexEntry entry;
+	entry.offset = sink->segmentSize;
+	entry.firstTime = header->firstTime;
+	entry.lastTime = header->lastTime;
+	entry.recordCount = header->recordCount;
+	entry.padding = 0;
+	sink->index.push_back(entry);
+	header->magic = LOG_SEGMENT_BLOCK_MAGIC;
+	memcpy(sink->writeBuffer + sink->writeBufferSize, header, sizeof(LogSegmentBlockHeader));
+	memcpy(sink->writeBuffer + sink->writeBufferSize + sizeof(LogSegmentBlockHeader), data, header->compressedSize);
+	sink->writeBufferSize += blockSize;
+	sink->segmentSize += blockSize;
+	memset(header, 0, sizeof(*header));
+}
+
+/// <summary>
+/// Packs the lines in a staging buffer, which logging threads are no longer staging into, into blocks. Blocks are compressed
+/// when full, and written once the write buffer is full, or the flush interval has elapsed. The write lock must be held.
+/// </summary>
+/// <param name="sink">The sink to drain.</param>
+/// <param name="drained">The index of the staging buffer to drain.</param>
+/// <param name="flush">Indicates whether the current block and write buffer should be written regardless of the flush interval.</param>
+/// <returns>None</returns>
+inline VOID LogSinkDrainStaging(LogSink* sink, UINT32 drained, BOOL flush)
+{
+	// Pack each staged line into the current block.
+	BYTE* staging = sink->staging[drained];
+	UINT32 stagingSize = sink->stagingSize[drained];
+	for (UINT32 offset = 0; offset < stagingSize;)
+	{
+		const LogRecordHeader* record = (const LogRecordHeader*)(staging + offset);
+		UINT32 recordSize = sizeof(LogRecordHeader) + record->size;
+		LogSegmentBlockHeader* header = &sink->blockHeader;
+		if (header->uncompressedSize + recordSize > LOG_SEGMENT_BLOCK_SIZE)
+			LogSinkFlushBlock(sink);
+		if (header->recordCount == 0)
+			header->firstTime = record->time;
+		header->lastTime = record->time;
+		memcpy(sink->block + header->uncompressedSize, record, recordSize);
+		header->uncompressedSize += recordSize;
+		header->recordCount++;
+		offset += recordSize;
+	}
+	sink->stagingSize[drained] = 0;
+
+	// Write what we have once the flush interval has elapsed, so lines reach the disk promptly while blocks stay large.
+	ULONGLONG now = GetTickCount64();
+	if (flush || now - sink->lastFlushTime >= LOG_SINK_FLUSH_INTERVAL_MS)
+	{
+		LogSinkFlushBlock(sink);
+		LogSinkWriteBuffer(sink);
+		sink->lastFlushTime = now;
+	}
+}
+
+/// <summary>
+/// Picks up the lines staged since the last drain and packs them into blocks. The write lock must be held.
+/// </summary>
+/// <param name="sink">The sink to drain.</param>
+/// <param name="flush">Indicates whether the current block and write buffer should be written regardless of the flush interval.</param>
+/// <returns>None</returns>
+inline VOID LogSinkDrain(LogSink* sink, BOOL flush)
+{
+	// Swap the staging buffers, so logging threads stage into the other while we drain this one.
+	AcquireSRWLockExclusive(&sink->stagingLock);
+	UINT32 drained = sink->stagingActive;
+	sink->stagingActive ^= 1;
+	ReleaseSRWLockExclusive(&sink->stagingLock);
+	LogSinkDrainStaging(sink, drained, flush);
+}
+
+/// <summary>
+/// The sink's thread entry point, which drains staged lines until the sink is closed.
+/// </summary>
+/// <param name="parameter">The sink.</param>
+/// <returns>Zero.</returns>
+inline DWORD WINAPI LogSinkThreadProc(LPVOID parameter)
+{
+	LogSink* sink = (LogSink*)parameter;
+	while (!sink->closed.load(std::memory_order_acquire))
+	{
+		WaitForSingleObject(sink->wakeEvent, LOG_SINK_DRAIN_INTERVAL_MS);
+		AcquireSRWLockExclusive(&sink->writeLock);
+		if (!sink->closed.load(std::memory_order_relaxed))
+			LogSinkDrain(sink, FALSE);
+		ReleaseSRWLockExclusive(&sink->writeLock);
+	}
+	return 0;
+}
+
+/// <summary>
+/// Starts a log sink, which begins a new segment with the first line logged.
+/// </summary>
+/// <param name="sink">The sink to start.</param>
+/// <param name="compressionAlgorithm">The Windows Compression API algorithm blocks are compressed with (with COMPRESS_RAW), or zero to store them uncompressed.</param>
+/// <param name="maxSegmentSize">The size at which a segment is rotated, in bytes.</param>
+/// <param name="maxSegmentAgeMs">The age at which a segment is rotated, in milliseconds.</param>
+/// <param name="passthrough">Indicates whether lines should still be passed to the game's own log.</param>
+/// <returns>TRUE if the sink was started, FALSE otherwise.</returns>
+inline BOOL LogSinkStart(LogSink* sink, DWORD compressionAlgorithm, UINT64 maxSegmentSize, ULONGLONG maxSegmentAgeMs, BOOL passthrough)
+{
+	InitializeSRWLock(&sink->stagingLock);
+	InitializeSRWLock(&sink->writeLock);
+	sink->staging[0] = (BYTE*)malloc(LOG_SINK_STAGING_SIZE);
+	sink->staging[1] = (BYTE*)malloc(LOG_SINK_STAGING_SIZE);
+	sink->stagingSize[0] = sink->stagingSize[1] = 0;
+	sink->stagingActive = 0;
+	sink->droppedRecords = 0;
+	sink->passthrough = passthrough;
+	sink->closed.store(FALSE, std::memory_order_relaxed);
+	sink->compressionAlgorithm = compressionAlgorithm;
+	sink->compressor = NULL;
+	memset(&sink->blockHeader, 0, sizeof(sink->blockHeader));
+	sink->block = (BYTE*)malloc(LOG_SEGMENT_BLOCK_SIZE);
+	sink->compressedBlock = (BYTE*)malloc(LOG_SEGMENT_BLOCK_SIZE);
+	sink->writeBuffer = (BYTE*)malloc(LOG_SINK_WRITE_SIZE);
+	sink->writeBufferSize = 0;
+	sink->lastFlushTime = GetTickCount64();
+	sink->file = NULL;
+	sink->segmentId = 0;
+	sink->segmentSize = 0;
+	sink->maxSegmentSize = maxSegmentSize;
+	sink->maxSegmentAgeMs = maxSegmentAgeMs;
+	sink->wakeEvent = CreateEventA(NULL, FALSE, FALSE, NULL);
+	sink->thread = NULL;
+	if (sink->staging[0] == NULL || sink->staging[1] == NULL || sink->block == NULL || sink->compressedBlock == NULL || sink->writeBuffer == NULL ||
+		sink->wakeEvent == NULL)
+		return FALSE;
+
+	// Blocks are stored uncompressed if a compressor is unavailable.
+	if (compressionAlgorithm != 0 && !CreateCompressor(compressionAlgorithm, NULL, &sink->compressor))
+		sink->compressor = NULL;
+	sink->thread = CreateThread(NULL, 0, LogSinkThreadProc, sink, 0, NULL);
+	return sink->thread != NULL;
+}
+
+/// <summary>
+/// Closes a log sink as the process exits, writing any staged lines and finalizing the current segment's index. Threads
+/// terminated by the exit never release the locks they held, so neither the sink's thread nor its locks are waited on. If
+/// a thread was terminated while writing, the segment is left without its index, and its blocks can still be found by
+/// walking their headers. If one was terminated while staging a line, the staged lines are dropped, but the lines already
+/// packed into blocks are still written.
+/// </summary>
+/// <param name="sink">The sink to close.</param>
+/// <returns>None</returns>
+inline VOID LogSinkCloseOnExit(LogSink* sink)
+{
+	if (sink->thread == NULL || sink->closed.load(std::memory_order_relaxed))
+		return;
+	if (!TryAcquireSRWLockExclusive(&sink->writeLock))
+		return;
+
+	// Drain the staging buffer in use if we can take it, otherwise drain the other, which is empty, to write what was packed.
+	UINT32 drained = sink->stagingActive ^ 1;
+	if (TryAcquireSRWLockExclusive(&sink->stagingLock))
+	{
+		drained = sink->stagingActive;
+		sink->stagingActive ^= 1;
+		ReleaseSRWLockExclusive(&sink->stagingLock);
+	}
+	LogSinkDrainStaging(sink, drained, TRUE);
+	LogSinkCloseSegment(sink);
+	sink->closed.store(TRUE, std::memory_order_release);
+	ReleaseSRWLockExclusive(&sink->writeLock);
+	SetEvent(sink->wakeEvent);
+}
+
+/// <summary>
+/// Formats a log line and stages it to be written by the sink's thread. This may be called from any thread.
+/// </summary>
+/// <param name="sink">The sink to log to.</param>
+/// <param name="level">The level the line was logged with.</param>
+/// <param name="format">The format string.</param>
+/// <param name="vl">The arguments for the format string.</param>
+/// <returns>None</returns>
+inline VOID LogSinkWrite(LogSink* sink, EchoVR::LogLevel level, const CHAR* format, va_list vl)
+{
+	if (sink->thread == NULL || sink->closed.load(std::memory_order_relaxed))
+		return;
+
+	// Format the line outside of the lock.
+	BYTE record[sizeof(LogRecordHeader) + LOG_SINK_MAX_LINE];
+	LogRecordHeader* header = (LogRecordHeader*)record;
+	INT32 length = vsnprintf((CHAR*)record + sizeof(LogRecordHeader), LOG_SINK_MAX_LINE, format, vl);
+	FILETIME now;
+	GetSystemTimeAsFileTime(&now);
+	header->time = ((ULARGE_INTEGER*)&now)->QuadPart;
+	header->level = level;
+	header->size = (UINT32)min(max(length, 0), (INT32)LOG_SINK_MAX_LINE - 1);
+
+	// Copy it into the active staging buffer, waking the sink's thread early once the buffer is half full.
+	UINT32 recordSize = sizeof(LogRecordHeader) + header->size;
+	BOOL wake = FALSE;
+	AcquireSRWLockExclusive(&sink->stagingLock);
+	UINT32* stagingSize = &sink->stagingSize[sink->stagingActive];
+	if (*stagingSize + recordSize <= LOG_SINK_STAGING_SIZE)
+	{
+		memcpy(sink->staging[sink->stagingActive] + *stagingSize, record, recordSize);
+		*stagingSize += recordSize;
+		wake = *stagingSize >= LOG_SINK_STAGING_SIZE / 2 && *stagingSize - recordSize < LOG_SINK_STAGING_SIZE / 2;
+	}
+	else
+	{
+		sink->droppedRecords++;
+	}
+	ReleaseSRWLockExclusive(&sink->stagingLock);
+	if (wake)
+		SetEvent(sink->wakeEvent);
+}
+
+/// <summary>
+/// A log segment reader, which reads a segment one block at a time.
+/// </summary>
+struct LogSegmentReader
+{
+	std::ifstream file;
+	LogSegmentHeader header;
+	DECOMPRESSOR_HANDLE decompressor;
+	std::vector<LogSegmentIndexEntry> index;
+	BOOL indexed; // indicates the index was read from the segment's footer, rather than built by walking its blocks
+	std::vector<BYTE> compressedBlock;
+	std::vector<BYTE> block;
+	UINT32 blockOffset;
+};
+
+/// <summary>
+/// Opens a log segment for reading, reading its index. If the segment has no index (its process crashed), one is built by
+/// walking the block headers, which does not decompress them.
+/// </summary>
+/// <param name="reader">The reader to open the segment with.</param>
+/// <param name="path">The path of the log segment.</param>
+/// <returns>TRUE if the file was opened and is a compatible log segment, FALSE otherwise.</returns>
+inline BOOL LogSegmentReaderOpen(LogSegmentReader* reader, const CHAR* path)
+{
+	reader->file.open(path, std::ios::binary);
+	reader->decompressor = NULL;
+	reader->indexed = FALSE;
+	reader->blockOffset = 0;
+	if (!reader->file.read((CHAR*)&reader->header, sizeof(reader->header)) || reader->header.magic != LOG_SEGMENT_MAGIC ||
+		reader->header.version != LOG_SEGMENT_VERSION || reader->header.blockSize == 0 || reader->header.blockSize > LOG_SEGMENT_BLOCK_SIZE)
+		return FALSE;
+	if (reader->header.compressionAlgorithm != 0 && !CreateDecompressor(reader->header.compressionAlgorithm, NULL, &reader->decompressor))
+		return FALSE;
+
+	// Read the index from the footer, if the segment was closed.
+	LogSegmentFooter footer;
+	reader->file.seekg(0, std::ios::end);
+	UINT64 fileSize = (UINT64)reader->file.tellg();
+	if (fileSize >= sizeof(LogSegmentHeader) + sizeof(footer))
+	{
+		reader->file.seekg(fileSize - sizeof(footer));
+		if (reader->file.read((CHAR*)&footer, sizeof(footer)) && footer.magic == LOG_SEGMENT_INDEX_MAGIC &&
+			footer.indexOffset + (UINT64)footer.entryCount * sizeof(LogSegmentIndexEntry) + sizeof(footer) == fileSize)
+		{
+			reader->index.resize(footer.entryCount);
+			reader->file.seekg(footer.indexOffset);
+			reader->indexed = reader->file.read((CHAR*)reader->index.data(), footer.entryCount * sizeof(LogSegmentIndexEntry)) ? TRUE : FALSE;
+		}
+	}
+
+	// Otherwise, walk the block headers. A block which was never written (e.g. the tail of a segment from a process which
+	// crashed) has no magic.
+	if (!reader->indexed)
+	{
+		reader->index.clear();
+		reader->file.clear();
+		UINT64 offset = sizeof(LogSegmentHeader);
+		LogSegmentBlockHeader blockHeader;
+		while (reader->file.seekg(offset) && reader->file.read((CHAR*)&blockHeader, sizeof(blockHeader)) && blockHeader.magic == LOG_SEGMENT_BLOCK_MAGIC &&
+			blockHeader.uncompressedSize <= reader->header.blockSize && blockHeader.compressedSize <= blockHeader.uncompressedSize &&
+			offset + sizeof(blockHeader) + blockHeader.compressedSize <= fileSize)
+		{
+			LogSegmentIndexEntry entry;
+			entry.offset = offset;
+			entry.firstTime = blockHeader.firstTime;
+			entry.lastTime = blockHeader.lastTime;
+			entry.recordCount = blockHeader.recordCount;
+			entry.padding = 0;
+			reader->index.push_back(entry);
+			offset += sizeof(blockHeader) + blockHeader.compressedSize;
+		}
+	}
+
+	// Position the reader at the first block.
+	reader->file.clear();
+	reader->file.seekg(sizeof(LogSegmentHeader));
+	return TRUE;
+}
+
+/// <summary>
+/// Positions the reader at the first block which may hold lines logged at or after a given time. Only that block and those
+/// after it are decompressed by subsequent reads.
+/// </summary>
+/// <param name="reader">The reader to position.</param>
+/// <param name="time">The time to seek to (FILETIME, UTC).</param>
+/// <returns>None</returns>
+inline VOID LogSegmentReaderSeek(LogSegmentReader* reader, UINT64 time)
+{
+	// Blocks are in the order they were logged, so their last times are ascending.
+	UINT32 first = 0;
+	while (first < reader->index.size() && reader->index[first].lastTime < time)
+		first++;
+	reader->file.clear();
+	if (first < reader->index.size())
+		reader->file.seekg(reader->index[first].offset);
+	else
+		reader->file.seekg(0, std::ios::end);
+	reader->block.clear();
+	reader->blockOffset = 0;
+}
+
+/// <summary>
+/// Reads the next line from a log segment.
+/// </summary>
+/// <param name="reader">The reader to read with.</param>
+/// <param name="header">The header of the line which was read.</param>
+/// <param name="text">The text of the line which was read (of header->size bytes, without a terminator). This remains valid until the next read.</param>
+/// <returns>TRUE if a line was read, FALSE if the end of the segment was reached (or it was truncated or corrupt).</returns>
+inline BOOL LogSegmentReaderNext(LogSegmentReader* reader, LogRecordHeader* header, const CHAR** text)
+{
+	// If we have consumed the current block, read and decompress the next.
+	if (reader->blockOffset >= reader->block.size())
+	{
+		LogSegmentBlockHeader blockHeader;
+		if (!reader->file.read((CHAR*)&blockHeader, sizeof(blockHeader)) || blockHeader.magic != LOG_SEGMENT_BLOCK_MAGIC ||
+			blockHeader.uncompressedSize > reader->header.blockSize || blockHeader.compressedSize > blockHeader.uncompressedSize)
+			return FALSE;
+		reader->block.resize(blockHeader.uncompressedSize);
+		reader->blockOffset = 0;
+		if (blockHeader.compressedSize == blockHeader.uncompressedSize)
+		{
+			if (!reader->file.read((CHAR*)reader->block.data(), blockHeader.uncompressedSize))
+				return FALSE;
+		}
+		else
+		{
+			SIZE_T decompressedSize = 0;
+			reader->compressedBlock.resize(blockHeader.compressedSize);
+			if (reader->decompressor == NULL || !reader->file.read((CHAR*)reader->compressedBlock.data(), blockHeader.compressedSize) ||
+				!Decompress(reader->decompressor, reader->compressedBlock.data(), blockHeader.compressedSize, reader->block.data(), blockHeader.uncompressedSize, &decompressedSize) ||
+				decompressedSize != blockHeader.uncompressedSize)
+				return FALSE;
+		}
+	}
+
+	// Read the next line from the block.
+	if (reader->blockOffset + sizeof(LogRecordHeader) > reader->block.size())
+		return FALSE;
+	memcpy(header, reader->block.data() + reader->blockOffset, sizeof(LogRecordHeader));
+	if (reader->blockOffset + sizeof(LogRecordHeader) + header->size > reader->block.size())
+		return FALSE;
+	*text = (const CHAR*)reader->block.data() + reader->blockOffset + sizeof(LogRecordHeader);
+	reader->blockOffset += sizeof(LogRecordHeader) + header->size;
+	return TRUE;
+}
+
+/// <summary>
+/// Closes a log segment opened for reading.
+/// </summary>
+/// <param name="reader">The reader to close.</param>
+/// <returns>None</returns>
+inline VOID LogSegmentReaderClose(LogSegmentReader* reader)
+{
+	if (reader->decompressor != NULL)
+		CloseDecompressor(reader->decompressor);
+	reader->decompressor = NULL;
+	reader->file.close();
+}
@@ -0,0 +1,376 @@
+#pragma once
+
+#include <atomic>
+#include "pch.h"
+#include <psapi.h>
+#include <tlhelp32.h>
+#include "foldedstacks.h"
+#include "stackcapture.h"
+
+/// <summary>
+/// The directory (relative to the game's working directory) profiles are written to.
+/// </summary>
+#define PROFILER_DUMP_DIRECTORY "_local\\profiles"
+
+/// <summary>
+/// The format of the name of the event which requests a profile be written, keyed by process identifier. External tools
+/// (such as EchoRelay.Monitor) signal it to write a profile on demand.
+/// </summary>
+#define PROFILER_DUMP_EVENT_NAME_FORMAT "Local\\EchoRelay.Profiler.%u"
+
+/// <summary>
+/// The maximum sampling rate, in samples per second of each thread.
+/// </summary>
+const UINT32 PROFILER_MAX_RATE_HZ = 1000;
+
+/// <summary>
+/// The portion of a CPU core the profiler may spend sampling (including the time threads are suspended), as a percentage.
+/// The sampling rate is lowered as needed to remain within it.
+/// </summary>
+const UINT32 PROFILER_CPU_BUDGET_PERCENT = 1;
+
+/// <summary>
+/// The maximum amount of threads sampled. Threads beyond this are not sampled.
+/// </summary>
+const UINT32 PROFILER_MAX_THREADS = 128;
+
+/// <summary>
+/// The interval at which the list of threads to sample is refreshed, in milliseconds.
+/// </summary>
+const ULONGLONG PROFILER_THREAD_REFRESH_MS = 5000;
+
+/// <summary>
+/// The maximum amount of each thread's stack copied for a sample, in bytes. Deeper frames are not unwound.
+/// </summary>
+const UINT64 PROFILER_STACK_COPY_SIZE = 64 * 1024;
+
+/// <summary>
+/// The maximum amount of profiles written by a process, so a long-running server does not fill its disk.
+/// </summary>
+const UINT32 PROFILER_MAX_DUMPS = 256;
+
+/// <summary>
+/// A request made to the profiler thread, as a flag.
+/// </summary>
+const UINT32 PROFILER_REQUEST_RESET = 1; // discard the samples taken so far
+const UINT32 PROFILER_REQUEST_DUMP_SESSION = 2; // write the samples taken so far as a session's profile, then discard them
+
+/// <summary>
+/// A thread of the process being sampled.
+/// </summary>
+struct ProfilerThread
+{
+	DWORD threadId;
+	HANDLE handle;
+	ULONG64 cycleTime; // the thread's cycle time when last sampled, so threads which have not run since are skipped
+	BOOL seen; // used while refreshing the thread list
+};
+
+/// <summary>
+/// A low-rate sampling profiler, which periodically suspends each thread in the process that has run since it was last
+/// sampled, and records its stack (as function start addresses) into folded stack counts. Profiles are written to
+/// <see cref="PROFILER_DUMP_DIRECTORY"/> when requested, symbolized as module offsets.
+/// </summary>
+struct Profiler
+{
+	HANDLE thread;
+	DWORD threadId;
+	HANDLE stopEvent;
+	HANDLE requestEvent; // signaled with the requests flags set
+	HANDLE dumpEvent; // named, signaled by external tools to write a profile on demand
+	std::atomic<UINT32> requests;
+	DWORD intervalMs;
+	INT64 frequency; // QueryPerformanceFrequency
+
+	// Sampling state (profiler thread only).
+	ProfilerThread threads[PROFILER_MAX_THREADS];
+	UINT32 threadCount;
+	ULONGLONG lastThreadRefresh;
+	BYTE* stackCopy;
+	FoldedStacks* stacks;
+	FoldedStacksModules modules;
+	INT64 sampleTime; // QueryPerformanceCounter ticks spent sampling since the samples were last discarded
+	UINT32 dumpCount;
+};
+
+/// <summary>
+/// Refreshes the list of threads to sample, opening threads which have started, and closing those which have exited.
+/// </summary>
+/// <param name="profiler">The profiler to refresh the thread list of.</param>
+/// <returns>None</returns>
+inline VOID ProfilerRefreshThreads(Profiler* profiler)
+{
+	HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+	if (snapshot == INVALID_HANDLE_VALUE)
+		return;
+	for (UINT32 i = 0; i < profiler->threadCount; i++)
+		profiler->threads[i].seen = FALSE;
+
+	// Mark the threads we know of which still exist, and open any others in our process (other than our own).
+	DWORD processId = GetCurrentProcessId();
+	THREADENTRY32 entry;
+	entry.dwSize = sizeof(entry);
+	for (BOOL found = Thread32First(snapshot, &entry); found; found = Thread32Next(snapshot, &entry))
+	{
+		if (entry.th32OwnerProcessID != processId || entry.th32ThreadID == profiler->threadId)
+			continue;
+		UINT32 index = 0;
+		while (index < profiler->threadCount && profiler->threads[index].threadId != entry.th32ThreadID)
+			index++;
+		if (index < profiler->threadCount)
+		{
+			profiler->threads[index].seen = TRUE;
+			continue;
+		}
+		if (profiler->threadCount == PROFILER_MAX_THREADS)
+			continue;
+		HANDLE handle = OpenThread(THREAD_SUSPEND_RESUME | THREAD_GET_CONTEXT | THREAD_QUERY_LIMITED_INFORMATION, FALSE, entry.th32ThreadID);
+		if (handle == NULL)
+			continue;
+		ProfilerThread* thread = &profiler->threads[profiler->threadCount++];
+		thread->threadId = entry.th32ThreadID;
+		thread->handle = handle;
+		thread->cycleTime = 0;
+		thread->seen = TRUE;
+	}
+	CloseHandle(snapshot);
+
+	// Close the threads which have exited.
+	UINT32 retained = 0;
+	for (UINT32 i = 0; i < profiler->threadCount; i++)
+	{
+		if (profiler->threads[i].seen)
+			profiler->threads[retained++] = profiler->threads[i];
+		else
+			CloseHandle(profiler->threads[i].handle);
+	}
+	profiler->threadCount = retained;
+}
+
+/// <summary>
+/// Samples the stack of each thread which has run since it was last sampled, counting it in the folded stacks.
+/// Idle threads are skipped, so profiles show where CPU time was spent.
+/// </summary>
+/// <param name="profiler">The profiler to sample with.</param>
+/// <returns>None</returns>
+inline VOID ProfilerSample(Profiler* profiler)
+{
+	UINT64 frames[FOLDED_STACKS_MAX_FRAMES];
+	for (UINT32 i = 0; i < profiler->threadCount; i++)
+	{
+		ProfilerThread* thread = &profiler->threads[i];
+		ULONG64 cycleTime = 0;
+		if (!QueryThreadCycleTime(thread->handle, &cycleTime) || cycleTime == thread->cycleTime)
+			continue;
+		thread->cycleTime = cycleTime;
+
+		BOOL truncated;
+		UINT32 frameCount = StackCapture(thread->handle, profiler->stackCopy, PROFILER_STACK_COPY_SIZE, frames, FOLDED_STACKS_MAX_FRAMES, TRUE, &truncated);
+		if (frameCount != 0)
+			FoldedStacksAdd(profiler->stacks, thread->threadId, frames, frameCount, truncated != FALSE);
+	}
+}
+
+/// <summary>
+/// Loads the list of modules in the process, to symbolize frames against.
+/// </summary>
+/// <param name="profiler">The profiler to load the module list of.</param>
+/// <returns>None</returns>
+inline VOID ProfilerLoadModules(Profiler* profiler)
+{
+	HMODULE handles[FOLDED_STACKS_MAX_MODULES];
+	DWORD needed = 0;
+	profiler->modules.count = 0;
+	if (!EnumProcessModules(GetCurrentProcess(), handles, sizeof(handles), &needed))
+		return;
+	UINT32 count = min(needed / (DWORD)sizeof(HMODULE), FOLDED_STACKS_MAX_MODULES);
+	for (UINT32 i = 0; i < count; i++)
+	{
+		MODULEINFO info;
+		CHAR path[MAX_PATH];
+		if (!GetModuleInformation(GetCurrentProcess(), handles[i], &info, sizeof(info)) || GetModuleFileNameA(handles[i], path, sizeof(path)) == 0)
+			continue;
+		FoldedStacksModule* module = &profiler->modules.modules[profiler->modules.count++];
+		const CHAR* name = strrchr(path, '\\');
+		module->base = (UINT64)info.lpBaseOfDll;
+		module->size = info.SizeOfImage;
+		strncpy_s(module->name, name != NULL ? name + 1 : path, _TRUNCATE);
+	}
+	FoldedStacksSortModules(&profiler->modules);
+}
+
+/// <summary>
+/// Discards the samples taken so far.
+/// </summary>
+/// <param name="profiler">The profiler to discard the samples of.</param>
+/// <returns>None</returns>
+inline VOID ProfilerReset(Profiler* profiler)
+{
+	FoldedStacksReset(profiler->stacks);
+	profiler->sampleTime = 0;
+}
+
+/// <summary>
+/// Writes the samples taken so far as folded stacks to a file in <see cref="PROFILER_DUMP_DIRECTORY"/>, then discards them.
+/// </summary>
+/// <param name="profiler">The profiler to write the samples of.</param>
+/// <param name="reason">The reason for the profile, used in its file name.</param>
+/// <returns>None</returns>
+inline VOID ProfilerDump(Profiler* profiler, const CHAR* reason)
+{
+	if (profiler->stacks->sampleCount != 0 && profiler->dumpCount < PROFILER_MAX_DUMPS)
+	{
+		CHAR path[MAX_PATH];
+		FILE* file = NULL;
+		CreateDirectoryA("_local", NULL);
+		CreateDirectoryA(PROFILER_DUMP_DIRECTORY, NULL);
+		sprintf_s(path, PROFILER_DUMP_DIRECTORY "\\profile.%u.%u.%s.folded", GetCurrentProcessId(), profiler->dumpCount, reason);
+		if (fopen_s(&file, path, "w") == 0 && file != NULL)
+		{
+			ProfilerLoadModules(profiler);
+			FoldedStacksWrite(profiler->stacks, &profiler->modules, file);
+			fclose(file);
+			profiler->dumpCount++;
+		}
+	}
+	ProfilerReset(profiler);
+}
+
+/// <summary>
+/// The profiler thread's entry point, which samples threads at the configured rate (or lower, to remain within the CPU
+/// budget) and handles requests, until the profiler is stopped.
+/// </summary>
+/// <param name="parameter">The profiler.</param>
+/// <returns>Zero.</returns>
+inline DWORD WINAPI ProfilerThreadProc(LPVOID parameter)
+{
+	Profiler* profiler = (Profiler*)parameter;
+	HANDLE events[] = { profiler->stopEvent, profiler->requestEvent, profiler->dumpEvent };
+	DWORD waitMs = profiler->intervalMs;
+	while (TRUE)
+	{
+		DWORD result = WaitForMultipleObjects(profiler->dumpEvent != NULL ? 3 : 2, events, FALSE, waitMs);
+		if (result == WAIT_OBJECT_0 + 1)
+		{
+			UINT32 requests = profiler->requests.exchange(0, std::memory_order_acquire);
+			if (requests & PROFILER_REQUEST_DUMP_SESSION)
+				ProfilerDump(profiler, "session");
+			if (requests & PROFILER_REQUEST_RESET)
+				ProfilerReset(profiler);
+			continue;
+		}
+		if (result == WAIT_OBJECT_0 + 2)
+		{
+			ProfilerDump(profiler, "request");
+			continue;
+		}
+		if (result != WAIT_TIMEOUT)
+			break;
+
+		// Sample each thread which has run, refreshing the thread list if it is due.
+		LARGE_INTEGER start, end;
+		QueryPerformanceCounter(&start);
+		ULONGLONG now = GetTickCount64();
+		if (now - profiler->lastThreadRefresh >= PROFILER_THREAD_REFRESH_MS)
+		{
+			profiler->lastThreadRefresh = now;
+			ProfilerRefreshThreads(profiler);
+		}
+		ProfilerSample(profiler);
+		QueryPerformanceCounter(&end);
+
+		// Wait long enough after each round that the time spent sampling remains within our CPU budget.
+		INT64 cost = end.QuadPart - start.QuadPart;
+		profiler->sampleTime += cost;
+		INT64 budgetWaitMs = cost * (100 / PROFILER_CPU_BUDGET_PERCENT - 1) * 1000 / profiler->frequency;
+		waitMs = (DWORD)max((INT64)profiler->intervalMs, budgetWaitMs);
+	}
+	return 0;
+}
+
+/// <summary>
+/// Stops the profiler thread, discarding any samples which have not been written.
+/// </summary>
+/// <param name="profiler">The profiler to stop.</param>
+/// <returns>None</returns>
+inline VOID ProfilerStop(Profiler* profiler)
+{
+	if (profiler->thread != NULL)
+	{
+		SetEvent(profiler->stopEvent);
+		WaitForSingleObject(profiler->thread, INFINITE);
+		CloseHandle(profiler->thread);
+		profiler->thread = NULL;
+	}
+	for (UINT32 i = 0; i < profiler->threadCount; i++)
+		CloseHandle(profiler->threads[i].handle);
+	profiler->threadCount = 0;
+	HANDLE* events[] = { &profiler->stopEvent, &profiler->requestEvent, &profiler->dumpEvent };
+	for (UINT32 i = 0; i < ARRAYSIZE(events); i++)
+	{
+		if (*events[i] != NULL)
+			CloseHandle(*events[i]);
+		*events[i] = NULL;
+	}
+	if (profiler->stacks != NULL)
+		VirtualFree(profiler->stacks, 0, MEM_RELEASE);
+	if (profiler->stackCopy != NULL)
+		VirtualFree(profiler->stackCopy, 0, MEM_RELEASE);
+	profiler->stacks = NULL;
+	profiler->stackCopy = NULL;
+}
+
+/// <summary>
+/// Starts the profiler thread, sampling every other thread in the process.
+/// </summary>
+/// <param name="profiler">The profiler to start.</param>
+/// <param name="rateHz">The rate at which to sample each thread, in samples per second. This is lowered as needed to remain within <see cref="PROFILER_CPU_BUDGET_PERCENT"/>.</param>
+/// <returns>TRUE if the profiler thread was started, FALSE otherwise.</returns>
+inline BOOL ProfilerStart(Profiler* profiler, UINT32 rateHz)
+{
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	profiler->frequency = frequency.QuadPart;
+	profiler->intervalMs = 1000 / min(max(rateHz, 1u), PROFILER_MAX_RATE_HZ);
+	profiler->requests.store(0, std::memory_order_relaxed);
+	profiler->threadCount = 0;
+	profiler->lastThreadRefresh = 0;
+	profiler->sampleTime = 0;
+	profiler->dumpCount = 0;
+
+	// Reserve our stack copy and folded stacks up front, so sampling never allocates.
+	CHAR dumpEventName[64];
+	sprintf_s(dumpEventName, PROFILER_DUMP_EVENT_NAME_FORMAT, GetCurrentProcessId());
+	profiler->stackCopy = (BYTE*)VirtualAlloc(NULL, PROFILER_STACK_COPY_SIZE, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	profiler->stacks = (FoldedStacks*)VirtualAlloc(NULL, sizeof(FoldedStacks), MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	profiler->stopEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+	profiler->requestEvent = CreateEventA(NULL, FALSE, FALSE, NULL);
+	profiler->dumpEvent = CreateEventA(NULL, FALSE, FALSE, dumpEventName);
+	profiler->thread = NULL;
+	if (profiler->stackCopy != NULL && profiler->stacks != NULL && profiler->stopEvent != NULL && profiler->requestEvent != NULL)
+	{
+		FoldedStacksReset(profiler->stacks);
+		profiler->thread = CreateThread(NULL, 0, ProfilerThreadProc, profiler, CREATE_SUSPENDED, &profiler->threadId);
+	}
+	if (profiler->thread == NULL)
+	{
+		ProfilerStop(profiler);
+		return FALSE;
+	}
+	ResumeThread(profiler->thread);
+	return TRUE;
+}
+
+/// <summary>
+/// Makes a request of the profiler thread. This may be called from any thread.
+/// </summary>
+/// <param name="profiler">The profiler to make the request of.</param>
+/// <param name="request">The request flags (PROFILER_REQUEST_*).</param>
+/// <returns>None</returns>
+inline VOID ProfilerRequest(Profiler* profiler, UINT32 request)
+{
+	if (profiler->thread == NULL)
+		return;
+	profiler->requests.fetch_or(request, std::memory_order_release);
+	SetEvent(profiler->requestEvent);
+}
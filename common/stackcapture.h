@@ -0,0 +1,103 @@
+#pragma once
+
+#include "pch.h"
+
+/// <summary>
+/// The amount of a copied stack left unwound below its end when the stack was truncated, in bytes, so unwinding a frame
+/// never reads past the copy.
+/// </summary>
+const UINT64 STACK_CAPTURE_UNWIND_MARGIN = 16 * 1024;
+
+/// <summary>
+/// Captures the stack of another thread in this process. The thread is only suspended while its registers and stack are
+/// copied, as anything more (allocating, or looking up unwind data) may need a lock the thread holds. The copy is unwound
+/// once the thread has resumed, after rebasing any pointers into the stack (registers, and saved frame pointers) onto it.
+/// </summary>
+/// <param name="thread">The thread to capture, opened with THREAD_SUSPEND_RESUME and THREAD_GET_CONTEXT access.</param>
+/// <param name="stackCopy">A buffer to copy the thread's stack into. Frames beyond it are not unwound.</param>
+/// <param name="stackCopySize">The size of the stack copy buffer, in bytes.</param>
+/// <param name="frames">The frames captured: the instruction pointer, followed by return addresses.</param>
+/// <param name="maxFrames">The maximum amount of frames to capture.</param>
+/// <param name="functionStarts">Indicates whether frames should be the start of their function where it is known, rather than the exact address, so samples within a function aggregate.</param>
+/// <param name="truncated">Set to indicate whether the stack had more frames than were captured.</param>
+/// <returns>The amount of frames captured, or zero if the thread could not be captured.</returns>
+inline UINT32 StackCapture(HANDLE thread, BYTE* stackCopy, UINT64 stackCopySize, UINT64* frames, UINT32 maxFrames, BOOL functionStarts, BOOL* truncated)
+{
+	*truncated = FALSE;
+	CONTEXT context;
+	memset(&context, 0, sizeof(context));
+	context.ContextFlags = CONTEXT_FULL;
+	if (SuspendThread(thread) == (DWORD)-1)
+		return 0;
+	UINT64 stackBottom = 0;
+	UINT64 stackSize = 0;
+	BOOL stackTruncated = FALSE;
+	if (GetThreadContext(thread, &context))
+	{
+		// The committed region containing the stack pointer extends up to the base of the stack.
+		MEMORY_BASIC_INFORMATION region;
+		if (VirtualQuery((LPCVOID)context.Rsp, &region, sizeof(region)) != 0)
+		{
+			stackBottom = context.Rsp;
+			stackSize = (UINT64)region.BaseAddress + region.RegionSize - stackBottom;
+			stackTruncated = stackSize > stackCopySize;
+			stackSize = min(stackSize, stackCopySize);
+			memcpy(stackCopy, (VOID*)stackBottom, stackSize);
+		}
+	}
+	ResumeThread(thread);
+	if (stackSize == 0)
+		return 0;
+
+	// Rebase any pointers into the stack (registers, and saved frame pointers within it) onto our copy.
+	UINT64 stackTop = stackBottom + stackSize;
+	UINT64 copyBottom = (UINT64)stackCopy;
+	UINT64 rebase = copyBottom - stackBottom;
+	DWORD64* registers[] = { &context.Rax, &context.Rcx, &context.Rdx, &context.Rbx, &context.Rsp, &context.Rbp, &context.Rsi, &context.Rdi,
+		&context.R8, &context.R9, &context.R10, &context.R11, &context.R12, &context.R13, &context.R14, &context.R15 };
+	for (UINT32 i = 0; i < ARRAYSIZE(registers); i++)
+	{
+		if (*registers[i] >= stackBottom && *registers[i] < stackTop)
+			*registers[i] += rebase;
+	}
+	UINT64* words = (UINT64*)stackCopy;
+	for (UINT64 i = 0; i < stackSize / sizeof(UINT64); i++)
+	{
+		if (words[i] >= stackBottom && words[i] < stackTop)
+			words[i] += rebase;
+	}
+
+	// Unwind the copy, recording each frame until we leave it.
+	UINT64 copyEnd = copyBottom + stackSize - (stackTruncated ? min(STACK_CAPTURE_UNWIND_MARGIN, stackSize) : 0);
+	UINT32 frameCount = 0;
+	while (context.Rip != 0)
+	{
+		if (frameCount == maxFrames)
+		{
+			*truncated = TRUE;
+			break;
+		}
+		DWORD64 imageBase = 0;
+		PRUNTIME_FUNCTION function = RtlLookupFunctionEntry(context.Rip, &imageBase, NULL);
+		frames[frameCount++] = functionStarts && function != NULL ? imageBase + function->BeginAddress : context.Rip;
+		if (context.Rsp < copyBottom || context.Rsp + sizeof(UINT64) > copyEnd)
+		{
+			*truncated = stackTruncated;
+			break;
+		}
+
+		if (function != NULL)
+		{
+			PVOID handlerData = NULL;
+			DWORD64 establisherFrame = 0;
+			RtlVirtualUnwind(UNW_FLAG_NHANDLER, imageBase, context.Rip, function, &context, &handlerData, &establisherFrame, NULL);
+		}
+		else
+		{
+			// Leaf functions have no unwind data, and leave their return address at the top of the stack.
+			context.Rip = *(UINT64*)context.Rsp;
+			context.Rsp += sizeof(UINT64);
+		}
+	}
+	return frameCount;
+}
@@ -0,0 +1,258 @@
+#pragma once
+
+#include <atomic>
+#include "pch.h"
+#include "echovr.h"
+
+/// <summary>
+/// The format of the name of the shared memory region holding a game process's startup trace, keyed by process identifier.
+/// Both the patch and game server libraries record into the same region, so their phases share one timeline.
+/// </summary>
+#define STARTUP_TRACE_NAME_FORMAT "Local\\EchoRelay.StartupTrace.%u"
+
+/// <summary>
+/// The directory (relative to the game's working directory) trace files are written to.
+/// </summary>
+#define TRACE_DIRECTORY "_local\\traces"
+
+/// <summary>
+/// A magic value identifying a startup trace region ("ERST").
+/// </summary>
+const UINT32 STARTUP_TRACE_MAGIC = 0x54535245;
+
+/// <summary>
+/// The version of the startup trace layout. This must be incremented whenever the layout changes.
+/// </summary>
+const UINT32 STARTUP_TRACE_VERSION = 1;
+
+/// <summary>
+/// The maximum amount of events recorded in a startup trace. Events beyond this are dropped.
+/// </summary>
+const UINT32 STARTUP_TRACE_MAX_EVENTS = 128;
+
+/// <summary>
+/// An invalid startup trace event index, returned when an event could not be recorded.
+/// </summary>
+const UINT32 STARTUP_TRACE_INVALID_EVENT = 0xFFFFFFFF;
+
+/// <summary>
+/// A single phase (or instant) recorded in a startup trace.
+/// </summary>
+struct StartupTraceEvent
+{
+	INT64 begin; // 0x00 (QueryPerformanceCounter)
+	INT64 end; // 0x08 (QueryPerformanceCounter, zero while the phase is in progress)
+	UINT32 threadId; // 0x10
+	BOOL instant; // 0x14
+	CHAR category[16]; // 0x18
+	CHAR name[48]; // 0x28
+};
+static_assert(sizeof(StartupTraceEvent) == 0x58, "StartupTraceEvent layout changed, update STARTUP_TRACE_VERSION.");
+
+/// <summary>
+/// A startup trace region, shared between the libraries loaded into a game process.
+/// </summary>
+struct StartupTrace
+{
+	UINT32 magic; // 0x00
+	UINT32 version; // 0x04
+	UINT32 processId; // 0x08
+	BYTE padding[4]; // 0x0C
+	INT64 frequency; // 0x10 (QueryPerformanceFrequency)
+	INT64 processStartTimestamp; // 0x18 (QueryPerformanceCounter equivalent of the process creation time)
+	std::atomic<UINT32> eventCount; // 0x20
+	std::atomic<BOOL> written; // 0x24
+	StartupTraceEvent events[STARTUP_TRACE_MAX_EVENTS]; // 0x28
+};
+static_assert(offsetof(StartupTrace, events) == 0x28, "StartupTrace layout changed, update STARTUP_TRACE_VERSION.");
+
+/// <summary>
+/// Opens (creating if necessary) the startup trace region for the current process.
+/// </summary>
+/// <param name="hMapping">The handle to the file mapping, to be provided when closing the trace.</param>
+/// <returns>The mapped startup trace, or NULL if it could not be opened.</returns>
+inline StartupTrace* StartupTraceOpen(HANDLE* hMapping)
+{
+	// Open or create the file mapping for our process.
+	CHAR name[64];
+	sprintf_s(name, STARTUP_TRACE_NAME_FORMAT, GetCurrentProcessId());
+	*hMapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(StartupTrace), name);
+	if (*hMapping == NULL)
+		return NULL;
+	StartupTrace* trace = (StartupTrace*)MapViewOfFile(*hMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(StartupTrace));
+	if (trace == NULL)
+	{
+		CloseHandle(*hMapping);
+		*hMapping = NULL;
+		return NULL;
+	}
+
+	// If we created the region, initialize the header. Libraries are attached under the loader lock, so only one can get here at a time.
+	if (trace->magic != STARTUP_TRACE_MAGIC)
+	{
+		// Obtain the timestamp equivalent of the process creation time, so time spent before our libraries loaded is visible.
+		LARGE_INTEGER frequency, now;
+		FILETIME creationTime, exitTime, kernelTime, userTime, currentTime;
+		QueryPerformanceFrequency(&frequency);
+		QueryPerformanceCounter(&now);
+		GetSystemTimePreciseAsFileTime(&currentTime);
+		GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime);
+		ULONGLONG sinceCreation = (((ULONGLONG)currentTime.dwHighDateTime << 32) | currentTime.dwLowDateTime) - (((ULONGLONG)creationTime.dwHighDateTime << 32) | creationTime.dwLowDateTime);
+
+		trace->version = STARTUP_TRACE_VERSION;
+		trace->processId = GetCurrentProcessId();
+		trace->frequency = frequency.QuadPart;
+		trace->processStartTimestamp = now.QuadPart - (INT64)(sinceCreation * frequency.QuadPart / 10000000);
+		trace->magic = STARTUP_TRACE_MAGIC;
+	}
+	else if (trace->version != STARTUP_TRACE_VERSION)
+	{
+		// The region was created by an incompatible version of the other library.
+		UnmapViewOfFile(trace);
+		CloseHandle(*hMapping);
+		*hMapping = NULL;
+		return NULL;
+	}
+	return trace;
+}
+
+/// <summary>
+/// Unmaps a startup trace region and closes its file mapping.
+/// </summary>
+/// <param name="trace">The trace to unmap.</param>
+/// <param name="hMapping">The handle to the file mapping obtained when opening the trace.</param>
+/// <returns>None</returns>
+inline VOID StartupTraceClose(StartupTrace* trace, HANDLE hMapping)
+{
+	if (trace != NULL)
+		UnmapViewOfFile(trace);
+	if (hMapping != NULL)
+		CloseHandle(hMapping);
+}
+
+/// <summary>
+/// Records an event in the startup trace.
+/// </summary>
+/// <param name="trace">The trace to record in, or NULL if tracing is unavailable.</param>
+/// <param name="category">The category of the event (the library or subsystem recording it).</param>
+/// <param name="name">The name of the phase or instant.</param>
+/// <param name="begin">The timestamp at which the phase began.</param>
+/// <param name="end">The timestamp at which the phase ended, or zero if it is still in progress.</param>
+/// <param name="instant">Indicates whether the event is an instant, rather than a phase.</param>
+/// <returns>The index of the recorded event, or STARTUP_TRACE_INVALID_EVENT if it was not recorded.</returns>
+inline UINT32 StartupTraceRecord(StartupTrace* trace, const CHAR* category, const CHAR* name, INT64 begin, INT64 end, BOOL instant)
+{
+	// Once the trace has been written, startup is over and we stop recording.
+	if (trace == NULL || trace->written.load(std::memory_order_relaxed))
+		return STARTUP_TRACE_INVALID_EVENT;
+
+	UINT32 index = trace->eventCount.fetch_add(1, std::memory_order_relaxed);
+	if (index >= STARTUP_TRACE_MAX_EVENTS)
+		return STARTUP_TRACE_INVALID_EVENT;
+
+	StartupTraceEvent* evt = &trace->events[index];
+	evt->begin = begin;
+	evt->end = end;
+	evt->threadId = GetCurrentThreadId();
+	evt->instant = instant;
+	strncpy_s(evt->category, category, _TRUNCATE);
+	strncpy_s(evt->name, name, _TRUNCATE);
+	return index;
+}
+
+/// <summary>
+/// Obtains the current timestamp for the startup trace.
+/// </summary>
+/// <returns>The current QueryPerformanceCounter value.</returns>
+inline INT64 StartupTraceNow()
+{
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return now.QuadPart;
+}
+
+/// <summary>
+/// Begins a phase in the startup trace.
+/// </summary>
+/// <param name="trace">The trace to record in, or NULL if tracing is unavailable.</param>
+/// <param name="category">The category of the phase (the library or subsystem recording it).</param>
+/// <param name="name">The name of the phase.</param>
+/// <returns>The index of the phase, to be provided to <see cref="StartupTraceEnd"/>.</returns>
+inline UINT32 StartupTraceBegin(StartupTrace* trace, const CHAR* category, const CHAR* name)
+{
+	return StartupTraceRecord(trace, category, name, StartupTraceNow(), 0, FALSE);
+}
+
+/// <summary>
+/// Ends a phase in the startup trace.
+/// </summary>
+/// <param name="trace">The trace to record in, or NULL if tracing is unavailable.</param>
+/// <param name="index">The index of the phase obtained from <see cref="StartupTraceBegin"/>.</param>
+/// <returns>None</returns>
+inline VOID StartupTraceEnd(StartupTrace* trace, UINT32 index)
+{
+	if (trace != NULL && index < STARTUP_TRACE_MAX_EVENTS)
+		trace->events[index].end = StartupTraceNow();
+}
+
+/// <summary>
+/// Records an instant in the startup trace.
+/// </summary>
+/// <param name="trace">The trace to record in, or NULL if tracing is unavailable.</param>
+/// <param name="category">The category of the instant (the library or subsystem recording it).</param>
+/// <param name="name">The name of the instant.</param>
+/// <returns>None</returns>
+inline VOID StartupTraceInstant(StartupTrace* trace, const CHAR* category, const CHAR* name)
+{
+	INT64 now = StartupTraceNow();
+	StartupTraceRecord(trace, category, name, now, now, TRUE);
+}
+
+/// <summary>
+/// Writes the startup trace to a Chrome trace event JSON file in <see cref="TRACE_DIRECTORY"/>, which can be opened in
+/// chrome://tracing or Perfetto. Only the first call writes the trace; recording stops afterwards. Phases which are still
+/// in progress are written as ending at the time of writing.
+/// </summary>
+/// <param name="trace">The trace to write.</param>
+/// <returns>TRUE if the trace was written, FALSE otherwise.</returns>
+inline BOOL StartupTraceWrite(StartupTrace* trace)
+{
+	// Only write the trace once.
+	if (trace == NULL || trace->written.exchange(TRUE))
+		return FALSE;
+
+	// Create the output file.
+	CHAR path[MAX_PATH];
+	CreateDirectoryA("_local", NULL);
+	CreateDirectoryA(TRACE_DIRECTORY, NULL);
+	sprintf_s(path, TRACE_DIRECTORY "\\startup.%u.json", trace->processId);
+	FILE* file = NULL;
+	if (fopen_s(&file, path, "w") != 0 || file == NULL)
+		return FALSE;
+
+	// Write each event, with timestamps in microseconds since the process was created.
+	INT64 now = StartupTraceNow();
+	UINT32 eventCount = min(trace->eventCount.load(std::memory_order_relaxed), STARTUP_TRACE_MAX_EVENTS);
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,\"args\":{\"name\":\"echovr.exe (startup)\"}}", trace->processId);
+	for (UINT32 i = 0; i < eventCount; i++)
+	{
+		const StartupTraceEvent* evt = &trace->events[i];
+		double begin = (double)(evt->begin - trace->processStartTimestamp) * 1000000.0 / trace->frequency;
+		if (evt->instant)
+		{
+			fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"p\",\"ts\":%.3f,\"pid\":%u,\"tid\":%u}",
+				evt->name, evt->category, begin, trace->processId, evt->threadId);
+		}
+		else
+		{
+			INT64 end = evt->end != 0 ? evt->end : now;
+			double duration = (double)(end - evt->begin) * 1000000.0 / trace->frequency;
+			fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%u,\"tid\":%u,\"args\":{\"completed\":%s}}",
+				evt->name, evt->category, begin, duration, trace->processId, evt->threadId, evt->end != 0 ? "true" : "false");
+		}
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	return TRUE;
+}
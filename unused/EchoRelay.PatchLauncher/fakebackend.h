@@ -0,0 +1,87 @@
+#pragma once
+
+#include <map>
+#include "supervisor.h"
+
+/// <summary>
+/// A fake instance backend which simulates game server processes, used to exercise the <see cref="FleetSupervisor"/>
+/// scheduling logic without launching the game. Instances register a fixed time after launch, and sessions, exits and
+/// launch failures are driven by the caller.
+/// </summary>
+class FakeInstanceBackend : public InstanceBackend
+{
+public:
+    /// <summary>
+    /// Initializes a fake backend.
+    /// </summary>
+    /// <param name="clock">A pointer to the current simulated time, in milliseconds.</param>
+    /// <param name="bootDurationMs">The time it takes a simulated instance to register after launch, in milliseconds.</param>
+    FakeInstanceBackend(const uint64_t* clock, uint64_t bootDurationMs)
+        : clock(clock), bootDurationMs(bootDurationMs), nextId(1), failLaunches(0)
+    {
+    }
+
+    bool Launch(uint64_t* instanceId) override
+    {
+        if (failLaunches > 0)
+        {
+            failLaunches--;
+            return false;
+        }
+        *instanceId = nextId++;
+        FakeInstance instance = { *clock, InstanceState::Booting };
+        fakeInstances[*instanceId] = instance;
+        return true;
+    }
+
+    InstanceState Poll(uint64_t instanceId) override
+    {
+        // Simulated instances register once their boot duration has elapsed.
+        FakeInstance& instance = fakeInstances[instanceId];
+        if (instance.state == InstanceState::Booting && *clock - instance.launchTime >= bootDurationMs)
+            instance.state = InstanceState::Idle;
+        return instance.state;
+    }
+
+    void Terminate(uint64_t instanceId) override
+    {
+        fakeInstances[instanceId].state = InstanceState::Exited;
+    }
+
+    void Release(uint64_t instanceId) override
+    {
+        fakeInstances.erase(instanceId);
+    }
+
+    /// <summary>
+    /// Sets the state of a simulated instance, to simulate sessions starting/ending or the process exiting.
+    /// </summary>
+    /// <param name="instanceId">The identifier of the instance to update.</param>
+    /// <param name="state">The state to set.</param>
+    void SetState(uint64_t instanceId, InstanceState state)
+    {
+        fakeInstances[instanceId].state = state;
+    }
+
+    /// <summary>
+    /// Causes the next given amount of launches to fail.
+    /// </summary>
+    /// <param name="count">The amount of launches to fail.</param>
+    void FailLaunches(uint32_t count)
+    {
+        failLaunches = count;
+    }
+
+private:
+    struct FakeInstance
+    {
+        uint64_t launchTime;
+        InstanceState state;
+    };
+
+    const uint64_t* clock;
+    uint64_t bootDurationMs;
+    uint64_t nextId;
+    uint32_t failLaunches;
+    std::map<uint64_t, FakeInstance> fakeInstances;
+};
@@ -1,12 +1,194 @@
 #include <iostream>
+#include <map>
+#include <random>
+#include <string>
 #include "pch.h"
 #include <locale>
 #include <codecvt>
+#include <shellapi.h>
 #include <detours.h>
+#include "echovr.h"
+#include "lobbysnapshot.h"
+#include "supervisor.h"
+#include "fakebackend.h"
 
 // Note: A lazy hack here for Windows systems which enable paths longer than MAX_PATH.
 #define PATH_SIZE   (MAX_PATH * 10)
 
+/// <summary>
+/// The interval at which the fleet supervisor polls its instances, in milliseconds.
+/// </summary>
+#define FLEET_TICK_INTERVAL_MS      1000
+/// <summary>
+/// The interval at which the fleet supervisor prints its statistics, in milliseconds.
+/// </summary>
+#define FLEET_STATS_INTERVAL_MS     60000
+
+/// <summary>
+/// An instance backend which launches game server processes with the patch DLL injected, observing their
+/// registration and session state through the lobby snapshot each game server publishes to shared memory.
+/// </summary>
+class ProcessInstanceBackend : public InstanceBackend
+{
+public:
+    ProcessInstanceBackend(const WCHAR* gameExe, const CHAR* patchDll, const std::wstring& args)
+        : gameExe(gameExe), patchDll(patchDll), args(args)
+    {
+    }
+
+    bool Launch(uint64_t* instanceId) override
+    {
+        // Clone the command line arguments to a writeable buffer.
+        std::vector<WCHAR> sArgs(args.begin(), args.end());
+        sArgs.push_back(L'\0');
+
+        // Create the process in a suspended state with our injected DLLs, then resume it.
+        STARTUPINFO StartupInfo = { 0 };
+        PROCESS_INFORMATION ProcInfo = { 0 };
+        StartupInfo.cb = sizeof(STARTUPINFO);
+        LPCSTR dllsToInject[] = { patchDll.c_str() };
+        if (DetourCreateProcessWithDlls(gameExe.c_str(), sArgs.data(), NULL, NULL, FALSE, CREATE_SUSPENDED | CREATE_NEW_CONSOLE, NULL,
+            NULL, &StartupInfo, &ProcInfo, ARRAYSIZE(dllsToInject), dllsToInject, NULL) == FALSE)
+            return false;
+        ResumeThread(ProcInfo.hThread);
+        CloseHandle(ProcInfo.hThread);
+
+        // Track the process by its identifier. The lobby snapshot is opened once the game server library creates it.
+        ProcessInstance instance = { ProcInfo.hProcess, NULL, NULL };
+        processes[ProcInfo.dwProcessId] = instance;
+        *instanceId = ProcInfo.dwProcessId;
+        return true;
+    }
+
+    InstanceState Poll(uint64_t instanceId) override
+    {
+        // If the process exited, report it.
+        ProcessInstance& instance = processes[instanceId];
+        if (WaitForSingleObject(instance.hProcess, 0) == WAIT_OBJECT_0)
+            return InstanceState::Exited;
+
+        // Open the lobby snapshot if we haven't yet. It only exists once the game server library has initialized.
+        if (instance.snapshot == NULL)
+            instance.snapshot = LobbySnapshotOpen((DWORD)instanceId, FALSE, &instance.hMapping);
+        LobbySnapshotData data;
+        if (instance.snapshot == NULL || !LobbySnapshotRead(instance.snapshot, &data) || !data.registered)
+            return InstanceState::Booting;
+
+        // A registered instance is busy if it has entrants or is loading/running a level.
+        EchoVR::NetGameState netGameState = (EchoVR::NetGameState)instance.snapshot->netGameState.load(std::memory_order_relaxed);
+        if (data.entrantCount > 0 || netGameState == EchoVR::NetGameState::LoadingLevel || netGameState == EchoVR::NetGameState::ReadyForGame || netGameState == EchoVR::NetGameState::InGame)
+            return InstanceState::Busy;
+        return InstanceState::Idle;
+    }
+
+    void Terminate(uint64_t instanceId) override
+    {
+        TerminateProcess(processes[instanceId].hProcess, 1);
+    }
+
+    void Release(uint64_t instanceId) override
+    {
+        ProcessInstance& instance = processes[instanceId];
+        LobbySnapshotClose(instance.snapshot, instance.hMapping);
+        CloseHandle(instance.hProcess);
+        processes.erase(instanceId);
+    }
+
+private:
+    struct ProcessInstance
+    {
+        HANDLE hProcess;
+        HANDLE hMapping;
+        LobbySnapshot* snapshot;
+    };
+
+    std::wstring gameExe;
+    std::string patchDll;
+    std::wstring args;
+    std::map<uint64_t, ProcessInstance> processes;
+};
+
+/// <summary>
+/// Prints the statistics gathered by a fleet supervisor.
+/// </summary>
+/// <param name="supervisor">The supervisor to print statistics for.</param>
+/// <returns>None</returns>
+VOID PrintFleetStatistics(const FleetSupervisor& supervisor)
+{
+    const FleetStatistics& stats = supervisor.GetStatistics();
+    printf("[FLEET] instances: booting=%u idle=%u busy=%u | launches=%llu failures=%llu exits=%llu boot_timeouts=%llu\n",
+        supervisor.CountInstances(InstanceState::Booting), supervisor.CountInstances(InstanceState::Idle), supervisor.CountInstances(InstanceState::Busy),
+        stats.launches, stats.launchFailures, stats.exits, stats.bootTimeouts);
+    if (stats.registrations > 0)
+        printf("[FLEET] boot to registered: min=%llums avg=%llums max=%llums (%llu registrations)\n",
+            stats.bootToRegisteredMinMs, stats.bootToRegisteredTotalMs / stats.registrations, stats.bootToRegisteredMaxMs, stats.registrations);
+}
+
+/// <summary>
+/// Runs a fleet supervisor until the launcher is closed.
+/// </summary>
+/// <param name="supervisor">The supervisor to run.</param>
+/// <returns>None</returns>
+VOID RunFleet(FleetSupervisor& supervisor)
+{
+    // Log instance state transitions, including boot times as instances register.
+    supervisor.OnInstanceStateChanged = [](const SupervisedInstance& instance, InstanceState previousState) {
+        if (previousState == InstanceState::Booting && instance.registeredTime != 0 && instance.state != InstanceState::Exited)
+            printf("[FLEET] instance %llu registered after %llums\n", instance.id, instance.registeredTime - instance.launchTime);
+        printf("[FLEET] instance %llu: %s -> %s\n", instance.id, GetInstanceStateName(previousState), GetInstanceStateName(instance.state));
+    };
+
+    // Tick the supervisor at a fixed interval, printing statistics periodically.
+    ULONGLONG lastStatsTime = GetTickCount64();
+    while (true)
+    {
+        ULONGLONG now = GetTickCount64();
+        supervisor.Tick(now);
+        if (now - lastStatsTime >= FLEET_STATS_INTERVAL_MS)
+        {
+            PrintFleetStatistics(supervisor);
+            lastStatsTime = now;
+        }
+        Sleep(FLEET_TICK_INTERVAL_MS);
+    }
+}
+
+/// <summary>
+/// Runs a fleet supervisor against a fake backend for a simulated period, with random session assignments
+/// and crashes, to preview how a given configuration schedules launches without starting the game.
+/// </summary>
+/// <param name="config">The supervisor configuration to simulate.</param>
+/// <param name="durationMs">The simulated duration, in milliseconds.</param>
+/// <returns>None</returns>
+VOID SimulateFleet(const FleetSupervisorConfig& config, uint64_t durationMs)
+{
+    // Simulated instances take 90 seconds to register. Each tick, an idle instance may receive a session,
+    // a busy instance may finish its session, and any instance may crash.
+    uint64_t now = 0;
+    std::mt19937 random(0);
+    std::uniform_real_distribution<double> chance(0.0, 1.0);
+    FakeInstanceBackend backend(&now, 90000);
+    FleetSupervisor supervisor(&backend, config);
+    supervisor.OnInstanceStateChanged = [&now](const SupervisedInstance& instance, InstanceState previousState) {
+        printf("[FLEET] +%6.1fs instance %llu: %s -> %s\n", now / 1000.0, instance.id, GetInstanceStateName(previousState), GetInstanceStateName(instance.state));
+    };
+    for (; now < durationMs; now += FLEET_TICK_INTERVAL_MS)
+    {
+        for (const SupervisedInstance& instance : supervisor.GetInstances())
+        {
+            if (instance.state == InstanceState::Idle && chance(random) < 0.01)
+                backend.SetState(instance.id, InstanceState::Busy);
+            else if (instance.state == InstanceState::Busy && chance(random) < 0.005)
+                backend.SetState(instance.id, InstanceState::Idle);
+            else if (chance(random) < 0.0005)
+                backend.SetState(instance.id, InstanceState::Exited);
+        }
+        supervisor.Tick(now);
+    }
+    PrintFleetStatistics(supervisor);
+    supervisor.Shutdown();
+}
+
 int main()
 {
     // Define our game and patch paths.
@@ -39,6 +221,60 @@ int main()
     // Get the command line arguments
     LPWSTR sOriginalArgs = GetCommandLineW();
 
+    // Parse our fleet supervisor arguments. If a fleet was requested, any remaining arguments are forwarded to each instance.
+    int argc = 0;
+    LPWSTR* argv = CommandLineToArgvW(sOriginalArgs, &argc);
+    BOOL fleet = FALSE;
+    BOOL simulate = FALSE;
+    FleetSupervisorConfig fleetConfig;
+    std::wstring forwardedArgs;
+    for (int i = 0; argv != NULL && i < argc; i++)
+    {
+        BOOL hasValue = i + 1 < argc;
+        if (wcscmp(argv[i], L"-fleet") == 0 && hasValue)
+        {
+            fleet = TRUE;
+            fleetConfig.standbyCount = wcstoul(argv[++i], NULL, 10);
+        }
+        else if (wcscmp(argv[i], L"-fleet-max") == 0 && hasValue)
+            fleetConfig.maxInstances = wcstoul(argv[++i], NULL, 10);
+        else if (wcscmp(argv[i], L"-fleet-concurrent-boots") == 0 && hasValue)
+            fleetConfig.maxConcurrentBoots = wcstoul(argv[++i], NULL, 10);
+        else if (wcscmp(argv[i], L"-fleet-stagger") == 0 && hasValue)
+            fleetConfig.launchStaggerMs = wcstoull(argv[++i], NULL, 10);
+        else if (wcscmp(argv[i], L"-fleet-boot-timeout") == 0 && hasValue)
+            fleetConfig.bootTimeoutMs = wcstoull(argv[++i], NULL, 10);
+        else if (wcscmp(argv[i], L"-fleet-simulate") == 0)
+            simulate = TRUE;
+        else
+        {
+            // Forward the argument, quoting it if required.
+            if (!forwardedArgs.empty())
+                forwardedArgs += L" ";
+            if (wcschr(argv[i], L' ') != NULL)
+                forwardedArgs += std::wstring(L"\"") + argv[i] + L"\"";
+            else
+                forwardedArgs += argv[i];
+        }
+    }
+    if (argv != NULL)
+        LocalFree(argv);
+
+    // If a fleet was requested, supervise it rather than launching a single instance.
+    if (fleet)
+    {
+        if (simulate)
+        {
+            SimulateFleet(fleetConfig, 60 * 60 * 1000);
+            return 0;
+        }
+
+        ProcessInstanceBackend backend(sGameExe, sPatchDll, forwardedArgs);
+        FleetSupervisor supervisor(&backend, fleetConfig);
+        RunFleet(supervisor);
+        return 0;
+    }
+
     // Clone the command line arguments to a writeable buffer.
     size_t szArgsLen = wcslen(sOriginalArgs) * sizeof(WCHAR) + 1;
     WCHAR* sArgs = (WCHAR*)malloc(szArgsLen);
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include "supervisor.h"
+
+const char* GetInstanceStateName(InstanceState state)
+{
+    switch (state)
+    {
+    case InstanceState::Booting: return "booting";
+    case InstanceState::Idle: return "idle";
+    case InstanceState::Busy: return "busy";
+    case InstanceState::Exited: return "exited";
+    default: return "unknown";
+    }
+}
+
+FleetSupervisor::FleetSupervisor(InstanceBackend* backend, const FleetSupervisorConfig& config)
+    : backend(backend), config(config), lastLaunchTime(0), hasLaunched(false), pendingReplacements(0)
+{
+}
+
+/// <summary>
+/// Transitions an instance to a new state, tracking registration times and firing the state changed event.
+/// </summary>
+/// <param name="instance">The instance to transition.</param>
+/// <param name="state">The state to transition to.</param>
+/// <param name="now">The current time, in milliseconds.</param>
+void FleetSupervisor::SetState(SupervisedInstance* instance, InstanceState state, uint64_t now)
+{
+    InstanceState previousState = instance->state;
+    instance->state = state;
+
+    // If the instance registered for the first time, track its boot time.
+    if (previousState == InstanceState::Booting && (state == InstanceState::Idle || state == InstanceState::Busy))
+    {
+        instance->registeredTime = now;
+        uint64_t bootTime = now - instance->launchTime;
+        statistics.bootToRegisteredMinMs = statistics.registrations == 0 ? bootTime : std::min(statistics.bootToRegisteredMinMs, bootTime);
+        statistics.bootToRegisteredMaxMs = std::max(statistics.bootToRegisteredMaxMs, bootTime);
+        statistics.bootToRegisteredTotalMs += bootTime;
+        statistics.registrations++;
+    }
+
+    // If the instance exited, schedule its replacement.
+    if (state == InstanceState::Exited)
+    {
+        statistics.exits++;
+        pendingReplacements++;
+    }
+
+    if (OnInstanceStateChanged)
+        OnInstanceStateChanged(*instance, previousState);
+}
+
+void FleetSupervisor::Tick(uint64_t now)
+{
+    // Poll every instance for state changes, terminating any which are taking too long to boot.
+    for (SupervisedInstance& instance : instances)
+    {
+        InstanceState state = backend->Poll(instance.id);
+        if (state == InstanceState::Booting && now - instance.launchTime >= config.bootTimeoutMs)
+        {
+            backend->Terminate(instance.id);
+            statistics.bootTimeouts++;
+            state = InstanceState::Exited;
+        }
+        if (state != instance.state)
+            SetState(&instance, state, now);
+    }
+
+    // Release and remove any exited instances.
+    for (const SupervisedInstance& instance : instances)
+    {
+        if (instance.state == InstanceState::Exited)
+            backend->Release(instance.id);
+    }
+    instances.erase(std::remove_if(instances.begin(), instances.end(), [](const SupervisedInstance& instance) { return instance.state == InstanceState::Exited; }), instances.end());
+
+    // Launch instances until the standby pool is satisfied, or we reach a limit.
+    while (true)
+    {
+        // If we have enough warm instances, any pending replacements are no longer needed.
+        uint32_t booting = CountInstances(InstanceState::Booting);
+        uint32_t warm = booting + CountInstances(InstanceState::Idle);
+        if (warm >= config.standbyCount)
+        {
+            pendingReplacements = 0;
+            break;
+        }
+
+        // Respect our instance limits.
+        if (instances.size() >= config.maxInstances || booting >= config.maxConcurrentBoots)
+            break;
+
+        // Replacements for exited instances are launched immediately, but growing the pool is staggered.
+        bool replacement = pendingReplacements > 0;
+        if (!replacement && hasLaunched && now - lastLaunchTime < config.launchStaggerMs)
+            break;
+
+        // Launch the instance. If the launch failed, drop any pending replacements, so that retries are staggered.
+        lastLaunchTime = now;
+        hasLaunched = true;
+        SupervisedInstance instance = { 0, InstanceState::Booting, now, 0 };
+        if (!backend->Launch(&instance.id))
+        {
+            statistics.launchFailures++;
+            pendingReplacements = 0;
+            break;
+        }
+        statistics.launches++;
+        if (replacement)
+            pendingReplacements--;
+        instances.push_back(instance);
+        if (OnInstanceStateChanged)
+            OnInstanceStateChanged(instance, InstanceState::Exited);
+    }
+}
+
+void FleetSupervisor::Shutdown()
+{
+    for (const SupervisedInstance& instance : instances)
+    {
+        backend->Terminate(instance.id);
+        backend->Release(instance.id);
+    }
+    instances.clear();
+    pendingReplacements = 0;
+}
+
+uint32_t FleetSupervisor::CountInstances(InstanceState state) const
+{
+    return (uint32_t)std::count_if(instances.begin(), instances.end(), [state](const SupervisedInstance& instance) { return instance.state == state; });
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+// Note: The supervisor's scheduling logic is kept free of any Windows dependencies, so it can be exercised with
+// a fake process backend on any platform. Process management lives in the backend implementations.
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/// <summary>
+/// The state of a supervised game server instance.
+/// </summary>
+enum class InstanceState
+{
+    /// <summary>
+    /// The instance was launched, but has not yet registered with ServerDB.
+    /// </summary>
+    Booting,
+    /// <summary>
+    /// The instance is registered with ServerDB and is not hosting a session (a warm standby).
+    /// </summary>
+    Idle,
+    /// <summary>
+    /// The instance is registered with ServerDB and is hosting a session.
+    /// </summary>
+    Busy,
+    /// <summary>
+    /// The instance's process has exited.
+    /// </summary>
+    Exited,
+};
+
+/// <summary>
+/// Obtains a display name for a given instance state.
+/// </summary>
+/// <param name="state">The state to obtain the name for.</param>
+/// <returns>The name of the instance state.</returns>
+const char* GetInstanceStateName(InstanceState state);
+
+/// <summary>
+/// A backend which launches and observes game server instances on behalf of a <see cref="FleetSupervisor"/>.
+/// </summary>
+class InstanceBackend
+{
+public:
+    virtual ~InstanceBackend() {}
+
+    /// <summary>
+    /// Launches a new game server instance.
+    /// </summary>
+    /// <param name="instanceId">The identifier of the launched instance, set if the launch succeeded.</param>
+    /// <returns>True if the instance was launched, false otherwise.</returns>
+    virtual bool Launch(uint64_t* instanceId) = 0;
+
+    /// <summary>
+    /// Obtains the current state of a launched instance.
+    /// </summary>
+    /// <param name="instanceId">The identifier of the instance to poll.</param>
+    /// <returns>The current state of the instance.</returns>
+    virtual InstanceState Poll(uint64_t instanceId) = 0;
+
+    /// <summary>
+    /// Forcefully terminates a launched instance.
+    /// </summary>
+    /// <param name="instanceId">The identifier of the instance to terminate.</param>
+    virtual void Terminate(uint64_t instanceId) = 0;
+
+    /// <summary>
+    /// Releases any resources held for an instance which has exited. The identifier is not used after this call.
+    /// </summary>
+    /// <param name="instanceId">The identifier of the instance to release.</param>
+    virtual void Release(uint64_t instanceId) = 0;
+};
+
+/// <summary>
+/// Configuration for a <see cref="FleetSupervisor"/>.
+/// </summary>
+struct FleetSupervisorConfig
+{
+    /// <summary>
+    /// The amount of instances to keep booting or idle (registered, without a session) at all times.
+    /// </summary>
+    uint32_t standbyCount = 2;
+    /// <summary>
+    /// The maximum amount of instances to run at once, including those hosting sessions.
+    /// </summary>
+    uint32_t maxInstances = 8;
+    /// <summary>
+    /// The maximum amount of instances which may be booting at once.
+    /// </summary>
+    uint32_t maxConcurrentBoots = 1;
+    /// <summary>
+    /// The minimum time between launches when growing the pool, in milliseconds, to avoid disk/CPU storms.
+    /// Replacements for exited instances are not delayed by this.
+    /// </summary>
+    uint64_t launchStaggerMs = 10000;
+    /// <summary>
+    /// The time after which an instance which has not registered is terminated and replaced, in milliseconds.
+    /// </summary>
+    uint64_t bootTimeoutMs = 5 * 60 * 1000;
+};
+
+/// <summary>
+/// A game server instance tracked by a <see cref="FleetSupervisor"/>.
+/// </summary>
+struct SupervisedInstance
+{
+    uint64_t id;
+    InstanceState state;
+    uint64_t launchTime;
+    uint64_t registeredTime; // zero until the instance first registers
+};
+
+/// <summary>
+/// Statistics gathered by a <see cref="FleetSupervisor"/> over its lifetime.
+/// </summary>
+struct FleetStatistics
+{
+    uint64_t launches = 0;
+    uint64_t launchFailures = 0;
+    uint64_t exits = 0;
+    uint64_t bootTimeouts = 0;
+    uint64_t registrations = 0;
+    uint64_t bootToRegisteredMinMs = 0;
+    uint64_t bootToRegisteredMaxMs = 0;
+    uint64_t bootToRegisteredTotalMs = 0;
+};
+
+/// <summary>
+/// A supervisor which keeps a pool of pre-booted game server instances which have already registered with ServerDB,
+/// so a new session never waits on a cold boot. Exited instances are replaced immediately, pool growth is staggered,
+/// and the boot-to-registered time of each instance is tracked.
+/// </summary>
+class FleetSupervisor
+{
+public:
+    /// <summary>
+    /// An event fired when an instance changes state. The previous state is provided alongside the updated instance.
+    /// Newly launched instances are reported as transitioning from <see cref="InstanceState::Exited"/>.
+    /// </summary>
+    std::function<void(const SupervisedInstance& instance, InstanceState previousState)> OnInstanceStateChanged;
+
+    FleetSupervisor(InstanceBackend* backend, const FleetSupervisorConfig& config);
+
+    /// <summary>
+    /// Polls all instances and launches new ones as required. This should be called at a regular interval.
+    /// </summary>
+    /// <param name="now">The current time, in milliseconds, from a monotonic clock.</param>
+    void Tick(uint64_t now);
+
+    /// <summary>
+    /// Terminates and releases all instances.
+    /// </summary>
+    void Shutdown();
+
+    /// <summary>
+    /// Obtains the amount of instances in a given state.
+    /// </summary>
+    /// <param name="state">The state to count instances in.</param>
+    /// <returns>The amount of instances in the given state.</returns>
+    uint32_t CountInstances(InstanceState state) const;
+
+    const std::vector<SupervisedInstance>& GetInstances() const { return instances; }
+    const FleetStatistics& GetStatistics() const { return statistics; }
+
+private:
+    void SetState(SupervisedInstance* instance, InstanceState state, uint64_t now);
+
+    InstanceBackend* backend;
+    FleetSupervisorConfig config;
+    std::vector<SupervisedInstance> instances;
+    FleetStatistics statistics;
+    uint64_t lastLaunchTime;
+    bool hasLaunched;
+    uint32_t pendingReplacements;
+};